@@ -13,11 +13,19 @@ struct CommandOptions {
   std::string output;
   std::string weekday;
   std::string personality;
+  std::string trace_path;
+  std::string query;  // search
   bool json_output = false;
   bool fetch_only = false;
   bool date_offset_set = false;
+  bool fragmented = false;
+  bool faststart = false;
+  // Yields upstream requests and bandwidth to live recordings.
+  bool backfill = false;
   int duration = 0;
   int date_offset = 0;
+  int fragment_seconds = 10;
+  int limit = 20;  // search
 };
 
 }  // namespace radicc
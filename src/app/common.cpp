@@ -1,5 +1,7 @@
 #include "app/common.h"
 
+#include "utils/json.h"
+
 #include <ctime>
 
 namespace radicc {
@@ -85,28 +87,9 @@ int diff_minutes(const std::string& ft, const std::string& to) {
 }
 
 std::string json_escape(const std::string& input) {
-  static constexpr char hex[] = "0123456789ABCDEF";
   std::string escaped;
   escaped.reserve(input.size() + 8);
-  for (unsigned char c : input) {
-    switch (c) {
-      case '\\': escaped += "\\\\"; break;
-      case '"': escaped += "\\\""; break;
-      case '\b': escaped += "\\b"; break;
-      case '\f': escaped += "\\f"; break;
-      case '\n': escaped += "\\n"; break;
-      case '\r': escaped += "\\r"; break;
-      case '\t': escaped += "\\t"; break;
-      default:
-        if (c < 0x20) {
-          escaped += "\\u00";
-          escaped.push_back(hex[c >> 4]);
-          escaped.push_back(hex[c & 0x0F]);
-        } else {
-          escaped.push_back(static_cast<char>(c));
-        }
-    }
-  }
+  append_json_escaped(escaped, input);
   return escaped;
 }
 
@@ -1,11 +1,11 @@
 #include "app/list_command.h"
 
 #include "app/common.h"
+#include "app/program_json.h"
 #include "core/radiko_programs.h"
 #include "utils/date.h"
 
 #include <iostream>
-#include <sstream>
 #include <utility>
 #include <vector>
 
@@ -37,44 +37,34 @@ std::pair<std::string, std::vector<ProgramEventInfo>> resolve_programs_for_list(
 
 }  // namespace
 
-int run_list_command(const CommandOptions& options) {
+int run_list_command(const CommandOptions& options, std::ostream& out) {
   if (options.station_id.empty()) print_error_and_exit("--station-id is required for list.");
 
   auto [schedule_date, programs] = resolve_programs_for_list(options);
   if (programs.empty()) print_error_and_exit("No programs found for station/date.");
 
   if (options.json_output) {
-    std::ostringstream json;
-    json << '[';
-    for (size_t i = 0; i < programs.size(); ++i) {
-      const auto& p = programs[i];
-      if (i > 0) json << ',';
-      json << '{'
-           << "\"station_id\":\"" << json_escape(options.station_id) << "\","
-           << "\"date\":\"" << json_escape(schedule_date) << "\","
-           << "\"title\":\"" << json_escape(p.title) << "\","
-           << "\"ft\":\"" << json_escape(p.ft) << "\","
-           << "\"to\":\"" << json_escape(p.to) << "\","
-           << "\"pfm\":\"" << json_escape(p.pfm) << "\","
-           << "\"event_url\":\"" << json_escape(p.event_url) << "\","
-           << "\"url\":\"" << json_escape(build_timefree_url(options.station_id, p.ft)) << "\","
-           << "\"image_url\":\"" << json_escape(p.image_url) << "\","
-           << "\"img\":\"" << json_escape(p.img) << "\""
-           << '}';
+    // Streamed into `out` as it is built.
+    JsonWriter json(out);
+    json.begin_array();
+    for (const auto& p : programs) {
+      json.begin_object().member("station_id", options.station_id).member("date", schedule_date);
+      write_program_members(json, options.station_id, p);
+      json.end_object();
     }
-    json << ']';
-    std::cout << json.str() << std::endl;
+    json.end_array().flush();
+    out << std::endl;
     return 0;
   }
 
-  std::cout << "Station: " << options.station_id << "\n";
-  std::cout << "Date: " << schedule_date << "\n\n";
+  out << "Station: " << options.station_id << "\n";
+  out << "Date: " << schedule_date << "\n\n";
   for (const auto& p : programs) {
-    std::cout << time_hhmm(p.ft) << "-" << time_hhmm(p.to) << " | " << p.title;
-    if (!p.pfm.empty()) std::cout << " | " << p.pfm;
+    out << time_hhmm(p.ft) << "-" << time_hhmm(p.to) << " | " << p.title;
+    if (!p.pfm.empty()) out << " | " << p.pfm;
     const auto url = build_timefree_url(options.station_id, p.ft);
-    if (!url.empty()) std::cout << " | " << url;
-    std::cout << "\n";
+    if (!url.empty()) out << " | " << url;
+    out << "\n";
   }
   return 0;
 }
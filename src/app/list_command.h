@@ -2,8 +2,12 @@
 
 #include "app/command_options.h"
 
+#include <iostream>
+
 namespace radicc {
 
-int run_list_command(const CommandOptions& options);
+// Prints the schedule to `out`; radicc-server passes a buffer for thin
+// clients.
+int run_list_command(const CommandOptions& options, std::ostream& out = std::cout);
 
 }  // namespace radicc
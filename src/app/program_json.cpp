@@ -0,0 +1,18 @@
+#include "app/program_json.h"
+
+#include "app/common.h"
+
+namespace radicc {
+
+void write_program_members(JsonWriter& json, const std::string& station_id, const ProgramEventInfo& program) {
+  json.member("title", program.title)
+      .member("ft", program.ft)
+      .member("to", program.to)
+      .member("pfm", program.pfm)
+      .member("event_url", program.event_url)
+      .member("url", build_timefree_url(station_id, program.ft))
+      .member("image_url", program.image_url)
+      .member("img", program.img);
+}
+
+}  // namespace radicc
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "core/radiko_programs.h"
+#include "utils/json.h"
+
+#include <string>
+
+namespace radicc {
+
+// Members every program object in list and search output carries: title,
+// ft, to, pfm, event_url, url (the timefree URL), image_url and img.
+void write_program_members(JsonWriter& json, const std::string& station_id, const ProgramEventInfo& program);
+
+}  // namespace radicc
@@ -1,30 +1,91 @@
 #include "app/record_command.h"
 
 #include "service/record_service.h"
+#include "utils/log.h"
+#include "utils/trace.h"
 
+#include <unistd.h>
+
+#include <chrono>
+#include <condition_variable>
 #include <iostream>
+#include <mutex>
+#include <thread>
 
 namespace radicc {
+namespace {
+
+// Redraws a one-line progress summary on stderr while the recorder runs.
+class ProgressLine {
+ public:
+  explicit ProgressLine(const RecordProgress& progress) : progress_(progress) {
+    thread_ = std::thread([this]() { run(); });
+  }
+  ~ProgressLine() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    stop_.notify_all();
+    thread_.join();
+    if (drawn_) std::cerr << "\r\033[K" << std::flush;
+  }
+
+ private:
+  void run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_.wait_for(lock, std::chrono::seconds(1), [this]() { return stopping_; })) {
+      const auto snapshot = snapshot_record_progress(progress_);
+      if (snapshot.phase != RecordPhase::recording) continue;
+      std::cerr << "\r" << format_record_progress(snapshot) << "\033[K" << std::flush;
+      drawn_ = true;
+    }
+  }
+
+  const RecordProgress& progress_;
+  std::mutex mutex_;
+  std::condition_variable stop_;
+  bool stopping_ = false;
+  bool drawn_ = false;
+  std::thread thread_;
+};
+
+// Writes the trace on the way out, including when the request throws.
+class TraceFile {
+ public:
+  explicit TraceFile(const std::string& path) : path_(path) {
+    if (!path_.empty()) start_trace();
+  }
+  ~TraceFile() {
+    if (!path_.empty() && !write_trace(path_)) RADICC_LOG_ERROR << "Failed to write trace file: " << path_;
+  }
+
+ private:
+  std::string path_;
+};
+
+}  // namespace
 
 int run_record_command(const CommandOptions& options) {
-  const auto result = execute_record_request(options);
+  TraceFile trace(options.trace_path);
+  RecordProgress progress;
+  RecordObserver observer;
+  observer.progress = &progress;
+  RecordExecutionResult result;
+  if (!options.json_output && ::isatty(STDERR_FILENO)) {
+    ProgressLine line(progress);
+    result = execute_record_request(options, observer);
+  } else {
+    result = execute_record_request(options, observer);
+  }
+  flush_log();
 
   if (options.json_output) {
     std::cout << build_record_result_json(options, result) << std::endl;
     return 0;
   }
 
-  std::cout << "\n";
-  std::cout << "ID: " << (options.id.empty() ? options.target : options.id) << "\n";
-  std::cout << "Station: " << result.resolved.station_id << "\n";
-  std::cout << "Time: " << result.start_time << " - " << result.end_time << "\n";
-  std::cout << "Duration: " << result.resolved.duration << " minutes\n";
-  std::cout << "Output File: " << result.paths.filename << "\n";
-  std::cout << "pfm: " << result.resolved.pfm << "\n";
-  if (!result.paths.dir_name.empty()) std::cout << "dir: " << result.paths.dir_name << "\n";
-  std::cout << "Directory: " << result.paths.directory_path << "\n\n";
-  if (!result.resolved.image_url.empty()) std::cout << "(image url)   " << result.resolved.image_url << "\n";
-  std::cout << (result.resolved.fetch_only ? "Fetch completed successfully.\n" : "Recording completed successfully.\n");
+  std::cout << build_record_result_text(options, result);
   return 0;
 }
 
@@ -1,9 +1,11 @@
 #include "app/record_resolver.h"
 
 #include "app/common.h"
+#include "core/config_snapshot.h"
 #include "core/radiko_programs.h"
-#include "core/toml_parser.h"
 #include "core/url_parser.h"
+#include "utils/log.h"
+#include "utils/trace.h"
 
 #include <tuple>
 
@@ -33,28 +35,31 @@ void apply_url_mode(const CommandOptions& options, ResolvedRecord& resolved, int
   resolved.title = info->title;
   resolved.pfm = info->pfm;
   resolved.image_url = info->image_url;
+  if (info->image_url.empty()) resolved.event_url = info->event_url;
   if (info->ft.size() == 14 && info->to.size() == 14) {
     resolved.datetime = {info->ft.substr(0, 4), info->ft.substr(4, 4), info->ft.substr(8)};
     resolved.duration = diff_minutes(info->ft, info->to);
   }
 }
 
-void apply_toml_config(const CommandOptions& options, ResolvedRecord& resolved) {
-  auto config = !options.target.empty() ? parse_toml(options.target) : parse_toml_by_id(options.id);
-  if (config.empty() && !options.target.empty() && !options.id.empty()) config = parse_toml_by_id(options.id);
-  if (config.empty()) print_error_and_exit("Missing required configuration. Provide either -t <section> or -i <id>.");
+void apply_toml_config(const CommandOptions& options, const ConfigSnapshot& config, ResolvedRecord& resolved) {
+  if (!config.found()) RADICC_LOG_WARN << "Warning: TOML file not found. Proceeding with command-line arguments.";
+  const ProgramConfig* program =
+      !options.target.empty() ? config.find_section(options.target) : config.find_id(options.id);
+  if (!program && !options.target.empty() && !options.id.empty()) program = config.find_id(options.id);
+  if (!program) print_error_and_exit("Missing required configuration. Provide either -t <section> or -i <id>.");
 
-  resolved.station_id = config["station"];
-  resolved.title = decode_xml_entities(
-      config.count("title") ? config["title"] : (!options.target.empty() ? options.target : options.id));
-  resolved.dir_name = config.count("dir") ? config["dir"] : std::string();
-  resolved.pfm = config.count("pfm") ? config["pfm"] : std::string();
-  resolved.image_url = config.count("img") ? config["img"] : std::string();
-  if (!options.date_offset_set && config.count("date_offset")) resolved.date_offset = std::stoi(config["date_offset"]);
+  resolved.station_id = program->station;
+  resolved.title = decode_xml_entities(program->title);
+  resolved.dir_name = program->dir;
+  resolved.pfm = program->pfm;
+  resolved.image_url = program->img;
+  if (!options.date_offset_set && program->date_offset) resolved.date_offset = *program->date_offset;
 
   auto info = find_nearest_weekly_program_info(resolved.station_id, resolved.title);
   if (info) {
     if (!info->image_url.empty()) resolved.image_url = info->image_url;
+    else resolved.event_url = info->event_url;
     if (!info->pfm.empty()) resolved.pfm = info->pfm;
     if (info->ft.size() == 14 && info->to.size() == 14) {
       resolved.datetime = {info->ft.substr(0, 4), info->ft.substr(4, 4), info->ft.substr(8)};
@@ -66,19 +71,21 @@ void apply_toml_config(const CommandOptions& options, ResolvedRecord& resolved)
 }  // namespace
 
 ResolvedRecord resolve_record_command(const CommandOptions& options, int max_timefree_days) {
+  TraceSpan span("resolve_record_command");
   ResolvedRecord resolved;
   resolved.json_output = options.json_output;
   resolved.fetch_only = options.fetch_only;
   resolved.duration = options.duration;
   resolved.date_offset = options.date_offset;
 
-  const auto global_config = parse_toml_global();
-  if (global_config.count("base_dir")) resolved.toml_base_dir = global_config.at("base_dir");
+  // One snapshot for the whole resolution, even if the file changes meanwhile.
+  const auto config = current_config();
+  resolved.toml_base_dir = config->base_dir();
 
   if (!options.url.empty()) {
     apply_url_mode(options, resolved, max_timefree_days);
   } else {
-    apply_toml_config(options, resolved);
+    apply_toml_config(options, *config, resolved);
   }
 
   if (!has_datetime_components(resolved.datetime)) {
@@ -12,6 +12,9 @@ struct ResolvedRecord {
   std::string title;
   std::string pfm;
   std::string image_url;
+  // Event page to take the cover from when the schedule had no image;
+  // scanned in the background while recording.
+  std::string event_url;
   std::string dir_name;
   std::string toml_base_dir;
   std::array<std::string, 3> datetime = {"", "", ""};
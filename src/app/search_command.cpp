@@ -0,0 +1,47 @@
+#include "app/search_command.h"
+
+#include "app/common.h"
+#include "app/program_json.h"
+
+namespace radicc {
+
+void write_search_results_json(JsonWriter& json, const std::vector<ProgramSearchHit>& hits) {
+  json.begin_array();
+  for (const auto& hit : hits) {
+    json.begin_object().member("station_id", hit.station_id);
+    write_program_members(json, hit.station_id, hit.program);
+    json.member("score", hit.score, 3).end_object();
+  }
+  json.end_array();
+}
+
+int run_search_command(const CommandOptions& options, std::ostream& out) {
+  if (options.query.empty()) print_error_and_exit("A search query is required.");
+  if (options.limit <= 0) print_error_and_exit("--limit must be greater than 0.");
+
+  refresh_program_search_index();
+  const auto hits = program_search_index().search(options.query, static_cast<std::size_t>(options.limit),
+                                                  options.station_id);
+  if (hits.empty()) print_error_and_exit("No programs matched \"" + options.query + "\".");
+
+  if (options.json_output) {
+    JsonWriter json(out);
+    write_search_results_json(json, hits);
+    json.flush();
+    out << std::endl;
+    return 0;
+  }
+
+  for (const auto& hit : hits) {
+    const auto& p = hit.program;
+    out << p.ft.substr(0, 8) << ' ' << time_hhmm(p.ft) << "-" << time_hhmm(p.to) << " | " << hit.station_id << " | "
+        << p.title;
+    if (!p.pfm.empty()) out << " | " << p.pfm;
+    const auto url = build_timefree_url(hit.station_id, p.ft);
+    if (!url.empty()) out << " | " << url;
+    out << "\n";
+  }
+  return 0;
+}
+
+}  // namespace radicc
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "app/command_options.h"
+#include "core/program_search.h"
+#include "utils/json.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace radicc {
+
+// Searches every station's weekly schedule for options.query and prints the
+// best matches to `out`.
+int run_search_command(const CommandOptions& options, std::ostream& out = std::cout);
+// The --json output of `radicc search` and the body of GET /search.
+void write_search_results_json(JsonWriter& json, const std::vector<ProgramSearchHit>& hits);
+
+}  // namespace radicc
@@ -0,0 +1,149 @@
+#include "app/server_client.h"
+
+#include "utils/local_socket.h"
+#include "utils/log.h"
+#include "utils/runtime_settings.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+
+namespace radicc {
+namespace {
+
+std::string form_encode(const std::string& value) {
+  static const char* kHex = "0123456789ABCDEF";
+  std::string encoded;
+  encoded.reserve(value.size());
+  for (unsigned char ch : value) {
+    if (std::isalnum(ch) || ch == '-' || ch == '_' || ch == '.' || ch == '~' || ch == '/') {
+      encoded.push_back(static_cast<char>(ch));
+    } else {
+      encoded.push_back('%');
+      encoded.push_back(kHex[ch >> 4]);
+      encoded.push_back(kHex[ch & 0x0f]);
+    }
+  }
+  return encoded;
+}
+
+// The server resolves paths in its own working directory, so relative
+// output paths are made absolute here.
+std::string absolute_output(std::string output) {
+  if (output.find('/') == std::string::npos && output != "." && output != "..") return output;
+  if (output == "." || output == "..") output += '/';
+  const bool directory = output.back() == '/';
+  std::string absolute = std::filesystem::absolute(output).lexically_normal().string();
+  if (directory && (absolute.empty() || absolute.back() != '/')) absolute += '/';
+  return absolute;
+}
+
+std::string build_cli_form(const std::string& command, const CommandOptions& options) {
+  std::ostringstream form;
+  const auto field = [&](const char* name, const std::string& value) {
+    if (form.tellp() > 0) form << '&';
+    form << name << '=' << form_encode(value);
+  };
+  field("command", command);
+  field("target", options.target);
+  field("id", options.id);
+  field("url", options.url);
+  field("station_id", options.station_id);
+  field("date", options.date);
+  field("output", options.output.empty() ? std::string() : absolute_output(options.output));
+  field("weekday", options.weekday);
+  field("personality", options.personality);
+  field("query", options.query);
+  field("limit", std::to_string(options.limit));
+  field("json", options.json_output ? "1" : "0");
+  if (options.date_offset_set) field("date_offset", std::to_string(options.date_offset));
+  field("fragmented", options.fragmented ? "1" : "0");
+  field("fragment_duration", std::to_string(options.fragment_seconds));
+  field("faststart", options.faststart ? "1" : "0");
+  field("backfill", options.backfill ? "1" : "0");
+  field("duration", std::to_string(options.duration));
+  field("cwd", std::filesystem::current_path().string());
+  field("settings", load_runtime_settings(true)->fingerprint());
+  return form.str();
+}
+
+bool send_all(int fd, const std::string& data) {
+  std::size_t sent = 0;
+  while (sent < data.size()) {
+    const ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+    if (n <= 0) return false;
+    sent += static_cast<std::size_t>(n);
+  }
+  return true;
+}
+
+std::string receive_all(int fd) {
+  std::string response;
+  char buffer[8192];
+  while (true) {
+    const ssize_t n = ::recv(fd, buffer, sizeof(buffer), 0);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+    response.append(buffer, static_cast<std::size_t>(n));
+  }
+  return response;
+}
+
+}  // namespace
+
+std::optional<int> run_on_local_server(const std::string& command, const CommandOptions& options) {
+  if (const char* standalone = std::getenv("RADICC_STANDALONE"); standalone && std::string(standalone) == "1") {
+    return std::nullopt;
+  }
+  // A trace covers this process's spans only.
+  if (!options.trace_path.empty()) return std::nullopt;
+  const int fd = connect_local_socket(local_socket_path());
+  if (fd < 0) return std::nullopt;
+
+  const std::string body = build_cli_form(command, options);
+  const std::string request = "POST /cli HTTP/1.1\r\n"
+                              "Host: localhost\r\n"
+                              "Content-Type: application/x-www-form-urlencoded\r\n"
+                              "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                              "Connection: close\r\n\r\n" + body;
+  if (!send_all(fd, request)) {
+    ::close(fd);
+    RADICC_LOG_WARN << "radicc-server did not take the command; running standalone.";
+    return std::nullopt;
+  }
+  const std::string response = receive_all(fd);
+  ::close(fd);
+
+  // The server may already have started the command, so running it here
+  // too could record the same program twice.
+  const std::size_t header_end = response.find("\r\n\r\n");
+  int status = 0;
+  std::istringstream status_line(response.substr(0, response.find("\r\n")));
+  std::string version;
+  status_line >> version >> status;
+  if (header_end == std::string::npos || version.rfind("HTTP/", 0) != 0 || status == 0) {
+    flush_log();
+    std::cerr << "Error: radicc-server dropped the " << command << " command before answering." << std::endl;
+    return 1;
+  }
+  if (status == 412) {
+    RADICC_LOG_INFO << "radicc-server runs with different settings; running standalone.";
+    return std::nullopt;
+  }
+  const std::string output = response.substr(header_end + 4);
+  if (status != 200) {
+    flush_log();
+    std::cerr << "Error: " << output << std::endl;
+    return 1;
+  }
+  std::cout << output << std::flush;
+  return 0;
+}
+
+}  // namespace radicc
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "app/command_options.h"
+
+#include <optional>
+#include <string>
+
+namespace radicc {
+
+// Runs `command` (list, search, fetch or rec) on the radicc-server
+// listening on local_socket_path(), so it is served from the server's warm
+// caches, and prints what the command would have printed. Returns the exit code, or
+// nullopt when no server takes the command and the caller should run it
+// itself; once the command is sent, a server that fails to answer is an
+// error. RADICC_STANDALONE=1, --trace and a server whose RADICC_*/RADIKO_*
+// settings differ from this process's always run standalone.
+std::optional<int> run_on_local_server(const std::string& command, const CommandOptions& options);
+
+}  // namespace radicc
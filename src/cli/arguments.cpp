@@ -17,6 +17,12 @@ void show_usage(const std::string& program_name, const std::string& command) {
         << "  -d, --duration <minutes>  Recording duration in minutes\n"
         << "      --date-offset <days>  Shift filename date backward\n"
         << "  -o, --output <path>       Output filename base or explicit path\n"
+        << "      --fragmented          Write fragmented MP4 (playable while recording)\n"
+        << "      --fragment-duration <seconds>\n"
+        << "                            Fragment length for --fragmented (default: 10)\n"
+        << "      --faststart           Move moov ahead of the audio data when done\n"
+        << "      --backfill            Yield upstream bandwidth to live recordings\n"
+        << "      --trace <file>        Write a Chrome trace (JSON) of the run\n"
         << "      --json                Print result as JSON\n"
         << "  -h, --help                Show this help\n";
     return;
@@ -32,6 +38,7 @@ void show_usage(const std::string& program_name, const std::string& command) {
         << "  -d, --duration <minutes>  Recording duration in minutes\n"
         << "      --date-offset <days>  Shift filename date backward\n"
         << "  -o, --output <path>       Output filename base or explicit path\n"
+        << "      --trace <file>        Write a Chrome trace (JSON) of the run\n"
         << "      --json                Print result as JSON\n"
         << "  -h, --help                Show this help\n";
     return;
@@ -48,17 +55,30 @@ void show_usage(const std::string& program_name, const std::string& command) {
     return;
   }
 
+  if (command == "search") {
+    std::cout
+        << "Usage: " << program_name << " search <query> [options]\n"
+        << "Options:\n"
+        << "      --station-id <id>     Only search this station\n"
+        << "      --limit <n>           Maximum number of results (default: 20)\n"
+        << "      --json                Print result as JSON\n"
+        << "  -h, --help                Show this help\n";
+    return;
+  }
+
   std::cout
       << "Usage: " << program_name << " <command> [options]\n"
       << "Commands:\n"
       << "  rec                     Record program\n"
       << "  fetch                   Resolve program info without recording\n"
       << "  list                    List station schedule for one date\n"
+      << "  search                  Find programs by title or performer\n"
       << "\n"
       << "Examples:\n"
       << "  " << program_name << " rec --url https://radiko.jp/#!/ts/JORF/20260322003000\n"
       << "  " << program_name << " fetch -t karin-zatsudan\n"
       << "  " << program_name << " list --station-id JORF --date 20260322\n"
+      << "  " << program_name << " search オールナイトニッポン\n"
       << "\n"
       << "Use `<command> --help` for command-specific options.\n";
 }
@@ -110,12 +130,45 @@ void parse_arguments(
       }
     } else if ((arg == "--output" || arg == "-o") && i + 1 < argc) {
       options.output = argv[++i];
+    } else if (arg == "--fragmented") {
+      options.fragmented = true;
+    } else if (arg == "--fragment-duration" && i + 1 < argc) {
+      try {
+        options.fragment_seconds = std::stoi(argv[++i]);
+      } catch (const std::exception&) {
+        std::cerr << "Invalid fragment duration: " << argv[i] << std::endl;
+        std::exit(1);
+      }
+      if (options.fragment_seconds <= 0) {
+        std::cerr << "Fragment duration must be greater than 0." << std::endl;
+        std::exit(1);
+      }
+    } else if (arg == "--faststart") {
+      options.faststart = true;
+    } else if (arg == "--backfill") {
+      options.backfill = true;
+    } else if (arg == "--trace" && i + 1 < argc) {
+      options.trace_path = argv[++i];
     } else if ((arg == "--weekday" || arg == "-w") && i + 1 < argc) {
       options.weekday = argv[++i];
     } else if ((arg == "--personality" || arg == "-p") && i + 1 < argc) {
       options.personality = argv[++i];
+    } else if (arg == "--limit" && i + 1 < argc) {
+      try {
+        options.limit = std::stoi(argv[++i]);
+      } catch (const std::exception&) {
+        std::cerr << "Invalid limit: " << argv[i] << std::endl;
+        std::exit(1);
+      }
+      if (options.limit <= 0) {
+        std::cerr << "Limit must be greater than 0." << std::endl;
+        std::exit(1);
+      }
     } else if (arg == "--json") {
       options.json_output = true;
+    } else if (command == "search" && !arg.empty() && arg[0] != '-') {
+      // Words of the query; quoting is optional.
+      options.query += options.query.empty() ? arg : " " + arg;
     } else {
       std::cerr << "Invalid argument: " << arg << std::endl;
       std::cerr << "Try --help for usage." << std::endl;
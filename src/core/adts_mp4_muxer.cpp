@@ -0,0 +1,570 @@
+#include "core/adts_mp4_muxer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+
+namespace radicc {
+namespace {
+
+constexpr int kSampleRates[] = {
+    96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050, 16000, 12000, 11025, 8000, 7350};
+constexpr std::uint32_t kSamplesPerFrame = 1024;
+constexpr std::size_t kSamplesPerChunk = 32;
+// Plain output appends one mdat box per segment (about 43 s at 48 kHz) so
+// no byte is rewritten after it reaches the file.
+constexpr std::size_t kSamplesPerSegment = kSamplesPerChunk * 64;
+constexpr std::size_t kCopyBufferSize = 1 << 20;
+
+// Appends big-endian fields and nested boxes whose sizes are patched on close.
+class BoxWriter {
+ public:
+  void u8(std::uint8_t value) { out_.push_back(static_cast<char>(value)); }
+  void u16(std::uint16_t value) {
+    u8(static_cast<std::uint8_t>(value >> 8));
+    u8(static_cast<std::uint8_t>(value));
+  }
+  void u24(std::uint32_t value) {
+    u8(static_cast<std::uint8_t>(value >> 16));
+    u16(static_cast<std::uint16_t>(value));
+  }
+  void u32(std::uint32_t value) {
+    u16(static_cast<std::uint16_t>(value >> 16));
+    u16(static_cast<std::uint16_t>(value));
+  }
+  void u64(std::uint64_t value) {
+    u32(static_cast<std::uint32_t>(value >> 32));
+    u32(static_cast<std::uint32_t>(value));
+  }
+  void fourcc(const char* code) { out_.append(code, 4); }
+  void bytes(const std::string& value) { out_.append(value); }
+  void zeros(std::size_t count) { out_.append(count, '\0'); }
+
+  void begin(const char* type) {
+    starts_.push_back(out_.size());
+    u32(0);
+    fourcc(type);
+  }
+  void begin_full(const char* type, std::uint8_t version, std::uint32_t flags) {
+    begin(type);
+    u8(version);
+    u24(flags);
+  }
+  void end() {
+    const std::size_t start = starts_.back();
+    starts_.pop_back();
+    const std::uint32_t size = static_cast<std::uint32_t>(out_.size() - start);
+    out_[start] = static_cast<char>(size >> 24);
+    out_[start + 1] = static_cast<char>(size >> 16);
+    out_[start + 2] = static_cast<char>(size >> 8);
+    out_[start + 3] = static_cast<char>(size);
+  }
+
+  // MPEG-4 descriptor with the four-byte length form libav also writes.
+  void descriptor(std::uint8_t tag, std::uint32_t length) {
+    u8(tag);
+    for (int shift = 21; shift > 0; shift -= 7) u8(static_cast<std::uint8_t>(((length >> shift) & 0x7F) | 0x80));
+    u8(static_cast<std::uint8_t>(length & 0x7F));
+  }
+
+  void matrix() {
+    static constexpr std::uint32_t kUnity[] = {0x00010000, 0, 0, 0, 0x00010000, 0, 0, 0, 0x40000000};
+    for (std::uint32_t value : kUnity) u32(value);
+  }
+
+  std::size_t size() const { return out_.size(); }
+  std::string take() { return std::move(out_); }
+
+ private:
+  std::string out_;
+  std::vector<std::size_t> starts_;
+};
+
+std::size_t id3v2_tag_length(const std::uint8_t* data, std::size_t size) {
+  if (size < 10 || std::memcmp(data, "ID3", 3) != 0) return 0;
+  const std::size_t body = (static_cast<std::size_t>(data[6] & 0x7F) << 21)
+      | (static_cast<std::size_t>(data[7] & 0x7F) << 14)
+      | (static_cast<std::size_t>(data[8] & 0x7F) << 7)
+      | static_cast<std::size_t>(data[9] & 0x7F);
+  const bool has_footer = (data[5] & 0x10) != 0;
+  return 10 + body + (has_footer ? 10 : 0);
+}
+
+void write_metadata_item(BoxWriter& box, const char* type, std::uint32_t data_type, const std::string& value) {
+  box.begin(type);
+  box.begin("data");
+  box.u32(data_type);
+  box.u32(0);
+  box.bytes(value);
+  box.end();
+  box.end();
+}
+
+}  // namespace
+
+std::optional<AdtsFrameHeader> parse_adts_header(const std::uint8_t* data, std::size_t size) {
+  if (size < 7) return std::nullopt;
+  if (data[0] != 0xFF || (data[1] & 0xF6) != 0xF0) return std::nullopt;  // sync word, layer 0
+  AdtsFrameHeader header;
+  const bool protection_absent = (data[1] & 0x01) != 0;
+  header.audio_object_type = ((data[2] >> 6) & 0x03) + 1;
+  header.sampling_index = (data[2] >> 2) & 0x0F;
+  header.channel_config = ((data[2] & 0x01) << 2) | ((data[3] >> 6) & 0x03);
+  header.frame_length = (static_cast<std::size_t>(data[3] & 0x03) << 11)
+      | (static_cast<std::size_t>(data[4]) << 3)
+      | (static_cast<std::size_t>(data[5]) >> 5);
+  header.raw_data_blocks = (data[6] & 0x03) + 1;
+  header.header_length = protection_absent ? 7 : 9;
+  if (adts_sample_rate(header.sampling_index) == 0) return std::nullopt;
+  if (header.frame_length <= header.header_length) return std::nullopt;
+  return header;
+}
+
+int adts_sample_rate(int sampling_index) {
+  if (sampling_index < 0 || sampling_index >= static_cast<int>(std::size(kSampleRates))) return 0;
+  return kSampleRates[sampling_index];
+}
+
+std::string build_audio_specific_config(const AdtsFrameHeader& header) {
+  const unsigned value = (static_cast<unsigned>(header.audio_object_type) << 11)
+      | (static_cast<unsigned>(header.sampling_index) << 7)
+      | (static_cast<unsigned>(header.channel_config) << 3);
+  return std::string{static_cast<char>(value >> 8), static_cast<char>(value & 0xFF)};
+}
+
+bool looks_like_adts(const std::uint8_t* data, std::size_t size) {
+  const std::size_t skip = id3v2_tag_length(data, size);
+  if (skip >= size) return false;
+  const auto header = parse_adts_header(data + skip, size - skip);
+  if (!header || header->raw_data_blocks != 1) return false;
+  // Require a second frame right behind the first when the buffer has one.
+  const std::size_t next = skip + header->frame_length;
+  return next + 2 > size || parse_adts_header(data + next, size - next).has_value();
+}
+
+AdtsMp4Muxer::AdtsMp4Muxer(Mp4Metadata metadata, Mp4OutputOptions options)
+    : metadata_(std::move(metadata)), options_(options) {
+  if (options_.fragment_seconds <= 0) options_.fragment_seconds = 10;
+}
+
+AdtsMp4Muxer::~AdtsMp4Muxer() = default;
+
+bool AdtsMp4Muxer::fail(const std::string& message) {
+  if (error_.empty()) error_ = message;
+  return false;
+}
+
+bool AdtsMp4Muxer::write_bytes(const void* data, std::size_t size) {
+  if (!sink_->write(data, size)) return fail(sink_->error());
+  bytes_written_ += size;
+  // Progressive faststart output is hashed while it is rewritten instead;
+  // fragmented output already leads with moov and is never rewritten.
+  if (!options_.faststart || options_.fragmented) hasher_.update(data, size);
+  return true;
+}
+
+bool AdtsMp4Muxer::open(const std::string& path, const OutputSinkOptions& sink_options) {
+  path_ = path;
+  sink_options_ = sink_options;
+  // Every flush ends a fragment, so an interrupted file stays playable.
+  sink_options_.keep_flushed_on_abort = options_.fragmented;
+  sink_ = std::make_unique<OutputSink>(sink_options_);
+  if (!sink_->open(path)) return fail(sink_->error());
+
+  BoxWriter header;
+  header.begin("ftyp");
+  if (options_.fragmented) {
+    header.fourcc("iso6");
+    header.u32(0);
+    header.fourcc("iso6");
+    header.fourcc("cmfc");
+    header.fourcc("M4A ");
+    header.fourcc("mp42");
+  } else {
+    header.fourcc("M4A ");
+    header.u32(0x200);
+    header.fourcc("M4A ");
+    header.fourcc("mp42");
+    header.fourcc("isom");
+  }
+  header.end();
+  const std::string ftyp = header.take();
+  media_offset_ = ftyp.size();
+  // The init segment needs the AudioSpecificConfig, so fragmented output
+  // writes its moov together with the first fragment.
+  return write_bytes(ftyp.data(), ftyp.size());
+}
+
+bool AdtsMp4Muxer::write(const std::uint8_t* data, std::size_t size) {
+  if (!sink_ || finished_) return fail("muxer is not open");
+  pending_.insert(pending_.end(), data, data + size);
+  return consume_frames();
+}
+
+bool AdtsMp4Muxer::consume_frames() {
+  std::size_t position = 0;
+  while (position < pending_.size()) {
+    const std::uint8_t* cursor = pending_.data() + position;
+    const std::size_t remaining = pending_.size() - position;
+    if (remaining >= 3 && std::memcmp(cursor, "ID3", 3) == 0) {
+      if (remaining < 10) break;
+      const std::size_t tag_length = id3v2_tag_length(cursor, remaining);
+      if (tag_length > remaining) break;
+      position += tag_length;
+      continue;
+    }
+    if (remaining < 9) break;
+    const auto header = parse_adts_header(cursor, remaining);
+    if (!header) {
+      ++position;  // resynchronise on the next sync word
+      continue;
+    }
+    if (header->frame_length > remaining) break;
+    if (header->raw_data_blocks != 1) return fail("ADTS frames with multiple raw data blocks are not supported");
+    if (!format_) {
+      format_ = header;
+    } else if (format_->sampling_index != header->sampling_index
+               || format_->channel_config != header->channel_config
+               || format_->audio_object_type != header->audio_object_type) {
+      return fail("ADTS stream changed format mid-recording");
+    }
+    const std::size_t payload = header->frame_length - header->header_length;
+    staged_payload_.append(reinterpret_cast<const char*>(cursor + header->header_length), payload);
+    staged_sizes_.push_back(static_cast<std::uint32_t>(payload));
+    sample_sizes_.push_back(static_cast<std::uint32_t>(payload));
+    max_sample_size_ = std::max(max_sample_size_, static_cast<std::uint32_t>(payload));
+    payload_bytes_ += payload;
+    position += header->frame_length;
+    if (options_.fragmented
+        && staged_sizes_.size() * kSamplesPerFrame
+            >= static_cast<std::uint64_t>(options_.fragment_seconds) * adts_sample_rate(format_->sampling_index)
+        && !flush_fragment()) {
+      return false;
+    }
+    if (!options_.fragmented && staged_sizes_.size() >= kSamplesPerSegment && !flush_segment()) return false;
+  }
+  pending_.erase(pending_.begin(), pending_.begin() + static_cast<std::ptrdiff_t>(position));
+  return true;
+}
+
+double AdtsMp4Muxer::duration_seconds() const {
+  if (!format_) return 0.0;
+  return static_cast<double>(sample_sizes_.size()) * kSamplesPerFrame / adts_sample_rate(format_->sampling_index);
+}
+
+bool AdtsMp4Muxer::write_mdat() {
+  BoxWriter mdat;
+  mdat.u32(static_cast<std::uint32_t>(8 + staged_payload_.size()));
+  mdat.fourcc("mdat");
+  const std::string mdat_header = mdat.take();
+  if (!write_bytes(mdat_header.data(), mdat_header.size())
+      || !write_bytes(staged_payload_.data(), staged_payload_.size())) {
+    return false;
+  }
+  media_bytes_ += mdat_header.size() + staged_payload_.size();
+  staged_sizes_.clear();
+  staged_payload_.clear();
+  return true;
+}
+
+bool AdtsMp4Muxer::flush_segment() {
+  return staged_sizes_.empty() || write_mdat();
+}
+
+bool AdtsMp4Muxer::flush_fragment() {
+  if (staged_sizes_.empty()) return true;
+  if (!init_segment_written_) {
+    const std::string moov = build_moov(0);
+    if (!write_bytes(moov.data(), moov.size())) return false;
+    init_segment_written_ = true;
+  }
+
+  BoxWriter box;
+  box.begin("moof");
+  box.begin_full("mfhd", 0, 0);
+  box.u32(++fragment_sequence_);
+  box.end();
+  box.begin("traf");
+  box.begin_full("tfhd", 0, 0x020000);  // default-base-is-moof
+  box.u32(1);
+  box.end();
+  box.begin_full("tfdt", 1, 0);
+  box.u64(fragment_start_sample_ * kSamplesPerFrame);
+  box.end();
+  box.begin_full("trun", 0, 0x000201);  // data-offset + sample-size
+  box.u32(static_cast<std::uint32_t>(staged_sizes_.size()));
+  const std::size_t data_offset_position = box.size();
+  box.u32(0);
+  for (std::uint32_t size : staged_sizes_) box.u32(size);
+  box.end();
+  box.end();
+  box.end();
+  std::string moof = box.take();
+  const std::uint32_t data_offset = static_cast<std::uint32_t>(moof.size() + 8);
+  for (int i = 0; i < 4; ++i) moof[data_offset_position + i] = static_cast<char>(data_offset >> (24 - 8 * i));
+
+  const std::size_t fragment_samples = staged_sizes_.size();
+  if (!write_bytes(moof.data(), moof.size()) || !write_mdat()) return false;
+  // Each fragment reaches the file as a unit so readers never see a torn one.
+  if (!sink_->flush()) return fail(sink_->error());
+  committed_bytes_ = sink_->bytes_written();
+  fragment_start_sample_ += fragment_samples;
+  return true;
+}
+
+bool AdtsMp4Muxer::finish() {
+  if (!sink_ || finished_) return fail("muxer is not open");
+  finished_ = true;
+  if (sample_sizes_.empty() || !format_) return fail("no ADTS frames were written");
+
+  if (options_.fragmented) {
+    if (!flush_fragment()) return false;
+  } else {
+    if (!flush_segment()) return false;
+    const std::string moov = build_moov(media_offset_);
+    if (!write_bytes(moov.data(), moov.size())) return false;
+    if (options_.faststart) return rewrite_faststart();
+  }
+  if (!sink_->commit()) return fail(sink_->error());
+  digest_ = hasher_.finish();
+  return true;
+}
+
+bool AdtsMp4Muxer::rewrite_faststart() {
+  // moov size depends on whether chunk offsets fit stco, which in turn
+  // depends on the moov size; two rounds settle it.
+  const std::uint64_t header_size = media_offset_;
+  std::string moov = build_moov(header_size);
+  moov = build_moov(header_size + moov.size());
+
+  // The sorted copy goes through its own sink and replaces the unsorted
+  // partial file, which the destructor removes.
+  if (!sink_->flush()) return fail(sink_->error());
+  std::FILE* source = std::fopen(sink_->partial_path().c_str(), "rb");
+  if (!source) return fail("could not reopen " + sink_->partial_path());
+  OutputSink target(sink_options_);
+  if (!target.open(path_)) {
+    std::fclose(source);
+    return fail(target.error());
+  }
+
+  std::vector<char> buffer(kCopyBufferSize);
+  bool ok = std::fread(buffer.data(), 1, header_size, source) == header_size
+      && target.write(buffer.data(), header_size) && target.write(moov.data(), moov.size());
+  ContentHasher hasher;
+  hasher.update(buffer.data(), header_size);
+  hasher.update(moov.data(), moov.size());
+  // Copy the mdat boxes as they are.
+  std::uint64_t remaining = media_bytes_;
+  while (ok && remaining > 0) {
+    const std::size_t want = static_cast<std::size_t>(std::min<std::uint64_t>(remaining, buffer.size()));
+    const std::size_t got = std::fread(buffer.data(), 1, want, source);
+    ok = got == want && target.write(buffer.data(), got);
+    hasher.update(buffer.data(), got);
+    remaining -= got;
+  }
+  std::fclose(source);
+  if (!ok || !target.commit()) return fail("faststart rewrite failed" + (target.error().empty() ? "" : ": " + target.error()));
+  sink_->abort();
+  digest_ = hasher.finish();
+  return true;
+}
+
+std::string AdtsMp4Muxer::build_moov(std::uint64_t media_offset) const {
+  // A fragmented init segment carries empty sample tables and a zero duration.
+  static const std::vector<std::uint32_t> kNoSamples;
+  const std::vector<std::uint32_t>& samples = options_.fragmented ? kNoSamples : sample_sizes_;
+  const std::uint32_t sample_rate = static_cast<std::uint32_t>(adts_sample_rate(format_->sampling_index));
+  const std::uint64_t media_duration = static_cast<std::uint64_t>(samples.size()) * kSamplesPerFrame;
+  const std::uint32_t movie_duration = static_cast<std::uint32_t>(media_duration * 1000 / sample_rate);
+  const double seconds = static_cast<double>(sample_sizes_.size()) * kSamplesPerFrame / sample_rate;
+  const std::uint32_t avg_bitrate = seconds > 0 ? static_cast<std::uint32_t>(payload_bytes_ * 8 / seconds) : 0;
+  const std::uint32_t max_bitrate = max_sample_size_ * 8 * sample_rate / kSamplesPerFrame;
+  const std::string asc = build_audio_specific_config(*format_);
+
+  std::vector<std::uint64_t> chunk_offsets;
+  std::uint64_t offset = media_offset;
+  for (std::size_t i = 0; i < samples.size(); ++i) {
+    if (i % kSamplesPerSegment == 0) offset += 8;  // mdat header
+    if (i % kSamplesPerChunk == 0) chunk_offsets.push_back(offset);
+    offset += samples[i];
+  }
+  const bool use_co64 = offset > std::numeric_limits<std::uint32_t>::max();
+
+  BoxWriter box;
+  box.begin("moov");
+
+  box.begin_full("mvhd", 0, 0);
+  box.u32(0);
+  box.u32(0);
+  box.u32(1000);
+  box.u32(movie_duration);
+  box.u32(0x00010000);
+  box.u16(0x0100);
+  box.zeros(10);
+  box.matrix();
+  box.zeros(24);
+  box.u32(2);
+  box.end();
+
+  box.begin("trak");
+  box.begin_full("tkhd", 0, 0x000003);
+  box.u32(0);
+  box.u32(0);
+  box.u32(1);
+  box.u32(0);
+  box.u32(movie_duration);
+  box.zeros(8);
+  box.u16(0);
+  box.u16(1);
+  box.u16(0x0100);
+  box.u16(0);
+  box.matrix();
+  box.u32(0);
+  box.u32(0);
+  box.end();
+
+  box.begin("mdia");
+  box.begin_full("mdhd", 0, 0);
+  box.u32(0);
+  box.u32(0);
+  box.u32(sample_rate);
+  box.u32(static_cast<std::uint32_t>(media_duration));
+  box.u16(0x55C4);  // "und"
+  box.u16(0);
+  box.end();
+
+  box.begin_full("hdlr", 0, 0);
+  box.u32(0);
+  box.fourcc("soun");
+  box.zeros(12);
+  box.bytes(std::string("SoundHandler", 13));
+  box.end();
+
+  box.begin("minf");
+  box.begin_full("smhd", 0, 0);
+  box.u16(0);
+  box.u16(0);
+  box.end();
+  box.begin("dinf");
+  box.begin_full("dref", 0, 0);
+  box.u32(1);
+  box.begin_full("url ", 0, 1);
+  box.end();
+  box.end();
+  box.end();
+
+  box.begin("stbl");
+  box.begin_full("stsd", 0, 0);
+  box.u32(1);
+  box.begin("mp4a");
+  box.zeros(6);
+  box.u16(1);
+  box.zeros(8);
+  box.u16(static_cast<std::uint16_t>(format_->channel_config == 0 ? 2 : format_->channel_config));
+  box.u16(16);
+  box.u16(0);
+  box.u16(0);
+  box.u32(sample_rate << 16);
+  box.begin_full("esds", 0, 0);
+  const std::uint32_t decoder_specific_length = static_cast<std::uint32_t>(asc.size());
+  const std::uint32_t decoder_config_length = 13 + 5 + decoder_specific_length;
+  box.descriptor(0x03, 3 + 5 + decoder_config_length + 5 + 1);
+  box.u16(1);
+  box.u8(0);
+  box.descriptor(0x04, decoder_config_length);
+  box.u8(0x40);  // MPEG-4 audio
+  box.u8(0x15);  // audio stream
+  box.u24(max_sample_size_);
+  box.u32(std::max(max_bitrate, avg_bitrate));
+  box.u32(avg_bitrate);
+  box.descriptor(0x05, decoder_specific_length);
+  box.bytes(asc);
+  box.descriptor(0x06, 1);
+  box.u8(0x02);
+  box.end();
+  box.end();
+  box.end();
+
+  box.begin_full("stts", 0, 0);
+  box.u32(samples.empty() ? 0 : 1);
+  if (!samples.empty()) {
+    box.u32(static_cast<std::uint32_t>(samples.size()));
+    box.u32(kSamplesPerFrame);
+  }
+  box.end();
+
+  const std::size_t last_chunk_samples = samples.size() % kSamplesPerChunk;
+  const bool has_short_tail = last_chunk_samples != 0 && chunk_offsets.size() > 1;
+  box.begin_full("stsc", 0, 0);
+  box.u32(chunk_offsets.empty() ? 0 : has_short_tail ? 2 : 1);
+  if (!chunk_offsets.empty()) {
+    box.u32(1);
+    box.u32(static_cast<std::uint32_t>(chunk_offsets.size() == 1 ? samples.size() : kSamplesPerChunk));
+    box.u32(1);
+  }
+  if (has_short_tail) {
+    box.u32(static_cast<std::uint32_t>(chunk_offsets.size()));
+    box.u32(static_cast<std::uint32_t>(last_chunk_samples));
+    box.u32(1);
+  }
+  box.end();
+
+  box.begin_full("stsz", 0, 0);
+  box.u32(0);
+  box.u32(static_cast<std::uint32_t>(samples.size()));
+  for (std::uint32_t size : samples) box.u32(size);
+  box.end();
+
+  box.begin_full(use_co64 ? "co64" : "stco", 0, 0);
+  box.u32(static_cast<std::uint32_t>(chunk_offsets.size()));
+  for (std::uint64_t chunk_offset : chunk_offsets) {
+    if (use_co64) box.u64(chunk_offset);
+    else box.u32(static_cast<std::uint32_t>(chunk_offset));
+  }
+  box.end();
+
+  box.end();  // stbl
+  box.end();  // minf
+  box.end();  // mdia
+  box.end();  // trak
+
+  if (options_.fragmented) {
+    box.begin("mvex");
+    box.begin_full("trex", 0, 0);
+    box.u32(1);
+    box.u32(1);
+    box.u32(kSamplesPerFrame);
+    box.u32(0);
+    box.u32(0);
+    box.end();
+    box.end();
+  }
+
+  if (!metadata_.artist.empty() || !metadata_.album.empty() || !metadata_.cover.empty()) {
+    box.begin("udta");
+    box.begin_full("meta", 0, 0);
+    box.begin_full("hdlr", 0, 0);
+    box.u32(0);
+    box.fourcc("mdir");
+    box.fourcc("appl");
+    box.zeros(9);
+    box.end();
+    box.begin("ilst");
+    if (!metadata_.artist.empty()) write_metadata_item(box, "\xA9" "ART", 1, metadata_.artist);
+    if (!metadata_.album.empty()) write_metadata_item(box, "\xA9" "alb", 1, metadata_.album);
+    if (!metadata_.cover.empty()) {
+      const bool is_png = metadata_.cover.compare(0, 4, "\x89PNG") == 0;
+      write_metadata_item(box, "covr", is_png ? 14 : 13, metadata_.cover);
+    }
+    box.end();
+    box.end();
+    box.end();
+  }
+
+  box.end();  // moov
+  return box.take();
+}
+
+}  // namespace radicc
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "core/output_sink.h"
+#include "utils/hash.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace radicc {
+
+struct AdtsFrameHeader {
+  int audio_object_type = 0;   // ADTS profile + 1
+  int sampling_index = 0;
+  int channel_config = 0;
+  std::size_t header_length = 0;
+  std::size_t frame_length = 0;  // header + payload
+  int raw_data_blocks = 1;
+};
+
+std::optional<AdtsFrameHeader> parse_adts_header(const std::uint8_t* data, std::size_t size);
+int adts_sample_rate(int sampling_index);
+// Two-byte AudioSpecificConfig as produced by aac_adtstoasc.
+std::string build_audio_specific_config(const AdtsFrameHeader& header);
+// True when `data` starts with an ADTS frame, optionally behind an ID3v2 tag.
+bool looks_like_adts(const std::uint8_t* data, std::size_t size);
+
+struct Mp4Metadata {
+  std::string artist;
+  std::string album;
+  std::string cover;  // JPEG or PNG bytes
+};
+
+struct Mp4OutputOptions {
+  // Write ftyp+moov up front and append self-contained moof+mdat fragments,
+  // so the file is playable while it grows and after a crash.
+  bool fragmented = false;
+  int fragment_seconds = 10;
+  // Rewrite a non-fragmented file with moov ahead of mdat once it is complete.
+  bool faststart = false;
+};
+
+// Streams ADTS AAC into an M4A file: ftyp, then one mdat box per segment of
+// frames as they arrive, and moov with the sample tables appended by
+// finish(). In fragmented mode the sample tables travel in per-fragment moof
+// boxes instead. Either way the file is only appended to, so it is hashed
+// as it is written.
+class AdtsMp4Muxer {
+ public:
+  explicit AdtsMp4Muxer(Mp4Metadata metadata, Mp4OutputOptions options = Mp4OutputOptions());
+  ~AdtsMp4Muxer();
+  AdtsMp4Muxer(const AdtsMp4Muxer&) = delete;
+  AdtsMp4Muxer& operator=(const AdtsMp4Muxer&) = delete;
+
+  // Writes to a partial file beside `path`, renamed into place by finish().
+  // In fragmented mode a muxer destroyed before finish() leaves its complete
+  // fragments at kept_partial_output_path(path).
+  bool open(const std::string& path, const OutputSinkOptions& sink_options = OutputSinkOptions());
+  // Accepts arbitrary slices of an ADTS byte stream; ID3 tags between
+  // segments are skipped and a trailing partial frame is kept for the next call.
+  bool write(const std::uint8_t* data, std::size_t size);
+  bool finish();
+  // Replaces the cover art. It is written with moov, so it takes effect
+  // until the first fragment in fragmented mode and until finish() otherwise.
+  void set_cover(std::string cover) { metadata_.cover = std::move(cover); }
+
+  std::uint64_t sample_count() const { return sample_sizes_.size(); }
+  // Leading bytes of the file that are flushed and will not be rewritten;
+  // advances per fragment in fragmented mode and stays 0 otherwise.
+  std::uint64_t committed_bytes() const { return committed_bytes_; }
+  std::uint64_t bytes_written() const { return bytes_written_; }
+  double duration_seconds() const;
+  // Where the output is written until finish() renames it; empty after.
+  std::string partial_path() const { return sink_ ? sink_->partial_path() : std::string(); }
+  // Digest of the final file, available once finish() succeeded.
+  const std::optional<ContentDigest>& digest() const { return digest_; }
+  const std::string& error() const { return error_; }
+
+ private:
+  bool fail(const std::string& message);
+  bool write_bytes(const void* data, std::size_t size);
+  bool consume_frames();
+  bool write_mdat();
+  bool flush_segment();
+  bool flush_fragment();
+  bool rewrite_faststart();
+  // `media_offset` is where the first mdat box starts.
+  std::string build_moov(std::uint64_t media_offset) const;
+
+  Mp4Metadata metadata_;
+  Mp4OutputOptions options_;
+  std::string path_;
+  OutputSinkOptions sink_options_;
+  std::unique_ptr<OutputSink> sink_;
+  std::string error_;
+  std::vector<std::uint8_t> pending_;
+  std::optional<AdtsFrameHeader> format_;
+  std::vector<std::uint32_t> sample_sizes_;
+  std::uint64_t media_offset_ = 0;
+  std::uint64_t media_bytes_ = 0;  // mdat boxes written so far
+  std::uint64_t payload_bytes_ = 0;
+  std::uint32_t max_sample_size_ = 0;
+  bool finished_ = false;
+  // Samples buffered for the next mdat segment or moof+mdat fragment.
+  std::vector<std::uint32_t> staged_sizes_;
+  std::string staged_payload_;
+  std::uint64_t fragment_start_sample_ = 0;
+  std::uint32_t fragment_sequence_ = 0;
+  std::uint64_t committed_bytes_ = 0;
+  std::uint64_t bytes_written_ = 0;
+  bool init_segment_written_ = false;
+  ContentHasher hasher_;
+  std::optional<ContentDigest> digest_;
+};
+
+}  // namespace radicc
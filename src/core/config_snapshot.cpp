@@ -0,0 +1,226 @@
+#include "core/config_snapshot.h"
+
+#include "third_party/tomlplusplus/toml.hpp"
+#include "utils/log.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/inotify.h>
+#endif
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace radicc {
+namespace {
+
+constexpr const char* kConfigFileName = "radicc.toml";
+constexpr auto kPollInterval = std::chrono::seconds(2);
+
+std::string config_directory() {
+  if (const char* xdg_config_home = std::getenv("XDG_CONFIG_HOME")) return std::string(xdg_config_home) + "/radicc";
+  if (const char* home = std::getenv("HOME")) return std::string(home) + "/.config/radicc";
+  return {};
+}
+
+std::string config_file_path() {
+  const std::string directory = config_directory();
+  return directory.empty() ? std::string() : directory + "/" + kConfigFileName;
+}
+
+void log_config_errors(const ConfigSnapshot& snapshot) {
+  for (const auto& error : snapshot.errors()) RADICC_LOG_WARN << "Config: " << error;
+}
+
+std::mutex g_config_mutex;
+std::shared_ptr<const ConfigSnapshot> g_config;
+bool g_watching = false;
+
+// Identity of the file as far as reloading is concerned.
+struct FileStamp {
+  bool exists = false;
+  ino_t inode = 0;
+  off_t size = 0;
+  std::int64_t mtime_ns = 0;
+
+  bool operator==(const FileStamp&) const = default;
+};
+
+FileStamp stamp_of(const std::string& path) {
+  struct stat st;
+  if (path.empty() || ::stat(path.c_str(), &st) != 0) return {};
+#if defined(__APPLE__)
+  const std::int64_t mtime_ns = static_cast<std::int64_t>(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+  const std::int64_t mtime_ns = static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+  return FileStamp{true, st.st_ino, st.st_size, mtime_ns};
+}
+
+void reload_and_report() {
+  const auto previous = current_config();
+  const auto snapshot = reload_config();
+  if (snapshot == previous) return;
+  RADICC_LOG_INFO << "Config reloaded: " << snapshot->programs().size() << " programs";
+}
+
+void poll_config(const std::string& path) {
+  FileStamp last = stamp_of(path);
+  while (true) {
+    std::this_thread::sleep_for(kPollInterval);
+    const FileStamp now = stamp_of(path);
+    if (now == last) continue;
+    last = now;
+    reload_and_report();
+  }
+}
+
+void watch_loop(const std::string& directory, const std::string& path) {
+#if defined(__linux__)
+  const int fd = ::inotify_init1(IN_CLOEXEC);
+  // Editors replace the file by renaming over it, so watch the directory.
+  if (fd >= 0 && ::inotify_add_watch(fd, directory.c_str(),
+                                     IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE) >= 0) {
+    alignas(inotify_event) char buffer[4096];
+    while (true) {
+      const ssize_t n = ::read(fd, buffer, sizeof(buffer));
+      if (n <= 0) {
+        if (n < 0 && errno == EINTR) continue;
+        break;
+      }
+      bool changed = false;
+      for (ssize_t offset = 0; offset < n;) {
+        const auto* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+        if (event->len > 0 && std::string(event->name) == kConfigFileName) changed = true;
+        offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+      }
+      if (changed) reload_and_report();
+    }
+  }
+  if (fd >= 0) ::close(fd);
+#else
+  (void)directory;
+#endif
+  // No inotify (or no config directory yet): fall back to polling.
+  poll_config(path);
+}
+
+}  // namespace
+
+std::shared_ptr<const ConfigSnapshot> ConfigSnapshot::load(const std::string& path) {
+  auto snapshot = std::make_shared<ConfigSnapshot>();
+  snapshot->path_ = path;
+  struct stat st;
+  if (path.empty() || ::stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) return snapshot;
+  snapshot->found_ = true;
+
+  toml::table root;
+  try {
+    root = toml::parse_file(path);
+  } catch (const toml::parse_error& err) {
+    snapshot->errors_.push_back(std::string("could not parse ") + path + ": " + std::string(err.description()));
+    return snapshot;
+  }
+  snapshot->parsed_ = true;
+
+  if (const auto* base_dir = root["base_dir"].as_string()) snapshot->base_dir_ = base_dir->get();
+  for (const auto& [name, node] : root) {
+    const auto* table = node.as_table();
+    if (!table) continue;
+    ProgramConfig program;
+    program.section = std::string(name.str());
+    for (const auto& [key, value] : *table) {
+      if (const auto* text = value.as_string()) {
+        program.fields.emplace(std::string(key.str()), text->get());
+      } else if (const auto* number = value.as_integer()) {
+        program.fields.emplace(std::string(key.str()), std::to_string(number->get()));
+      } else {
+        snapshot->errors_.push_back("[" + program.section + "] " + std::string(key.str()) +
+                                    ": unsupported value type");
+      }
+    }
+    const auto field = [&](const char* key) {
+      const auto it = program.fields.find(key);
+      return it == program.fields.end() ? std::string() : it->second;
+    };
+    program.id = field("id");
+    program.title = program.fields.count("title") ? field("title") : program.section;
+    program.station = field("station");
+    program.dir = field("dir");
+    program.img = field("img");
+    program.pfm = field("pfm");
+    if (const std::string offset = field("date_offset"); !offset.empty()) {
+      char* end = nullptr;
+      const long days = std::strtol(offset.c_str(), &end, 10);
+      if (*end == '\0' && days >= 0 && days <= 3650) {
+        program.date_offset = static_cast<int>(days);
+      } else {
+        snapshot->errors_.push_back("[" + program.section + "] date_offset must be a non-negative integer");
+      }
+    }
+    if (program.station.empty()) snapshot->errors_.push_back("[" + program.section + "] station is missing");
+
+    const std::size_t index = snapshot->programs_.size();
+    snapshot->by_section_.emplace(program.section, index);
+    if (!program.id.empty()) {
+      const auto [it, inserted] = snapshot->by_id_.emplace(program.id, index);
+      if (!inserted) {
+        snapshot->errors_.push_back("id \"" + program.id + "\" is used by both [" +
+                                    snapshot->programs_[it->second].section + "] and [" + program.section + "]");
+      }
+    }
+    snapshot->programs_.push_back(std::move(program));
+  }
+  return snapshot;
+}
+
+const ProgramConfig* ConfigSnapshot::find_section(const std::string& section) const {
+  const auto it = by_section_.find(section);
+  return it == by_section_.end() ? nullptr : &programs_[it->second];
+}
+
+const ProgramConfig* ConfigSnapshot::find_id(const std::string& id) const {
+  const auto it = by_id_.find(id);
+  return it == by_id_.end() ? nullptr : &programs_[it->second];
+}
+
+std::shared_ptr<const ConfigSnapshot> current_config() {
+  {
+    std::lock_guard<std::mutex> lock(g_config_mutex);
+    if (g_config) return g_config;
+  }
+  return reload_config();
+}
+
+std::shared_ptr<const ConfigSnapshot> reload_config() {
+  auto snapshot = ConfigSnapshot::load(config_file_path());
+  log_config_errors(*snapshot);
+  std::lock_guard<std::mutex> lock(g_config_mutex);
+  if (snapshot->found() && !snapshot->parsed() && g_config) {
+    RADICC_LOG_WARN << "Config: keeping the previous " << g_config->programs().size() << " programs until "
+                    << snapshot->path() << " parses";
+    return g_config;
+  }
+  g_config = snapshot;
+  return snapshot;
+}
+
+void watch_config() {
+  {
+    std::lock_guard<std::mutex> lock(g_config_mutex);
+    if (g_watching) return;
+    g_watching = true;
+  }
+  current_config();
+  const std::string directory = config_directory();
+  std::thread([directory]() { watch_loop(directory, directory.empty() ? std::string() : directory + "/" + kConfigFileName); })
+      .detach();
+}
+
+}  // namespace radicc
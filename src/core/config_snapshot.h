@@ -0,0 +1,70 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace radicc {
+
+// One program table of radicc.toml.
+struct ProgramConfig {
+  std::string section;
+  std::string id;
+  std::string title;  // the section name when the table has none
+  std::string station;
+  std::string dir;
+  std::string img;
+  std::string pfm;
+  std::optional<int> date_offset;
+  // Every string and integer value of the table, integers as decimal text.
+  std::map<std::string, std::string> fields;
+};
+
+// radicc.toml parsed once. A snapshot never changes after load(); a config
+// change produces a new snapshot, so holders keep a consistent view.
+class ConfigSnapshot {
+ public:
+  // Parses `path`. A missing file gives an empty snapshot with found() false;
+  // a parse error gives an empty one with the error in errors().
+  static std::shared_ptr<const ConfigSnapshot> load(const std::string& path);
+
+  bool found() const { return found_; }
+  // False when the file exists but is not valid TOML.
+  bool parsed() const { return parsed_; }
+  const std::string& path() const { return path_; }
+  const std::string& base_dir() const { return base_dir_; }
+  // Problems found while loading: parse errors, unsupported values, bad
+  // date_offset values and duplicate ids.
+  const std::vector<std::string>& errors() const { return errors_; }
+  const std::vector<ProgramConfig>& programs() const { return programs_; }
+
+  const ProgramConfig* find_section(const std::string& section) const;
+  const ProgramConfig* find_id(const std::string& id) const;
+
+ private:
+  std::string path_;
+  bool found_ = false;
+  bool parsed_ = false;
+  std::string base_dir_;
+  std::vector<std::string> errors_;
+  std::vector<ProgramConfig> programs_;
+  std::unordered_map<std::string, std::size_t> by_section_;
+  std::unordered_map<std::string, std::size_t> by_id_;
+};
+
+// The process's current radicc.toml snapshot, loaded on first use. Cheap:
+// a shared_ptr copy under a short lock.
+std::shared_ptr<const ConfigSnapshot> current_config();
+// Re-reads radicc.toml now and swaps the result in. A file that no longer
+// parses, e.g. one an editor is halfway through saving, keeps the previous
+// snapshot in place.
+std::shared_ptr<const ConfigSnapshot> reload_config();
+// Starts a background thread that reloads the snapshot whenever radicc.toml
+// changes (inotify on Linux, a periodic stat elsewhere). For long-running
+// processes; idempotent.
+void watch_config();
+
+}  // namespace radicc
@@ -0,0 +1,45 @@
+#include "core/hls_playlist.h"
+
+#include "core/radiko_http.h"
+
+namespace radicc {
+
+std::string resolve_playlist_url(const std::string& base_url, const std::string& reference) {
+  if (reference.find("://") != std::string::npos) return reference;
+  const std::size_t scheme_end = base_url.find("://");
+  if (scheme_end == std::string::npos) return reference;
+  if (reference.rfind("//", 0) == 0) return base_url.substr(0, scheme_end + 1) + reference;
+  if (!reference.empty() && reference.front() == '/') {
+    const std::size_t path_start = base_url.find('/', scheme_end + 3);
+    return (path_start == std::string::npos ? base_url : base_url.substr(0, path_start)) + reference;
+  }
+  const std::size_t query = base_url.find('?');
+  const std::size_t slash = base_url.rfind('/', query == std::string::npos ? std::string::npos : query);
+  if (slash == std::string::npos || slash < scheme_end + 3) return base_url + "/" + reference;
+  return base_url.substr(0, slash + 1) + reference;
+}
+
+HlsPlaylist parse_hls_playlist(const std::string& body, const std::string& playlist_url) {
+  HlsPlaylist playlist;
+  bool next_is_variant = false;
+  std::size_t line_start = 0;
+  while (line_start < body.size()) {
+    const std::size_t line_end = body.find('\n', line_start);
+    std::string line = trim_crlf(body.substr(
+        line_start, line_end == std::string::npos ? std::string::npos : line_end - line_start));
+    line_start = line_end == std::string::npos ? body.size() : line_end + 1;
+    while (!line.empty() && (line.back() == ' ' || line.back() == '\t')) line.pop_back();
+    if (line.empty()) continue;
+    if (line.front() == '#') {
+      if (line.rfind("#EXT-X-STREAM-INF", 0) == 0) next_is_variant = true;
+      continue;
+    }
+    const std::string url = resolve_playlist_url(playlist_url, line);
+    if (next_is_variant) playlist.variant_urls.push_back(url);
+    else playlist.segment_urls.push_back(url);
+    next_is_variant = false;
+  }
+  return playlist;
+}
+
+}  // namespace radicc
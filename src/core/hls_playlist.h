@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace radicc {
+
+struct HlsPlaylist {
+  std::vector<std::string> variant_urls;  // master playlist entries
+  std::vector<std::string> segment_urls;  // media playlist entries
+};
+
+HlsPlaylist parse_hls_playlist(const std::string& body, const std::string& playlist_url);
+std::string resolve_playlist_url(const std::string& base_url, const std::string& reference);
+
+}  // namespace radicc
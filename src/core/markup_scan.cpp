@@ -0,0 +1,165 @@
+#include "core/markup_scan.h"
+
+#include <algorithm>
+#include <array>
+
+namespace radicc {
+namespace {
+
+constexpr std::size_t npos = std::string_view::npos;
+// An <img> tag longer than this is not worth waiting for.
+constexpr std::size_t kMaxPendingTag = 64 * 1024;
+
+// std::regex's \w in the classic locale.
+constexpr std::array<bool, 256> kWordChars = [] {
+  std::array<bool, 256> table{};
+  for (int c = '0'; c <= '9'; ++c) table[c] = true;
+  for (int c = 'A'; c <= 'Z'; ++c) table[c] = true;
+  for (int c = 'a'; c <= 'z'; ++c) table[c] = true;
+  table['_'] = true;
+  return table;
+}();
+
+// \b right after a name that ends in a word character.
+bool word_boundary_at(std::string_view text, std::size_t position) {
+  return position >= text.size() || !kWordChars[static_cast<unsigned char>(text[position])];
+}
+
+// (\d{14})" at `position`.
+bool datetime14_then_quote(std::string_view text, std::size_t position) {
+  if (text.size() < position + 15 || text[position + 14] != '"') return false;
+  for (std::size_t i = position; i < position + 14; ++i) {
+    if (text[i] < '0' || text[i] > '9') return false;
+  }
+  return true;
+}
+
+// Occurrences of `needle` at or after `from` that [^>]*? can reach, i.e.
+// with no '>' in between, in order.
+template <typename Visit>
+bool for_each_within_tag(std::string_view text, std::string_view needle, std::size_t from, Visit&& visit) {
+  const std::size_t limit = text.find('>', from);
+  for (std::size_t at = text.find(needle, from); at != npos && at < limit; at = text.find(needle, at + 1)) {
+    if (visit(at)) return true;
+  }
+  return false;
+}
+
+}  // namespace
+
+std::optional<std::string_view> find_element_text(std::string_view text, std::string_view name) {
+  const std::string open = "<" + std::string(name) + ">";
+  const std::string close = "</" + std::string(name) + ">";
+  // A later opening tag cannot succeed where the first found no closing one.
+  const std::size_t start = text.find(open);
+  if (start == npos) return std::nullopt;
+  const std::size_t body = start + open.size();
+  const std::size_t stop = text.find(close, body);
+  if (stop == npos) return std::nullopt;
+  return text.substr(body, stop - body);
+}
+
+std::optional<MarkupElement> find_element(std::string_view text, std::string_view name, std::size_t from) {
+  const std::string open = "<" + std::string(name);
+  const std::string close = "</" + std::string(name) + ">";
+  for (std::size_t start = text.find(open, from); start != npos; start = text.find(open, start + 1)) {
+    const std::size_t attributes = start + open.size();
+    if (!word_boundary_at(text, attributes)) continue;
+    const std::size_t gt = text.find('>', attributes);
+    if (gt == npos) return std::nullopt;
+    const std::size_t stop = text.find(close, gt + 1);
+    if (stop == npos) return std::nullopt;
+    return MarkupElement{text.substr(attributes, gt - attributes), text.substr(gt + 1, stop - gt - 1),
+                         stop + close.size()};
+  }
+  return std::nullopt;
+}
+
+std::optional<ProgElement> find_prog_element(std::string_view text, std::size_t from) {
+  constexpr std::string_view kOpen = "<prog";
+  constexpr std::string_view kClose = "</prog>";
+  // Tries the same alternatives as the regex, in the same order: each lazy
+  // gap takes the earliest attribute that lets the rest of the tag match.
+  const auto match_to = [&](std::size_t after_ft, ProgElement& prog) {
+    return for_each_within_tag(text, "to=\"", after_ft, [&](std::size_t to) {
+      if (!datetime14_then_quote(text, to + 4)) return false;
+      const std::size_t gt = text.find('>', to + 19);
+      if (gt == npos) return false;
+      const std::size_t stop = text.find(kClose, gt + 1);
+      if (stop == npos) return false;
+      prog.to = text.substr(to + 4, 14);
+      prog.body = text.substr(gt + 1, stop - gt - 1);
+      prog.end = stop + kClose.size();
+      return true;
+    });
+  };
+  const auto match_ft = [&](std::size_t after_id, ProgElement& prog) {
+    return for_each_within_tag(text, "ft=\"", after_id, [&](std::size_t ft) {
+      if (!datetime14_then_quote(text, ft + 4)) return false;
+      prog.ft = text.substr(ft + 4, 14);
+      return match_to(ft + 19, prog);
+    });
+  };
+  for (std::size_t start = text.find(kOpen, from); start != npos; start = text.find(kOpen, start + 1)) {
+    if (!word_boundary_at(text, start + kOpen.size())) continue;
+    ProgElement prog;
+    const bool matched = for_each_within_tag(text, "id=\"", start + kOpen.size(), [&](std::size_t id) {
+      const std::size_t value = id + 4;
+      const std::size_t quote = text.find('"', value);
+      if (quote == npos || quote == value) return false;
+      prog.id = text.substr(value, quote - value);
+      return match_ft(quote + 1, prog);
+    });
+    if (matched) return prog;
+  }
+  return std::nullopt;
+}
+
+bool ImageSrcScanner::feed(std::string_view data) {
+  if (!src_.empty()) return false;
+  pending_.append(data);
+  return scan(false);
+}
+
+void ImageSrcScanner::finish() {
+  if (src_.empty()) scan(true);
+  pending_.clear();
+}
+
+bool ImageSrcScanner::scan(bool at_end) {
+  constexpr std::string_view kSrc = "src=\"";
+  const std::string_view text = pending_;
+  const auto wait_from = [&](std::size_t start) {
+    pending_.erase(0, start);
+    if (pending_.size() > kMaxPendingTag) pending_.clear();
+    return true;
+  };
+  for (std::size_t open = text.find("<img"); ; open = text.find("<img", open + 1)) {
+    if (open == npos) {
+      // Keep enough of the tail to see a "<img" split across pieces.
+      if (!at_end) pending_.erase(0, pending_.size() - std::min<std::size_t>(pending_.size(), 3));
+      return true;
+    }
+    // [^>]+ is greedy, so the last src=" before the tag ends is tried
+    // first. Without a '>' the tag may still be arriving.
+    const std::size_t gt = text.find('>', open + 4);
+    if (gt == npos && !at_end) return wait_from(open);
+    const std::size_t limit = gt == npos ? text.size() : gt;
+    if (limit <= open + 5) continue;
+    for (std::size_t src = text.rfind(kSrc, limit - 1); src != npos && src >= open + 5;
+         src = src == 0 ? npos : text.rfind(kSrc, src - 1)) {
+      const std::size_t value = src + kSrc.size();
+      const std::size_t quote = text.find('"', value);
+      if (quote == npos) {
+        if (!at_end) return wait_from(open);
+        continue;
+      }
+      if (quote == value) continue;
+      src_ = std::string(text.substr(value, quote - value));
+      pending_.clear();
+      return false;
+    }
+  }
+}
+
+}  // namespace radicc
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Hand-written matchers for the few shapes radicc pulls out of radiko's XML
+// and HTML. Each one returns exactly what the std::regex noted beside it
+// would, without compiling a pattern per call or backtracking through the
+// document.
+
+namespace radicc {
+
+// <name>([\s\S]*?)</name>: the text of the first such element.
+std::optional<std::string_view> find_element_text(std::string_view text, std::string_view name);
+
+struct MarkupElement {
+  std::string_view attributes;  // everything between the name and '>'
+  std::string_view body;
+  std::size_t end = 0;  // just past the closing tag
+};
+
+// <name\b([^>]*)>([\s\S]*?)</name>, searched from `from`.
+std::optional<MarkupElement> find_element(std::string_view text, std::string_view name, std::size_t from = 0);
+
+struct ProgElement {
+  std::string_view id;
+  std::string_view ft;
+  std::string_view to;
+  std::string_view body;
+  std::size_t end = 0;  // just past </prog>
+};
+
+// <prog\b[^>]*?id="([^"]+)"[^>]*?ft="(\d{14})"[^>]*?to="(\d{14})"[^>]*?>([\s\S]*?)</prog>,
+// searched from `from`.
+std::optional<ProgElement> find_prog_element(std::string_view text, std::size_t from = 0);
+
+// Finds the first <img[^>]+src="([^"]+)" in HTML fed in arbitrary pieces, so
+// a page can be scanned while it downloads.
+class ImageSrcScanner {
+ public:
+  // Returns false once a src was found and no more input is needed.
+  bool feed(std::string_view data);
+  // Settles a tag left open by input that ended early.
+  void finish();
+  const std::string& src() const { return src_; }
+
+ private:
+  bool scan(bool at_end);
+
+  std::string pending_;  // an unfinished tag, or a tail that may start one
+  std::string src_;
+};
+
+}  // namespace radicc
@@ -0,0 +1,223 @@
+#include "core/output_sink.h"
+
+#include "utils/atomic_file.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace radicc {
+namespace {
+
+constexpr std::size_t kBufferAlignment = 4096;
+// Buffers in flight in async mode; the caller waits once all are queued.
+constexpr std::size_t kAsyncBuffers = 4;
+
+// The data is already synced; the directory sync makes the rename durable.
+bool move_into_place(const std::string& partial_path, const std::string& final_path) {
+  if (std::rename(partial_path.c_str(), final_path.c_str()) != 0) return false;
+  sync_parent_directory(final_path);
+  return true;
+}
+
+}  // namespace
+
+std::string partial_output_path(const std::string& final_path) {
+  static std::atomic<unsigned> next{0};
+  const std::size_t slash = final_path.find_last_of('/');
+  const std::string directory = slash == std::string::npos ? std::string() : final_path.substr(0, slash + 1);
+  const std::string name = slash == std::string::npos ? final_path : final_path.substr(slash + 1);
+  return directory + "." + name + ".partial-" + std::to_string(static_cast<long>(::getpid())) + "-"
+      + std::to_string(next.fetch_add(1, std::memory_order_relaxed));
+}
+
+std::string kept_partial_output_path(const std::string& final_path) {
+  const std::size_t slash = final_path.find_last_of('/');
+  const std::size_t name_start = slash == std::string::npos ? 0 : slash + 1;
+  const std::size_t dot = final_path.find_last_of('.');
+  if (dot == std::string::npos || dot <= name_start) return final_path + ".partial";
+  return final_path.substr(0, dot) + ".partial" + final_path.substr(dot);
+}
+
+bool commit_output_file(const std::string& partial_path, const std::string& final_path) {
+  const int fd = ::open(partial_path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+  const bool synced = ::fsync(fd) == 0;
+  ::close(fd);
+  return synced && move_into_place(partial_path, final_path);
+}
+
+OutputSink::OutputSink(OutputSinkOptions options) : options_(options) {
+  if (options_.buffer_size < kBufferAlignment) options_.buffer_size = kBufferAlignment;
+  options_.buffer_size = (options_.buffer_size + kBufferAlignment - 1) / kBufferAlignment * kBufferAlignment;
+}
+
+OutputSink::~OutputSink() {
+  abort();
+  for (char* allocation : allocations_) std::free(allocation);
+}
+
+bool OutputSink::fail(const std::string& message) {
+  if (error_.empty()) error_ = message;
+  return false;
+}
+
+OutputSink::Buffer OutputSink::take_free_buffer() {
+  if (options_.async) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [&]() { return !free_.empty() || allocations_.size() < kAsyncBuffers; });
+    if (!free_.empty()) {
+      Buffer buffer = free_.back();
+      free_.pop_back();
+      buffer.size = 0;
+      return buffer;
+    }
+  }
+  void* memory = nullptr;
+  if (::posix_memalign(&memory, kBufferAlignment, options_.buffer_size) != 0) return {};
+  allocations_.push_back(static_cast<char*>(memory));
+  return Buffer{static_cast<char*>(memory), 0};
+}
+
+bool OutputSink::open(const std::string& final_path) {
+  final_path_ = final_path;
+  partial_path_ = partial_output_path(final_path);
+  fd_ = ::open(partial_path_.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+  if (fd_ < 0) return fail("could not open " + partial_path_ + ": " + std::strerror(errno));
+#if defined(__linux__)
+  // KEEP_SIZE reserves the blocks without moving EOF, so the partial file
+  // never shows a zero-filled tail; commit() trims whatever is left over.
+  if (options_.expected_bytes > 0) {
+    ::fallocate(fd_, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(options_.expected_bytes));
+  }
+#endif
+  current_ = take_free_buffer();
+  if (!current_.data) return fail("could not allocate the output buffer");
+  if (options_.async) writer_ = std::thread([this]() { writer_loop(); });
+  return true;
+}
+
+bool OutputSink::write_fully(const Buffer& buffer) {
+  std::size_t offset = 0;
+  while (offset < buffer.size) {
+    const ssize_t written = ::write(fd_, buffer.data + offset, buffer.size - offset);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    offset += static_cast<std::size_t>(written);
+  }
+  return true;
+}
+
+void OutputSink::writer_loop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    changed_.wait(lock, [&]() { return stopping_ || !queued_.empty(); });
+    if (queued_.empty()) return;
+    Buffer buffer = queued_.front();
+    queued_.pop_front();
+    writing_ = true;
+    lock.unlock();
+    const bool ok = write_fully(buffer);
+    const int error = errno;
+    lock.lock();
+    writing_ = false;
+    if (!ok && writer_error_.empty()) writer_error_ = std::string("write failed: ") + std::strerror(error);
+    free_.push_back(buffer);
+    changed_.notify_all();
+  }
+}
+
+bool OutputSink::submit_current() {
+  if (current_.size == 0) return true;
+  if (!options_.async) {
+    if (!write_fully(current_)) return fail(std::string("write failed: ") + std::strerror(errno));
+    current_.size = 0;
+    return true;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!writer_error_.empty()) return fail(writer_error_);
+    queued_.push_back(current_);
+  }
+  changed_.notify_all();
+  current_ = take_free_buffer();
+  return current_.data || fail("could not allocate the output buffer");
+}
+
+bool OutputSink::write(const void* data, std::size_t size) {
+  if (fd_ < 0) return fail("sink is not open");
+  const char* bytes = static_cast<const char*>(data);
+  while (size > 0) {
+    const std::size_t take = std::min(size, options_.buffer_size - current_.size);
+    std::memcpy(current_.data + current_.size, bytes, take);
+    current_.size += take;
+    bytes += take;
+    size -= take;
+    bytes_written_ += take;
+    if (current_.size == options_.buffer_size && !submit_current()) return false;
+  }
+  return true;
+}
+
+bool OutputSink::flush() {
+  if (fd_ < 0) return fail("sink is not open");
+  if (!submit_current()) return false;
+  if (options_.async) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [&]() { return queued_.empty() && !writing_; });
+    if (!writer_error_.empty()) return fail(writer_error_);
+  }
+  flushed_bytes_ = bytes_written_;
+  return true;
+}
+
+void OutputSink::stop_writer() {
+  if (!writer_.joinable()) return;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  changed_.notify_all();
+  writer_.join();
+}
+
+bool OutputSink::commit() {
+  if (!flush()) return false;
+  stop_writer();
+  if (::ftruncate(fd_, static_cast<off_t>(bytes_written_)) != 0) return fail("could not trim " + partial_path_);
+  if (::fsync(fd_) != 0) return fail("fsync failed");
+  const bool closed = ::close(fd_) == 0;
+  fd_ = -1;
+  if (!closed) return fail("close failed");
+  if (!move_into_place(partial_path_, final_path_)) return fail("could not move " + partial_path_ + " into place");
+  partial_path_.clear();
+  return true;
+}
+
+void OutputSink::abort() {
+  stop_writer();
+  bool keep = options_.keep_flushed_on_abort && flushed_bytes_ > 0;
+  if (fd_ >= 0) {
+    // Bytes written since the last flush may end mid-record.
+    keep = keep && ::ftruncate(fd_, static_cast<off_t>(flushed_bytes_)) == 0 && ::fsync(fd_) == 0;
+    ::close(fd_);
+    fd_ = -1;
+  }
+  if (!partial_path_.empty()) {
+    if (!keep || !move_into_place(partial_path_, kept_partial_output_path(final_path_))) {
+      std::remove(partial_path_.c_str());
+    }
+    partial_path_.clear();
+  }
+}
+
+}  // namespace radicc
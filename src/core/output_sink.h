@@ -0,0 +1,94 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace radicc {
+
+struct OutputSinkOptions {
+  // Planned output size; the file is preallocated to it so a long recording
+  // lands in few extents. 0 skips preallocation.
+  std::uint64_t expected_bytes = 0;
+  // Hand full buffers to a writer thread so the caller never waits on disk.
+  bool async = false;
+  std::size_t buffer_size = 1 << 20;
+  // For formats whose every flush() ends on a playable boundary: an aborted
+  // sink keeps the bytes of its last flush as kept_partial_output_path()
+  // instead of removing them.
+  bool keep_flushed_on_abort = false;
+};
+
+// Sequential file writer for recording outputs. Bytes go to a hidden
+// partial file next to the final path through large page-aligned buffers;
+// commit() syncs it and renames it into place, so the final path only ever
+// holds a complete file. A sink that is never committed removes its
+// partial file unless keep_flushed_on_abort is set.
+class OutputSink {
+ public:
+  explicit OutputSink(OutputSinkOptions options = OutputSinkOptions());
+  ~OutputSink();
+  OutputSink(const OutputSink&) = delete;
+  OutputSink& operator=(const OutputSink&) = delete;
+
+  bool open(const std::string& final_path);
+  bool write(const void* data, std::size_t size);
+  // Hands every buffered byte to the file; readers of partial_path() see
+  // them afterwards.
+  bool flush();
+  bool commit();
+  void abort();
+
+  const std::string& partial_path() const { return partial_path_; }
+  std::uint64_t bytes_written() const { return bytes_written_; }
+  const std::string& error() const { return error_; }
+
+ private:
+  struct Buffer {
+    char* data = nullptr;
+    std::size_t size = 0;
+  };
+
+  bool fail(const std::string& message);
+  bool submit_current();
+  bool write_fully(const Buffer& buffer);
+  void writer_loop();
+  void stop_writer();
+  Buffer take_free_buffer();
+
+  OutputSinkOptions options_;
+  std::string final_path_;
+  std::string partial_path_;
+  int fd_ = -1;
+  std::string error_;
+  std::uint64_t bytes_written_ = 0;
+  std::uint64_t flushed_bytes_ = 0;
+  Buffer current_;
+  std::vector<char*> allocations_;
+
+  // Async mode: full buffers queue up for the writer thread and come back
+  // through free_ once written.
+  std::thread writer_;
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  std::deque<Buffer> queued_;
+  std::vector<Buffer> free_;
+  bool writing_ = false;
+  bool stopping_ = false;
+  std::string writer_error_;
+};
+
+// Hidden sibling of `final_path` used while the file is written.
+std::string partial_output_path(const std::string& final_path);
+// Visible sibling that keeps an aborted output: "a/b.m4a" -> "a/b.partial.m4a".
+std::string kept_partial_output_path(const std::string& final_path);
+// fsyncs `partial_path`, renames it to `final_path` and fsyncs the directory.
+bool commit_output_file(const std::string& partial_path, const std::string& final_path);
+
+}  // namespace radicc
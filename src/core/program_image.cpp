@@ -0,0 +1,150 @@
+#include "core/program_image.h"
+
+#include "core/markup_scan.h"
+#include "core/radiko_http.h"
+#include "core/radiko_programs_xml.h"
+#include "utils/atomic_file.h"
+#include "utils/cache_path.h"
+#include "utils/cancellation.h"
+#include "utils/hash.h"
+#include "utils/log.h"
+#include "utils/runtime_settings.h"
+
+#include <sys/stat.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <unordered_map>
+
+namespace radicc {
+namespace {
+
+constexpr char kCoverDir[] = "covers";
+
+struct CachedImageUrl {
+  std::string image_url;
+  std::chrono::steady_clock::time_point resolved;
+};
+
+std::mutex g_image_urls_mutex;
+std::unordered_map<std::string, CachedImageUrl> g_image_urls;  // by program id
+
+std::string program_id(const std::string& event_url) {
+  const std::size_t slash = event_url.find_last_of('/');
+  return slash == std::string::npos ? event_url : event_url.substr(slash + 1);
+}
+
+std::optional<std::string> find_cached_image_url(const std::string& id) {
+  const auto ttl = schedule_cache_ttl();
+  std::lock_guard<std::mutex> lock(g_image_urls_mutex);
+  const auto it = g_image_urls.find(id);
+  if (it == g_image_urls.end()) return std::nullopt;
+  if (std::chrono::steady_clock::now() - it->second.resolved >= ttl) {
+    g_image_urls.erase(it);
+    return std::nullopt;
+  }
+  return it->second.image_url;
+}
+
+// Unlimited unless RADICC_COVER_MAX_KB is set to a positive size.
+std::uint64_t cover_max_bytes() {
+  const std::string value = runtime_env("RADICC_COVER_MAX_KB");
+  char* end = nullptr;
+  const long long kilobytes = value.empty() ? 0 : std::strtoll(value.c_str(), &end, 10);
+  if (!end || *end != '\0' || kilobytes <= 0) return std::numeric_limits<std::uint64_t>::max();
+  return static_cast<std::uint64_t>(kilobytes) * 1024;
+}
+
+bool is_cover_image(const std::string& bytes) {
+  return bytes.compare(0, 2, "\xFF\xD8") == 0 || bytes.compare(0, 4, "\x89PNG") == 0;
+}
+
+std::string cover_path(const std::string& image_url) {
+  const std::string dir = get_cache_path(kCoverDir);
+  if (dir.empty()) return {};
+  if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) return {};
+  return dir + "/" + xxh3_hex(image_url);
+}
+
+std::optional<std::string> read_file(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) return std::nullopt;
+  return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+}  // namespace
+
+std::string cached_program_image_url(const ProgramEventInfo& info) {
+  if (!info.img.empty()) return info.img;
+  if (info.event_url.empty()) return {};
+  return find_cached_image_url(program_id(info.event_url)).value_or(std::string());
+}
+
+std::string resolve_program_image_url(const std::string& event_url) {
+  if (event_url.empty()) return {};
+  const std::string id = program_id(event_url);
+  if (auto cached = find_cached_image_url(id)) return *cached;
+
+  ImageSrcScanner scanner;
+  if (!curl_scan_text(event_url, [&](std::string_view data) { return scanner.feed(data); })) {
+    RADICC_LOG_DEBUG << "Event page unavailable: " << event_url;
+    return {};
+  }
+  scanner.finish();
+  if (schedule_cache_ttl().count() > 0) {
+    std::lock_guard<std::mutex> lock(g_image_urls_mutex);
+    g_image_urls[id] = CachedImageUrl{scanner.src(), std::chrono::steady_clock::now()};
+  }
+  return scanner.src();
+}
+
+std::optional<std::string> load_cover_image(const std::string& image_url) {
+  if (image_url.empty()) return std::nullopt;
+  const std::uint64_t max_bytes = cover_max_bytes();
+  const std::string path = cover_path(image_url);
+  if (!path.empty()) {
+    if (auto bytes = read_file(path); bytes && is_cover_image(*bytes) && bytes->size() <= max_bytes) return bytes;
+  }
+
+  // A cover is small; a slow one is not worth holding the recording for.
+  auto bytes = curl_text({"curl", "--silent", "--fail", "--location", "--connect-timeout", "10", "--max-time", "30",
+                          image_url});
+  if (!bytes || !is_cover_image(*bytes)) {
+    RADICC_LOG_WARN << "Cover image unavailable: " << image_url << " (non-fatal)";
+    return std::nullopt;
+  }
+  if (bytes->size() > max_bytes) {
+    RADICC_LOG_WARN << "Cover image is " << bytes->size() / 1024 << " KB, over RADICC_COVER_MAX_KB; not embedded";
+    return std::nullopt;
+  }
+  if (!path.empty()) write_file_atomically(path, *bytes);
+  return bytes;
+}
+
+std::shared_future<ProgramCover> prefetch_program_cover(const std::string& image_url, const std::string& event_url) {
+  // The caller's cancellation token follows the download, so a stopped
+  // request does not wait for it; its settings snapshot goes along too.
+  return std::async(std::launch::async,
+                    [image_url, event_url, token = current_cancellation(), settings = scoped_runtime_settings()]() {
+                      CancellationScope scope(token);
+                      RuntimeSettingsScope settings_scope(settings);
+                      ProgramCover cover;
+                      cover.image_url = resolve_program_image_url(event_url);
+                      if (cover.image_url.empty()) cover.image_url = image_url;
+                      if (auto bytes = load_cover_image(cover.image_url)) {
+                        cover.bytes = std::move(*bytes);
+                        struct stat st;
+                        const std::string path = cover_path(cover.image_url);
+                        if (!path.empty() && stat(path.c_str(), &st) == 0) cover.path = path;
+                      }
+                      return cover;
+                    })
+      .share();
+}
+
+}  // namespace radicc
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "core/radiko_programs.h"
+
+#include <future>
+#include <optional>
+#include <string>
+
+namespace radicc {
+
+// The image URL for `info`: its schedule <img>, else the image URL already
+// found on its event page by this process. Never fetches; empty when the
+// page was not scanned yet.
+std::string cached_program_image_url(const ProgramEventInfo& info);
+
+// The first image on the event page at `event_url`, scanned only up to that
+// image. Results, including pages without one, are cached by program id for
+// the schedule cache TTL.
+std::string resolve_program_image_url(const std::string& event_url);
+
+// JPEG or PNG bytes of `image_url`, downloaded once into
+// $XDG_CACHE_HOME/radicc/covers and read from there afterwards. nullopt
+// when the image is unavailable, in another format, or larger than
+// RADICC_COVER_MAX_KB when that is set (no limit by default).
+std::optional<std::string> load_cover_image(const std::string& image_url);
+
+struct ProgramCover {
+  std::string image_url;
+  std::string bytes;  // empty when no cover is available
+  std::string path;   // the cached copy, for readers that need a file; may be empty
+};
+
+// Resolves and downloads a cover on a background thread. The event page
+// at `event_url` is scanned when set and its image wins; `image_url` is
+// the fallback.
+std::shared_future<ProgramCover> prefetch_program_cover(const std::string& image_url, const std::string& event_url);
+
+}  // namespace radicc
@@ -0,0 +1,220 @@
+#include "core/program_search.h"
+
+#include "core/radiko_programs_xml.h"
+#include "core/schedule_snapshot.h"
+#include "utils/log.h"
+#include "utils/text_fold.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace radicc {
+namespace {
+
+constexpr std::size_t kRefreshWorkers = 8;
+
+std::uint64_t term_key(char32_t first, char32_t second) {
+  return (static_cast<std::uint64_t>(first) << 32) | second;
+}
+
+// Every character and adjacent pair of `folded`, deduplicated. Queries pass
+// `pairs_only` so a longer word is matched by its pairs alone.
+std::vector<std::uint64_t> terms_of(const std::u32string& folded, bool pairs_only) {
+  std::vector<std::uint64_t> terms;
+  std::size_t start = 0;
+  while (start < folded.size()) {
+    std::size_t end = folded.find(U' ', start);
+    if (end == std::u32string::npos) end = folded.size();
+    const bool single = end - start == 1;
+    for (std::size_t i = start; i < end; ++i) {
+      if (!pairs_only || single) terms.push_back(term_key(folded[i], 0));
+      if (i + 1 < end) terms.push_back(term_key(folded[i], folded[i + 1]));
+    }
+    start = end + 1;
+  }
+  std::sort(terms.begin(), terms.end());
+  terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+  return terms;
+}
+
+std::mutex g_refresh_mutex;
+std::vector<std::string> g_station_ids;
+std::chrono::steady_clock::time_point g_station_ids_fetched;
+
+}  // namespace
+
+void ProgramSearchIndex::remove_station_locked(const std::string& station_id) {
+  const auto it = by_station_.find(station_id);
+  if (it == by_station_.end()) return;
+  // One pass over each affected posting list, however many of the
+  // station's entries are on it.
+  std::vector<bool> removed(entries_.size());
+  std::vector<std::uint64_t> terms;
+  for (const std::uint32_t index : it->second) {
+    removed[index] = true;
+    terms.insert(terms.end(), entries_[index].terms.begin(), entries_[index].terms.end());
+    entries_[index] = Entry();
+    free_.push_back(index);
+  }
+  std::sort(terms.begin(), terms.end());
+  terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+  for (const std::uint64_t term : terms) {
+    const auto posting = postings_.find(term);
+    if (posting == postings_.end()) continue;
+    auto& list = posting->second;
+    list.erase(std::remove_if(list.begin(), list.end(), [&](std::uint32_t value) { return removed[value >> 1]; }),
+               list.end());
+    if (list.empty()) postings_.erase(posting);
+  }
+  by_station_.erase(it);
+}
+
+void ProgramSearchIndex::update_station(const std::string& station_id, const std::vector<ProgramEventInfo>& programs) {
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  remove_station_locked(station_id);
+  auto& station_entries = by_station_[station_id];
+  for (const auto& program : programs) {
+    Entry entry;
+    entry.station_id = station_id;
+    entry.program = program;
+    entry.folded_title = fold_for_match(program.title);
+    const auto title_terms = terms_of(entry.folded_title, false);
+    const auto pfm_terms = terms_of(fold_for_match(program.pfm), false);
+    std::set_union(title_terms.begin(), title_terms.end(), pfm_terms.begin(), pfm_terms.end(),
+                   std::back_inserter(entry.terms));
+    entry.live = true;
+
+    std::uint32_t index;
+    if (!free_.empty()) {
+      index = free_.back();
+      free_.pop_back();
+      entries_[index] = std::move(entry);
+    } else {
+      index = static_cast<std::uint32_t>(entries_.size());
+      entries_.push_back(std::move(entry));
+    }
+    for (const std::uint64_t term : title_terms) postings_[term].push_back(index << 1 | 1);
+    for (const std::uint64_t term : pfm_terms) postings_[term].push_back(index << 1);
+    station_entries.push_back(index);
+  }
+  updated_[station_id] = std::chrono::steady_clock::now();
+}
+
+std::chrono::steady_clock::time_point ProgramSearchIndex::station_updated(const std::string& station_id) const {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  const auto it = updated_.find(station_id);
+  return it == updated_.end() ? std::chrono::steady_clock::time_point() : it->second;
+}
+
+std::vector<ProgramSearchHit> ProgramSearchIndex::search(const std::string& query, std::size_t limit,
+                                                        const std::string& station_id) const {
+  const std::u32string folded_query = fold_for_match(query);
+  const auto terms = terms_of(folded_query, true);
+  if (terms.empty() || limit == 0) return {};
+  // Short queries must match in full; longer ones may miss a third of their
+  // pairs, which tolerates small spelling differences.
+  const std::size_t required = terms.size() <= 2 ? terms.size() : (terms.size() * 2 + 2) / 3;
+
+  struct Score {
+    int weight = 0;  // 2 per term found in the title, 1 per term found only in the performer
+    std::size_t matched = 0;
+  };
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  std::unordered_map<std::uint32_t, Score> scores;
+  for (const std::uint64_t term : terms) {
+    const auto posting = postings_.find(term);
+    if (posting == postings_.end()) continue;
+    std::unordered_map<std::uint32_t, int> best;
+    for (const std::uint32_t value : posting->second) {
+      int& weight = best[value >> 1];
+      weight = std::max(weight, (value & 1) ? 2 : 1);
+    }
+    for (const auto& [index, weight] : best) {
+      Score& score = scores[index];
+      score.weight += weight;
+      ++score.matched;
+    }
+  }
+
+  std::vector<ProgramSearchHit> hits;
+  for (const auto& [index, score] : scores) {
+    if (score.matched < required) continue;
+    const Entry& entry = entries_[index];
+    if (!entry.live || (!station_id.empty() && entry.station_id != station_id)) continue;
+    ProgramSearchHit hit;
+    hit.station_id = entry.station_id;
+    hit.program = entry.program;
+    hit.score = static_cast<double>(score.weight) / (2.0 * static_cast<double>(terms.size()));
+    if (entry.folded_title.find(folded_query) != std::u32string::npos) hit.score += 0.5;
+    hits.push_back(std::move(hit));
+  }
+  lock.unlock();
+
+  const auto order = [](const ProgramSearchHit& a, const ProgramSearchHit& b) {
+    if (a.score != b.score) return a.score > b.score;
+    if (a.program.ft != b.program.ft) return a.program.ft < b.program.ft;
+    return a.station_id < b.station_id;
+  };
+  if (hits.size() > limit) {
+    std::partial_sort(hits.begin(), hits.begin() + static_cast<std::ptrdiff_t>(limit), hits.end(), order);
+    hits.resize(limit);
+  } else {
+    std::sort(hits.begin(), hits.end(), order);
+  }
+  return hits;
+}
+
+std::size_t ProgramSearchIndex::size() const {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  return entries_.size() - free_.size();
+}
+
+ProgramSearchIndex& program_search_index() {
+  static ProgramSearchIndex index;
+  return index;
+}
+
+std::size_t refresh_program_search_index() {
+  std::lock_guard<std::mutex> lock(g_refresh_mutex);
+  const auto now = std::chrono::steady_clock::now();
+  const auto ttl = schedule_cache_ttl();
+  if (g_station_ids.empty() || now - g_station_ids_fetched >= ttl) {
+    // A snapshot lists the stations it was built from; upstream otherwise.
+    std::vector<std::string> ids;
+    if (const auto snapshot = current_schedule_snapshot()) ids = snapshot->station_ids();
+    if (ids.empty()) ids = fetch_station_ids();
+    if (!ids.empty()) {
+      g_station_ids = std::move(ids);
+      g_station_ids_fetched = now;
+    }
+    if (g_station_ids.empty()) RADICC_LOG_WARN << "Search: station list is unavailable.";
+  }
+
+  std::vector<std::string> stale;
+  for (const auto& station_id : g_station_ids) {
+    const auto updated = program_search_index().station_updated(station_id);
+    if (updated == std::chrono::steady_clock::time_point() || now - updated >= ttl) stale.push_back(station_id);
+  }
+  if (stale.empty()) return 0;
+
+  // fetch_program_schedule() indexes each weekly schedule it fetches.
+  std::atomic<std::size_t> next{0};
+  std::vector<std::thread> workers;
+  for (std::size_t i = 0; i < std::min(kRefreshWorkers, stale.size()); ++i) {
+    workers.emplace_back([&]() {
+      for (std::size_t n; (n = next.fetch_add(1)) < stale.size();) {
+        fetch_program_schedule("https://radiko.jp/v3/program/station/weekly/" + stale[n] + ".xml");
+      }
+    });
+  }
+  for (auto& worker : workers) worker.join();
+  RADICC_LOG_DEBUG << "Search: refreshed " << stale.size() << " stations, " << program_search_index().size()
+                   << " programs indexed";
+  return stale.size();
+}
+
+}  // namespace radicc
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "core/radiko_programs.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace radicc {
+
+struct ProgramSearchHit {
+  std::string station_id;
+  ProgramEventInfo program;
+  double score = 0.0;  // 0..1, plus 0.5 when the title contains the whole query
+};
+
+// Inverted index over program titles and performers. Text is folded with
+// fold_for_match() and split on whitespace; every character and every pair
+// of adjacent characters is a term, which suits Japanese titles with no
+// word boundaries. Entries are replaced one station at a time.
+class ProgramSearchIndex {
+ public:
+  // Replaces everything indexed for `station_id` with `programs`.
+  void update_station(const std::string& station_id, const std::vector<ProgramEventInfo>& programs);
+  // When `station_id` was last updated; the epoch when it never was.
+  std::chrono::steady_clock::time_point station_updated(const std::string& station_id) const;
+
+  // Best matches first: title matches outrank performer matches, then
+  // earlier airings come first. `station_id` limits the search when set.
+  std::vector<ProgramSearchHit> search(const std::string& query, std::size_t limit,
+                                       const std::string& station_id = std::string()) const;
+  std::size_t size() const;
+
+ private:
+  struct Entry {
+    std::string station_id;
+    ProgramEventInfo program;
+    std::u32string folded_title;
+    std::vector<std::uint64_t> terms;  // posting lists this entry is on
+    bool live = false;
+  };
+
+  void remove_station_locked(const std::string& station_id);
+
+  mutable std::shared_mutex mutex_;
+  std::vector<Entry> entries_;
+  std::vector<std::uint32_t> free_;
+  // Term -> entry index << 1 | 1 for a title term, 0 for a performer term.
+  std::unordered_map<std::uint64_t, std::vector<std::uint32_t>> postings_;
+  std::unordered_map<std::string, std::vector<std::uint32_t>> by_station_;
+  std::unordered_map<std::string, std::chrono::steady_clock::time_point> updated_;
+};
+
+// The process's index. fetch_program_schedule() feeds it every weekly schedule
+// it fetches or reads from the schedule snapshot, so it follows schedule
+// refreshes on its own.
+ProgramSearchIndex& program_search_index();
+
+// Fetches the weekly schedule of every station that is not indexed yet or
+// was indexed longer ago than the schedule cache TTL. Concurrent callers
+// share one refresh. Returns the number of stations refreshed.
+std::size_t refresh_program_search_index();
+
+}  // namespace radicc
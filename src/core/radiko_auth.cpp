@@ -2,8 +2,9 @@
 
 #include "core/radiko_http.h"
 #include "utils/base64.h"
+#include "utils/log.h"
+#include "utils/trace.h"
 
-#include <iostream>
 
 namespace radicc {
 namespace {
@@ -67,8 +68,9 @@ std::optional<std::string> extract_header_value(const std::string& headers, cons
 }  // namespace
 
 std::optional<RadikoLoginSession> login_to_radiko(const std::string& mail, const std::string& password) {
+  TraceSpan span("login_to_radiko");
   if (mail.empty() || password.empty()) {
-    std::cerr << "Warning: No Radiko credentials provided. Skipping login.\n";
+    RADICC_LOG_WARN << "Warning: No Radiko credentials provided. Skipping login.";
     return std::nullopt;
   }
 
@@ -78,13 +80,13 @@ std::optional<RadikoLoginSession> login_to_radiko(const std::string& mail, const
       "--data-urlencode", "pass=" + password,
       "https://radiko.jp/v4/api/member/login"});
   if (!body) {
-    std::cerr << "Error: Failed to execute login command.\n";
+    RADICC_LOG_ERROR << "Error: Failed to execute login command.";
     return std::nullopt;
   }
 
   auto session_id = find_json_string(*body, "radiko_session");
   if (!session_id || session_id->empty()) {
-    std::cerr << "Login failed: Radiko session not found.\n";
+    RADICC_LOG_ERROR << "Login failed: Radiko session not found.";
     return std::nullopt;
   }
 
@@ -95,6 +97,7 @@ std::optional<RadikoLoginSession> login_to_radiko(const std::string& mail, const
 }
 
 std::optional<RadikoAuthState> authorize_radiko(const std::string& session_id) {
+  TraceSpan span("authorize_radiko");
   const auto auth1_headers = curl_text({
       "curl", "--silent",
       "--header", "X-Radiko-App: pc_html5",
@@ -105,7 +108,7 @@ std::optional<RadikoAuthState> authorize_radiko(const std::string& session_id) {
       "--output", "/dev/null",
       "https://radiko.jp/v2/api/auth1"});
   if (!auth1_headers) {
-    std::cerr << "Error: Failed to execute auth1 command.\n";
+    RADICC_LOG_ERROR << "Error: Failed to execute auth1 command.";
     return std::nullopt;
   }
 
@@ -113,7 +116,7 @@ std::optional<RadikoAuthState> authorize_radiko(const std::string& session_id) {
   auto keyoffset = extract_header_value(*auth1_headers, "x-radiko-keyoffset");
   auto keylength = extract_header_value(*auth1_headers, "x-radiko-keylength");
   if (!authtoken || !keyoffset || !keylength) {
-    std::cerr << "Authorization failed: Required fields not found.\n";
+    RADICC_LOG_ERROR << "Authorization failed: Required fields not found.";
     return std::nullopt;
   }
 
@@ -132,13 +135,13 @@ std::optional<RadikoAuthState> authorize_radiko(const std::string& session_id) {
 
   const std::string normalized = trim_crlf(*auth2_body);
   if (normalized.empty() || normalized == "OUT") {
-    std::cerr << "Authorization failed: auth2 returned empty/OUT.\n";
+    RADICC_LOG_ERROR << "Authorization failed: auth2 returned empty/OUT.";
     return std::nullopt;
   }
 
   const std::size_t comma = normalized.find(',');
   if (comma == std::string::npos || comma == 0) {
-    std::cerr << "Authorization failed: area_id not found.\n";
+    RADICC_LOG_ERROR << "Authorization failed: area_id not found.";
     return std::nullopt;
   }
 
@@ -151,6 +154,7 @@ std::optional<RadikoAuthState> authorize_radiko(const std::string& session_id) {
 std::optional<bool> is_station_available_in_area(
     const std::string& station_id,
     const std::string& area_id) {
+  TraceSpan span("is_station_available_in_area", station_id);
   if (station_id.empty() || area_id.empty()) return std::nullopt;
 
   const auto xml = curl_get_text("https://radiko.jp/v3/station/list/" + area_id + ".xml");
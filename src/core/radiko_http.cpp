@@ -1,11 +1,33 @@
 #include "core/radiko_http.h"
 
+#include "core/retry_policy.h"
+#include "core/upstream_governor.h"
+#include "utils/cancellation.h"
+#include "utils/metrics.h"
+#include "utils/runtime_settings.h"
+#include "utils/trace.h"
+
+#include <poll.h>
+#include <signal.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include <chrono>
+#include <cerrno>
+#include <cstdlib>
+#include <map>
+
 namespace radicc {
 
 int run_command_capture(const std::vector<std::string>& args, std::string& output) {
+  return run_command_stream(args, [&](std::string_view data) {
+    output.append(data);
+    return true;
+  });
+}
+
+int run_command_stream(const std::vector<std::string>& args,
+                       const std::function<bool(std::string_view)>& on_output) {
   int pipefd[2];
   if (pipe(pipefd) != 0) return -1;
 
@@ -31,23 +53,142 @@ int run_command_capture(const std::vector<std::string>& args, std::string& outpu
   }
 
   close(pipefd[1]);
+  // With a cancellation token in scope the pipe is polled, and the child is
+  // killed as soon as the token expires.
+  const auto token = current_cancellation();
+  bool killed = false;
+  bool stopped = false;
   char buf[4096];
-  ssize_t n = 0;
-  while ((n = read(pipefd[0], buf, sizeof(buf))) > 0) {
-    output.append(buf, static_cast<size_t>(n));
+  pollfd pfd{pipefd[0], POLLIN, 0};
+  while (true) {
+    if (token && !killed && token->expired()) {
+      kill(pid, SIGKILL);
+      killed = true;
+    }
+    const int ready = poll(&pfd, 1, token && !killed ? 100 : -1);
+    if (ready < 0 && errno != EINTR) break;
+    if (ready <= 0) continue;
+    const ssize_t n = read(pipefd[0], buf, sizeof(buf));
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+    if (!on_output(std::string_view(buf, static_cast<size_t>(n)))) {
+      kill(pid, SIGKILL);
+      stopped = true;
+      break;
+    }
   }
   close(pipefd[0]);
 
   int status = 0;
   if (waitpid(pid, &status, 0) < 0) return -1;
+  if (killed) return -1;
+  if (stopped) return 0;
   if (WIFEXITED(status)) return WEXITSTATUS(status);
   return -1;
 }
 
+int upstream_stall_timeout_seconds() {
+  const int seconds = std::atoi(runtime_env("RADICC_STALL_TIMEOUT").c_str());
+  return seconds > 0 ? seconds : 30;
+}
+
+namespace {
+
+// Written by --write-out after every transfer, so each response's status
+// can be told apart from the bodies in the captured output.
+constexpr char kStatusMarker[] = "\x1eradicc-http-status:";
+constexpr std::size_t kStatusDigits = 3;
+
+struct CurlTransfer {
+  std::string body;
+  int status = 0;
+};
+
+struct CurlRun {
+  int exit_code = 0;
+  std::vector<CurlTransfer> transfers;
+  std::string trailing;  // output after the last transfer, e.g. error text
+
+  int last_status() const { return transfers.empty() ? 0 : transfers.back().status; }
+  std::string output() const {
+    std::string joined;
+    for (const auto& transfer : transfers) joined += transfer.body;
+    return joined + trailing;
+  }
+};
+
+CurlRun parse_curl_output(int exit_code, const std::string& output) {
+  CurlRun run;
+  run.exit_code = exit_code;
+  const std::size_t marker_size = sizeof(kStatusMarker) - 1;
+  std::size_t start = 0;
+  std::size_t marker = 0;
+  while ((marker = output.find(kStatusMarker, start)) != std::string::npos
+         && marker + marker_size + kStatusDigits <= output.size()) {
+    CurlTransfer transfer;
+    transfer.body = output.substr(start, marker - start);
+    transfer.status = std::atoi(output.substr(marker + marker_size, kStatusDigits).c_str());
+    run.transfers.push_back(std::move(transfer));
+    start = marker + marker_size + kStatusDigits;
+  }
+  run.trailing = output.substr(start);
+  return run;
+}
+
+// One attempt: waits for the governor, then runs curl with every URL in
+// `urls` appended to `args`.
+CurlRun run_curl_attempt(std::vector<std::string> args, const std::vector<std::string>& urls,
+                         const std::string& labels) {
+  std::map<std::string, std::pair<std::string, std::size_t>> requests_by_host;
+  for (const auto& url : urls) {
+    auto& [host_url, count] = requests_by_host[upstream_host(url)];
+    if (host_url.empty()) host_url = url;
+    ++count;
+  }
+  for (const auto& [host, request] : requests_by_host) acquire_upstream_requests(request.first, request.second);
+
+  args.push_back("--write-out");
+  args.push_back(std::string(kStatusMarker) + "%{http_code}");
+  args.insert(args.end(), urls.begin(), urls.end());
+  const auto started = std::chrono::steady_clock::now();
+  std::string output;
+  int rc = 0;
+  {
+    TraceSpan span("http", urls.empty() ? std::string() : urls.front());
+    rc = run_command_capture(args, output);
+  }
+  metrics()
+      .histogram("radicc_upstream_request_duration_seconds", "Upstream HTTP request latency by endpoint.",
+                 latency_buckets_seconds(), labels)
+      .observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count());
+  if (rc != 0) {
+    metrics().counter("radicc_upstream_request_failures_total", "Failed upstream HTTP requests by endpoint.", labels).add();
+  }
+  return parse_curl_output(rc, output);
+}
+
+bool is_url(const std::string& arg) {
+  return arg.rfind("https://", 0) == 0 || arg.rfind("http://", 0) == 0;
+}
+
+}  // namespace
+
 std::optional<std::string> curl_text(const std::vector<std::string>& args) {
-  std::string result;
-  if (run_command_capture(args, result) != 0) return std::nullopt;
-  return result;
+  std::vector<std::string> options;
+  std::vector<std::string> urls;
+  for (const auto& arg : args) (is_url(arg) ? urls : options).push_back(arg);
+  const std::string url = urls.empty() ? std::string() : urls.front();
+  const std::string labels = "endpoint=\"" + classify_upstream_endpoint(url) + "\"";
+  UpstreamCall call(url);
+  while (call.begin()) {
+    const CurlRun run = run_curl_attempt(options, urls, labels);
+    if (run.exit_code == 0) {
+      call.succeeded();
+      return run.output();
+    }
+    if (!call.retry(classify_http_failure(run.exit_code, run.last_status()))) break;
+  }
+  return std::nullopt;
 }
 
 std::optional<std::string> curl_get_text(const std::string& url) {
@@ -60,13 +201,104 @@ std::optional<std::string> curl_get_text(const std::string& url) {
       "--compressed",
       "--connect-timeout", "15",
       "--max-time", "60",
-      "--retry", "2",
-      "--retry-delay", "1",
-      "--retry-all-errors",
       url,
   });
 }
 
+std::optional<std::string> curl_get_binary(
+    const std::vector<std::string>& urls,
+    const std::vector<std::string>& headers,
+    int* http_status) {
+  if (http_status) *http_status = 0;
+  if (urls.empty()) return std::string();
+  // stderr shares the capture pipe, so errors must stay silent here.
+  std::vector<std::string> args = {
+      "curl",
+      "--silent",
+      "--fail",
+      "--fail-early",
+      "--location",
+      "--connect-timeout", "15",
+      "--max-time", "600",
+      // A transfer that moves no data for the stall timeout is dropped.
+      "--speed-limit", "1",
+      "--speed-time", std::to_string(upstream_stall_timeout_seconds()),
+  };
+  for (const auto& header : headers) {
+    args.push_back("--header");
+    args.push_back(header);
+  }
+  const std::string labels = "endpoint=\"" + classify_upstream_endpoint(urls.front()) + "\"";
+  std::string bodies;
+  std::size_t done = 0;
+  UpstreamCall call(urls.front());
+  while (call.begin()) {
+    std::vector<std::string> attempt_args = args;
+    if (const std::uint64_t rate = upstream_bandwidth_share()) {
+      attempt_args.push_back("--limit-rate");
+      attempt_args.push_back(std::to_string(rate));
+    }
+    const CurlRun run = run_curl_attempt(
+        attempt_args, std::vector<std::string>(urls.begin() + static_cast<std::ptrdiff_t>(done), urls.end()), labels);
+    if (run.exit_code == 0) {
+      call.succeeded();
+      return bodies + run.output();
+    }
+    // Transfers before the failing one are complete; a retry only fetches
+    // the rest.
+    for (std::size_t i = 0; i + 1 < run.transfers.size(); ++i) {
+      const int status = run.transfers[i].status;
+      if (status < 200 || status >= 300) break;
+      bodies += run.transfers[i].body;
+      ++done;
+    }
+    if (http_status) *http_status = run.last_status();
+    if (!call.retry(classify_http_failure(run.exit_code, run.last_status()))) break;
+  }
+  return std::nullopt;
+}
+
+bool curl_scan_text(const std::string& url, const std::function<bool(std::string_view)>& on_data) {
+  const std::string labels = "endpoint=\"" + classify_upstream_endpoint(url) + "\"";
+  acquire_upstream_requests(url);
+  const auto started = std::chrono::steady_clock::now();
+  int rc = 0;
+  {
+    TraceSpan span("http", url);
+    // stderr shares the pipe, so curl stays silent.
+    rc = run_command_stream({"curl", "--silent", "--fail", "--location", "--compressed", "--connect-timeout", "15",
+                             "--max-time", "60", url},
+                            on_data);
+  }
+  metrics()
+      .histogram("radicc_upstream_request_duration_seconds", "Upstream HTTP request latency by endpoint.",
+                 latency_buckets_seconds(), labels)
+      .observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count());
+  if (rc != 0) {
+    metrics().counter("radicc_upstream_request_failures_total", "Failed upstream HTTP requests by endpoint.", labels).add();
+  }
+  return rc == 0;
+}
+
+std::string classify_upstream_endpoint(const std::string& url) {
+  static const std::pair<const char*, const char*> kRules[] = {
+      {"/v2/api/auth1", "auth1"},
+      {"/v2/api/auth2", "auth2"},
+      {"/v3/station/list/", "station_list"},
+      {"/v3/station/stream/", "stream_xml"},
+      {"/v3/program/", "program_xml"},
+      {"/mobile/events/", "event_page"},
+      {"/member/login", "login"},
+      {"/member/logout", "logout"},
+      {".m3u8", "playlist"},
+      {".aac", "segment"},
+  };
+  for (const auto& [needle, name] : kRules) {
+    if (url.find(needle) != std::string::npos) return name;
+  }
+  return "other";
+}
+
 std::string trim_crlf(std::string value) {
   while (!value.empty() && (value.back() == '\n' || value.back() == '\r')) {
     value.pop_back();
@@ -1,14 +1,43 @@
 #pragma once
 
+#include <cstddef>
+#include <functional>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace radicc {
 
+// Runs `args` and captures stdout and stderr. Returns -1 when the command
+// could not run or was killed because the thread's cancellation token
+// expired.
 int run_command_capture(const std::vector<std::string>& args, std::string& output);
+// Like run_command_capture, but hands output to `on_output` as it arrives.
+// Returning false from `on_output` kills the command, which then counts as
+// a success (0).
+int run_command_stream(const std::vector<std::string>& args,
+                       const std::function<bool(std::string_view)>& on_output);
+// Seconds without data after which a download counts as stalled
+// (RADICC_STALL_TIMEOUT, default 30).
+int upstream_stall_timeout_seconds();
 std::optional<std::string> curl_text(const std::vector<std::string>& args);
 std::optional<std::string> curl_get_text(const std::string& url);
+// Fetches every URL over one curl process (connection reuse) and returns the
+// bodies concatenated. Fails if any transfer fails; `http_status` then
+// receives the failing transfer's status (0 when no response arrived).
+std::optional<std::string> curl_get_binary(
+    const std::vector<std::string>& urls,
+    const std::vector<std::string>& headers = {},
+    int* http_status = nullptr);
+// Fetches `url` once and passes the body to `on_data` piece by piece. The
+// transfer is abandoned as soon as `on_data` returns false, so a scan for
+// something near the top of a page does not download the rest. Returns
+// false when the transfer failed; stopping early is not a failure.
+bool curl_scan_text(const std::string& url, const std::function<bool(std::string_view)>& on_data);
 std::string trim_crlf(std::string value);
+// Names the radiko endpoint a URL belongs to (auth1, auth2, station_list,
+// stream_xml, program_xml, event_page, ...) for per-endpoint metrics.
+std::string classify_upstream_endpoint(const std::string& url);
 
 }  // namespace radicc
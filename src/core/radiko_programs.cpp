@@ -1,5 +1,6 @@
 #include "core/radiko_programs.h"
 
+#include "core/program_image.h"
 #include "core/radiko_programs_xml.h"
 #include "utils/date.h"
 
@@ -21,11 +22,11 @@ std::optional<ProgramEventInfo> find_program_by_station_ft_in_date_xml(
     const std::string& yyyymmdd,
     const std::string& ft) {
   if (station_id.empty() || !is_basic_date8(yyyymmdd) || ft.size() != 14) return std::nullopt;
-  const std::string xml = fetch_programs_xml("https://radiko.jp/v3/program/station/date/" + yyyymmdd + "/" + station_id + ".xml");
-  if (xml.empty()) return std::nullopt;
-  for (auto program : parse_programs_from_xml(xml)) {
+  const auto schedule =
+      fetch_program_schedule("https://radiko.jp/v3/program/station/date/" + yyyymmdd + "/" + station_id + ".xml");
+  for (auto program : schedule->programs) {
     if (program.ft == ft) {
-      fill_program_image_from_event_page(program);
+      program.image_url = cached_program_image_url(program);
       return program;
     }
   }
@@ -47,11 +48,10 @@ std::optional<ProgramEventInfo> find_program_by_station_ft(
     if (auto info = find_program_by_station_ft_in_date_xml(station_id, previous_date, ft)) return info;
   }
 
-  const std::string xml = fetch_programs_xml("https://radiko.jp/v3/program/station/weekly/" + station_id + ".xml");
-  if (xml.empty()) return std::nullopt;
-  for (auto program : parse_programs_from_xml(xml)) {
+  const auto schedule = fetch_program_schedule("https://radiko.jp/v3/program/station/weekly/" + station_id + ".xml");
+  for (auto program : schedule->programs) {
     if (program.ft == ft) {
-      fill_program_image_from_event_page(program);
+      program.image_url = cached_program_image_url(program);
       return program;
     }
   }
@@ -62,10 +62,7 @@ std::optional<ProgramEventInfo> find_nearest_weekly_program_info(
     const std::string& station_id,
     const std::string& title) {
   if (station_id.empty() || title.empty()) return std::nullopt;
-  const std::string xml = fetch_programs_xml("https://radiko.jp/v3/program/station/weekly/" + station_id + ".xml");
-  if (xml.empty()) return std::nullopt;
-
-  auto programs = parse_programs_from_xml(xml);
+  const auto schedule = fetch_program_schedule("https://radiko.jp/v3/program/station/weekly/" + station_id + ".xml");
   auto now = []() {
     char buf[16];
     std::time_t t = std::time(nullptr);
@@ -74,15 +71,14 @@ std::optional<ProgramEventInfo> find_nearest_weekly_program_info(
     return std::string(buf);
   }();
 
-  ProgramEventInfo* best = nullptr;
-  for (auto& program : programs) {
-    if (program.title == title && program.to <= now && (!best || program.to > best->to)) {
-      best = &program;
-    }
+  const ProgramEventInfo* best = nullptr;
+  for (const ProgramEventInfo* program : schedule->find_title(title)) {
+    if (program->to <= now && (!best || program->to > best->to)) best = program;
   }
   if (!best) return std::nullopt;
-  fill_program_image_from_event_page(*best);
-  return *best;
+  ProgramEventInfo info = *best;
+  info.image_url = cached_program_image_url(info);
+  return info;
 }
 
 }  // namespace radicc
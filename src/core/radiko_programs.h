@@ -5,14 +5,15 @@
 
 namespace radicc {
 
-// Fetches program URL for given station and date by matching exact title.
+// Fetches program URL for given station and date by title, compared by match_key().
 // Returns mobile events URL like: https://radiko.jp/mobile/events/<programId>
 std::optional<std::string> find_program_event_url(
     const std::string& station_id,
     const std::string& yyyymmdd,
     const std::string& title);
 
-// Extended info: returns pair (event_url, image_url). Either may be empty.
+// Extended info: event_url and image_url may be empty. image_url is the schedule's
+// <img> or an already resolved event page image (see core/program_image.h).
 struct ProgramEventInfo {
   std::string event_url;
   std::string image_url;
@@ -27,7 +28,7 @@ std::optional<ProgramEventInfo> find_program_event_info(
     const std::string& yyyymmdd,
     const std::string& title);
 
-// Nearest program from weekly XML by exact title, preferring past programs (to <= now).
+// Nearest program from weekly XML by title (match_key()), preferring past programs (to <= now).
 std::optional<ProgramEventInfo> find_nearest_weekly_program_info(
     const std::string& station_id,
     const std::string& title);
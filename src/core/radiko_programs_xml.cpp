@@ -1,15 +1,29 @@
 #include "core/radiko_programs_xml.h"
 
 #include "app/common.h"
+#include "core/program_search.h"
 #include "core/radiko_http.h"
+#include "core/schedule_snapshot.h"
+#include "utils/date.h"
+#include "utils/metrics.h"
+#include "utils/runtime_settings.h"
+#include "utils/text_fold.h"
 
 #include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <iterator>
+#include <memory>
+#include <mutex>
 #include <optional>
-#include <regex>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace radicc {
 namespace {
 
+constexpr const char* kStationListUrl = "https://radiko.jp/v3/station/region/full.xml";
+
 std::optional<std::string> find_attribute(
     const std::string& open_tag,
     const std::string& name) {
@@ -40,13 +54,176 @@ std::string find_element_text(const std::string& body, const std::string& name)
   return decode_xml_entities(body.substr(content_start, value_end - content_start));
 }
 
+// Parsed schedules by URL, so a long-running process (radicc-server and
+// the CLI clients it serves) fetches and parses each station/date once per
+// TTL.
+class ScheduleCache {
+ public:
+  std::shared_ptr<const ProgramSchedule> find(const std::string& url) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto it = entries_.find(url);
+    if (it == entries_.end()) return nullptr;
+    if (std::chrono::steady_clock::now() >= it->second.expires) {
+      entries_.erase(it);
+      return nullptr;
+    }
+    return it->second.schedule;
+  }
+
+  void store(const std::string& url, std::shared_ptr<const ProgramSchedule> schedule, std::chrono::seconds ttl) {
+    const auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (entries_.size() >= kMaxEntries) {
+      for (auto it = entries_.begin(); it != entries_.end();) {
+        it = now >= it->second.expires ? entries_.erase(it) : std::next(it);
+      }
+      if (entries_.size() >= kMaxEntries) entries_.erase(entries_.begin());
+    }
+    entries_[url] = Entry{std::move(schedule), now + ttl};
+  }
+
+ private:
+  static constexpr std::size_t kMaxEntries = 256;
+  struct Entry {
+    std::shared_ptr<const ProgramSchedule> schedule;
+    std::chrono::steady_clock::time_point expires;
+  };
+  std::mutex mutex_;
+  std::unordered_map<std::string, Entry> entries_;
+};
+
+ScheduleCache& schedule_cache() {
+  static ScheduleCache cache;
+  return cache;
+}
+
+Counter& schedule_cache_counter(const char* result) {
+  return metrics().counter("radicc_schedule_cache_requests_total", "Schedule lookups by cache result.",
+                           std::string("result=\"") + result + "\"");
+}
+
+// `/v3/program/station/weekly/<station>.xml` -> station; empty otherwise.
+std::string weekly_schedule_station(const std::string& url) {
+  static const std::string kWeeklyPath = "/v3/program/station/weekly/";
+  const std::size_t start = url.find(kWeeklyPath);
+  if (start == std::string::npos) return {};
+  const std::size_t id_start = start + kWeeklyPath.size();
+  const std::size_t id_end = url.find(".xml", id_start);
+  return id_end == std::string::npos ? std::string() : url.substr(id_start, id_end - id_start);
+}
+
+// `/v3/program/station/date/<yyyymmdd>/<station>.xml` -> {station, date};
+// empty otherwise.
+std::pair<std::string, std::string> date_schedule_station(const std::string& url) {
+  static const std::string kDatePath = "/v3/program/station/date/";
+  const std::size_t start = url.find(kDatePath);
+  if (start == std::string::npos) return {};
+  const std::size_t date_start = start + kDatePath.size();
+  const std::size_t slash = url.find('/', date_start);
+  if (slash != date_start + 8) return {};
+  const std::size_t id_end = url.find(".xml", slash + 1);
+  if (id_end == std::string::npos) return {};
+  return {url.substr(slash + 1, id_end - slash - 1), url.substr(date_start, 8)};
+}
+
+std::shared_ptr<const ProgramSchedule> make_program_schedule(std::vector<ProgramEventInfo> programs) {
+  auto schedule = std::make_shared<ProgramSchedule>();
+  schedule->programs = std::move(programs);
+  // Keys are computed once here; lookups only hash the requested title.
+  for (std::size_t i = 0; i < schedule->programs.size(); ++i) {
+    schedule->by_title[match_key(schedule->programs[i].title)].push_back(i);
+  }
+  return schedule;
+}
+
+// The schedule at `url` taken from the binary snapshot, when there is one
+// that holds the whole station/week or station/date.
+std::shared_ptr<const ProgramSchedule> find_snapshot_schedule(const std::string& url) {
+  const auto snapshot = current_schedule_snapshot();
+  if (!snapshot) return nullptr;
+  if (const std::string station_id = weekly_schedule_station(url); !station_id.empty()) {
+    auto programs = snapshot->programs(station_id);
+    return programs.empty() ? nullptr : make_program_schedule(std::move(programs));
+  }
+  // A date schedule is the broadcast day, 05:00 to 05:00 the next morning.
+  const auto [station_id, date] = date_schedule_station(url);
+  const std::string next_date = station_id.empty() ? std::string() : shift_date8(date, 1);
+  if (next_date.empty() || !snapshot->covers(station_id, date + "050000", next_date + "050000")) return nullptr;
+  return make_program_schedule(snapshot->programs(station_id, date + "050000", next_date + "050000"));
+}
+
+std::vector<std::string> parse_station_ids(const std::string& xml) {
+  std::vector<std::string> ids;
+  std::unordered_set<std::string> seen;
+  std::size_t position = 0;
+  while ((position = xml.find("<station>", position)) != std::string::npos) {
+    const std::size_t open = xml.find("<id>", position);
+    if (open == std::string::npos) break;
+    const std::size_t close = xml.find("</id>", open);
+    if (close == std::string::npos) break;
+    std::string id = xml.substr(open + 4, close - open - 4);
+    if (!id.empty() && seen.insert(id).second) ids.push_back(std::move(id));
+    position = close;
+  }
+  return ids;
+}
+
 }  // namespace
 
+std::chrono::seconds schedule_cache_ttl() {
+  const std::string value = runtime_env("RADICC_SCHEDULE_CACHE_TTL");
+  if (value.empty()) return std::chrono::seconds(600);
+  const long seconds = std::strtol(value.c_str(), nullptr, 10);
+  return std::chrono::seconds(seconds > 0 ? seconds : 0);
+}
+
 std::string fetch_programs_xml(const std::string& url) {
   auto result = curl_get_text(url);
   return result ? *result : std::string();
 }
 
+std::shared_ptr<const ProgramSchedule> fetch_program_schedule(const std::string& url) {
+  const auto ttl = schedule_cache_ttl();
+  if (ttl.count() > 0) {
+    if (auto cached = schedule_cache().find(url)) {
+      static Counter& hits = schedule_cache_counter("hit");
+      hits.add();
+      return cached;
+    }
+  }
+  if (auto schedule = find_snapshot_schedule(url)) {
+    static Counter& snapshot_hits = schedule_cache_counter("snapshot");
+    snapshot_hits.add();
+    if (ttl.count() > 0) schedule_cache().store(url, schedule, ttl);
+    if (const std::string station_id = weekly_schedule_station(url); !station_id.empty()) {
+      program_search_index().update_station(station_id, schedule->programs);
+    }
+    return schedule;
+  }
+  static Counter& misses = schedule_cache_counter("miss");
+  misses.add();
+  const std::string xml = fetch_programs_xml(url);
+  auto schedule = parse_program_schedule(xml);
+  if (xml.empty()) return schedule;
+  if (ttl.count() > 0) schedule_cache().store(url, schedule, ttl);
+  if (const std::string station_id = weekly_schedule_station(url); !station_id.empty()) {
+    program_search_index().update_station(station_id, schedule->programs);
+  }
+  return schedule;
+}
+
+std::shared_ptr<const ProgramSchedule> parse_program_schedule(const std::string& xml) {
+  return make_program_schedule(parse_programs_from_xml(xml));
+}
+
+std::vector<const ProgramEventInfo*> ProgramSchedule::find_title(const std::string& title) const {
+  std::vector<const ProgramEventInfo*> found;
+  const auto it = by_title.find(match_key(title));
+  if (it == by_title.end()) return found;
+  for (const std::size_t index : it->second) found.push_back(&programs[index]);
+  return found;
+}
+
 std::vector<ProgramEventInfo> parse_programs_from_xml(const std::string& xml) {
   std::vector<ProgramEventInfo> programs;
   std::size_t position = 0;
@@ -79,16 +256,9 @@ std::vector<ProgramEventInfo> parse_programs_from_xml(const std::string& xml) {
   return programs;
 }
 
-void fill_program_image_from_event_page(ProgramEventInfo& info) {
-  if (!info.img.empty()) {
-    info.image_url = info.img;
-    return;
-  }
-  const std::string html = fetch_programs_xml(info.event_url);
-  if (html.empty()) return;
-  std::smatch m;
-  std::regex img_re(R"(<img[^>]+src=\"([^\"]+)\")");
-  if (std::regex_search(html, m, img_re)) info.image_url = m[1].str();
+std::vector<std::string> fetch_station_ids() {
+  const auto xml = curl_get_text(kStationListUrl);
+  return xml ? parse_station_ids(*xml) : std::vector<std::string>();
 }
 
 }  // namespace radicc
@@ -2,13 +2,40 @@
 
 #include "core/radiko_programs.h"
 
+#include <chrono>
+#include <cstddef>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace radicc {
 
+// One parsed schedule document (`/v3/program/...`).
+struct ProgramSchedule {
+  std::vector<ProgramEventInfo> programs;  // in document order
+  // Indexes into `programs` by match_key(title).
+  std::unordered_map<std::string, std::vector<std::size_t>> by_title;
+
+  // Programs whose title equals `title` up to width, case, whitespace and
+  // punctuation variants, in document order.
+  std::vector<const ProgramEventInfo*> find_title(const std::string& title) const;
+};
+
+// Fetches `url` as text; empty on failure.
 std::string fetch_programs_xml(const std::string& url);
+// Fetches and parses a schedule, served from an in-memory cache for
+// schedule_cache_ttl(). A current schedule snapshot (core/schedule_snapshot.h)
+// that holds the whole schedule is used before upstream. Weekly schedules
+// fetched from either also update program_search_index(). Never null; empty
+// when the fetch failed.
+std::shared_ptr<const ProgramSchedule> fetch_program_schedule(const std::string& url);
+std::shared_ptr<const ProgramSchedule> parse_program_schedule(const std::string& xml);
+// RADICC_SCHEDULE_CACHE_TTL seconds, default 600; 0 disables the cache.
+std::chrono::seconds schedule_cache_ttl();
 std::vector<ProgramEventInfo> parse_programs_from_xml(const std::string& xml);
-void fill_program_image_from_event_page(ProgramEventInfo& info);
+// Every station id in radiko's nationwide station list, fetched from
+// upstream; empty on failure.
+std::vector<std::string> fetch_station_ids();
 
 }  // namespace radicc
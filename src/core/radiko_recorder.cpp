@@ -11,8 +11,31 @@ extern "C" {
 #include <libavutil/error.h>
 }
 #endif
-#include <iostream>
+#include "core/adts_mp4_muxer.h"
+#include "core/hls_playlist.h"
+#include "core/output_sink.h"
+#include "core/radiko_http.h"
+#include "core/retry_policy.h"
+#include "core/stream_source_stats.h"
+#include "core/upstream_governor.h"
+#include "utils/cancellation.h"
+#include "utils/log.h"
+#include "utils/metrics.h"
+#include "utils/runtime_settings.h"
+#include "utils/trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <sys/stat.h>
+#include <thread>
+#include <utility>
+#include <vector>
 
 namespace radicc {
 
@@ -28,6 +51,352 @@ static int find_audio_stream_index(AVFormatContext* input) {
   return -1;
 }
 
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static std::int64_t steady_ms() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Interrupts blocking libav I/O on a chunk: when the hedge race is lost,
+// when the recording is cancelled or past its deadline, or when a read has
+// made no progress for the stall timeout.
+struct ChunkInterrupt {
+  const std::atomic<bool>* abort = nullptr;
+  std::shared_ptr<CancellationToken> cancellation = current_cancellation();
+  std::int64_t stall_ms = static_cast<std::int64_t>(upstream_stall_timeout_seconds()) * 1000;
+  std::atomic<std::int64_t> last_progress_ms{steady_ms()};
+  std::atomic<bool> stalled{false};
+
+  void progressed() { last_progress_ms.store(steady_ms(), std::memory_order_relaxed); }
+};
+
+static int interrupt_chunk(void* opaque) {
+  auto* interrupt = static_cast<ChunkInterrupt*>(opaque);
+  if (interrupt->abort && interrupt->abort->load(std::memory_order_relaxed)) return 1;
+  if (interrupt->cancellation && interrupt->cancellation->expired()) return 1;
+  if (steady_ms() - interrupt->last_progress_ms.load(std::memory_order_relaxed) > interrupt->stall_ms) {
+    interrupt->stalled.store(true, std::memory_order_relaxed);
+    return 1;
+  }
+  return 0;
+}
+
+static void attach_interrupt(AVFormatContext* input, ChunkInterrupt* interrupt) {
+  input->interrupt_callback.callback = interrupt_chunk;
+  input->interrupt_callback.opaque = interrupt;
+}
+
+// Opens and probes one chunk. On failure `*in_fmt` is left null.
+static int open_chunk_input(AVFormatContext** in_fmt, const std::string& url,
+                            const std::string& request_headers, ChunkInterrupt* interrupt) {
+  *in_fmt = avformat_alloc_context();
+  if (!*in_fmt) return AVERROR(ENOMEM);
+  interrupt->progressed();
+  attach_interrupt(*in_fmt, interrupt);
+  AVDictionary* opts = nullptr;
+  av_dict_set(&opts, "headers", request_headers.c_str(), 0);
+  av_dict_set_int(&opts, "rw_timeout", interrupt->stall_ms * 1000, 0);
+  av_dict_set(&opts, "http_seekable", "0", 0);
+  av_dict_set(&opts, "seekable", "0", 0);
+  // libav fetches the segments itself; only the chunk playlist is counted.
+  acquire_upstream_requests(url);
+  int rc = 0;
+  {
+    TraceSpan span("avformat_open_input", url);
+    rc = avformat_open_input(in_fmt, url.c_str(), nullptr, &opts);
+  }
+  av_dict_free(&opts);
+  if (rc < 0) return rc;
+  {
+    TraceSpan span("avformat_find_stream_info", url);
+    rc = avformat_find_stream_info(*in_fmt, nullptr);
+  }
+  if (rc < 0) avformat_close_input(in_fmt);
+  return rc;
+}
+
+// Client errors and bad data will not change on a retry; timeouts, resets
+// and server errors may.
+static UpstreamFailure classify_libav_failure(int rc) {
+  if (rc == AVERROR_HTTP_TOO_MANY_REQUESTS) return UpstreamFailure::retryable;
+  if (rc == AVERROR_HTTP_BAD_REQUEST || rc == AVERROR_HTTP_UNAUTHORIZED || rc == AVERROR_HTTP_FORBIDDEN
+      || rc == AVERROR_HTTP_NOT_FOUND || rc == AVERROR_HTTP_OTHER_4XX || rc == AVERROR_INVALIDDATA
+      || rc == AVERROR_EXIT || rc == AVERROR(ENOMEM)) {
+    return UpstreamFailure::fatal;
+  }
+  return UpstreamFailure::retryable;
+}
+
+// An interrupt is final when the recording was cancelled, but a stall is
+// worth another attempt.
+static UpstreamFailure classify_chunk_failure(int rc, ChunkInterrupt& interrupt) {
+  const bool stalled = interrupt.stalled.exchange(false, std::memory_order_relaxed);
+  if (rc == AVERROR_EXIT && stalled && !(interrupt.cancellation && interrupt.cancellation->expired())) {
+    return UpstreamFailure::retryable;
+  }
+  return classify_libav_failure(rc);
+}
+
+// A chunk playlist refused outright may mean radiko moved the stream, so a
+// cached definition is dropped and the next plan fetches a fresh one.
+static void forget_stream_definition(const RadikoStreamPlan& stream_plan) {
+  if (stream_plan.cached_definition) invalidate_stream_definition(stream_plan.station_id);
+}
+
+static bool is_refused_by_upstream(int rc) {
+  return rc == AVERROR_HTTP_BAD_REQUEST || rc == AVERROR_HTTP_UNAUTHORIZED || rc == AVERROR_HTTP_FORBIDDEN
+      || rc == AVERROR_HTTP_NOT_FOUND || rc == AVERROR_HTTP_OTHER_4XX;
+}
+
+static int open_chunk_with_retries(AVFormatContext** in_fmt, const std::string& url,
+                                   const std::string& request_headers, ChunkInterrupt& interrupt) {
+  UpstreamCall call(url);
+  int rc = AVERROR(EHOSTUNREACH);
+  while (call.begin()) {
+    rc = open_chunk_input(in_fmt, url, request_headers, &interrupt);
+    if (rc >= 0) {
+      call.succeeded();
+      break;
+    }
+    if (!call.retry(classify_chunk_failure(rc, interrupt))) break;
+  }
+  return rc;
+}
+
+struct HedgedFirstChunk {
+  std::size_t source_index = 0;
+  AVFormatContext* input = nullptr;
+  double ttfb_seconds = 0.0;
+};
+
+// Races the first chunk of the two leading sources. The loser is interrupted
+// through its AVIOInterruptCB as soon as a winner is known.
+static std::optional<HedgedFirstChunk> race_first_chunk(const RadikoStreamPlan& stream_plan) {
+  struct Contender {
+    std::atomic<bool> abort{false};
+    ChunkInterrupt interrupt;
+    AVFormatContext* input = nullptr;
+    int rc = 0;
+    double elapsed = 0.0;
+  };
+  Contender contenders[2];
+  std::mutex mutex;
+  std::condition_variable done_cv;
+  std::optional<std::size_t> winner;
+  int finished = 0;
+
+  const auto started = std::chrono::steady_clock::now();
+  const auto upstream_job = current_upstream_job();
+  const auto cancellation = current_cancellation();
+  const auto settings = scoped_runtime_settings();
+  const LogContext log_context = current_log_context();
+  std::vector<std::thread> threads;
+  for (std::size_t i = 0; i < 2; ++i) {
+    threads.emplace_back([&, i]() {
+      UpstreamJobScope upstream_scope(upstream_job);
+      CancellationScope cancellation_scope(cancellation);
+      RuntimeSettingsScope settings_scope(settings);
+      LogContextScope log_scope(log_context);
+      Contender& self = contenders[i];
+      self.interrupt.abort = &self.abort;
+      self.rc = open_chunk_input(&self.input, stream_plan.sources[i].chunks.front().url,
+                                 stream_plan.request_headers, &self.interrupt);
+      self.elapsed = seconds_since(started);
+      std::lock_guard<std::mutex> lock(mutex);
+      ++finished;
+      if (self.rc >= 0 && !winner) {
+        winner = i;
+        contenders[1 - i].abort.store(true, std::memory_order_relaxed);
+      }
+      done_cv.notify_all();
+    });
+  }
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    done_cv.wait(lock, [&]() { return winner.has_value() || finished == 2; });
+  }
+  for (auto& thread : threads) thread.join();
+
+  for (std::size_t i = 0; i < 2; ++i) {
+    if (winner && *winner == i) continue;
+    if (contenders[i].input) avformat_close_input(&contenders[i].input);
+    if (!contenders[i].abort.load() && contenders[i].rc < 0) {
+      RADICC_LOG_WARN << "libav: hedged open of source " << i << " failed: "
+                      << av_error_to_string(contenders[i].rc);
+      record_stream_source_failure(stream_plan.sources[i].origin);
+      if (is_refused_by_upstream(contenders[i].rc)) forget_stream_definition(stream_plan);
+    }
+  }
+  if (!winner) return std::nullopt;
+  RADICC_LOG_INFO << "libav: hedged first chunk won by source " << *winner
+                  << " after " << contenders[*winner].elapsed << "s";
+  return HedgedFirstChunk{*winner, contenders[*winner].input, contenders[*winner].elapsed};
+}
+
+enum class NativeRecordResult { recorded, unsupported, failed };
+
+static std::vector<std::string> split_request_headers(const std::string& request_headers) {
+  std::vector<std::string> headers;
+  std::size_t start = 0;
+  while (start < request_headers.size()) {
+    const std::size_t end = request_headers.find("\r\n", start);
+    const std::string line = request_headers.substr(start, end == std::string::npos ? std::string::npos : end - start);
+    if (!line.empty()) headers.push_back(line);
+    if (end == std::string::npos) break;
+    start = end + 2;
+  }
+  return headers;
+}
+
+// Resolves a chunk's playlist down to its media segments and downloads them
+// in one transfer. `ttfb_seconds` receives the playlist round-trip time and
+// `open_status` the HTTP status when the chunk playlist itself failed.
+static std::optional<std::string> fetch_chunk_audio(const std::string& chunk_url,
+                                                    const std::vector<std::string>& headers,
+                                                    double& ttfb_seconds, int& open_status) {
+  TraceSpan span("fetch_chunk", chunk_url);
+  const auto started = std::chrono::steady_clock::now();
+  std::string playlist_url = chunk_url;
+  auto body = curl_get_binary({playlist_url}, headers, &open_status);
+  if (!body) return std::nullopt;
+  ttfb_seconds = seconds_since(started);
+  HlsPlaylist playlist = parse_hls_playlist(*body, playlist_url);
+  for (int depth = 0; depth < 3 && playlist.segment_urls.empty() && !playlist.variant_urls.empty(); ++depth) {
+    playlist_url = playlist.variant_urls.front();
+    body = curl_get_binary({playlist_url}, headers);
+    if (!body) return std::nullopt;
+    playlist = parse_hls_playlist(*body, playlist_url);
+  }
+  if (playlist.segment_urls.empty()) return std::nullopt;
+  return curl_get_binary(playlist.segment_urls, headers);
+}
+
+static void observe_chunk_metrics(const char* muxer, double open_seconds, double read_seconds, std::uint64_t bytes) {
+  const std::string labels = std::string("muxer=\"") + muxer + "\"";
+  auto& registry = metrics();
+  registry.histogram("radicc_chunk_open_seconds", "Time to first byte of a stream chunk.",
+                     latency_buckets_seconds(), labels).observe(open_seconds);
+  registry.histogram("radicc_chunk_read_seconds", "Time to read a stream chunk after it opened.",
+                     latency_buckets_seconds(), labels).observe(read_seconds);
+  if (read_seconds > 0.0) {
+    registry.histogram("radicc_chunk_throughput_bytes_per_second", "Sustained read rate of stream chunks.",
+                       throughput_buckets_bytes_per_second(), labels).observe(bytes / read_seconds);
+  }
+}
+
+static std::uint64_t file_size(const std::string& path) {
+  struct stat st;
+  return stat(path.c_str(), &st) == 0 ? static_cast<std::uint64_t>(st.st_size) : 0;
+}
+
+// Planned output size: radiko serves 48 kbit/s AAC, plus a margin for the
+// container and faster streams.
+static std::uint64_t planned_output_bytes(const RadikoStreamSource& source) {
+  std::uint64_t seconds = 0;
+  for (const auto& chunk : source.chunks) seconds += static_cast<std::uint64_t>(std::max(chunk.duration_seconds, 0));
+  return seconds * 48000 / 8 * 21 / 20;
+}
+
+static void report_opened(const RadikoRecordOptions& record_options, const std::string& partial_path) {
+  if (record_options.on_output_opened) record_options.on_output_opened(partial_path);
+}
+
+static void report_committed(const RadikoRecordOptions& record_options, std::uint64_t bytes) {
+  if (record_options.on_output_committed) record_options.on_output_committed(bytes);
+}
+
+// libav-free path for the ADTS AAC radiko serves: segments are fetched with
+// curl and muxed by AdtsMp4Muxer. Anything else is left to libav.
+static NativeRecordResult record_source_native(const RadikoStreamPlan& stream_plan,
+                                               const RadikoStreamSource& source,
+                                               const std::string& output_path,
+                                               Mp4Metadata metadata,
+                                               const RadikoRecordOptions& record_options,
+                                               RecordProgress& progress) {
+  const auto headers = split_request_headers(stream_plan.request_headers);
+  std::unique_ptr<AdtsMp4Muxer> muxer;
+  for (std::size_t chunk_index = 0; chunk_index < source.chunks.size(); ++chunk_index) {
+    if (current_cancellation_expired()) return NativeRecordResult::failed;
+    double ttfb_seconds = 0.0;
+    int open_status = 0;
+    const auto started = std::chrono::steady_clock::now();
+    const auto audio = fetch_chunk_audio(source.chunks[chunk_index].url, headers, ttfb_seconds, open_status);
+    const double fetch_seconds = seconds_since(started);
+    if (!audio) {
+      RADICC_LOG_WARN << "native: fetching chunk " << chunk_index << " failed";
+      record_stream_source_failure(source.origin);
+      if (open_status >= 400 && open_status < 500 && open_status != 429) forget_stream_definition(stream_plan);
+      return NativeRecordResult::failed;
+    }
+    progress.bytes_in.fetch_add(audio->size(), std::memory_order_relaxed);
+    const auto* bytes = reinterpret_cast<const std::uint8_t*>(audio->data());
+    if (!muxer) {
+      if (!looks_like_adts(bytes, audio->size())) {
+        RADICC_LOG_INFO << "native: stream is not ADTS AAC; falling back to libav";
+        return NativeRecordResult::unsupported;
+      }
+      // Fragmented output writes moov with the first fragment, so the cover
+      // is needed now; otherwise it is attached just before finish().
+      if (record_options.output.fragmented && record_options.cover.valid()) {
+        metadata.cover = record_options.cover.get().bytes;
+      }
+      muxer = std::make_unique<AdtsMp4Muxer>(std::move(metadata), record_options.output);
+      OutputSinkOptions sink_options;
+      sink_options.expected_bytes = planned_output_bytes(source);
+      sink_options.async = record_options.async_writer;
+      if (!muxer->open(output_path, sink_options)) {
+        RADICC_LOG_WARN << "native: " << muxer->error();
+        return NativeRecordResult::failed;
+      }
+      report_opened(record_options, muxer->partial_path());
+      report_committed(record_options, 0);
+    }
+    const std::uint64_t committed_before = muxer->committed_bytes();
+    bool muxed = false;
+    {
+      TraceSpan span("mux_chunk", source.chunks[chunk_index].url);
+      muxed = muxer->write(bytes, audio->size());
+    }
+    if (!muxed) {
+      RADICC_LOG_WARN << "native: muxing chunk " << chunk_index << " failed: " << muxer->error();
+      return NativeRecordResult::failed;
+    }
+    if (muxer->committed_bytes() != committed_before) report_committed(record_options, muxer->committed_bytes());
+    progress.chunks_done.store(static_cast<std::uint32_t>(chunk_index + 1), std::memory_order_relaxed);
+    progress.packets.store(muxer->sample_count(), std::memory_order_relaxed);
+    progress.bytes_out.store(muxer->bytes_written(), std::memory_order_relaxed);
+    progress.position_ms.store(static_cast<std::uint64_t>(muxer->duration_seconds() * 1000), std::memory_order_relaxed);
+    record_stream_source_success(
+        source.origin, ttfb_seconds, fetch_seconds > 0.0 ? audio->size() / fetch_seconds : 0.0);
+    observe_chunk_metrics("native", ttfb_seconds, std::max(0.0, fetch_seconds - ttfb_seconds), audio->size());
+    RADICC_LOG_DEBUG << "native: chunk " << chunk_index << " muxed: " << audio->size() << " bytes, ttfb "
+                     << ttfb_seconds << "s, fetch " << fetch_seconds << "s";
+  }
+  bool finished = false;
+  if (muxer) {
+    if (!record_options.output.fragmented && record_options.cover.valid()) {
+      muxer->set_cover(record_options.cover.get().bytes);
+    }
+    TraceSpan span("mux_finish", output_path);
+    finished = muxer->finish();
+  }
+  if (!finished) {
+    RADICC_LOG_WARN << "native: finalizing output failed" << (muxer ? ": " + muxer->error() : std::string());
+    return NativeRecordResult::failed;
+  }
+  report_committed(record_options, file_size(output_path));
+  if (record_options.recorded && muxer->digest()) {
+    record_options.recorded->digest = *muxer->digest();
+    record_options.recorded->duration_seconds = muxer->duration_seconds();
+  }
+  RADICC_LOG_INFO << "native: wrote " << muxer->sample_count() << " AAC frames ("
+                  << static_cast<long long>(muxer->duration_seconds()) << "s)";
+  return NativeRecordResult::recorded;
+}
+
 static bool mkdir_p(const std::string& path, mode_t mode = 0755) {
   struct stat st; if (stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) return true;
   size_t pos = path.find_last_of('/');
@@ -36,7 +405,7 @@ static bool mkdir_p(const std::string& path, mode_t mode = 0755) {
     if (!parent.empty() && !mkdir_p(parent, mode)) return false;
   }
   if (mkdir(path.c_str(), mode) != 0) {
-    if (errno != EEXIST) { std::cerr << "Error: Failed to create directory " << path << ": " << strerror(errno) << std::endl; return false; }
+    if (errno != EEXIST) { RADICC_LOG_ERROR << "Error: Failed to create directory " << path << ": " << strerror(errno); return false; }
   }
   return true;
 }
@@ -44,7 +413,9 @@ static bool mkdir_p(const std::string& path, mode_t mode = 0755) {
 bool record_radiko(const RadikoStreamPlan& stream_plan, const std::string& filename,
                   const std::string& pfm, const std::string& album_title,
                   const std::string& dir_name, const std::string& outputDir,
-                  const std::string& image_url) {
+                  const RadikoRecordOptions& record_options) {
+  TraceSpan span("record_radiko", filename);
+  const auto recording_started = std::chrono::steady_clock::now();
   // Build final output path and ensure parent directory exists
   std::string outputPath = dir_name.empty() ? (outputDir + filename)
                                             : (outputDir + dir_name + "/" + filename);
@@ -53,15 +424,35 @@ bool record_radiko(const RadikoStreamPlan& stream_plan, const std::string& filen
     if (pos != std::string::npos) {
       std::string parent = outputPath.substr(0, pos);
       if (!mkdir_p(parent, 0755)) {
-        std::cerr << "Error: Failed to create directory " << parent << std::endl;
+        RADICC_LOG_ERROR << "Error: Failed to create directory " << parent;
         return false;
       }
     }
   }
 
+  RecordProgress local_progress;
+  RecordProgress& progress = record_options.progress ? *record_options.progress : local_progress;
+  auto finish_recording = [&](bool recorded) {
+    save_stream_source_stats();
+    // Fragments kept from an earlier failed source are superseded.
+    if (recorded && record_options.output.fragmented) std::remove(kept_partial_output_path(outputPath).c_str());
+    metrics()
+        .counter("radicc_recordings_total", "Finished recordings by result.",
+                 recorded ? "result=\"ok\"" : "result=\"failed\"")
+        .add();
+    const double wall_seconds = seconds_since(recording_started);
+    if (recorded && wall_seconds > 0.0) {
+      metrics()
+          .histogram("radicc_recording_realtime_factor", "Recorded audio seconds per wall-clock second.",
+                     {1, 2, 5, 10, 20, 50, 100, 200, 500, 1000})
+          .observe(progress.position_ms.load(std::memory_order_relaxed) / 1000.0 / wall_seconds);
+    }
+    return recorded;
+  };
+
 #ifdef USE_LIBAV
   // Library-based remux with optional attached_pic (cover image).
-  auto do_libav = [&](const RadikoStreamSource& source) -> bool {
+  auto do_libav = [&](const RadikoStreamSource& source, std::optional<HedgedFirstChunk> first_chunk) -> bool {
     // Suppress libav info logs (e.g., segment opening spam)
     av_log_set_level(AV_LOG_ERROR);
     AVFormatContext* out_fmt = nullptr;  // MP4/M4A output
@@ -71,9 +462,16 @@ bool record_radiko(const RadikoStreamPlan& stream_plan, const std::string& filen
     AVStream* out_a = nullptr;
     int64_t next_audio_ts = 0;
     bool wrote_packets = false;
+    UpstreamPacer pacer;
+    ChunkInterrupt interrupt;
+    // libav writes a hidden partial file too; it is renamed into place once
+    // the trailer is written and removed on any failure.
+    const std::string partial_path = partial_output_path(outputPath);
+    bool partial_committed = false;
 
     if (source.chunks.empty()) {
-      std::cerr << "libav: stream source is empty\n";
+      RADICC_LOG_WARN << "libav: stream source is empty";
+      if (first_chunk) avformat_close_input(&first_chunk->input);
       return false;
     }
 
@@ -82,36 +480,37 @@ bool record_radiko(const RadikoStreamPlan& stream_plan, const std::string& filen
       if (bsf) av_bsf_free(&bsf);
       if (img_fmt) avformat_close_input(&img_fmt);
       if (out_fmt) avformat_free_context(out_fmt);
+      out_fmt = nullptr;
+      if (!partial_committed) std::remove(partial_path.c_str());
     };
 
     for (size_t chunk_index = 0; chunk_index < source.chunks.size(); ++chunk_index) {
       AVFormatContext* in_fmt = nullptr;
-      AVDictionary* opts = nullptr;
-      av_dict_set(&opts, "headers", stream_plan.request_headers.c_str(), 0);
-      av_dict_set(&opts, "http_seekable", "0", 0);
-      av_dict_set(&opts, "seekable", "0", 0);
-      int rc = avformat_open_input(&in_fmt, source.chunks[chunk_index].url.c_str(), nullptr, &opts);
-      av_dict_free(&opts);
-      if (rc < 0) {
-        std::cerr << "libav: avformat_open_input failed on chunk " << chunk_index
-                  << ": " << av_error_to_string(rc) << "\n";
-        if (in_fmt) avformat_close_input(&in_fmt);
-        cleanup();
-        return false;
-      }
-
-      rc = avformat_find_stream_info(in_fmt, nullptr);
-      if (rc < 0) {
-        std::cerr << "libav: avformat_find_stream_info failed on chunk " << chunk_index
-                  << ": " << av_error_to_string(rc) << "\n";
-        avformat_close_input(&in_fmt);
-        cleanup();
-        return false;
+      int rc = 0;
+      double ttfb_seconds = 0.0;
+      if (chunk_index == 0 && first_chunk) {
+        in_fmt = first_chunk->input;
+        // The race's interrupt state is gone; this source's takes over.
+        interrupt.progressed();
+        attach_interrupt(in_fmt, &interrupt);
+        ttfb_seconds = first_chunk->ttfb_seconds;
+      } else {
+        const auto open_started = std::chrono::steady_clock::now();
+        rc = open_chunk_with_retries(&in_fmt, source.chunks[chunk_index].url, stream_plan.request_headers, interrupt);
+        ttfb_seconds = seconds_since(open_started);
+        if (rc < 0) {
+          RADICC_LOG_WARN << "libav: opening chunk " << chunk_index
+                          << " failed: " << av_error_to_string(rc);
+          record_stream_source_failure(source.origin);
+          if (is_refused_by_upstream(rc)) forget_stream_definition(stream_plan);
+          cleanup();
+          return false;
+        }
       }
 
-      const int audio_stream = find_audio_stream_index(in_fmt);
+      int audio_stream = find_audio_stream_index(in_fmt);
       if (audio_stream < 0) {
-        std::cerr << "libav: audio stream not found on chunk " << chunk_index << "\n";
+        RADICC_LOG_WARN << "libav: audio stream not found on chunk " << chunk_index;
         avformat_close_input(&in_fmt);
         cleanup();
         return false;
@@ -119,9 +518,9 @@ bool record_radiko(const RadikoStreamPlan& stream_plan, const std::string& filen
 
       AVStream* in_a = in_fmt->streams[audio_stream];
       if (!out_fmt) {
-        rc = avformat_alloc_output_context2(&out_fmt, nullptr, "mp4", outputPath.c_str());
+        rc = avformat_alloc_output_context2(&out_fmt, nullptr, "mp4", partial_path.c_str());
         if (rc < 0) {
-          std::cerr << "libav: avformat_alloc_output_context2 failed: " << av_error_to_string(rc) << "\n";
+          RADICC_LOG_WARN << "libav: avformat_alloc_output_context2 failed: " << av_error_to_string(rc);
           avformat_close_input(&in_fmt);
           cleanup();
           return false;
@@ -129,14 +528,14 @@ bool record_radiko(const RadikoStreamPlan& stream_plan, const std::string& filen
 
         out_a = avformat_new_stream(out_fmt, nullptr);
         if (!out_a) {
-          std::cerr << "libav: avformat_new_stream (audio) returned null\n";
+          RADICC_LOG_WARN << "libav: avformat_new_stream (audio) returned null";
           avformat_close_input(&in_fmt);
           cleanup();
           return false;
         }
         rc = avcodec_parameters_copy(out_a->codecpar, in_a->codecpar);
         if (rc < 0) {
-          std::cerr << "libav: avcodec_parameters_copy failed: " << av_error_to_string(rc) << "\n";
+          RADICC_LOG_WARN << "libav: avcodec_parameters_copy failed: " << av_error_to_string(rc);
           avformat_close_input(&in_fmt);
           cleanup();
           return false;
@@ -144,8 +543,13 @@ bool record_radiko(const RadikoStreamPlan& stream_plan, const std::string& filen
         out_a->codecpar->codec_tag = 0;
         out_a->time_base = in_a->time_base;
 
-        if (!image_url.empty()) {
-          if ((rc = avformat_open_input(&img_fmt, image_url.c_str(), nullptr, nullptr)) == 0) {
+        // The mov muxer only writes cover art into a trailing moov, which
+        // fragmented output never has. The cover is read from its cache file.
+        const std::string cover_path = !record_options.output.fragmented && record_options.cover.valid()
+                                           ? record_options.cover.get().path
+                                           : std::string();
+        if (!cover_path.empty()) {
+          if ((rc = avformat_open_input(&img_fmt, cover_path.c_str(), nullptr, nullptr)) == 0) {
             if (avformat_find_stream_info(img_fmt, nullptr) >= 0) {
               for (unsigned i = 0; i < img_fmt->nb_streams; ++i) {
                 if (img_fmt->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
@@ -163,7 +567,7 @@ bool record_radiko(const RadikoStreamPlan& stream_plan, const std::string& filen
               }
             }
           } else {
-            std::cerr << "libav: avformat_open_input(image) failed: " << av_error_to_string(rc) << " (non-fatal)\n";
+            RADICC_LOG_WARN << "libav: avformat_open_input(image) failed: " << av_error_to_string(rc) << " (non-fatal)";
           }
         }
         if (in_a->codecpar->codec_id == AV_CODEC_ID_AAC) {
@@ -182,19 +586,30 @@ bool record_radiko(const RadikoStreamPlan& stream_plan, const std::string& filen
         if (!album_title.empty()) av_dict_set(&out_fmt->metadata, "album", album_title.c_str(), 0);
 
         if (!(out_fmt->oformat->flags & AVFMT_NOFILE)) {
-          rc = avio_open(&out_fmt->pb, outputPath.c_str(), AVIO_FLAG_WRITE);
+          rc = avio_open(&out_fmt->pb, partial_path.c_str(), AVIO_FLAG_WRITE);
           if (rc < 0) {
-            std::cerr << "libav: avio_open failed for " << outputPath
-                      << ": " << av_error_to_string(rc) << "\n";
+            RADICC_LOG_ERROR << "libav: avio_open failed for " << partial_path
+                             << ": " << av_error_to_string(rc);
             avformat_close_input(&in_fmt);
             cleanup();
             return false;
           }
         }
+        report_opened(record_options, partial_path);
+        report_committed(record_options, 0);
 
-        rc = avformat_write_header(out_fmt, nullptr);
+        AVDictionary* mux_opts = nullptr;
+        if (record_options.output.fragmented) {
+          av_dict_set(&mux_opts, "movflags", "empty_moov+default_base_moof", 0);
+          av_dict_set_int(&mux_opts, "frag_duration",
+                          static_cast<long long>(record_options.output.fragment_seconds) * 1000000, 0);
+        } else if (record_options.output.faststart) {
+          av_dict_set(&mux_opts, "movflags", "faststart", 0);
+        }
+        rc = avformat_write_header(out_fmt, &mux_opts);
+        av_dict_free(&mux_opts);
         if (rc < 0) {
-          std::cerr << "libav: avformat_write_header failed: " << av_error_to_string(rc) << "\n";
+          RADICC_LOG_WARN << "libav: avformat_write_header failed: " << av_error_to_string(rc);
           avformat_close_input(&in_fmt);
           cleanup();
           return false;
@@ -220,7 +635,7 @@ bool record_radiko(const RadikoStreamPlan& stream_plan, const std::string& filen
       AVPacket* pkt = av_packet_alloc();
       AVPacket* filt = bsf ? av_packet_alloc() : nullptr;
       if (!pkt || (bsf && !filt)) {
-        std::cerr << "libav: packet allocation failed on chunk " << chunk_index << "\n";
+        RADICC_LOG_WARN << "libav: packet allocation failed on chunk " << chunk_index;
         if (filt) av_packet_free(&filt);
         if (pkt) av_packet_free(&pkt);
         avformat_close_input(&in_fmt);
@@ -248,88 +663,196 @@ bool record_radiko(const RadikoStreamPlan& stream_plan, const std::string& filen
         if (rc_write == 0) {
           wrote_packets = true;
           next_audio_ts += duration;
+          progress.packets.fetch_add(1, std::memory_order_relaxed);
         }
         return rc_write;
       };
 
       int read_rc = 0;
-      while ((read_rc = av_read_frame(in_fmt, pkt)) >= 0) {
-        if (pkt->stream_index != audio_stream) {
-          av_packet_unref(pkt);
-          continue;
-        }
-        if (bsf) {
-          if (av_bsf_send_packet(bsf, pkt) == 0) {
-            while (av_bsf_receive_packet(bsf, filt) == 0) {
-              if (write_packet(filt) < 0) {
-                std::cerr << "libav: filtered packet write failed on chunk "
-                          << chunk_index << "\n";
+      std::int64_t chunk_bytes = 0;
+      const auto read_started = std::chrono::steady_clock::now();
+      std::optional<TraceSpan> packet_span;
+      packet_span.emplace("packet_loop", source.chunks[chunk_index].url);
+      // A read that fails mid-chunk reopens the chunk and skips the audio
+      // packets already written.
+      UpstreamCall read_call(source.chunks[chunk_index].url);
+      std::uint64_t chunk_packets = 0;
+      std::uint64_t skip_packets = 0;
+      read_rc = AVERROR(EHOSTUNREACH);
+      while (read_call.begin()) {
+        while ((read_rc = av_read_frame(in_fmt, pkt)) >= 0) {
+          interrupt.progressed();
+          if (pkt->stream_index != audio_stream) {
+            av_packet_unref(pkt);
+            continue;
+          }
+          if (skip_packets > 0) {
+            --skip_packets;
+            av_packet_unref(pkt);
+            continue;
+          }
+          ++chunk_packets;
+          chunk_bytes += pkt->size;
+          pacer.account(static_cast<std::uint64_t>(pkt->size));
+          if (bsf) {
+            if (av_bsf_send_packet(bsf, pkt) == 0) {
+              while (av_bsf_receive_packet(bsf, filt) == 0) {
+                if (write_packet(filt) < 0) {
+                  RADICC_LOG_WARN << "libav: filtered packet write failed on chunk "
+                                  << chunk_index;
+                  av_packet_unref(filt);
+                  av_packet_unref(pkt);
+                  av_packet_free(&filt);
+                  av_packet_free(&pkt);
+                  avformat_close_input(&in_fmt);
+                  cleanup();
+                  return false;
+                }
                 av_packet_unref(filt);
-                av_packet_unref(pkt);
-                av_packet_free(&filt);
-                av_packet_free(&pkt);
-                avformat_close_input(&in_fmt);
-                cleanup();
-                return false;
               }
-              av_packet_unref(filt);
             }
-          }
-          av_packet_unref(pkt);
-        } else {
-          if (write_packet(pkt) < 0) {
-            std::cerr << "libav: packet write failed on chunk " << chunk_index << "\n";
             av_packet_unref(pkt);
-            if (filt) av_packet_free(&filt);
-            av_packet_free(&pkt);
-            avformat_close_input(&in_fmt);
-            cleanup();
-            return false;
+          } else {
+            if (write_packet(pkt) < 0) {
+              RADICC_LOG_WARN << "libav: packet write failed on chunk " << chunk_index;
+              av_packet_unref(pkt);
+              if (filt) av_packet_free(&filt);
+              av_packet_free(&pkt);
+              avformat_close_input(&in_fmt);
+              cleanup();
+              return false;
+            }
+            av_packet_unref(pkt);
           }
-          av_packet_unref(pkt);
         }
+        if (read_rc >= 0 || read_rc == AVERROR_EOF) {
+          read_call.succeeded();
+          break;
+        }
+        if (!read_call.retry(classify_chunk_failure(read_rc, interrupt))) break;
+        RADICC_LOG_WARN << "libav: av_read_frame failed on chunk " << chunk_index << ": "
+                        << av_error_to_string(read_rc) << "; reopening after " << chunk_packets << " packets";
+        avformat_close_input(&in_fmt);
+        const int reopen_rc =
+            open_chunk_with_retries(&in_fmt, source.chunks[chunk_index].url, stream_plan.request_headers, interrupt);
+        audio_stream = reopen_rc < 0 ? -1 : find_audio_stream_index(in_fmt);
+        if (audio_stream < 0) {
+          if (reopen_rc >= 0) avformat_close_input(&in_fmt);
+          read_rc = reopen_rc < 0 ? reopen_rc : AVERROR_STREAM_NOT_FOUND;
+          break;
+        }
+        in_a = in_fmt->streams[audio_stream];
+        skip_packets = chunk_packets;
       }
 
+      packet_span.reset();
       if (read_rc < 0 && read_rc != AVERROR_EOF) {
-        std::cerr << "libav: av_read_frame failed on chunk " << chunk_index
-                  << ": " << av_error_to_string(read_rc) << "\n";
+        RADICC_LOG_WARN << "libav: av_read_frame failed on chunk " << chunk_index
+                        << ": " << av_error_to_string(read_rc);
+        record_stream_source_failure(source.origin);
         if (filt) av_packet_free(&filt);
         av_packet_free(&pkt);
         avformat_close_input(&in_fmt);
         cleanup();
         return false;
       }
+      const double read_seconds = seconds_since(read_started);
+      record_stream_source_success(
+          source.origin, ttfb_seconds, read_seconds > 0.0 ? chunk_bytes / read_seconds : 0.0);
+      observe_chunk_metrics("libav", ttfb_seconds, read_seconds, static_cast<std::uint64_t>(chunk_bytes));
+      RADICC_LOG_DEBUG << "libav: chunk " << chunk_index << " read: " << chunk_packets << " packets, "
+                       << static_cast<long long>(chunk_bytes) << " bytes in " << read_seconds << "s";
+      progress.bytes_in.fetch_add(static_cast<std::uint64_t>(chunk_bytes), std::memory_order_relaxed);
+      progress.chunks_done.store(static_cast<std::uint32_t>(chunk_index + 1), std::memory_order_relaxed);
+      progress.position_ms.store(
+          static_cast<std::uint64_t>(av_rescale_q(next_audio_ts, out_a->time_base, AVRational{1, 1000})),
+          std::memory_order_relaxed);
+      if (out_fmt->pb) progress.bytes_out.store(static_cast<std::uint64_t>(avio_tell(out_fmt->pb)), std::memory_order_relaxed);
+      // The mov muxer hands each fragment to pb as a whole, so everything
+      // flushed so far is final.
+      if (record_options.output.fragmented && out_fmt->pb) {
+        avio_flush(out_fmt->pb);
+        report_committed(record_options, static_cast<std::uint64_t>(avio_tell(out_fmt->pb)));
+      }
       if (filt) av_packet_free(&filt);
       av_packet_free(&pkt);
       avformat_close_input(&in_fmt);
     }
 
     if (!out_fmt || !wrote_packets) {
-      std::cerr << "libav: source produced no writable audio packets\n";
+      RADICC_LOG_WARN << "libav: source produced no writable audio packets";
       cleanup();
       return false;
     }
 
-    const int trailer_rc = av_write_trailer(out_fmt);
+    int trailer_rc = 0;
+    {
+      TraceSpan span("av_write_trailer", outputPath);
+      trailer_rc = av_write_trailer(out_fmt);
+    }
     if (trailer_rc < 0) {
-      std::cerr << "libav: av_write_trailer failed: "
-                << av_error_to_string(trailer_rc) << "\n";
+      RADICC_LOG_WARN << "libav: av_write_trailer failed: "
+                      << av_error_to_string(trailer_rc);
       cleanup();
       return false;
     }
+    const double duration_seconds = av_q2d(out_a->time_base) * static_cast<double>(next_audio_ts);
+    partial_committed = true;
     cleanup();
+    if (!commit_output_file(partial_path, outputPath)) {
+      RADICC_LOG_ERROR << "libav: could not move " << partial_path << " into place: " << strerror(errno);
+      std::remove(partial_path.c_str());
+      return false;
+    }
+    report_committed(record_options, file_size(outputPath));
+    // The mov muxer patches the mdat size in place, so libav output is
+    // hashed after it is closed rather than while written.
+    if (record_options.recorded) {
+      if (auto digest = digest_file(outputPath)) record_options.recorded->digest = std::move(*digest);
+      record_options.recorded->duration_seconds = duration_seconds;
+    }
     return true;
   };
-  for (std::size_t source_index = 0; source_index < stream_plan.sources.size(); ++source_index) {
+  // Sources are already ranked by delivery history; hedging only reorders
+  // the first two when the runner-up answers first this time.
+  std::vector<std::size_t> order;
+  for (std::size_t i = 0; i < stream_plan.sources.size(); ++i) order.push_back(i);
+  std::optional<HedgedFirstChunk> hedged;
+  if (record_options.hedge_first_chunk && stream_plan.sources.size() >= 2
+      && !stream_plan.sources[0].chunks.empty() && !stream_plan.sources[1].chunks.empty()) {
+    av_log_set_level(AV_LOG_ERROR);
+    hedged = race_first_chunk(stream_plan);
+    if (hedged && hedged->source_index == 1) std::swap(order[0], order[1]);
+  }
+  for (const std::size_t source_index : order) {
+    if (current_cancellation_expired()) {
+      RADICC_LOG_WARN << "Recording stopped: " << current_cancellation()->reason();
+      break;
+    }
     const auto& source = stream_plan.sources[source_index];
-    std::cerr << "libav: trying source " << source_index
-              << " with " << source.chunks.size() << " chunks\n";
-    if (do_libav(source)) return true;
-    std::cerr << "libav: source " << source_index << " failed\n";
+    RADICC_LOG_INFO << "recorder: trying source " << source_index
+                    << " with " << source.chunks.size() << " chunks";
+    std::optional<HedgedFirstChunk> first_chunk;
+    if (hedged && hedged->source_index == source_index) first_chunk = std::exchange(hedged, std::nullopt);
+    const auto chunk_total = static_cast<std::uint32_t>(source.chunks.size());
+    if (!first_chunk && record_options.native_muxer) {
+      begin_record_source(progress, static_cast<int>(source_index), chunk_total);
+      const auto native = record_source_native(
+          stream_plan, source, outputPath, Mp4Metadata{pfm, album_title, {}}, record_options, progress);
+      if (native == NativeRecordResult::recorded) return finish_recording(true);
+      if (native == NativeRecordResult::failed) {
+        RADICC_LOG_WARN << "native: source " << source_index << " failed";
+        continue;
+      }
+    }
+    begin_record_source(progress, static_cast<int>(source_index), chunk_total);
+    if (do_libav(source, first_chunk)) return finish_recording(true);
+    RADICC_LOG_WARN << "libav: source " << source_index << " failed";
   }
+  if (hedged) avformat_close_input(&hedged->input);
 #endif
-  std::cerr << "Recording failed: libav remux path only (CLI disabled)\n";
-  return false;
+  RADICC_LOG_ERROR << "Recording failed: every stream source failed";
+  return finish_recording(false);
 }
 
 } // namespace radicc
@@ -1,13 +1,52 @@
 #pragma once
+#include "core/adts_mp4_muxer.h"
+#include "core/program_image.h"
 #include "core/radiko_stream.h"
+#include "core/record_progress.h"
+#include "utils/hash.h"
 
+#include <cstdint>
+#include <functional>
+#include <future>
 #include <string>
 
 namespace radicc {
 
+// What record_radiko wrote, filled in on success.
+struct RecordedOutput {
+  ContentDigest digest;
+  double duration_seconds = 0.0;
+};
+
+struct RadikoRecordOptions {
+  // Open the first chunk of the two best-ranked sources concurrently and
+  // record from whichever answers first.
+  bool hedge_first_chunk = false;
+  // Mux ADTS AAC natively and keep libav for streams it does not recognise.
+  bool native_muxer = true;
+  // Container layout, honoured by both the native muxer and libav.
+  Mp4OutputOptions output;
+  // Native muxer: write the output from a background thread.
+  bool async_writer = false;
+  // Receives the hidden partial file the output is written to until it is
+  // renamed into place; live readers follow that file.
+  std::function<void(const std::string&)> on_output_opened;
+  // Reports how many leading bytes of the output file are final. Fragmented
+  // output reports every fragment, other layouts only the finished file.
+  // 0 means the output was restarted, e.g. when falling back to another source.
+  std::function<void(std::uint64_t)> on_output_committed;
+  // Live counters for status readers; optional.
+  RecordProgress* progress = nullptr;
+  // Receives the output digest and duration; optional.
+  RecordedOutput* recorded = nullptr;
+  // Cover art, usually still downloading when recording starts. It is only
+  // waited for when the muxer has to write it; optional.
+  std::shared_future<ProgramCover> cover;
+};
+
 bool record_radiko(const RadikoStreamPlan& stream_plan, const std::string& filename,
                    const std::string& pfm, const std::string& album_title,
                    const std::string& dir_name, const std::string& outputDir,
-                   const std::string& image_url = std::string());
+                   const RadikoRecordOptions& record_options = RadikoRecordOptions());
 
 } // namespace radicc
@@ -1,14 +1,31 @@
 #include "core/radiko_stream.h"
 
+#include "core/markup_scan.h"
 #include "core/radiko_http.h"
+#include "core/stream_source_stats.h"
+#include "utils/atomic_file.h"
+#include "utils/cache_path.h"
 #include "utils/date.h"
+#include "utils/log.h"
+#include "utils/metrics.h"
+#include "utils/runtime_settings.h"
+#include "utils/trace.h"
 
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
 #include <cstdint>
-#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
 #include <optional>
 #include <random>
-#include <regex>
 #include <sstream>
+#include <unordered_map>
 
 namespace radicc {
 namespace {
@@ -25,30 +42,133 @@ std::string generate_lsid() {
   return value;
 }
 
-std::vector<std::string> extract_playlist_create_urls(
-    const std::string& xml,
-    bool areafree) {
-  std::vector<std::string> urls;
-  const std::string needle = areafree ? "areafree=\"1\"" : "areafree=\"0\"";
-  std::regex url_re(R"(<url\b([^>]*)>([\s\S]*?)</url>)");
-  std::regex playlist_re(R"(<playlist_create_url>([\s\S]*?)</playlist_create_url>)");
-  std::smatch m;
-  auto begin = xml.cbegin();
-  auto end = xml.cend();
-  while (std::regex_search(begin, end, m, url_re)) {
-    const std::string attrs = m[1].str();
-    const std::string inner = m[2].str();
-    if (attrs.find("timefree=\"1\"") == std::string::npos || attrs.find(needle) == std::string::npos) {
-      begin = m.suffix().first;
-      continue;
+// The timefree playlist_create_url entries of a station's stream XML, by
+// their areafree flag.
+struct StreamDefinition {
+  std::vector<std::string> areafree_urls;
+  std::vector<std::string> local_urls;
+
+  bool empty() const { return areafree_urls.empty() && local_urls.empty(); }
+};
+
+struct CachedStreamDefinition {
+  StreamDefinition definition;
+  std::chrono::system_clock::time_point fetched;
+};
+
+constexpr char kStreamDefinitionDir[] = "streams";
+constexpr std::int64_t kDefaultStreamDefinitionTtlSeconds = 86400;
+
+std::mutex g_definitions_mutex;
+std::unordered_map<std::string, CachedStreamDefinition> g_definitions;
+
+StreamDefinition parse_stream_definition(const std::string& xml) {
+  StreamDefinition definition;
+  for (auto url = find_element(xml, "url"); url; url = find_element(xml, "url", url->end)) {
+    if (url->attributes.find("timefree=\"1\"") == std::string_view::npos) continue;
+    const auto playlist = find_element_text(url->body, "playlist_create_url");
+    if (!playlist) continue;
+    const std::string playlist_url = trim_crlf(std::string(*playlist));
+    if (url->attributes.find("areafree=\"1\"") != std::string_view::npos) {
+      definition.areafree_urls.push_back(playlist_url);
+    }
+    if (url->attributes.find("areafree=\"0\"") != std::string_view::npos) {
+      definition.local_urls.push_back(playlist_url);
+    }
+  }
+  return definition;
+}
+
+std::chrono::seconds stream_definition_ttl() {
+  const std::string value = runtime_env("RADICC_STREAM_DEFINITION_TTL");
+  char* end = nullptr;
+  const long long parsed = value.empty() ? -1 : std::strtoll(value.c_str(), &end, 10);
+  return std::chrono::seconds(end && *end == '\0' && parsed >= 0 ? parsed : kDefaultStreamDefinitionTtlSeconds);
+}
+
+Counter& stream_definition_counter(const char* result) {
+  return metrics().counter("radicc_stream_definition_cache_requests_total",
+                           "Stream definition lookups by cache result.", std::string("result=\"") + result + "\"");
+}
+
+// $XDG_CACHE_HOME/radicc/streams/<station>.tsv; empty when `station_id` is
+// not a plain name or the directory is unavailable.
+std::string stream_definition_path(const std::string& station_id) {
+  if (station_id.empty() || station_id.front() == '.' ||
+      !std::all_of(station_id.begin(), station_id.end(), [](unsigned char c) {
+        return std::isalnum(c) || c == '-' || c == '_' || c == '.';
+      })) {
+    return {};
+  }
+  const std::string dir = get_cache_path(kStreamDefinitionDir);
+  if (dir.empty()) return {};
+  if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) return {};
+  return dir + "/" + station_id + ".tsv";
+}
+
+// One "areafree\t<url>" or "local\t<url>" line per entry; the file's mtime is
+// when the definition was fetched.
+std::optional<CachedStreamDefinition> read_stream_definition(const std::string& path) {
+  struct stat st;
+  if (path.empty() || ::stat(path.c_str(), &st) != 0) return std::nullopt;
+  std::ifstream file(path);
+  CachedStreamDefinition cached;
+  cached.fetched = std::chrono::system_clock::from_time_t(st.st_mtime);
+  for (std::string line; std::getline(file, line);) {
+    const std::size_t tab = line.find('\t');
+    if (tab == std::string::npos || tab + 1 == line.size()) continue;
+    const std::string_view kind(line.data(), tab);
+    if (kind == "areafree") cached.definition.areafree_urls.push_back(line.substr(tab + 1));
+    if (kind == "local") cached.definition.local_urls.push_back(line.substr(tab + 1));
+  }
+  if (cached.definition.empty()) return std::nullopt;
+  return cached;
+}
+
+void write_stream_definition(const std::string& path, const StreamDefinition& definition) {
+  if (path.empty()) return;
+  std::string contents;
+  for (const auto& url : definition.areafree_urls) contents += "areafree\t" + url + "\n";
+  for (const auto& url : definition.local_urls) contents += "local\t" + url + "\n";
+  write_file_atomically(path, contents);
+}
+
+// The station's stream definition from memory, disk or upstream, in that
+// order. `cached` tells whether upstream was skipped.
+std::optional<StreamDefinition> load_stream_definition(const std::string& station_id, bool& cached) {
+  cached = false;
+  const auto ttl = stream_definition_ttl();
+  const auto now = std::chrono::system_clock::now();
+  const std::string path = ttl.count() > 0 ? stream_definition_path(station_id) : std::string();
+  if (ttl.count() > 0) {
+    std::lock_guard<std::mutex> lock(g_definitions_mutex);
+    const auto it = g_definitions.find(station_id);
+    if (it != g_definitions.end() && now - it->second.fetched < ttl) {
+      static Counter& hits = stream_definition_counter("hit");
+      hits.add();
+      cached = true;
+      return it->second.definition;
     }
-    std::smatch mp;
-    if (std::regex_search(inner, mp, playlist_re)) {
-      urls.push_back(trim_crlf(mp[1].str()));
+    if (auto stored = read_stream_definition(path); stored && now - stored->fetched < ttl) {
+      static Counter& disk_hits = stream_definition_counter("disk");
+      disk_hits.add();
+      cached = true;
+      g_definitions[station_id] = *stored;
+      return stored->definition;
     }
-    begin = m.suffix().first;
   }
-  return urls;
+
+  static Counter& misses = stream_definition_counter("miss");
+  misses.add();
+  const auto xml = curl_get_text("https://radiko.jp/v3/station/stream/pc_html5/" + station_id + ".xml");
+  if (!xml) return std::nullopt;
+  StreamDefinition definition = parse_stream_definition(*xml);
+  if (ttl.count() > 0 && !definition.empty()) {
+    std::lock_guard<std::mutex> lock(g_definitions_mutex);
+    g_definitions[station_id] = CachedStreamDefinition{definition, now};
+    write_stream_definition(path, definition);
+  }
+  return definition;
 }
 
 int compute_chunk_length(int remaining_seconds) {
@@ -72,14 +192,15 @@ std::optional<RadikoStreamPlan> build_timefree_stream_plan(
     const std::string& totime,
     bool is_areafree,
     const RadikoAuthState& auth_state) {
+  TraceSpan span("build_timefree_stream_plan", station_id);
   if (station_id.empty() || !is_valid_datetime14(fromtime) || !is_valid_datetime14(totime)) {
     return std::nullopt;
   }
 
-  const auto xml = curl_get_text("https://radiko.jp/v3/station/stream/pc_html5/" + station_id + ".xml");
-  if (!xml) return std::nullopt;
-
-  const auto playlist_urls = extract_playlist_create_urls(*xml, is_areafree);
+  bool cached_definition = false;
+  const auto definition = load_stream_definition(station_id, cached_definition);
+  if (!definition) return std::nullopt;
+  const auto& playlist_urls = is_areafree ? definition->areafree_urls : definition->local_urls;
   if (playlist_urls.empty()) return std::nullopt;
 
   const std::int64_t start_unixtime = to_unixtime_jst(fromtime);
@@ -87,14 +208,16 @@ std::optional<RadikoStreamPlan> build_timefree_stream_plan(
   if (start_unixtime < 0 || end_unixtime <= start_unixtime) return std::nullopt;
 
   RadikoStreamPlan plan;
+  plan.station_id = station_id;
+  plan.cached_definition = cached_definition;
   plan.area_id = auth_state.area_id;
   plan.request_headers = "X-Radiko-Authtoken: " + auth_state.authtoken + "\r\n"
       + "X-Radiko-AreaId: " + auth_state.area_id + "\r\n";
 
   const std::string lsid = generate_lsid();
   for (const auto& base_url : playlist_urls) {
-    std::cerr << "Timefree playlist source: " << url_origin(base_url) << std::endl;
     RadikoStreamSource source;
+    source.origin = url_origin(base_url);
     std::int64_t seek_timestamp = start_unixtime;
     int remaining_seconds = static_cast<int>(end_unixtime - start_unixtime);
     while (remaining_seconds > 0) {
@@ -121,7 +244,26 @@ std::optional<RadikoStreamPlan> build_timefree_stream_plan(
     plan.sources.push_back(std::move(source));
   }
 
+  rank_stream_sources(plan.sources);
+  for (const auto& source : plan.sources) {
+    const auto stats = stream_source_stats(source.origin);
+    if (stats.samples > 0) {
+      RADICC_LOG_INFO << "Timefree playlist source: " << source.origin << " (ttfb " << stats.ttfb_seconds << "s, "
+                      << static_cast<long long>(stats.bytes_per_second / 1024) << " KiB/s)";
+    } else {
+      RADICC_LOG_INFO << "Timefree playlist source: " << source.origin;
+    }
+  }
   return plan;
 }
 
+void invalidate_stream_definition(const std::string& station_id) {
+  std::lock_guard<std::mutex> lock(g_definitions_mutex);
+  g_definitions.erase(station_id);
+  if (const std::string path = stream_definition_path(station_id); !path.empty()) std::remove(path.c_str());
+  static Counter& invalidated = stream_definition_counter("invalidated");
+  invalidated.add();
+  RADICC_LOG_INFO << "Stream definition for " << station_id << " was refused upstream; it will be fetched again.";
+}
+
 }  // namespace radicc
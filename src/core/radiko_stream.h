@@ -14,15 +14,24 @@ struct RadikoStreamChunk {
 };
 
 struct RadikoStreamSource {
+  std::string origin;  // scheme://host of the playlist_create_url
   std::vector<RadikoStreamChunk> chunks;
 };
 
 struct RadikoStreamPlan {
+  std::string station_id;
   std::string area_id;
   std::string request_headers;
   std::vector<RadikoStreamSource> sources;
+  // The playlist URLs came from the stream definition cache rather than a
+  // fresh /v3/station/stream download.
+  bool cached_definition = false;
 };
 
+// Plans the chunks of a timefree recording. The station's stream definition
+// (its playlist_create_url list) is cached in memory and under
+// $XDG_CACHE_HOME/radicc/streams for RADICC_STREAM_DEFINITION_TTL seconds
+// (default 86400, 0 disables), so a plan usually needs no request.
 std::optional<RadikoStreamPlan> build_timefree_stream_plan(
     const std::string& station_id,
     const std::string& fromtime,
@@ -30,4 +39,8 @@ std::optional<RadikoStreamPlan> build_timefree_stream_plan(
     bool is_areafree,
     const RadikoAuthState& auth_state);
 
+// Drops the cached stream definition of `station_id`, e.g. after a chunk
+// playlist built from it was refused with a 4xx.
+void invalidate_stream_definition(const std::string& station_id);
+
 }  // namespace radicc
@@ -0,0 +1,124 @@
+#include "core/record_progress.h"
+
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+
+namespace radicc {
+namespace {
+
+std::int64_t steady_now_ms() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+std::string format_clock(std::uint64_t seconds) {
+  char buffer[32];
+  if (seconds >= 3600) {
+    std::snprintf(buffer, sizeof(buffer), "%llu:%02llu:%02llu",
+                  static_cast<unsigned long long>(seconds / 3600),
+                  static_cast<unsigned long long>(seconds / 60 % 60),
+                  static_cast<unsigned long long>(seconds % 60));
+  } else {
+    std::snprintf(buffer, sizeof(buffer), "%02llu:%02llu",
+                  static_cast<unsigned long long>(seconds / 60),
+                  static_cast<unsigned long long>(seconds % 60));
+  }
+  return buffer;
+}
+
+}  // namespace
+
+const char* record_phase_name(RecordPhase phase) {
+  switch (phase) {
+    case RecordPhase::queued: return "queued";
+    case RecordPhase::authorizing: return "authorizing";
+    case RecordPhase::resolving: return "resolving";
+    case RecordPhase::recording: return "recording";
+    case RecordPhase::done: return "done";
+    case RecordPhase::failed: return "failed";
+  }
+  return "unknown";
+}
+
+void set_record_phase(RecordProgress& progress, RecordPhase phase) {
+  if (phase == RecordPhase::recording) progress.recording_started_ms.store(steady_now_ms(), std::memory_order_relaxed);
+  progress.phase.store(static_cast<int>(phase), std::memory_order_relaxed);
+}
+
+void begin_record_source(RecordProgress& progress, int source_index, std::uint32_t chunks_total) {
+  progress.source_index.store(source_index, std::memory_order_relaxed);
+  progress.chunks_total.store(chunks_total, std::memory_order_relaxed);
+  progress.chunks_done.store(0, std::memory_order_relaxed);
+  progress.bytes_out.store(0, std::memory_order_relaxed);
+  progress.packets.store(0, std::memory_order_relaxed);
+  progress.position_ms.store(0, std::memory_order_relaxed);
+}
+
+RecordProgressSnapshot snapshot_record_progress(const RecordProgress& progress) {
+  RecordProgressSnapshot snapshot;
+  snapshot.phase = static_cast<RecordPhase>(progress.phase.load(std::memory_order_relaxed));
+  snapshot.source_index = progress.source_index.load(std::memory_order_relaxed);
+  snapshot.chunks_done = progress.chunks_done.load(std::memory_order_relaxed);
+  snapshot.chunks_total = progress.chunks_total.load(std::memory_order_relaxed);
+  snapshot.bytes_in = progress.bytes_in.load(std::memory_order_relaxed);
+  snapshot.bytes_out = progress.bytes_out.load(std::memory_order_relaxed);
+  snapshot.packets = progress.packets.load(std::memory_order_relaxed);
+  snapshot.position_ms = progress.position_ms.load(std::memory_order_relaxed);
+  snapshot.expected_ms = progress.expected_ms.load(std::memory_order_relaxed);
+  const std::int64_t started = progress.recording_started_ms.load(std::memory_order_relaxed);
+  if (started > 0 && snapshot.phase == RecordPhase::recording) {
+    snapshot.elapsed_seconds = static_cast<double>(steady_now_ms() - started) / 1000.0;
+    if (snapshot.position_ms > 0 && snapshot.expected_ms > snapshot.position_ms) {
+      snapshot.eta_seconds = snapshot.elapsed_seconds
+          * static_cast<double>(snapshot.expected_ms - snapshot.position_ms) / static_cast<double>(snapshot.position_ms);
+    } else if (snapshot.position_ms > 0) {
+      snapshot.eta_seconds = 0.0;
+    }
+  }
+  return snapshot;
+}
+
+void write_record_progress_json(JsonWriter& json, const RecordProgressSnapshot& snapshot) {
+  json.begin_object()
+      .member("phase", record_phase_name(snapshot.phase))
+      .member("source", snapshot.source_index)
+      .member("chunks_done", snapshot.chunks_done)
+      .member("chunks_total", snapshot.chunks_total)
+      .member("bytes_in", snapshot.bytes_in)
+      .member("bytes_out", snapshot.bytes_out)
+      .member("packets", snapshot.packets)
+      .member("position_ms", snapshot.position_ms)
+      .member("expected_ms", snapshot.expected_ms)
+      .member("elapsed_seconds", static_cast<long long>(snapshot.elapsed_seconds))
+      .key("eta_seconds");
+  if (snapshot.eta_seconds) {
+    json.value(static_cast<long long>(*snapshot.eta_seconds + 0.5));
+  } else {
+    json.null();
+  }
+  json.end_object();
+}
+
+std::string record_progress_json(const RecordProgressSnapshot& snapshot) {
+  JsonWriter json;
+  write_record_progress_json(json, snapshot);
+  return json.take();
+}
+
+std::string format_record_progress(const RecordProgressSnapshot& snapshot) {
+  std::ostringstream line;
+  line << record_phase_name(snapshot.phase);
+  if (snapshot.phase != RecordPhase::recording) return line.str();
+  line << ' ' << format_clock(snapshot.position_ms / 1000);
+  if (snapshot.expected_ms > 0) {
+    line << '/' << format_clock(snapshot.expected_ms / 1000) << " ("
+         << (snapshot.position_ms * 100 / snapshot.expected_ms) << "%)";
+  }
+  line << " chunks " << snapshot.chunks_done << '/' << snapshot.chunks_total;
+  if (snapshot.eta_seconds) line << " ETA " << format_clock(static_cast<std::uint64_t>(*snapshot.eta_seconds + 0.5));
+  return line.str();
+}
+
+}  // namespace radicc
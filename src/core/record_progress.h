@@ -0,0 +1,56 @@
+#pragma once
+
+#include "utils/json.h"
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace radicc {
+
+enum class RecordPhase : int { queued, authorizing, resolving, recording, done, failed };
+
+const char* record_phase_name(RecordPhase phase);
+
+// Live counters for one recording. The recorder updates them with relaxed
+// atomics from its loop; status readers take snapshots concurrently and
+// never block it.
+struct RecordProgress {
+  std::atomic<int> phase{static_cast<int>(RecordPhase::queued)};
+  std::atomic<std::int64_t> recording_started_ms{0};  // steady clock, set on entering `recording`
+  std::atomic<std::int32_t> source_index{-1};
+  std::atomic<std::uint32_t> chunks_done{0};
+  std::atomic<std::uint32_t> chunks_total{0};
+  std::atomic<std::uint64_t> bytes_in{0};    // stream bytes received
+  std::atomic<std::uint64_t> bytes_out{0};   // bytes written to the output file
+  std::atomic<std::uint64_t> packets{0};     // audio frames written
+  std::atomic<std::uint64_t> position_ms{0};
+  std::atomic<std::uint64_t> expected_ms{0};
+};
+
+struct RecordProgressSnapshot {
+  RecordPhase phase = RecordPhase::queued;
+  int source_index = -1;
+  std::uint32_t chunks_done = 0;
+  std::uint32_t chunks_total = 0;
+  std::uint64_t bytes_in = 0;
+  std::uint64_t bytes_out = 0;
+  std::uint64_t packets = 0;
+  std::uint64_t position_ms = 0;
+  std::uint64_t expected_ms = 0;
+  double elapsed_seconds = 0.0;  // time spent in `recording`
+  std::optional<double> eta_seconds;
+};
+
+void set_record_phase(RecordProgress& progress, RecordPhase phase);
+// Resets the per-source counters when the recorder starts over on a source.
+void begin_record_source(RecordProgress& progress, int source_index, std::uint32_t chunks_total);
+RecordProgressSnapshot snapshot_record_progress(const RecordProgress& progress);
+
+void write_record_progress_json(JsonWriter& json, const RecordProgressSnapshot& snapshot);
+std::string record_progress_json(const RecordProgressSnapshot& snapshot);
+// One-line summary for terminals, e.g. "recording 12:00/30:00 (40%) chunks 2/6 ETA 03:00".
+std::string format_record_progress(const RecordProgressSnapshot& snapshot);
+
+}  // namespace radicc
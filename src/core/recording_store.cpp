@@ -0,0 +1,291 @@
+#include "core/recording_store.h"
+
+#include "utils/cache_path.h"
+#include "utils/hash.h"
+#include "utils/runtime_settings.h"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <linux/fs.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <vector>
+
+namespace radicc {
+namespace {
+
+constexpr char kStoreDir[] = "recordings";
+constexpr char kIndexFile[] = "index.tsv";
+constexpr std::int64_t kDefaultRetentionDays = 30;
+constexpr std::int64_t kDefaultMaxMegabytes = 10240;
+
+std::mutex g_store_mutex;
+
+std::int64_t env_int(const char* name, std::int64_t fallback) {
+  const std::string value = runtime_env(name);
+  if (value.empty()) return fallback;
+  char* end = nullptr;
+  const long long parsed = std::strtoll(value.c_str(), &end, 10);
+  return end && *end == '\0' && parsed >= 0 ? parsed : fallback;
+}
+
+std::string store_dir() {
+  const std::string path = get_cache_path(kStoreDir);
+  if (path.empty()) return {};
+  if (mkdir(path.c_str(), 0755) != 0 && errno != EEXIST) return {};
+  return path;
+}
+
+std::string object_path(const std::string& dir, const StoredRecording& entry) {
+  const std::size_t plus = entry.format.find('+');
+  return dir + "/" + entry.sha256 + "." + entry.format.substr(0, plus);
+}
+
+// Serialises index updates across processes (CLI and server share the
+// cache); g_store_mutex does the same across threads.
+class StoreLock {
+ public:
+  explicit StoreLock(const std::string& dir) : lock_(g_store_mutex) {
+    fd_ = ::open((dir + "/index.lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd_ >= 0) ::flock(fd_, LOCK_EX);
+  }
+  ~StoreLock() {
+    if (fd_ >= 0) ::close(fd_);
+  }
+  StoreLock(const StoreLock&) = delete;
+  StoreLock& operator=(const StoreLock&) = delete;
+
+ private:
+  std::lock_guard<std::mutex> lock_;
+  int fd_ = -1;
+};
+
+std::string index_field(const std::string& value) {
+  std::string field = value;
+  std::replace_if(field.begin(), field.end(), [](char c) { return c == '\t' || c == '\n' || c == '\r'; }, ' ');
+  return field;
+}
+
+std::vector<StoredRecording> load_index(const std::string& dir) {
+  std::vector<StoredRecording> entries;
+  std::ifstream file(dir + "/" + kIndexFile);
+  std::string line;
+  while (std::getline(file, line)) {
+    std::vector<std::string> fields;
+    std::istringstream stream(line);
+    std::string field;
+    while (std::getline(stream, field, '\t')) fields.push_back(field);
+    if (fields.size() < 8) continue;
+    StoredRecording entry;
+    entry.station_id = fields[0];
+    entry.ft = fields[1];
+    entry.to = fields[2];
+    entry.format = fields[3];
+    entry.sha256 = fields[4];
+    entry.size = std::strtoull(fields[5].c_str(), nullptr, 10);
+    entry.stored_at = std::strtoll(fields[6].c_str(), nullptr, 10);
+    entry.last_used = std::strtoll(fields[7].c_str(), nullptr, 10);
+    if (fields.size() > 8) entry.title = fields[8];
+    if (fields.size() > 9) entry.pfm = fields[9];
+    if (fields.size() > 10) entry.image_url = fields[10];
+    if (fields.size() > 11) entry.xxh3 = fields[11];
+    if (fields.size() > 12) entry.duration_seconds = std::strtod(fields[12].c_str(), nullptr);
+    entries.push_back(std::move(entry));
+  }
+  return entries;
+}
+
+bool save_index(const std::string& dir, const std::vector<StoredRecording>& entries) {
+  const std::string path = dir + "/" + kIndexFile;
+  const std::string temp_path = path + ".tmp";
+  {
+    std::ofstream file(temp_path, std::ios::trunc);
+    if (!file) return false;
+    for (const auto& entry : entries) {
+      file << index_field(entry.station_id) << '\t' << index_field(entry.ft) << '\t' << index_field(entry.to) << '\t'
+           << index_field(entry.format) << '\t' << entry.sha256 << '\t' << entry.size << '\t' << entry.stored_at
+           << '\t' << entry.last_used << '\t' << index_field(entry.title) << '\t' << index_field(entry.pfm) << '\t'
+           << index_field(entry.image_url) << '\t' << entry.xxh3 << '\t' << entry.duration_seconds << '\n';
+    }
+    if (!file) return false;
+  }
+  return std::rename(temp_path.c_str(), path.c_str()) == 0;
+}
+
+bool same_key(const StoredRecording& a, const StoredRecording& b) {
+  return a.station_id == b.station_id && a.ft == b.ft && a.to == b.to && a.format == b.format;
+}
+
+// The object still holds the bytes the index describes. XXH3 is checked
+// when the entry has it, being the cheaper of the two; older entries fall
+// back to SHA-256.
+bool object_intact(const std::string& dir, const StoredRecording& entry) {
+  const std::string path = object_path(dir, entry);
+  struct stat st;
+  if (::stat(path.c_str(), &st) != 0 || static_cast<std::uint64_t>(st.st_size) != entry.size) return false;
+  std::ifstream file(path, std::ios::binary);
+  if (!file) return false;
+  Sha256 sha256;
+  Xxh3 xxh3;
+  std::vector<char> buffer(1 << 16);
+  while (file) {
+    file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    const auto read = static_cast<std::size_t>(file.gcount());
+    if (entry.xxh3.empty()) {
+      sha256.update(buffer.data(), read);
+    } else {
+      xxh3.update(buffer.data(), read);
+    }
+  }
+  if (file.bad()) return false;
+  return entry.xxh3.empty() ? sha256.hex_digest() == entry.sha256 : xxh3.hex_digest() == entry.xxh3;
+}
+
+bool reflink_file(const std::string& source, const std::string& destination) {
+#if defined(__linux__) && defined(FICLONE)
+  const int in = ::open(source.c_str(), O_RDONLY | O_CLOEXEC);
+  if (in < 0) return false;
+  const int out = ::open(destination.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (out < 0) {
+    ::close(in);
+    return false;
+  }
+  const bool cloned = ::ioctl(out, FICLONE, in) == 0;
+  ::close(in);
+  ::close(out);
+  if (!cloned) std::remove(destination.c_str());
+  return cloned;
+#else
+  (void)source;
+  (void)destination;
+  return false;
+#endif
+}
+
+// Reflink on CoW filesystems, otherwise a full copy; never a hardlink, so
+// editing a delivered file in place cannot change the stored object. Goes
+// through a temporary name so `destination` never exists half-written.
+bool place_file(const std::string& source, const std::string& destination) {
+  const std::string temp_path = destination + ".store.tmp";
+  std::remove(temp_path.c_str());
+  bool placed = reflink_file(source, temp_path);
+  if (!placed) {
+    std::error_code ec;
+    placed = std::filesystem::copy_file(source, temp_path, std::filesystem::copy_options::overwrite_existing, ec);
+  }
+  if (placed && std::rename(temp_path.c_str(), destination.c_str()) == 0) return true;
+  std::remove(temp_path.c_str());
+  return false;
+}
+
+// Drops expired entries, then the least recently used ones until the
+// objects fit the size limit, and deletes objects nothing refers to.
+void enforce_limits(const std::string& dir, std::vector<StoredRecording>& entries, std::int64_t now) {
+  const std::int64_t retention = env_int("RADICC_STORE_RETENTION_DAYS", kDefaultRetentionDays) * 24 * 3600;
+  const std::uint64_t max_bytes =
+      static_cast<std::uint64_t>(env_int("RADICC_STORE_MAX_MB", kDefaultMaxMegabytes)) * 1024 * 1024;
+  std::set<std::string> before;
+  for (const auto& entry : entries) before.insert(object_path(dir, entry));
+
+  entries.erase(std::remove_if(entries.begin(), entries.end(),
+                               [&](const StoredRecording& entry) { return now - entry.last_used > retention; }),
+                entries.end());
+  std::stable_sort(entries.begin(), entries.end(), [](const StoredRecording& a, const StoredRecording& b) {
+    return a.last_used > b.last_used;
+  });
+  std::set<std::string> kept;
+  std::uint64_t total = 0;
+  std::vector<StoredRecording> fitting;
+  for (auto& entry : entries) {
+    const std::string path = object_path(dir, entry);
+    const bool counted = kept.count(path) > 0;
+    if (!counted && total + entry.size > max_bytes) continue;
+    if (!counted) total += entry.size;
+    kept.insert(path);
+    fitting.push_back(std::move(entry));
+  }
+  entries = std::move(fitting);
+  for (const auto& path : before) {
+    if (!kept.count(path)) std::remove(path.c_str());
+  }
+}
+
+}  // namespace
+
+bool recording_store_enabled() {
+  return runtime_env("RADICC_STORE") != "0";
+}
+
+std::optional<StoredRecording> find_stored_recording(
+    const std::string& station_id, const std::string& ft, const std::string& to, const std::string& format) {
+  if (!recording_store_enabled() || station_id.empty() || ft.empty()) return std::nullopt;
+  const std::string dir = store_dir();
+  if (dir.empty()) return std::nullopt;
+  StoreLock lock(dir);
+  const std::int64_t retention = env_int("RADICC_STORE_RETENTION_DAYS", kDefaultRetentionDays) * 24 * 3600;
+  const std::int64_t now = static_cast<std::int64_t>(std::time(nullptr));
+  for (const auto& entry : load_index(dir)) {
+    if (entry.station_id != station_id || entry.ft != ft || entry.format != format) continue;
+    if (!to.empty() && entry.to != to) continue;
+    if (now - entry.last_used > retention || !object_intact(dir, entry)) continue;
+    return entry;
+  }
+  return std::nullopt;
+}
+
+bool materialize_stored_recording(const StoredRecording& entry, const std::string& path) {
+  const std::string dir = store_dir();
+  if (dir.empty()) return false;
+  StoreLock lock(dir);
+  if (!place_file(object_path(dir, entry), path)) return false;
+
+  auto entries = load_index(dir);
+  for (auto& stored : entries) {
+    if (same_key(stored, entry)) stored.last_used = static_cast<std::int64_t>(std::time(nullptr));
+  }
+  save_index(dir, entries);
+  return true;
+}
+
+bool store_recording(StoredRecording entry, const std::string& path) {
+  if (!recording_store_enabled()) return false;
+  const std::string dir = store_dir();
+  if (dir.empty()) return false;
+  if (entry.sha256.empty()) {
+    const auto digest = digest_file(path);
+    if (!digest) return false;
+    entry.sha256 = digest->sha256;
+    entry.xxh3 = digest->xxh3;
+    entry.size = digest->size;
+  }
+  const std::int64_t now = static_cast<std::int64_t>(std::time(nullptr));
+  entry.stored_at = now;
+  entry.last_used = now;
+
+  StoreLock lock(dir);
+  const std::string object = object_path(dir, entry);
+  if (!object_intact(dir, entry) && !place_file(path, object)) return false;
+  auto entries = load_index(dir);
+  entries.erase(std::remove_if(entries.begin(), entries.end(),
+                               [&](const StoredRecording& stored) { return same_key(stored, entry); }),
+                entries.end());
+  entries.push_back(entry);
+  enforce_limits(dir, entries, now);
+  return save_index(dir, entries);
+}
+
+}  // namespace radicc
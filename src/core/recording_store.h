@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace radicc {
+
+// Finished recordings kept under the cache directory
+// ($XDG_CACHE_HOME/radicc/recordings), stored once per content hash and
+// indexed by airing (station, ft, to) and output format. A repeat request
+// for a stored airing is served by copying the stored file into place
+// instead of recording it again.
+//
+// RADICC_STORE=0 disables the store. RADICC_STORE_RETENTION_DAYS (default
+// 30) drops entries not used for that long; RADICC_STORE_MAX_MB (default
+// 10240) evicts the least recently used entries above that size.
+struct StoredRecording {
+  std::string station_id;
+  std::string ft;
+  std::string to;
+  std::string format;
+  std::string sha256;
+  std::string xxh3;
+  std::uint64_t size = 0;
+  double duration_seconds = 0.0;
+  std::int64_t stored_at = 0;
+  std::int64_t last_used = 0;
+  // Program metadata, so a hit needs no schedule lookup.
+  std::string title;
+  std::string pfm;
+  std::string image_url;
+};
+
+bool recording_store_enabled();
+
+// Finds a stored airing whose object still matches its recorded digest; an
+// empty `to` matches any end time (timefree URLs carry only the start).
+std::optional<StoredRecording> find_stored_recording(
+    const std::string& station_id, const std::string& ft, const std::string& to, const std::string& format);
+
+// Places an independent copy of the stored file at `path`: reflink, then a
+// full copy. The destination appears atomically. Marks the entry used.
+bool materialize_stored_recording(const StoredRecording& entry, const std::string& path);
+
+// Adds the finished file at `path` to the store under `entry`'s key and
+// applies the retention and size limits. Without a `sha256` from the writer
+// the digests and size are computed from the file.
+bool store_recording(StoredRecording entry, const std::string& path);
+
+}  // namespace radicc
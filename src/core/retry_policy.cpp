@@ -0,0 +1,201 @@
+#include "core/retry_policy.h"
+
+#include "core/radiko_http.h"
+#include "core/upstream_governor.h"
+#include "utils/cancellation.h"
+#include "utils/log.h"
+#include "utils/metrics.h"
+#include "utils/runtime_settings.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+
+namespace radicc {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Retry tokens per endpoint; each retry spends one, each success returns a
+// tenth, so sustained retries stay near 10% of successful calls.
+constexpr double kRetryBudget = 10.0;
+constexpr double kRetryRefill = 0.1;
+constexpr long kDefaultCircuitFailures = 5;
+constexpr long kDefaultCircuitCooldownSeconds = 30;
+
+long env_long(const char* name, long fallback) {
+  const std::string value = runtime_env(name);
+  if (value.empty()) return fallback;
+  char* end = nullptr;
+  const long parsed = std::strtol(value.c_str(), &end, 10);
+  return end && *end == '\0' && parsed > 0 ? parsed : fallback;
+}
+
+struct CircuitBreaker {
+  int consecutive_failures = 0;
+  bool open = false;
+  bool probe_in_flight = false;
+  Clock::time_point opened_at;
+};
+
+struct RetryState {
+  std::mutex mutex;
+  std::map<std::string, CircuitBreaker> breakers;
+  std::map<std::string, double> budgets;
+};
+
+RetryState& retry_state() {
+  static RetryState state;
+  return state;
+}
+
+double& budget_for(RetryState& state, const std::string& endpoint) {
+  return state.budgets.try_emplace(endpoint, kRetryBudget).first->second;
+}
+
+double jittered_delay(const RetryPolicy& policy, int attempt) {
+  thread_local std::mt19937 rng{std::random_device{}()};
+  const double cap = std::min(policy.max_delay_seconds, policy.base_delay_seconds * std::pow(2.0, attempt - 1));
+  return std::uniform_real_distribution<double>(0.0, cap)(rng);
+}
+
+Counter& endpoint_counter(const char* name, const char* help, const std::string& endpoint) {
+  return metrics().counter(name, help, "endpoint=\"" + endpoint + "\"");
+}
+
+}  // namespace
+
+UpstreamFailure classify_http_failure(int exit_code, int http_status) {
+  if (http_status >= 400) {
+    const bool transient = http_status == 408 || http_status == 425 || http_status == 429 || http_status >= 500;
+    return transient ? UpstreamFailure::retryable : UpstreamFailure::fatal;
+  }
+  switch (exit_code) {
+    case -1:   // could not start curl
+    case 1:    // unsupported protocol
+    case 2:    // failed to initialise
+    case 3:    // malformed URL
+    case 27:   // out of memory
+    case 43:   // internal error
+    case 127:  // curl is not installed
+      return UpstreamFailure::fatal;
+    default:
+      // DNS, connect, TLS, timeouts and dropped transfers.
+      return UpstreamFailure::retryable;
+  }
+}
+
+RetryPolicy retry_policy_for(const std::string& endpoint) {
+  RetryPolicy policy;
+  if (endpoint == "auth1" || endpoint == "auth2" || endpoint == "login") {
+    policy = {3, 0.5, 4.0};
+  } else if (endpoint == "logout") {
+    policy = {1, 0.0, 0.0};
+  } else if (endpoint == "playlist" || endpoint == "segment") {
+    policy = {4, 0.5, 8.0};
+  } else if (endpoint == "station_list" || endpoint == "stream_xml" || endpoint == "program_xml"
+             || endpoint == "event_page") {
+    policy = {3, 1.0, 8.0};
+  } else {
+    policy = {2, 1.0, 4.0};
+  }
+  policy.max_attempts = std::min<long>(policy.max_attempts, env_long("RADICC_RETRY_MAX_ATTEMPTS", policy.max_attempts));
+  return policy;
+}
+
+UpstreamCall::UpstreamCall(const std::string& url)
+    : host_(upstream_host(url)),
+      endpoint_(classify_upstream_endpoint(url)),
+      policy_(retry_policy_for(endpoint_)) {}
+
+UpstreamCall::~UpstreamCall() {
+  if (!probing_) return;
+  // Abandoned mid-probe: let the next call probe instead.
+  RetryState& state = retry_state();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  state.breakers[host_].probe_in_flight = false;
+}
+
+bool UpstreamCall::begin() {
+  if (current_cancellation_expired()) return false;
+  RetryState& state = retry_state();
+  {
+    std::lock_guard<std::mutex> lock(state.mutex);
+    CircuitBreaker& breaker = state.breakers[host_];
+    const auto cooldown = std::chrono::seconds(env_long("RADICC_CIRCUIT_COOLDOWN", kDefaultCircuitCooldownSeconds));
+    // After the cooldown a single call probes the host; the rest keep failing fast.
+    if (breaker.open && !breaker.probe_in_flight && Clock::now() - breaker.opened_at >= cooldown) {
+      breaker.probe_in_flight = true;
+      probing_ = true;
+    }
+    if (!breaker.open || probing_) {
+      ++attempts_;
+      return true;
+    }
+  }
+  endpoint_counter("radicc_upstream_circuit_rejections_total",
+                   "Upstream calls failed at once because the host's circuit was open.", endpoint_).add();
+  return false;
+}
+
+void UpstreamCall::succeeded() {
+  RetryState& state = retry_state();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  CircuitBreaker& breaker = state.breakers[host_];
+  breaker.consecutive_failures = 0;
+  if (probing_) {
+    breaker.open = false;
+    breaker.probe_in_flight = false;
+    probing_ = false;
+    RADICC_LOG_INFO << "upstream: circuit for " << host_ << " closed";
+  }
+  double& budget = budget_for(state, endpoint_);
+  budget = std::min(kRetryBudget, budget + kRetryRefill);
+}
+
+bool UpstreamCall::retry(UpstreamFailure failure) {
+  RetryState& state = retry_state();
+  {
+    std::lock_guard<std::mutex> lock(state.mutex);
+    CircuitBreaker& breaker = state.breakers[host_];
+    if (failure == UpstreamFailure::fatal) {
+      // The host answered; the request itself is wrong.
+      breaker.consecutive_failures = 0;
+      if (probing_) breaker.open = false;
+    } else {
+      ++breaker.consecutive_failures;
+      const int threshold = static_cast<int>(env_long("RADICC_CIRCUIT_FAILURES", kDefaultCircuitFailures));
+      if (probing_ || (!breaker.open && breaker.consecutive_failures >= threshold)) {
+        breaker.open = true;
+        breaker.opened_at = Clock::now();
+        RADICC_LOG_WARN << "upstream: circuit for " << host_ << " opened after "
+                        << breaker.consecutive_failures << " failures";
+        metrics().counter("radicc_upstream_circuit_opened_total", "Times a host's circuit breaker opened.").add();
+      }
+    }
+    if (probing_) {
+      breaker.probe_in_flight = false;
+      probing_ = false;
+    }
+    if (failure == UpstreamFailure::fatal || breaker.open || attempts_ >= policy_.max_attempts) return false;
+    double& budget = budget_for(state, endpoint_);
+    if (budget < 1.0) {
+      endpoint_counter("radicc_upstream_retry_budget_exhausted_total",
+                       "Retries skipped because the endpoint's retry budget was spent.", endpoint_).add();
+      return false;
+    }
+    budget -= 1.0;
+  }
+  endpoint_counter("radicc_upstream_retries_total", "Upstream call attempts that were retried.", endpoint_).add();
+  const double delay = jittered_delay(policy_, attempts_);
+  if (const auto token = current_cancellation()) return token->wait_for(delay);
+  std::this_thread::sleep_for(std::chrono::duration<double>(delay));
+  return true;
+}
+
+}  // namespace radicc
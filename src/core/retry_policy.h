@@ -0,0 +1,65 @@
+#pragma once
+
+#include <string>
+
+namespace radicc {
+
+// Retries and circuit breaking for upstream calls, shared by curl and libav.
+//
+// Each endpoint (see classify_upstream_endpoint) has a retry policy: a
+// maximum number of attempts and an exponential backoff with full jitter.
+// Retries also draw from a per-endpoint budget that successes refill, so a
+// failing endpoint settles at a small retry ratio instead of multiplying
+// its traffic. RADICC_RETRY_MAX_ATTEMPTS caps the attempts of every
+// endpoint (1 disables retries).
+//
+// Each host has a circuit breaker: RADICC_CIRCUIT_FAILURES consecutive
+// retryable failures (default 5) open it, and calls fail at once until
+// RADICC_CIRCUIT_COOLDOWN seconds (default 30) have passed; then one probe
+// call decides whether it closes again.
+
+enum class UpstreamFailure { retryable, fatal };
+
+// HTTP status 0 means no response was received.
+UpstreamFailure classify_http_failure(int exit_code, int http_status);
+
+struct RetryPolicy {
+  int max_attempts = 3;
+  double base_delay_seconds = 0.5;
+  double max_delay_seconds = 8.0;
+};
+
+RetryPolicy retry_policy_for(const std::string& endpoint);
+
+// One logical upstream call and its attempts:
+//
+//   UpstreamCall call(url);
+//   while (call.begin()) {
+//     if (attempt succeeded) { call.succeeded(); return result; }
+//     if (!call.retry(classification)) break;
+//   }
+class UpstreamCall {
+ public:
+  explicit UpstreamCall(const std::string& url);
+  ~UpstreamCall();
+  UpstreamCall(const UpstreamCall&) = delete;
+  UpstreamCall& operator=(const UpstreamCall&) = delete;
+
+  // False when the host's circuit is open; the call should fail at once.
+  bool begin();
+  void succeeded();
+  // Records a failed attempt. Sleeps the backoff and returns true when
+  // another attempt is allowed.
+  bool retry(UpstreamFailure failure);
+
+  int attempts() const { return attempts_; }
+
+ private:
+  std::string host_;
+  std::string endpoint_;
+  RetryPolicy policy_;
+  int attempts_ = 0;
+  bool probing_ = false;
+};
+
+}  // namespace radicc
@@ -0,0 +1,307 @@
+#include "core/schedule_snapshot.h"
+
+#include "utils/atomic_file.h"
+#include "utils/cache_path.h"
+#include "utils/log.h"
+#include "utils/runtime_settings.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <unordered_map>
+
+namespace radicc {
+namespace {
+
+constexpr char kSnapshotFile[] = "schedule.snapshot";
+constexpr char kMagic[8] = {'R', 'A', 'D', 'I', 'S', 'C', 'H', 'D'};
+constexpr std::uint32_t kVersion = 1;
+constexpr std::uint32_t kByteOrderMark = 0x01020304;
+constexpr std::int64_t kDefaultMaxAgeSeconds = 86400;
+constexpr std::uint64_t kNoBound = std::numeric_limits<std::uint64_t>::max();
+
+struct StringRef {
+  std::uint32_t offset;  // into the string pool
+  std::uint32_t size;
+};
+
+struct Header {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t byte_order;  // kByteOrderMark as written
+  std::int64_t built_at;     // Unix seconds
+  std::uint32_t station_count;
+  std::uint32_t program_count;
+  std::uint64_t stations_offset;
+  std::uint64_t programs_offset;
+  std::uint64_t strings_offset;
+  std::uint64_t strings_size;
+};
+
+struct Station {
+  StringRef id;
+  std::uint32_t first_program;
+  std::uint32_t program_count;
+  std::uint64_t first_ft;  // earliest start, yyyymmddHHMMSS as a number
+  std::uint64_t last_to;   // latest end
+};
+
+struct Program {
+  std::uint64_t ft;
+  std::uint64_t to;
+  StringRef title;
+  StringRef pfm;
+  StringRef img;
+  StringRef event_url;
+};
+
+static_assert(sizeof(Header) == 64 && sizeof(Station) == 32 && sizeof(Program) == 48,
+              "the snapshot layout changed; bump kVersion");
+
+// yyyymmddHHMMSS as a number, so records sort and compare as integers; 0
+// when `text` is not 14 digits.
+std::uint64_t datetime_value(std::string_view text) {
+  std::uint64_t value = 0;
+  if (text.size() != 14) return 0;
+  const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+  return error == std::errc() && end == text.data() + text.size() ? value : 0;
+}
+
+std::string datetime_text(std::uint64_t value) {
+  char digits[24];
+  const auto result = std::to_chars(digits, digits + sizeof(digits), value);
+  return std::string(digits, result.ptr);
+}
+
+const Header& header_of(const char* data) { return *reinterpret_cast<const Header*>(data); }
+
+const Station* stations_of(const char* data) {
+  return reinterpret_cast<const Station*>(data + header_of(data).stations_offset);
+}
+
+const Program* programs_of(const char* data) {
+  return reinterpret_cast<const Program*>(data + header_of(data).programs_offset);
+}
+
+std::string_view string_at(const char* data, const StringRef& ref) {
+  const Header& header = header_of(data);
+  if (std::uint64_t{ref.offset} + ref.size > header.strings_size) return {};
+  return std::string_view(data + header.strings_offset + ref.offset, ref.size);
+}
+
+bool section_fits(std::uint64_t offset, std::uint64_t count, std::uint64_t record_size, std::size_t file_size) {
+  return offset % 8 == 0 && offset <= file_size && count <= (file_size - offset) / record_size;
+}
+
+bool valid_layout(const char* data, std::size_t size) {
+  if (size < sizeof(Header)) return false;
+  const Header& header = header_of(data);
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion ||
+      header.byte_order != kByteOrderMark) {
+    return false;
+  }
+  if (!section_fits(header.stations_offset, header.station_count, sizeof(Station), size) ||
+      !section_fits(header.programs_offset, header.program_count, sizeof(Program), size) ||
+      header.strings_offset > size || header.strings_size > size - header.strings_offset) {
+    return false;
+  }
+  const Station* stations = stations_of(data);
+  for (std::uint32_t i = 0; i < header.station_count; ++i) {
+    if (std::uint64_t{stations[i].first_program} + stations[i].program_count > header.program_count) return false;
+  }
+  return true;
+}
+
+const Station* find_station(const char* data, const std::string& station_id) {
+  const Header& header = header_of(data);
+  const Station* begin = stations_of(data);
+  const Station* end = begin + header.station_count;
+  const Station* found = std::lower_bound(begin, end, station_id, [&](const Station& station, const std::string& id) {
+    return string_at(data, station.id) < id;
+  });
+  return found != end && string_at(data, found->id) == station_id ? found : nullptr;
+}
+
+std::int64_t max_age_seconds() {
+  const std::string value = runtime_env("RADICC_SCHEDULE_SNAPSHOT_MAX_AGE");
+  if (value.empty()) return kDefaultMaxAgeSeconds;
+  char* end = nullptr;
+  const long long parsed = std::strtoll(value.c_str(), &end, 10);
+  return end && *end == '\0' && parsed >= 0 ? parsed : kDefaultMaxAgeSeconds;
+}
+
+}  // namespace
+
+std::shared_ptr<const ScheduleSnapshot> ScheduleSnapshot::open(const std::string& path) {
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return nullptr;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(Header))) {
+    ::close(fd);
+    return nullptr;
+  }
+  const auto size = static_cast<std::size_t>(st.st_size);
+  void* mapped = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (mapped == MAP_FAILED) return nullptr;
+  std::shared_ptr<const ScheduleSnapshot> snapshot(new ScheduleSnapshot(static_cast<const char*>(mapped), size));
+  if (!valid_layout(snapshot->data_, size)) {
+    RADICC_LOG_WARN << "Ignoring schedule snapshot of another version or malformed: " << path;
+    return nullptr;
+  }
+  return snapshot;
+}
+
+ScheduleSnapshot::~ScheduleSnapshot() { munmap(const_cast<char*>(data_), size_); }
+
+std::chrono::system_clock::time_point ScheduleSnapshot::built_at() const {
+  return std::chrono::system_clock::time_point(std::chrono::seconds(header_of(data_).built_at));
+}
+
+std::vector<std::string> ScheduleSnapshot::station_ids() const {
+  std::vector<std::string> ids;
+  const Station* stations = stations_of(data_);
+  for (std::uint32_t i = 0; i < header_of(data_).station_count; ++i) {
+    ids.emplace_back(string_at(data_, stations[i].id));
+  }
+  return ids;
+}
+
+std::size_t ScheduleSnapshot::program_count() const { return header_of(data_).program_count; }
+
+std::vector<ProgramEventInfo> ScheduleSnapshot::programs(const std::string& station_id, std::string_view from_ft,
+                                                         std::string_view to_ft) const {
+  std::vector<ProgramEventInfo> found;
+  const Station* station = find_station(data_, station_id);
+  if (!station) return found;
+  const Program* begin = programs_of(data_) + station->first_program;
+  const Program* end = begin + station->program_count;
+  const auto by_start = [](const Program& program, std::uint64_t ft) { return program.ft < ft; };
+  const Program* first = std::lower_bound(begin, end, from_ft.empty() ? 0 : datetime_value(from_ft), by_start);
+  const Program* last = std::lower_bound(first, end, to_ft.empty() ? kNoBound : datetime_value(to_ft), by_start);
+  found.reserve(static_cast<std::size_t>(last - first));
+  for (const Program* program = first; program != last; ++program) {
+    ProgramEventInfo info;
+    info.event_url = std::string(string_at(data_, program->event_url));
+    info.ft = datetime_text(program->ft);
+    info.to = datetime_text(program->to);
+    info.title = std::string(string_at(data_, program->title));
+    info.pfm = std::string(string_at(data_, program->pfm));
+    info.img = info.image_url = std::string(string_at(data_, program->img));
+    found.push_back(std::move(info));
+  }
+  return found;
+}
+
+bool ScheduleSnapshot::covers(const std::string& station_id, std::string_view from_ft, std::string_view to_ft) const {
+  const Station* station = find_station(data_, station_id);
+  const std::uint64_t from = datetime_value(from_ft);
+  const std::uint64_t to = datetime_value(to_ft);
+  return station && station->program_count > 0 && from && to && station->first_ft <= from && station->last_to >= to;
+}
+
+bool write_schedule_snapshot(const std::string& path,
+                             const std::vector<std::pair<std::string, std::vector<ProgramEventInfo>>>& stations) {
+  std::vector<const std::pair<std::string, std::vector<ProgramEventInfo>>*> sorted;
+  for (const auto& station : stations) sorted.push_back(&station);
+  std::sort(sorted.begin(), sorted.end(), [](const auto* a, const auto* b) { return a->first < b->first; });
+  sorted.erase(std::unique(sorted.begin(), sorted.end(), [](const auto* a, const auto* b) { return a->first == b->first; }),
+               sorted.end());
+
+  std::string pool;
+  std::unordered_map<std::string, StringRef> pooled;
+  bool fits = true;
+  const auto intern = [&](const std::string& text) {
+    const auto [it, inserted] = pooled.try_emplace(text, StringRef{0, 0});
+    if (inserted) {
+      if (pool.size() + text.size() > std::numeric_limits<std::uint32_t>::max()) fits = false;
+      it->second = StringRef{static_cast<std::uint32_t>(pool.size()), static_cast<std::uint32_t>(text.size())};
+      pool += text;
+    }
+    return it->second;
+  };
+
+  std::vector<Station> station_records;
+  std::vector<Program> program_records;
+  for (const auto* station : sorted) {
+    Station record{intern(station->first), static_cast<std::uint32_t>(program_records.size()), 0, kNoBound, 0};
+    for (const ProgramEventInfo& info : station->second) {
+      const std::uint64_t ft = datetime_value(info.ft);
+      const std::uint64_t to = datetime_value(info.to);
+      if (!ft || !to) continue;
+      program_records.push_back(Program{ft, to, intern(info.title), intern(info.pfm), intern(info.img),
+                                        intern(info.event_url)});
+      record.first_ft = std::min(record.first_ft, ft);
+      record.last_to = std::max(record.last_to, to);
+    }
+    std::stable_sort(program_records.begin() + record.first_program, program_records.end(),
+                     [](const Program& a, const Program& b) { return a.ft < b.ft; });
+    record.program_count = static_cast<std::uint32_t>(program_records.size() - record.first_program);
+    station_records.push_back(record);
+  }
+  if (!fits || program_records.size() > std::numeric_limits<std::uint32_t>::max()) return false;
+
+  Header header{};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.byte_order = kByteOrderMark;
+  header.built_at = std::chrono::duration_cast<std::chrono::seconds>(
+                        std::chrono::system_clock::now().time_since_epoch())
+                        .count();
+  header.station_count = static_cast<std::uint32_t>(station_records.size());
+  header.program_count = static_cast<std::uint32_t>(program_records.size());
+  header.stations_offset = sizeof(Header);
+  header.programs_offset = header.stations_offset + station_records.size() * sizeof(Station);
+  header.strings_offset = header.programs_offset + program_records.size() * sizeof(Program);
+  header.strings_size = pool.size();
+
+  const auto bytes = [](const void* data, std::size_t size) {
+    return std::string_view(static_cast<const char*>(data), size);
+  };
+  return write_file_atomically(path, {bytes(&header, sizeof(header)),
+                                      bytes(station_records.data(), station_records.size() * sizeof(Station)),
+                                      bytes(program_records.data(), program_records.size() * sizeof(Program)), pool});
+}
+
+std::string schedule_snapshot_path() { return get_cache_path(kSnapshotFile); }
+
+std::shared_ptr<const ScheduleSnapshot> current_schedule_snapshot() {
+  static std::mutex mutex;
+  static std::shared_ptr<const ScheduleSnapshot> snapshot;
+  static struct stat mapped_stat {};
+
+  const std::int64_t max_age = max_age_seconds();
+  if (max_age == 0) return nullptr;
+  const std::string path = schedule_snapshot_path();
+  if (path.empty()) return nullptr;
+
+  struct stat st;
+  std::lock_guard<std::mutex> lock(mutex);
+  if (::stat(path.c_str(), &st) != 0) {
+    snapshot.reset();
+    mapped_stat = {};
+    return nullptr;
+  }
+  // A new snapshot is renamed into place, so a changed inode or mtime
+  // means the mapping is stale; readers still holding it keep it alive.
+  if (st.st_ino != mapped_stat.st_ino || st.st_dev != mapped_stat.st_dev || st.st_size != mapped_stat.st_size ||
+      st.st_mtim.tv_sec != mapped_stat.st_mtim.tv_sec || st.st_mtim.tv_nsec != mapped_stat.st_mtim.tv_nsec) {
+    snapshot = ScheduleSnapshot::open(path);
+    mapped_stat = st;
+  }
+  if (!snapshot || std::chrono::system_clock::now() - snapshot->built_at() > std::chrono::seconds(max_age)) {
+    return nullptr;
+  }
+  return snapshot;
+}
+
+}  // namespace radicc
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "core/radiko_programs.h"
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace radicc {
+
+// Every station's weekly schedule in one versioned binary file, mapped
+// read-only so a process starts without fetching or parsing XML and all
+// processes share its pages through the page cache. Built by
+// `radicc_fetch --snapshot`.
+//
+// Layout, in native byte order: a header, fixed-width station records
+// sorted by id, fixed-width program records grouped by station and sorted
+// by start time within each, then a pool of the strings they reference.
+class ScheduleSnapshot {
+ public:
+  // nullptr when `path` is missing, of another version or malformed.
+  static std::shared_ptr<const ScheduleSnapshot> open(const std::string& path);
+  ~ScheduleSnapshot();
+  ScheduleSnapshot(const ScheduleSnapshot&) = delete;
+  ScheduleSnapshot& operator=(const ScheduleSnapshot&) = delete;
+
+  std::chrono::system_clock::time_point built_at() const;
+  std::vector<std::string> station_ids() const;
+  std::size_t program_count() const;
+
+  // Programs of `station_id` starting in [from_ft, to_ft), in start order.
+  // An empty bound is open.
+  std::vector<ProgramEventInfo> programs(const std::string& station_id, std::string_view from_ft = {},
+                                         std::string_view to_ft = {}) const;
+  // True when the snapshot holds `station_id` from at least `from_ft` to
+  // at least `to_ft`, so a schedule for that range can be served from it.
+  bool covers(const std::string& station_id, std::string_view from_ft, std::string_view to_ft) const;
+
+ private:
+  ScheduleSnapshot(const char* data, std::size_t size) : data_(data), size_(size) {}
+
+  const char* data_;
+  std::size_t size_;
+};
+
+// Writes `stations` (station id, weekly programs) to `path`. The file is
+// written beside it under a temporary name and renamed over it, so readers
+// see the old snapshot or the new one, never a partial file.
+bool write_schedule_snapshot(const std::string& path,
+                             const std::vector<std::pair<std::string, std::vector<ProgramEventInfo>>>& stations);
+
+// $XDG_CACHE_HOME/radicc/schedule.snapshot
+std::string schedule_snapshot_path();
+
+// The snapshot at schedule_snapshot_path() while it is younger than
+// RADICC_SCHEDULE_SNAPSHOT_MAX_AGE seconds (default 86400, 0 disables);
+// null otherwise. Remapped when the file is replaced.
+std::shared_ptr<const ScheduleSnapshot> current_schedule_snapshot();
+
+}  // namespace radicc
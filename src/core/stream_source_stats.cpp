@@ -0,0 +1,136 @@
+#include "core/stream_source_stats.h"
+
+#include "utils/atomic_file.h"
+#include "utils/cache_path.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+
+namespace radicc {
+namespace {
+
+constexpr double kSmoothing = 0.3;
+// Five-minute chunk at the 48 kbps HE-AAC rate radiko serves.
+constexpr double kNominalChunkBytes = 300.0 * 48000.0 / 8.0;
+constexpr char kStatsFile[] = "stream_sources.tsv";
+// Chunk results between saves while a recording runs.
+constexpr int kUpdatesPerSave = 8;
+
+std::mutex g_stats_mutex;
+bool g_stats_loaded = false;
+int g_unsaved_updates = 0;
+std::unordered_map<std::string, StreamSourceStats> g_stats;
+
+void load_stats_locked() {
+  if (g_stats_loaded) return;
+  g_stats_loaded = true;
+  const std::string path = get_cache_path(kStatsFile);
+  if (path.empty()) return;
+  std::ifstream file(path);
+  std::string line;
+  while (std::getline(file, line)) {
+    std::istringstream fields(line);
+    std::string origin;
+    StreamSourceStats stats;
+    if (std::getline(fields, origin, '\t')
+        && fields >> stats.ttfb_seconds >> stats.bytes_per_second >> stats.samples >> stats.failures) {
+      // Files written before the rate was kept start from the lifetime ratio.
+      if (!(fields >> stats.failure_rate) && stats.failures > 0) {
+        stats.failure_rate = static_cast<double>(stats.failures) / (stats.samples + stats.failures);
+      }
+      g_stats[origin] = stats;
+    }
+  }
+}
+
+void save_stats_locked() {
+  if (g_unsaved_updates == 0) return;
+  const std::string path = get_cache_path(kStatsFile);
+  if (path.empty()) return;
+  std::ostringstream contents;
+  for (const auto& [origin, stats] : g_stats) {
+    contents << origin << '\t' << stats.ttfb_seconds << '\t' << stats.bytes_per_second << '\t'
+             << stats.samples << '\t' << stats.failures << '\t' << stats.failure_rate << '\n';
+  }
+  if (write_file_atomically(path, contents.str())) g_unsaved_updates = 0;
+}
+
+// Counts an update and saves once enough have piled up; the rest are saved
+// when the recording finishes.
+void note_update_locked() {
+  if (++g_unsaved_updates >= kUpdatesPerSave) save_stats_locked();
+}
+
+double smooth(double current, double sample, int samples) {
+  return samples == 0 ? sample : current + kSmoothing * (sample - current);
+}
+
+double expected_chunk_seconds(const StreamSourceStats& stats) {
+  if (stats.samples == 0) {
+    return stats.failures == 0 ? std::numeric_limits<double>::quiet_NaN()
+                               : std::numeric_limits<double>::max();
+  }
+  const double transfer = stats.bytes_per_second > 0.0 ? kNominalChunkBytes / stats.bytes_per_second : 0.0;
+  return (stats.ttfb_seconds + transfer) * (1.0 + 4.0 * stats.failure_rate);
+}
+
+}  // namespace
+
+void record_stream_source_success(const std::string& origin, double ttfb_seconds, double bytes_per_second) {
+  if (origin.empty()) return;
+  std::lock_guard<std::mutex> lock(g_stats_mutex);
+  load_stats_locked();
+  auto& stats = g_stats[origin];
+  stats.failure_rate = smooth(stats.failure_rate, 0.0, stats.samples + stats.failures);
+  stats.ttfb_seconds = smooth(stats.ttfb_seconds, ttfb_seconds, stats.samples);
+  if (bytes_per_second > 0.0) stats.bytes_per_second = smooth(stats.bytes_per_second, bytes_per_second, stats.samples);
+  ++stats.samples;
+  note_update_locked();
+}
+
+void record_stream_source_failure(const std::string& origin) {
+  if (origin.empty()) return;
+  std::lock_guard<std::mutex> lock(g_stats_mutex);
+  load_stats_locked();
+  auto& stats = g_stats[origin];
+  stats.failure_rate = smooth(stats.failure_rate, 1.0, stats.samples + stats.failures);
+  ++stats.failures;
+  note_update_locked();
+}
+
+void save_stream_source_stats() {
+  std::lock_guard<std::mutex> lock(g_stats_mutex);
+  save_stats_locked();
+}
+
+StreamSourceStats stream_source_stats(const std::string& origin) {
+  std::lock_guard<std::mutex> lock(g_stats_mutex);
+  load_stats_locked();
+  const auto it = g_stats.find(origin);
+  return it == g_stats.end() ? StreamSourceStats{} : it->second;
+}
+
+void rank_stream_sources(std::vector<RadikoStreamSource>& sources) {
+  std::vector<std::pair<double, RadikoStreamSource>> ranked;
+  ranked.reserve(sources.size());
+  for (auto& source : sources) {
+    ranked.emplace_back(expected_chunk_seconds(stream_source_stats(source.origin)), std::move(source));
+  }
+  // NaN marks an origin without history; it sorts after every known origin
+  // that ever succeeded, ahead of those that only ever failed.
+  std::stable_sort(ranked.begin(), ranked.end(), [](const auto& a, const auto& b) {
+    const auto key = [](double score) {
+      return std::isnan(score) ? std::numeric_limits<double>::max() / 2 : score;
+    };
+    return key(a.first) < key(b.first);
+  });
+  sources.clear();
+  for (auto& entry : ranked) sources.push_back(std::move(entry.second));
+}
+
+}  // namespace radicc
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "core/radiko_stream.h"
+
+#include <string>
+#include <vector>
+
+namespace radicc {
+
+// Per-origin delivery history, persisted in the cache directory so later
+// recordings can prefer the origin that answered fastest last time.
+struct StreamSourceStats {
+  double ttfb_seconds = 0.0;       // moving average of chunk open latency
+  double bytes_per_second = 0.0;   // moving average of sustained read throughput
+  double failure_rate = 0.0;       // moving average of chunk results, 1 for a failure
+  int samples = 0;
+  int failures = 0;
+};
+
+void record_stream_source_success(const std::string& origin, double ttfb_seconds, double bytes_per_second);
+void record_stream_source_failure(const std::string& origin);
+// Writes results not yet saved; record_radiko calls it when it finishes.
+void save_stream_source_stats();
+StreamSourceStats stream_source_stats(const std::string& origin);
+
+// Stable-sorts sources so the origin with the best expected chunk time is
+// tried first. Origins without history keep their playlist order after the
+// known ones.
+void rank_stream_sources(std::vector<RadikoStreamSource>& sources);
+
+}  // namespace radicc
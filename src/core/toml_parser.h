@@ -4,6 +4,8 @@
 
 namespace radicc {
 
+// Map views of the current ConfigSnapshot (core/config_snapshot.h); the file
+// is parsed once, not on every call.
 std::map<std::string, std::string> parse_toml(const std::string& section);
 // Look up a section by its `id = "..."` field and return key/value map.
 std::map<std::string, std::string> parse_toml_by_id(const std::string& id);
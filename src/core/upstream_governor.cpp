@@ -0,0 +1,214 @@
+#include "core/upstream_governor.h"
+
+#include "utils/cancellation.h"
+#include "utils/metrics.h"
+#include "utils/runtime_settings.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace radicc {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr double kDefaultRequestsPerSecond = 50.0;
+constexpr unsigned kLiveWeight = 4;
+constexpr unsigned kBackfillWeight = 1;
+// The pacer forgets older traffic so a changed share applies quickly.
+constexpr double kPacerWindowSeconds = 5.0;
+
+double env_number(const char* name, double fallback) {
+  const std::string value = runtime_env(name);
+  if (value.empty()) return fallback;
+  char* end = nullptr;
+  const double parsed = std::strtod(value.c_str(), &end);
+  return end && *end == '\0' && parsed >= 0.0 ? parsed : fallback;
+}
+
+unsigned weight_of(UpstreamPriority priority) {
+  return priority == UpstreamPriority::live ? kLiveWeight : kBackfillWeight;
+}
+
+struct HostBucket {
+  double tokens = 0.0;
+  Clock::time_point refilled;
+  std::size_t live_waiting = 0;
+};
+
+struct Governor {
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::map<std::string, HostBucket> hosts;
+  // Read without the mutex on every paced read.
+  std::atomic<unsigned> active_weight{0};
+};
+
+Governor& governor() {
+  static Governor instance;
+  return instance;
+}
+
+Gauge& active_jobs_gauge(UpstreamPriority priority) {
+  return metrics().gauge("radicc_upstream_active_jobs", "Jobs currently sharing the upstream budget.",
+                         std::string("priority=\"") + upstream_priority_name(priority) + "\"");
+}
+
+void observe_wait(const char* kind, UpstreamPriority priority, double seconds) {
+  metrics()
+      .histogram("radicc_upstream_throttle_seconds", "Time upstream traffic was held back by the governor.",
+                 latency_buckets_seconds(),
+                 std::string("kind=\"") + kind + "\",priority=\"" + upstream_priority_name(priority) + "\"")
+      .observe(seconds);
+}
+
+thread_local std::shared_ptr<UpstreamJob> t_upstream_job;
+
+}  // namespace
+
+struct UpstreamJob {
+  explicit UpstreamJob(UpstreamPriority job_priority) : priority(job_priority) {
+    governor().active_weight.fetch_add(weight_of(priority), std::memory_order_relaxed);
+    active_jobs_gauge(priority).add(1);
+  }
+  ~UpstreamJob() {
+    governor().active_weight.fetch_sub(weight_of(priority), std::memory_order_relaxed);
+    active_jobs_gauge(priority).add(-1);
+  }
+  UpstreamJob(const UpstreamJob&) = delete;
+  UpstreamJob& operator=(const UpstreamJob&) = delete;
+
+  const UpstreamPriority priority;
+};
+
+namespace {
+
+UpstreamPriority current_priority() {
+  return t_upstream_job ? t_upstream_job->priority : UpstreamPriority::live;
+}
+
+// `global` split by job weight, capped at `per_job`; both in bytes per
+// second, 0 meaning no limit.
+std::uint64_t bandwidth_share(double global, double per_job) {
+  if (global <= 0.0 && per_job <= 0.0) return 0;
+  double share = 0.0;
+  if (global > 0.0) {
+    const unsigned weight = weight_of(current_priority());
+    unsigned total = governor().active_weight.load(std::memory_order_relaxed);
+    // Traffic outside any job competes as one more live job.
+    if (!t_upstream_job) total += weight;
+    share = global * weight / std::max(total, 1u);
+  }
+  if (per_job > 0.0 && (share <= 0.0 || per_job < share)) share = per_job;
+  return std::max<std::uint64_t>(1, static_cast<std::uint64_t>(share));
+}
+
+}  // namespace
+
+const char* upstream_priority_name(UpstreamPriority priority) {
+  return priority == UpstreamPriority::live ? "live" : "backfill";
+}
+
+UpstreamJobScope::UpstreamJobScope(UpstreamPriority priority)
+    : UpstreamJobScope(std::make_shared<UpstreamJob>(priority)) {}
+
+UpstreamJobScope::UpstreamJobScope(std::shared_ptr<UpstreamJob> job)
+    : previous_(std::exchange(t_upstream_job, std::move(job))) {}
+
+UpstreamJobScope::~UpstreamJobScope() {
+  t_upstream_job = std::move(previous_);
+}
+
+std::shared_ptr<UpstreamJob> current_upstream_job() {
+  return t_upstream_job;
+}
+
+std::string upstream_host(const std::string& url) {
+  const std::size_t scheme = url.find("://");
+  const std::size_t start = scheme == std::string::npos ? 0 : scheme + 3;
+  const std::size_t end = url.find_first_of(":/?#", start);
+  return url.substr(start, end == std::string::npos ? std::string::npos : end - start);
+}
+
+void acquire_upstream_requests(const std::string& url, std::size_t requests) {
+  const double rate = env_number("RADICC_UPSTREAM_RPS", kDefaultRequestsPerSecond);
+  if (rate <= 0.0 || requests == 0) return;
+  const double burst = std::max(1.0, env_number("RADICC_UPSTREAM_BURST", rate * 2));
+  const UpstreamPriority priority = current_priority();
+  const bool live = priority == UpstreamPriority::live;
+  // A batch larger than the burst waits for a full bucket and leaves it in
+  // debt, which holds later requests back by the same amount.
+  const double needed = std::min(static_cast<double>(requests), burst);
+
+  Governor& g = governor();
+  const auto started = Clock::now();
+  std::unique_lock<std::mutex> lock(g.mutex);
+  auto [it, inserted] = g.hosts.try_emplace(upstream_host(url));
+  HostBucket& bucket = it->second;
+  if (inserted) {
+    bucket.tokens = burst;
+    bucket.refilled = started;
+  }
+  if (live) ++bucket.live_waiting;
+  while (true) {
+    const auto now = Clock::now();
+    bucket.tokens = std::min(burst, bucket.tokens + std::chrono::duration<double>(now - bucket.refilled).count() * rate);
+    bucket.refilled = now;
+    if ((live || bucket.live_waiting == 0) && bucket.tokens >= needed) break;
+    // A cancelled caller goes ahead without tokens; its request fails on
+    // the token anyway.
+    if (current_cancellation_expired()) break;
+    const double deficit = std::max(needed - bucket.tokens, 0.0);
+    g.changed.wait_for(lock, std::chrono::duration<double>(std::min(deficit / rate + 0.001, 0.1)));
+  }
+  if (!current_cancellation_expired()) bucket.tokens -= static_cast<double>(requests);
+  if (live) --bucket.live_waiting;
+  lock.unlock();
+  // Backfill waiters recheck once the live queue drains.
+  if (live) g.changed.notify_all();
+
+  const double waited = std::chrono::duration<double>(Clock::now() - started).count();
+  if (waited >= 0.001) observe_wait("requests", priority, waited);
+}
+
+std::uint64_t upstream_bandwidth_share() {
+  return bandwidth_share(env_number("RADICC_UPSTREAM_BANDWIDTH_KB", 0.0) * 1000.0,
+                         env_number("RADICC_UPSTREAM_JOB_BANDWIDTH_KB", 0.0) * 1000.0);
+}
+
+UpstreamPacer::UpstreamPacer()
+    : global_limit_(env_number("RADICC_UPSTREAM_BANDWIDTH_KB", 0.0) * 1000.0),
+      job_limit_(env_number("RADICC_UPSTREAM_JOB_BANDWIDTH_KB", 0.0) * 1000.0) {}
+
+void UpstreamPacer::account(std::uint64_t bytes) {
+  window_bytes_ += bytes;
+  const std::uint64_t rate = bandwidth_share(global_limit_, job_limit_);
+  const auto now = Clock::now();
+  const double elapsed = std::chrono::duration<double>(now - window_start_).count();
+  if (rate == 0) {
+    window_start_ = now;
+    window_bytes_ = 0;
+    return;
+  }
+  const double ahead = static_cast<double>(window_bytes_) / static_cast<double>(rate) - elapsed;
+  if (ahead > 0.0) {
+    if (const auto token = current_cancellation()) {
+      token->wait_for(ahead);
+    } else {
+      std::this_thread::sleep_for(std::chrono::duration<double>(ahead));
+    }
+    observe_wait("bandwidth", current_priority(), ahead);
+  }
+  if (elapsed >= kPacerWindowSeconds) {
+    window_start_ = Clock::now();
+    window_bytes_ = 0;
+  }
+}
+
+}  // namespace radicc
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace radicc {
+
+// Process-wide limits on traffic to radiko and its CDN origins, shared by
+// every recording running in the process.
+//
+// Requests are rate limited per host with a token bucket
+// (RADICC_UPSTREAM_RPS per second, bursts of RADICC_UPSTREAM_BURST; 0
+// disables). Download bandwidth is capped globally by
+// RADICC_UPSTREAM_BANDWIDTH_KB and per job by RADICC_UPSTREAM_JOB_BANDWIDTH_KB
+// (kilobytes per second, 0 = unlimited); the global budget is split across
+// active jobs by weight, live jobs counting four times a backfill job. Live
+// requests waiting on a host are also served before backfill ones.
+
+enum class UpstreamPriority { live, backfill };
+
+const char* upstream_priority_name(UpstreamPriority priority);
+
+struct UpstreamJob;
+
+// Ties the calling thread's upstream traffic to a job for the scope's
+// lifetime. Worker threads join the job of the thread that started them by
+// passing current_upstream_job(). Scopes nest; the previous job is restored.
+class UpstreamJobScope {
+ public:
+  explicit UpstreamJobScope(UpstreamPriority priority);
+  explicit UpstreamJobScope(std::shared_ptr<UpstreamJob> job);
+  ~UpstreamJobScope();
+  UpstreamJobScope(const UpstreamJobScope&) = delete;
+  UpstreamJobScope& operator=(const UpstreamJobScope&) = delete;
+
+ private:
+  std::shared_ptr<UpstreamJob> previous_;
+};
+
+std::shared_ptr<UpstreamJob> current_upstream_job();
+
+// Host part of an http(s) URL, the unit requests are rate limited by.
+std::string upstream_host(const std::string& url);
+
+// Blocks until `requests` more requests to the host of `url` fit its rate.
+void acquire_upstream_requests(const std::string& url, std::size_t requests = 1);
+
+// Bytes per second the calling thread's job may download right now; 0 means
+// unlimited. Re-read before each transfer, as shares move with the job mix.
+std::uint64_t upstream_bandwidth_share();
+
+// Paces a reader that cannot be rate limited at the source (libav's HLS
+// demuxer): account() sleeps whenever the bytes so far run ahead of the
+// job's share. The limits are read once, when the pacer is created.
+class UpstreamPacer {
+ public:
+  UpstreamPacer();
+  void account(std::uint64_t bytes);
+
+ private:
+  double global_limit_;
+  double job_limit_;
+  std::chrono::steady_clock::time_point window_start_ = std::chrono::steady_clock::now();
+  std::uint64_t window_bytes_ = 0;
+};
+
+}  // namespace radicc
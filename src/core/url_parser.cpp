@@ -1,18 +1,24 @@
 #include "core/url_parser.h"
+#include <algorithm>
 #include <optional>
-#include <regex>
 #include <string>
+#include <string_view>
 #include <tuple>
 
 namespace radicc {
 
+// Same result as searching for https://radiko\.jp/#!/ts/([^/]+)/(\d{14}).
 std::optional<std::tuple<std::string, std::array<std::string, 3>>>
 parse_radiko_url(const std::string& url) {
-  std::regex url_pattern(R"(https://radiko\.jp/#!/ts/([^/]+)/(\d{14}))");
-  std::smatch match;
-  if (std::regex_search(url, match, url_pattern) && match.size() == 3) {
-    std::string station_id = match[1].str();
-    std::string datetime = match[2].str();
+  constexpr std::string_view kPrefix = "https://radiko.jp/#!/ts/";
+  for (std::size_t at = url.find(kPrefix); at != std::string::npos; at = url.find(kPrefix, at + 1)) {
+    const std::size_t station_begin = at + kPrefix.size();
+    const std::size_t slash = url.find('/', station_begin);
+    if (slash == std::string::npos || slash == station_begin || url.size() - slash - 1 < 14) continue;
+    const auto digits = url.begin() + static_cast<std::ptrdiff_t>(slash + 1);
+    if (!std::all_of(digits, digits + 14, [](char c) { return c >= '0' && c <= '9'; })) continue;
+    std::string station_id = url.substr(station_begin, slash - station_begin);
+    std::string datetime = url.substr(slash + 1, 14);
     std::array<std::string, 3> dt = { datetime.substr(0, 4), datetime.substr(4, 4), datetime.substr(8) };
     return std::make_tuple(station_id, dt);
   }
@@ -20,4 +26,3 @@ parse_radiko_url(const std::string& url) {
 }
 
 } // namespace radicc
-
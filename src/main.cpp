@@ -2,7 +2,10 @@
 #include "app/common.h"
 #include "app/list_command.h"
 #include "app/record_command.h"
+#include "app/search_command.h"
+#include "app/server_client.h"
 #include "cli/arguments.h"
+#include "utils/log.h"
 
 #include <iostream>
 #include <string>
@@ -10,11 +13,12 @@
 namespace {
 
 int print_missing_subcommand(const std::string& program_name) {
-  std::cerr << "Subcommand is required. Use one of: rec, fetch, list.\n";
+  std::cerr << "Subcommand is required. Use one of: rec, fetch, list, search.\n";
   std::cerr << "Examples:\n";
   std::cerr << "  " << program_name << " rec --url https://radiko.jp/#!/ts/JORF/20260322003000\n";
   std::cerr << "  " << program_name << " fetch -t karin-zatsudan\n";
   std::cerr << "  " << program_name << " list --station-id JORF\n";
+  std::cerr << "  " << program_name << " search オールナイトニッポン\n";
   std::cerr << "Run `" << program_name << " --help` for more information.\n";
   return 1;
 }
@@ -32,7 +36,7 @@ int main(int argc, char* argv[]) {
       show_usage(program_name);
       return 0;
     }
-    if (command != "rec" && command != "fetch" && command != "list") {
+    if (command != "rec" && command != "fetch" && command != "list" && command != "search") {
       std::cerr << "Error: unknown command '" << command << "'.\n";
       std::cerr << "Try --help for usage.\n";
       return 1;
@@ -41,10 +45,15 @@ int main(int argc, char* argv[]) {
     CommandOptions options;
     options.fetch_only = command == "fetch";
     parse_arguments(program_name, command, argc, argv, 2, options);
+    // A running radicc-server answers from its warm caches.
+    if (const auto exit_code = run_on_local_server(command, options)) return *exit_code;
 
     if (command == "list") return run_list_command(options);
+    if (command == "search") return run_search_command(options);
     return run_record_command(options);
   } catch (const RadiccError& error) {
+    // Queued log lines belong before the final error.
+    flush_log();
     std::cerr << "Error: " << error.what() << std::endl;
     return 1;
   }
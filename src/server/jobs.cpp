@@ -0,0 +1,151 @@
+#include "server/jobs.h"
+
+#include <algorithm>
+#include <random>
+
+namespace radicc {
+namespace {
+
+std::string make_job_id() {
+  static constexpr char kHex[] = "0123456789abcdef";
+  std::random_device rd;
+  std::mt19937 gen(rd());
+  std::uniform_int_distribution<int> dist(0, 15);
+  std::string id;
+  id.reserve(16);
+  for (int i = 0; i < 16; ++i) id.push_back(kHex[dist(gen)]);
+  return id;
+}
+
+}  // namespace
+
+const char* job_status_name(JobStatus status) {
+  switch (status) {
+    case JobStatus::recording: return "recording";
+    case JobStatus::done: return "done";
+    case JobStatus::failed: return "failed";
+    case JobStatus::cancelled: return "cancelled";
+  }
+  return "unknown";
+}
+
+void Job::set_output(const std::string& path, const std::string& name) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    absolute_path = path;
+    filename = name;
+  }
+  changed.notify_all();
+}
+
+void Job::set_partial(const std::string& path) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    partial_path = path;
+  }
+  changed.notify_all();
+}
+
+void Job::commit(std::uint64_t bytes) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (bytes < committed_bytes) ++generation;
+    committed_bytes = bytes;
+  }
+  changed.notify_all();
+}
+
+void Job::complete(const std::string& json) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    status = JobStatus::done;
+    partial_path.clear();
+    result_json = json;
+    http_status = 200;
+  }
+  changed.notify_all();
+}
+
+void Job::fail(const std::string& message, int status_code) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    status = JobStatus::failed;
+    partial_path.clear();
+    error = message;
+    http_status = status_code;
+  }
+  changed.notify_all();
+}
+
+void Job::finish_cancelled(const std::string& message) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    status = JobStatus::cancelled;
+    partial_path.clear();
+    error = message;
+    http_status = 409;
+  }
+  changed.notify_all();
+}
+
+std::shared_ptr<Job> JobRegistry::create(const std::string& key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return create_locked(key);
+}
+
+std::shared_ptr<Job> JobRegistry::attach_or_create(const std::string& key, bool& created) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& job : jobs_) {
+    if (job->key != key) continue;
+    std::lock_guard<std::mutex> job_lock(job->mutex);
+    if (job->status != JobStatus::recording) continue;
+    ++job->requests;
+    created = false;
+    return job;
+  }
+  created = true;
+  return create_locked(key);
+}
+
+std::shared_ptr<Job> JobRegistry::claim_output(const std::shared_ptr<Job>& job, const std::string& path,
+                                               const std::string& filename) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& other : jobs_) {
+    if (other == job) continue;
+    std::lock_guard<std::mutex> other_lock(other->mutex);
+    if (other->status == JobStatus::recording && other->absolute_path == path) return other;
+  }
+  job->set_output(path, filename);
+  return nullptr;
+}
+
+std::shared_ptr<Job> JobRegistry::create_locked(const std::string& key) {
+  auto job = std::make_shared<Job>();
+  job->id = make_job_id();
+  job->key = key;
+  jobs_.push_back(job);
+  while (jobs_.size() > capacity_) {
+    const auto finished = std::find_if(jobs_.begin(), jobs_.end(), [](const std::shared_ptr<Job>& entry) {
+      std::lock_guard<std::mutex> job_lock(entry->mutex);
+      return entry->status != JobStatus::recording;
+    });
+    if (finished == jobs_.end()) break;
+    jobs_.erase(finished);
+  }
+  return job;
+}
+
+std::shared_ptr<Job> JobRegistry::find(const std::string& id) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& job : jobs_) {
+    if (job->id == id) return job;
+  }
+  return nullptr;
+}
+
+std::vector<std::shared_ptr<Job>> JobRegistry::list() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return jobs_;
+}
+
+}  // namespace radicc
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "core/record_progress.h"
+#include "utils/cancellation.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace radicc {
+
+enum class JobStatus { recording, done, failed, cancelled };
+
+const char* job_status_name(JobStatus status);
+
+// One POST /record. Fields are guarded by `mutex`; `changed` is notified on
+// every update so live-tail readers can wait for new output.
+struct Job {
+  std::string id;
+  std::string key;  // identical requests share the job while it is unfinished
+  mutable std::mutex mutex;
+  std::condition_variable changed;
+  JobStatus status = JobStatus::recording;
+  std::string absolute_path;  // empty until the output path is resolved
+  std::string filename;
+  // Hidden file the recorder writes until it renames it to absolute_path;
+  // empty once the job finishes.
+  std::string partial_path;
+  std::uint64_t committed_bytes = 0;
+  // Bumped when the recorder restarts the output file, which invalidates
+  // anything a reader has already streamed.
+  std::uint64_t generation = 0;
+  std::string result_json;  // response body once done
+  std::string error;
+  int http_status = 0;   // set when the job finishes
+  int requests = 1;      // POST /record calls attached to this job
+  // Lock-free; read without holding `mutex`.
+  RecordProgress progress;
+  // Cancelled by DELETE /jobs/{id}; the recording stops at its next check.
+  std::shared_ptr<CancellationToken> cancellation = std::make_shared<CancellationToken>();
+
+  void set_output(const std::string& path, const std::string& name);
+  void set_partial(const std::string& path);
+  void commit(std::uint64_t bytes);
+  void complete(const std::string& json);
+  void fail(const std::string& message, int status);
+  void finish_cancelled(const std::string& message);
+};
+
+// Keeps recent jobs addressable by id; the oldest finished jobs are dropped
+// once more than `capacity` are held.
+class JobRegistry {
+ public:
+  explicit JobRegistry(std::size_t capacity = 32) : capacity_(capacity) {}
+
+  std::shared_ptr<Job> create(const std::string& key = std::string());
+  // Attaches to the unfinished job registered under `key`, or creates one.
+  std::shared_ptr<Job> attach_or_create(const std::string& key, bool& created);
+  std::shared_ptr<Job> find(const std::string& id) const;
+  // Assigns `path` to `job` unless another unfinished job already writes
+  // there; returns that job in that case.
+  std::shared_ptr<Job> claim_output(const std::shared_ptr<Job>& job, const std::string& path,
+                                    const std::string& filename);
+  std::vector<std::shared_ptr<Job>> list() const;
+
+ private:
+  std::shared_ptr<Job> create_locked(const std::string& key);
+
+  std::size_t capacity_;
+  mutable std::mutex mutex_;
+  std::vector<std::shared_ptr<Job>> jobs_;  // oldest first
+};
+
+}  // namespace radicc
@@ -1,23 +1,42 @@
 #include "app/common.h"
 #include "app/command_options.h"
+#include "app/list_command.h"
+#include "app/search_command.h"
+#include "core/config_snapshot.h"
+#include "core/url_parser.h"
+#include "server/jobs.h"
 #include "service/record_service.h"
+#include "utils/json.h"
+#include "utils/local_socket.h"
+#include "utils/log.h"
+#include "utils/metrics.h"
+#include "utils/runtime_settings.h"
+#include "utils/trace.h"
 
 #include <arpa/inet.h>
 #include <fcntl.h>
 #include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cerrno>
+#include <chrono>
 #include <csignal>
+#include <cstdlib>
 #include <cstring>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <memory>
 #include <mutex>
 #include <optional>
-#include <random>
-#include <regex>
 #include <sstream>
 #include <string>
 #include <thread>
@@ -26,14 +45,14 @@
 namespace radicc {
 namespace {
 
-struct DownloadEntry {
-  std::string absolute_path;
-  std::string filename;
-};
+JobRegistry g_jobs;
+std::string g_trace_path;
 
-std::mutex g_downloads_mutex;
-std::string g_current_job_id;
-std::optional<DownloadEntry> g_current_download;
+Counter& download_bytes_counter() {
+  static Counter& counter =
+      metrics().counter("radicc_server_download_bytes_total", "Recording bytes sent by /download and /jobs/{id}/stream.");
+  return counter;
+}
 
 std::string url_decode(const std::string& value) {
   std::string decoded;
@@ -68,38 +87,14 @@ std::unordered_map<std::string, std::string> parse_query(const std::string& quer
   return values;
 }
 
-std::optional<std::string> extract_json_string(const std::string& body, const std::string& key) {
-  const std::regex pattern("\"" + key + R"(\"\s*:\s*\"([^\"]*)\")");
-  std::smatch match;
-  if (!std::regex_search(body, match, pattern) || match.size() < 2) return std::nullopt;
-  return match[1].str();
-}
-
-std::optional<int> extract_json_int(const std::string& body, const std::string& key) {
-  const std::regex pattern("\"" + key + R"(\"\s*:\s*(-?\d+))");
-  std::smatch match;
-  if (!std::regex_search(body, match, pattern) || match.size() < 2) return std::nullopt;
-  return std::stoi(match[1].str());
-}
-
-std::string make_job_id() {
-  static constexpr char kHex[] = "0123456789abcdef";
-  std::random_device rd;
-  std::mt19937 gen(rd());
-  std::uniform_int_distribution<int> dist(0, 15);
-  std::string id;
-  id.reserve(16);
-  for (int i = 0; i < 16; ++i) id.push_back(kHex[dist(gen)]);
-  return id;
-}
-
-void send_all(int fd, const std::string& data) {
+bool send_all(int fd, const std::string& data) {
   std::size_t sent = 0;
   while (sent < data.size()) {
     const ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, 0);
-    if (n <= 0) return;
+    if (n <= 0) return false;
     sent += static_cast<std::size_t>(n);
   }
+  return true;
 }
 
 void send_response(int fd, int status, const std::string& status_text, const std::string& content_type, const std::string& body, const std::string& extra_headers = {}) {
@@ -117,87 +112,486 @@ void send_json(int fd, int status, const std::string& status_text, const std::st
   send_response(fd, status, status_text, "application/json; charset=utf-8", json);
 }
 
-void send_file(int fd, const DownloadEntry& entry) {
-  std::ifstream file(entry.absolute_path, std::ios::binary);
+const char* status_text(int status) {
+  switch (status) {
+    case 200: return "OK";
+    case 202: return "Accepted";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 409: return "Conflict";
+    case 412: return "Precondition Failed";
+    case 415: return "Unsupported Media Type";
+    case 504: return "Gateway Timeout";
+    default: return "Internal Server Error";
+  }
+}
+
+void send_json_error(int fd, int status, std::string_view message) {
+  JsonWriter json;
+  json.begin_object().member("error", message).end_object();
+  send_json(fd, status, status_text(status), json.str());
+}
+
+void send_file(int fd, const std::string& absolute_path, const std::string& filename) {
+  std::ifstream file(absolute_path, std::ios::binary);
   if (!file.is_open()) {
-    send_json(fd, 404, "Not Found", "{\"error\":\"file not found\"}");
+    send_json_error(fd, 404, "file not found");
     return;
   }
   std::ostringstream buffer;
   buffer << file.rdbuf();
   const std::string body = buffer.str();
-  const std::string headers = "Content-Disposition: attachment; filename=\"" + entry.filename + "\"\r\n";
+  const std::string headers = "Content-Disposition: attachment; filename=\"" + filename + "\"\r\n";
   send_response(fd, 200, "OK", "audio/mp4", body, headers);
+  download_bytes_counter().add(body.size());
+}
+
+std::string build_metrics_text() {
+  std::int64_t active = 0;
+  std::int64_t queued = 0;
+  for (const auto& job : g_jobs.list()) {
+    std::lock_guard<std::mutex> lock(job->mutex);
+    if (job->status != JobStatus::recording) continue;
+    ++active;
+    const auto phase = static_cast<RecordPhase>(job->progress.phase.load(std::memory_order_relaxed));
+    if (phase != RecordPhase::recording) ++queued;
+  }
+  metrics().gauge("radicc_server_active_jobs", "Jobs that have not finished yet.").set(active);
+  metrics()
+      .gauge("radicc_server_queue_depth", "Unfinished jobs that have not started fetching audio yet.")
+      .set(queued);
+  return metrics().render_prometheus();
 }
 
 std::string build_help_json() {
-  return "{"
-         "\"endpoints\":["
-         "\"GET /health\","
-         "\"POST /record (application/json: {\\\"url\\\":\\\"https://radiko.jp/#!/ts/JORF/20260322003000\\\",\\\"date_offset\\\":1})\","
-         "\"GET /download/{job_id}\""
-         "]"
-         "}";
+  JsonWriter json;
+  json.begin_object().key("endpoints").begin_array();
+  for (const char* endpoint : {
+           "GET /health",
+           "GET /metrics",
+           "GET /search?q={query}&station={station_id}&limit=20",
+           "POST /record (application/json: {\"url\":\"https://radiko.jp/#!/ts/JORF/20260322003000\",\"date_offset\":1,"
+           "\"fragmented\":false,\"fragment_duration\":10,\"faststart\":false,\"async\":false})",
+           "GET /jobs/{job_id}",
+           "GET /jobs/{job_id}/stream",
+           "GET /jobs/{job_id}/events",
+           "DELETE /jobs/{job_id}",
+           "GET /download/{job_id}",
+           "POST /cli (application/x-www-form-urlencoded; local socket only, used by radicc)",
+       }) {
+    json.value(endpoint);
+  }
+  json.end_array().end_object();
+  return json.take();
+}
+
+// The job object of /record (async), /jobs/{id} and the final /events event.
+std::string build_job_json(const Job& job) {
+  JsonWriter json;
+  json.begin_object()
+      .member("job_id", job.id)
+      .member("status", job_status_name(job.status))
+      .member("stream_url", "/jobs/" + job.id + "/stream")
+      .member("download_url", "/download/" + job.id)
+      .member("filepath", job.absolute_path)
+      .member("output_file", job.filename)
+      .member("committed_bytes", job.committed_bytes)
+      .member("requests", job.requests)
+      .key("progress");
+  write_record_progress_json(json, snapshot_record_progress(job.progress));
+  if (job.status == JobStatus::failed || job.status == JobStatus::cancelled) json.member("error", job.error);
+  json.end_object();
+  return json.take();
+}
+
+// Requests for the same airing with the same output settings share a job.
+std::string build_job_key(const CommandOptions& options) {
+  std::string station = options.url;
+  std::string start;
+  if (const auto parsed = parse_radiko_url(options.url)) {
+    const auto& [station_id, datetime] = *parsed;
+    station = station_id;
+    start = datetime[0] + datetime[1] + datetime[2];
+  }
+  std::ostringstream key;
+  key << station << '|' << start << '|' << options.duration << '|' << options.output << '|'
+      << (options.date_offset_set ? std::to_string(options.date_offset) : std::string("-")) << '|'
+      << (options.fragmented ? "fragmented:" + std::to_string(options.fragment_seconds) : std::string("plain"))
+      << (options.faststart ? "+faststart" : "");
+  return key.str();
+}
+
+std::string build_record_done_json(const std::string& job_id, const RecordExecutionResult& result) {
+  JsonWriter json;
+  json.begin_object().member("status", "done").member("job_id", job_id).member("download_url", "/download/" + job_id);
+  write_record_output_members(json, result);
+  json.end_object();
+  return json.take();
+}
+
+// Runs one recording to completion, keeping `job` updated so status and
+// live-tail readers can follow it. `render` builds the job's response body
+// from the result (the /record JSON by default); `settings` defaults to the
+// current snapshot. Returns the HTTP status for the outcome.
+int run_record_job(const std::shared_ptr<Job>& job, const CommandOptions& options,
+                   std::shared_ptr<const RuntimeSettings> settings = nullptr,
+                   const std::function<std::string(const RecordExecutionResult&)>& render = nullptr) {
+  RecordObserver observer;
+  observer.on_resolved = [job](const RecordExecutionResult& result) {
+    // Different request bodies can still resolve to the same file; never
+    // let two jobs write it at once.
+    const auto other = g_jobs.claim_output(job, result.paths.absolute_path, result.paths.filename);
+    if (other) {
+      print_error_and_exit("Output " + result.paths.absolute_path + " is already being recorded by job " + other->id + ".");
+    }
+  };
+  observer.on_output_opened = [job](const std::string& path) { job->set_partial(path); };
+  observer.on_output_committed = [job](std::uint64_t bytes) { job->commit(bytes); };
+  observer.progress = &job->progress;
+  observer.cancellation = job->cancellation;
+  // Rewrites the trace file with every span so far once the job ends.
+  struct TraceFlush {
+    ~TraceFlush() {
+      if (!g_trace_path.empty() && !write_trace(g_trace_path)) {
+        RADICC_LOG_ERROR << "Failed to write trace file: " << g_trace_path;
+      }
+    }
+  } trace_flush;
+  TraceSpan span("record_job", job->id);
+  LogContextScope log_scope({job->id, std::string(), std::string()});
+  try {
+    RADICC_LOG_INFO << "record request started: job=" << job->id << ", url=" << options.url;
+    const auto result =
+        execute_record_request(options, observer, settings ? std::move(settings) : current_runtime_settings());
+    RADICC_LOG_INFO << "record request completed: station=" << result.resolved.station_id
+                    << ", start=" << result.start_time;
+    job->set_output(result.paths.absolute_path, result.paths.filename);
+    job->complete(render ? render(result) : build_record_done_json(job->id, result));
+    return 200;
+  } catch (const RadiccError& error) {
+    set_record_phase(job->progress, RecordPhase::failed);
+    if (job->cancellation->cancelled()) {
+      RADICC_LOG_INFO << "record request cancelled: job=" << job->id;
+      job->finish_cancelled(error.what());
+      return 409;
+    }
+    if (job->cancellation->deadline_exceeded()) {
+      RADICC_LOG_WARN << "record request timed out: job=" << job->id;
+      job->fail(error.what(), 504);
+      return 504;
+    }
+    RADICC_LOG_WARN << "record request rejected: " << error.what();
+    job->fail(error.what(), 400);
+    return 400;
+  } catch (const std::exception& error) {
+    RADICC_LOG_ERROR << "record request failed: " << error.what();
+    set_record_phase(job->progress, RecordPhase::failed);
+    job->fail(error.what(), 500);
+    return 500;
+  } catch (...) {
+    RADICC_LOG_ERROR << "record request failed: unknown exception";
+    set_record_phase(job->progress, RecordPhase::failed);
+    job->fail("unknown server error", 500);
+    return 500;
+  }
 }
 
 void handle_record(int fd, const std::string& body) {
-  const auto url = extract_json_string(body, "url");
+  const auto request = parse_json_object(body);
+  if (!request) {
+    send_json_error(fd, 400, "request body must be a JSON object");
+    return;
+  }
+  const auto url = request->get_string("url");
   if (!url || url->empty()) {
-    send_json(fd, 400, "Bad Request", "{\"error\":\"url is required\"}");
+    send_json_error(fd, 400, "url is required");
     return;
   }
 
   CommandOptions options;
   options.url = *url;
 
-  const auto date_offset = extract_json_int(body, "date_offset");
-  if (date_offset.has_value()) {
+  if (request->find("date_offset")) {
+    const auto date_offset = request->get_integer("date_offset");
+    if (!date_offset || *date_offset < 0 || *date_offset > std::numeric_limits<int>::max()) {
+      send_json_error(fd, 400, "date_offset must be a non-negative integer");
+      return;
+    }
+    options.date_offset = static_cast<int>(*date_offset);
+    options.date_offset_set = true;
+  }
+
+  options.fragmented = request->get_bool("fragmented").value_or(false);
+  options.faststart = request->get_bool("faststart").value_or(false);
+  if (request->find("fragment_duration")) {
+    const auto fragment_duration = request->get_integer("fragment_duration");
+    if (!fragment_duration || *fragment_duration <= 0 || *fragment_duration > std::numeric_limits<int>::max()) {
+      send_json_error(fd, 400, "fragment_duration must be a positive integer");
+      return;
+    }
+    options.fragment_seconds = static_cast<int>(*fragment_duration);
+  }
+
+  const auto priority = request->get_string("priority");
+  if (request->find("priority") && (!priority || (*priority != "live" && *priority != "backfill"))) {
+    send_json_error(fd, 400, "priority must be live or backfill");
+    return;
+  }
+  options.backfill = priority && *priority == "backfill";
+
+  bool created = false;
+  const auto job = g_jobs.attach_or_create(build_job_key(options), created);
+  if (!created) RADICC_LOG_INFO << "record request attached to running job " << job->id;
+  if (request->get_bool("async").value_or(false)) {
+    std::unique_lock<std::mutex> lock(job->mutex);
+    const std::string json = build_job_json(*job);
+    lock.unlock();
+    if (created) std::thread([job, options]() { run_record_job(job, options); }).detach();
+    send_json(fd, 202, "Accepted", json);
+    return;
+  }
+  if (created) run_record_job(job, options);
+  std::unique_lock<std::mutex> lock(job->mutex);
+  job->changed.wait(lock, [&]() { return job->status != JobStatus::recording; });
+  const int status = job->http_status;
+  const bool done = job->status == JobStatus::done;
+  const std::string output = done ? job->result_json : job->error;
+  lock.unlock();
+  if (done) {
+    send_json(fd, status, status_text(status), output);
+  } else {
+    send_json_error(fd, status, output);
+  }
+}
+
+// Cancels `token` when the peer on `fd` goes away, e.g. a thin client
+// interrupted with Ctrl-C, so its recording stops as it would standalone.
+// The peer sends nothing after its request, so readable means closed.
+class PeerDisconnectWatch {
+ public:
+  PeerDisconnectWatch(int fd, std::shared_ptr<CancellationToken> token)
+      : thread_([this, fd, token = std::move(token)]() {
+          pollfd peer{fd, POLLIN | POLLRDHUP, 0};
+          while (!stopped_.load(std::memory_order_acquire)) {
+            if (::poll(&peer, 1, 250) <= 0) continue;
+            char byte;
+            if ((peer.revents & (POLLHUP | POLLRDHUP | POLLERR))
+                || ::recv(fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT) == 0) {
+              token->cancel("client disconnected");
+              return;
+            }
+            // Stray bytes from the peer are not ours to act on.
+            ::recv(fd, &byte, 1, MSG_DONTWAIT);
+          }
+        }) {}
+  ~PeerDisconnectWatch() {
+    stopped_.store(true, std::memory_order_release);
+    thread_.join();
+  }
+  PeerDisconnectWatch(const PeerDisconnectWatch&) = delete;
+  PeerDisconnectWatch& operator=(const PeerDisconnectWatch&) = delete;
+
+ private:
+  std::atomic<bool> stopped_{false};
+  std::thread thread_;
+};
+
+// POST /cli: the thin-client mode of `radicc` (see app/server_client.h). The
+// form carries the options the client parsed; the response body is exactly
+// what the command prints, or the error message when it fails. A forwarded
+// fetch/rec is cancelled if the client disconnects before it finishes.
+void handle_cli(int fd, const std::string& body) {
+  constexpr const char* kTextPlain = "text/plain; charset=utf-8";
+  auto form = parse_query(body);
+  const std::string command = form["command"];
+  if (command != "list" && command != "search" && command != "fetch" && command != "rec") {
+    send_response(fd, 400, "Bad Request", kTextPlain, "unknown command '" + command + "'");
+    return;
+  }
+  // The client's env files and environment would be ignored here, so a
+  // client whose settings differ runs the command itself instead.
+  if (form["settings"] != current_runtime_settings()->fingerprint()) {
+    send_response(fd, 412, status_text(412), kTextPlain, "client settings differ from the server's");
+    return;
+  }
+  const auto number = [&](const char* key, int fallback) {
+    const auto it = form.find(key);
+    return it == form.end() || it->second.empty() ? fallback : std::atoi(it->second.c_str());
+  };
+
+  CommandOptions options;
+  options.target = form["target"];
+  options.id = form["id"];
+  options.url = form["url"];
+  options.station_id = form["station_id"];
+  options.date = form["date"];
+  options.output = form["output"];
+  options.weekday = form["weekday"];
+  options.personality = form["personality"];
+  options.query = form["query"];
+  options.limit = number("limit", options.limit);
+  options.json_output = form["json"] == "1";
+  options.fetch_only = command == "fetch";
+  options.date_offset_set = form.count("date_offset") > 0;
+  options.date_offset = number("date_offset", 0);
+  options.fragmented = form["fragmented"] == "1";
+  options.fragment_seconds = number("fragment_duration", options.fragment_seconds);
+  options.faststart = form["faststart"] == "1";
+  options.backfill = form["backfill"] == "1";
+  options.duration = number("duration", 0);
+
+  if (command == "list" || command == "search") {
+    std::ostringstream out;
     try {
-      options.date_offset = *date_offset;
-      if (options.date_offset < 0) throw std::invalid_argument("negative");
-      options.date_offset_set = true;
-    } catch (const std::exception&) {
-      send_json(fd, 400, "Bad Request", "{\"error\":\"date_offset must be a non-negative integer\"}");
+      if (command == "list") {
+        run_list_command(options, out);
+      } else {
+        run_search_command(options, out);
+      }
+    } catch (const RadiccError& error) {
+      send_response(fd, 400, "Bad Request", kTextPlain, error.what());
+      return;
+    } catch (const std::exception& error) {
+      RADICC_LOG_ERROR << "cli " << command << " failed: " << error.what();
+      send_response(fd, 500, "Internal Server Error", kTextPlain, error.what());
       return;
     }
+    send_response(fd, 200, "OK", kTextPlain, out.str());
+    return;
   }
 
-  try {
-    std::cerr << "record request started: url=" << *url << std::endl;
-    const auto result = execute_record_request(options);
-    std::cerr << "record request completed: station=" << result.resolved.station_id
-              << ", start=" << result.start_time << std::endl;
-    const std::string job_id = make_job_id();
-    {
-      std::lock_guard<std::mutex> lock(g_downloads_mutex);
-      g_current_job_id = job_id;
-      g_current_download = DownloadEntry{result.paths.absolute_path, result.paths.filename};
+  // A relative RADICC_DIR ("./" when unset) means the client's working
+  // directory, as it would standalone.
+  auto settings = current_runtime_settings();
+  const std::string cwd = form["cwd"];
+  if (!cwd.empty() && cwd.front() == '/' && settings->output_dir.front() != '/') {
+    auto rebased = std::make_shared<RuntimeSettings>(*settings);
+    rebased->output_dir = settings->output_dir == "./" ? cwd + "/" : cwd + "/" + settings->output_dir;
+    settings = std::move(rebased);
+  }
+  const auto job = g_jobs.create();
+  int status = 0;
+  {
+    PeerDisconnectWatch watch(fd, job->cancellation);
+    status = run_record_job(job, options, std::move(settings), [options](const RecordExecutionResult& result) {
+      return options.json_output ? build_record_result_json(options, result) + "\n"
+                                 : build_record_result_text(options, result);
+    });
+  }
+  std::unique_lock<std::mutex> lock(job->mutex);
+  const std::string output = job->status == JobStatus::done ? job->result_json : job->error;
+  lock.unlock();
+  send_response(fd, status, status_text(status), kTextPlain, output);
+}
+
+// Sends the output of a job as it grows, one HTTP chunk per committed range.
+// The stream ends cleanly once the job is done; if the job fails or its
+// output restarts, the connection is dropped without the final chunk so the
+// client can tell the download is incomplete.
+void handle_job_stream(int fd, const std::shared_ptr<Job>& job) {
+  std::unique_lock<std::mutex> lock(job->mutex);
+  job->changed.wait(lock, [&]() { return !job->absolute_path.empty() || job->status != JobStatus::recording; });
+  if (job->absolute_path.empty()) {
+    const std::string error = job->error;
+    lock.unlock();
+    send_json_error(fd, 409, error);
+    return;
+  }
+  const std::string path = job->absolute_path;
+  const std::uint64_t generation = job->generation;
+  const std::string headers =
+      "HTTP/1.1 200 OK\r\n"
+      "Content-Type: audio/mp4\r\n"
+      "Transfer-Encoding: chunked\r\n"
+      "Content-Disposition: attachment; filename=\"" + job->filename + "\"\r\n"
+      "Connection: close\r\n\r\n";
+  lock.unlock();
+  if (!send_all(fd, headers)) return;
+
+  std::uint64_t sent = 0;
+  std::vector<char> buffer(256 * 1024);
+  // Opened once: an open partial file keeps its contents across the rename
+  // that finalizes it, so the reader never has to switch paths.
+  std::ifstream file;
+  while (true) {
+    lock.lock();
+    job->changed.wait(lock, [&]() {
+      return job->committed_bytes > sent || job->status != JobStatus::recording || job->generation != generation;
+    });
+    if (job->generation != generation || job->status == JobStatus::failed || job->status == JobStatus::cancelled) return;
+    const std::uint64_t target = job->committed_bytes;
+    const bool finished = job->status == JobStatus::done;
+    const std::string partial_path = job->partial_path;
+    lock.unlock();
+
+    if (!file.is_open() && target > sent) {
+      if (!partial_path.empty()) file.open(partial_path, std::ios::binary);
+      // The partial file may have been renamed in the meantime.
+      if (!file.is_open()) file.open(path, std::ios::binary);
+      if (!file.is_open()) return;
     }
+    file.clear();
+    file.seekg(static_cast<std::streamoff>(sent));
+    while (sent < target) {
+      const std::size_t want = static_cast<std::size_t>(std::min<std::uint64_t>(target - sent, buffer.size()));
+      file.read(buffer.data(), static_cast<std::streamsize>(want));
+      const std::size_t got = static_cast<std::size_t>(file.gcount());
+      if (got == 0) return;
+      std::ostringstream chunk;
+      chunk << std::hex << got << "\r\n";
+      chunk.write(buffer.data(), static_cast<std::streamsize>(got));
+      chunk << "\r\n";
+      if (!send_all(fd, chunk.str())) return;
+      download_bytes_counter().add(got);
+      sent += got;
+    }
+    if (finished) {
+      send_all(fd, "0\r\n\r\n");
+      return;
+    }
+  }
+}
 
-    const std::string json = "{"
-        "\"status\":\"done\","
-        "\"job_id\":\"" + json_escape(job_id) + "\","
-        "\"download_url\":\"/download/" + json_escape(job_id) + "\","
-        "\"filepath\":\"" + json_escape(result.paths.absolute_path) + "\","
-        "\"output_file\":\"" + json_escape(result.paths.filename) + "\","
-        "\"title\":\"" + json_escape(result.resolved.title) + "\","
-        "\"start_time\":\"" + json_escape(result.start_time) + "\","
-        "\"end_time\":\"" + json_escape(result.end_time) + "\""
-        "}";
-    send_json(fd, 200, "OK", json);
-  } catch (const RadiccError& error) {
-    std::cerr << "record request rejected: " << error.what() << std::endl;
-    send_json(fd, 400, "Bad Request", std::string("{\"error\":\"") + json_escape(error.what()) + "\"}");
-  } catch (const std::exception& error) {
-    std::cerr << "record request failed: " << error.what() << std::endl;
-    send_json(fd, 500, "Internal Server Error", std::string("{\"error\":\"") + json_escape(error.what()) + "\"}");
-  } catch (...) {
-    std::cerr << "record request failed: unknown exception" << std::endl;
-    send_json(fd, 500, "Internal Server Error", "{\"error\":\"unknown server error\"}");
+// Server-Sent Events: a `progress` event whenever the counters change
+// (polled once a second), then a final `done` or `failed` event carrying the
+// job status.
+void handle_job_events(int fd, const std::shared_ptr<Job>& job) {
+  if (!send_all(fd,
+                "HTTP/1.1 200 OK\r\n"
+                "Content-Type: text/event-stream\r\n"
+                "Cache-Control: no-cache\r\n"
+                "Connection: close\r\n\r\n")) {
+    return;
+  }
+  std::string last_progress;
+  int idle_ticks = 0;
+  while (true) {
+    const std::string progress = record_progress_json(snapshot_record_progress(job->progress));
+    if (progress != last_progress) {
+      if (!send_all(fd, "event: progress\ndata: " + progress + "\n\n")) return;
+      last_progress = progress;
+      idle_ticks = 0;
+    } else if (++idle_ticks >= 15) {
+      if (!send_all(fd, ": keepalive\n\n")) return;
+      idle_ticks = 0;
+    }
+
+    std::unique_lock<std::mutex> lock(job->mutex);
+    job->changed.wait_for(lock, std::chrono::seconds(1), [&]() { return job->status != JobStatus::recording; });
+    if (job->status != JobStatus::recording) {
+      const std::string event =
+          std::string("event: ") + job_status_name(job->status) + "\ndata: " + build_job_json(*job) + "\n\n";
+      lock.unlock();
+      send_all(fd, event);
+      return;
+    }
   }
 }
 
-void handle_client(int fd) {
+// `local` is true for connections on the Unix socket; only those may use
+// /cli, which writes wherever the client asks.
+void handle_client(int fd, bool local) {
   char buffer[8192];
   const ssize_t n = ::recv(fd, buffer, sizeof(buffer) - 1, 0);
   if (n <= 0) return;
@@ -206,7 +600,16 @@ void handle_client(int fd) {
   const std::string raw_request(buffer, static_cast<std::size_t>(n));
   const std::size_t header_end = raw_request.find("\r\n\r\n");
   const std::string headers = header_end == std::string::npos ? raw_request : raw_request.substr(0, header_end);
-  const std::string body = header_end == std::string::npos ? std::string() : raw_request.substr(header_end + 4);
+  std::string body = header_end == std::string::npos ? std::string() : raw_request.substr(header_end + 4);
+  // The body can arrive after the headers.
+  if (const std::size_t length_pos = headers.find("Content-Length: "); length_pos != std::string::npos) {
+    const std::size_t length = std::min<std::size_t>(std::strtoul(headers.c_str() + length_pos + 16, nullptr, 10), 1 << 20);
+    while (body.size() < length) {
+      const ssize_t more = ::recv(fd, buffer, sizeof(buffer), 0);
+      if (more <= 0) break;
+      body.append(buffer, static_cast<std::size_t>(more));
+    }
+  }
 
   std::istringstream request(headers);
   std::string method;
@@ -221,40 +624,159 @@ void handle_client(int fd) {
     send_json(fd, 200, "OK", build_help_json());
     return;
   }
+  if (method == "GET" && path == "/metrics") {
+    send_response(fd, 200, "OK", "text/plain; version=0.0.4; charset=utf-8", build_metrics_text());
+    return;
+  }
   if (method == "GET" && path == "/health") {
     send_json(fd, 200, "OK", "{\"status\":\"ok\"}");
     return;
   }
   if (path == "/record") {
     if (method != "POST") {
-      send_json(fd, 405, "Method Not Allowed", "{\"error\":\"POST only\"}");
+      send_json_error(fd, 405, "POST only");
       return;
     }
     if (headers.find("Content-Type: application/json") == std::string::npos
         && headers.find("Content-Type: application/json;") == std::string::npos) {
-      send_json(fd, 415, "Unsupported Media Type", "{\"error\":\"application/json is required\"}");
+      send_json_error(fd, 415, "application/json is required");
       return;
     }
     handle_record(fd, body);
     return;
   }
+  if (method == "GET" && path == "/search") {
+    auto query = parse_query(query_pos == std::string::npos ? std::string() : target.substr(query_pos + 1));
+    if (query["q"].empty()) {
+      send_json_error(fd, 400, "q is required");
+      return;
+    }
+    const int limit = query["limit"].empty() ? 20 : std::atoi(query["limit"].c_str());
+    if (limit <= 0) {
+      send_json_error(fd, 400, "limit must be a positive integer");
+      return;
+    }
+    refresh_program_search_index();
+    const auto hits = program_search_index().search(query["q"], static_cast<std::size_t>(limit), query["station"]);
+    // Written straight to the socket; closing the connection ends the body.
+    if (!send_all(fd, "HTTP/1.1 200 OK\r\nContent-Type: application/json; charset=utf-8\r\nConnection: close\r\n\r\n")) {
+      return;
+    }
+    JsonWriter json(fd);
+    write_search_results_json(json, hits);
+    json.flush();
+    return;
+  }
+  if (path == "/cli") {
+    if (!local) {
+      send_json_error(fd, 404, "not found");
+      return;
+    }
+    if (method != "POST") {
+      send_json_error(fd, 405, "POST only");
+      return;
+    }
+    handle_cli(fd, body);
+    return;
+  }
   if (method == "GET" && path.rfind("/download/", 0) == 0) {
-    const std::string job_id = path.substr(std::string("/download/").size());
-    std::lock_guard<std::mutex> lock(g_downloads_mutex);
-    if (!g_current_download || job_id != g_current_job_id) {
-      send_json(fd, 404, "Not Found", "{\"error\":\"unknown job id\"}");
+    const auto job = g_jobs.find(path.substr(std::string("/download/").size()));
+    if (!job) {
+      send_json_error(fd, 404, "unknown job id");
       return;
     }
-    send_file(fd, *g_current_download);
+    std::unique_lock<std::mutex> lock(job->mutex);
+    if (job->status != JobStatus::done) {
+      lock.unlock();
+      send_json_error(fd, 409, "job is not done");
+      return;
+    }
+    const std::string absolute_path = job->absolute_path;
+    const std::string filename = job->filename;
+    lock.unlock();
+    send_file(fd, absolute_path, filename);
+    return;
+  }
+  if (method == "GET" && path.rfind("/jobs/", 0) == 0) {
+    std::string job_id = path.substr(std::string("/jobs/").size());
+    const std::size_t slash = job_id.find('/');
+    const std::string action = slash == std::string::npos ? std::string() : job_id.substr(slash + 1);
+    if (slash != std::string::npos) job_id.resize(slash);
+    const auto job = g_jobs.find(job_id);
+    if (!job || (!action.empty() && action != "stream" && action != "events")) {
+      send_json_error(fd, 404, "unknown job id");
+      return;
+    }
+    if (action == "stream") {
+      handle_job_stream(fd, job);
+      return;
+    }
+    if (action == "events") {
+      handle_job_events(fd, job);
+      return;
+    }
+    std::unique_lock<std::mutex> lock(job->mutex);
+    const std::string json = build_job_json(*job);
+    lock.unlock();
+    send_json(fd, 200, "OK", json);
     return;
   }
 
-  if (method != "GET" && method != "POST") {
-    send_json(fd, 405, "Method Not Allowed", "{\"error\":\"GET and POST only\"}");
+  if (method == "DELETE" && path.rfind("/jobs/", 0) == 0) {
+    const auto job = g_jobs.find(path.substr(std::string("/jobs/").size()));
+    if (!job) {
+      send_json_error(fd, 404, "unknown job id");
+      return;
+    }
+    std::unique_lock<std::mutex> lock(job->mutex);
+    if (job->status != JobStatus::recording) {
+      lock.unlock();
+      send_json_error(fd, 409, "job is not running");
+      return;
+    }
+    lock.unlock();
+    // The worker notices within a poll interval and reports the job as
+    // cancelled once its partial output is gone.
+    job->cancellation->cancel("cancelled by request");
+    lock.lock();
+    const std::string json = build_job_json(*job);
+    lock.unlock();
+    send_json(fd, 202, "Accepted", json);
     return;
   }
 
-  send_json(fd, 404, "Not Found", "{\"error\":\"not found\"}");
+  if (method != "GET" && method != "POST" && method != "DELETE") {
+    send_json_error(fd, 405, "GET, POST and DELETE only");
+    return;
+  }
+
+  send_json_error(fd, 404, "not found");
+}
+
+// Env files are read once at startup; `kill -HUP` re-reads them (and
+// radicc.toml) for requests that start afterwards.
+void reload_on_sighup(sigset_t hangup) {
+  while (true) {
+    int signal = 0;
+    if (sigwait(&hangup, &signal) != 0) continue;
+    const auto settings = reload_runtime_settings();
+    reload_config();
+    RADICC_LOG_INFO << "Reloaded settings on SIGHUP: " << settings->loaded_files.size() << " env files";
+  }
+}
+
+// One thread per connection; both the TCP and the local socket land here.
+void serve_clients(int listen_fd, bool local) {
+  while (true) {
+    // Close-on-exec, so curl children do not keep a client's connection
+    // open after the server is gone.
+    const int client_fd = ::accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (client_fd < 0) continue;
+    std::thread([client_fd, local]() {
+      handle_client(client_fd, local);
+      ::close(client_fd);
+    }).detach();
+  }
 }
 
 }  // namespace
@@ -264,17 +786,32 @@ int main(int argc, char* argv[]) {
   using namespace radicc;
 
   std::signal(SIGPIPE, SIG_IGN);
+  // SIGHUP is taken by reload_on_sighup(); block it before any thread starts
+  // so every thread inherits the mask.
+  sigset_t hangup;
+  sigemptyset(&hangup);
+  sigaddset(&hangup, SIGHUP);
+  pthread_sigmask(SIG_BLOCK, &hangup, nullptr);
+  download_bytes_counter();  // register so /metrics lists it from the start
 
   std::string bind_host = "127.0.0.1";
   int bind_port = 8080;
+  std::string socket_path = local_socket_path();
   for (int i = 1; i < argc; ++i) {
     const std::string arg = argv[i];
     if ((arg == "--host" || arg == "-h") && i + 1 < argc) {
       bind_host = argv[++i];
     } else if ((arg == "--port" || arg == "-p") && i + 1 < argc) {
       bind_port = std::stoi(argv[++i]);
+    } else if (arg == "--trace" && i + 1 < argc) {
+      g_trace_path = argv[++i];
+    } else if (arg == "--socket" && i + 1 < argc) {
+      socket_path = argv[++i];
+    } else if (arg == "--no-socket") {
+      socket_path.clear();
     } else if (arg == "--help") {
-      std::cout << "Usage: radicc-server [--host 127.0.0.1] [--port 8080]\n";
+      std::cout << "Usage: radicc-server [--host 127.0.0.1] [--port 8080] [--trace trace.json]"
+                   " [--socket path | --no-socket]\n";
       return 0;
     } else {
       std::cerr << "Unknown argument: " << arg << std::endl;
@@ -282,9 +819,15 @@ int main(int argc, char* argv[]) {
     }
   }
 
+  if (!g_trace_path.empty()) start_trace();
+  current_runtime_settings();
+  std::thread(reload_on_sighup, hangup).detach();
+  // Picks up radicc.toml edits without a restart.
+  watch_config();
+
   const int server_fd = ::socket(AF_INET, SOCK_STREAM, 0);
   if (server_fd < 0) {
-    std::cerr << "socket() failed: " << std::strerror(errno) << std::endl;
+    RADICC_LOG_ERROR << "socket() failed: " << std::strerror(errno);
     return 1;
   }
 
@@ -295,29 +838,31 @@ int main(int argc, char* argv[]) {
   addr.sin_family = AF_INET;
   addr.sin_port = htons(static_cast<uint16_t>(bind_port));
   if (::inet_pton(AF_INET, bind_host.c_str(), &addr.sin_addr) != 1) {
-    std::cerr << "Invalid bind host: " << bind_host << std::endl;
+    RADICC_LOG_ERROR << "Invalid bind host: " << bind_host;
     ::close(server_fd);
     return 1;
   }
 
   if (::bind(server_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
-    std::cerr << "bind() failed: " << std::strerror(errno) << std::endl;
+    RADICC_LOG_ERROR << "bind() failed: " << std::strerror(errno);
     ::close(server_fd);
     return 1;
   }
   if (::listen(server_fd, 16) < 0) {
-    std::cerr << "listen() failed: " << std::strerror(errno) << std::endl;
+    RADICC_LOG_ERROR << "listen() failed: " << std::strerror(errno);
     ::close(server_fd);
     return 1;
   }
 
   std::cout << "radicc-server listening on http://" << bind_host << ':' << bind_port << std::endl;
-  while (true) {
-    const int client_fd = ::accept(server_fd, nullptr, nullptr);
-    if (client_fd < 0) continue;
-    std::thread([client_fd]() {
-      handle_client(client_fd);
-      ::close(client_fd);
-    }).detach();
+  if (!socket_path.empty()) {
+    const int local_fd = listen_local_socket(socket_path);
+    if (local_fd < 0) {
+      RADICC_LOG_WARN << "Not listening on " << socket_path << ": " << std::strerror(errno);
+    } else {
+      std::cout << "radicc-server listening on unix:" << socket_path << std::endl;
+      std::thread(serve_clients, local_fd, true).detach();
+    }
   }
+  serve_clients(server_fd, false);
 }
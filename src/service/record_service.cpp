@@ -1,64 +1,187 @@
 #include "service/record_service.h"
 
 #include "app/common.h"
+#include "core/config_snapshot.h"
+#include "core/program_image.h"
 #include "core/radiko_auth.h"
 #include "core/radiko_recorder.h"
 #include "core/radiko_stream.h"
+#include "core/recording_store.h"
+#include "core/upstream_governor.h"
+#include "core/url_parser.h"
+#include "utils/cancellation.h"
 #include "utils/date.h"
-#include "utils/env_loader.h"
+#include "utils/log.h"
+#include "utils/metrics.h"
+#include "utils/runtime_settings.h"
+#include "utils/trace.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
 #include <iostream>
 #include <sstream>
+#include <tuple>
 
 namespace radicc {
+namespace {
 
-RecordExecutionResult execute_record_request(const CommandOptions& options) {
-  if (options.json_output) {
-#if defined(_WIN32)
-    _putenv_s("RADICC_SUPPRESS_ENV_LOG", "1");
-#else
-    setenv("RADICC_SUPPRESS_ENV_LOG", "1", 1);
-#endif
+Counter& store_counter(const char* result) {
+  return metrics().counter("radicc_recording_store_requests_total", "Recording store lookups by result.",
+                           std::string("result=\"") + result + "\"");
+}
+
+// Store key component for everything that changes the output bytes' layout.
+std::string record_format(const CommandOptions& options) {
+  if (options.fragmented) return "m4a+frag" + std::to_string(options.fragment_seconds);
+  if (options.faststart) return "m4a+faststart";
+  return "m4a";
+}
+
+// Timefree URLs carry station and start time, so the store can answer them
+// before the schedule lookup.
+std::optional<StoredRecording> find_stored_url_recording(const CommandOptions& options, const std::string& format) {
+  const auto parsed = parse_radiko_url(options.url);
+  if (!parsed) return std::nullopt;
+  std::string station_id;
+  std::array<std::string, 3> dt;
+  std::tie(station_id, dt) = *parsed;
+  return find_stored_recording(station_id, dt[0] + dt[1] + dt[2], "", format);
+}
+
+ResolvedRecord resolved_from_store(const CommandOptions& options, const StoredRecording& stored) {
+  ResolvedRecord resolved;
+  resolved.station_id = stored.station_id;
+  resolved.title = stored.title;
+  resolved.pfm = stored.pfm;
+  resolved.image_url = stored.image_url;
+  resolved.datetime = {stored.ft.substr(0, 4), stored.ft.substr(4, 4), stored.ft.substr(8)};
+  resolved.duration = diff_minutes(stored.ft, stored.to);
+  resolved.date_offset = options.date_offset;
+  resolved.json_output = options.json_output;
+  resolved.toml_base_dir = current_config()->base_dir();
+  return resolved;
+}
+
+void replay_stored_recording(const CommandOptions& options, const RecordObserver& observer, RecordProgress& progress,
+                             const std::string& output_dir, const StoredRecording& stored,
+                             RecordExecutionResult& result) {
+  store_counter("hit").add();
+  result.from_store = true;
+  result.start_time = stored.ft;
+  result.end_time = stored.to;
+  result.digest = ContentDigest{stored.sha256, stored.xxh3, stored.size};
+  result.duration_seconds =
+      stored.duration_seconds > 0.0 ? stored.duration_seconds : result.resolved.duration * 60.0;
+  result.paths = resolve_output_paths(
+      output_dir, result.resolved.toml_base_dir, options.output, result.resolved.title, result.resolved.dir_name,
+      result.resolved.datetime, result.resolved.date_offset);
+  RADICC_LOG_INFO << "Recording found in store: station=" << stored.station_id << ", ft=" << stored.ft
+                  << ", sha256=" << stored.sha256;
+  if (observer.on_resolved) observer.on_resolved(result);
+  std::error_code ec;
+  std::filesystem::create_directories(std::filesystem::path(result.paths.absolute_path).parent_path(), ec);
+  if (!materialize_stored_recording(stored, result.paths.absolute_path)) {
+    print_error_and_exit("Failed to copy the stored recording to " + result.paths.absolute_path + ".");
+  }
+  if (observer.on_output_committed) observer.on_output_committed(stored.size);
+  progress.bytes_out.store(stored.size);
+  set_record_phase(progress, RecordPhase::done);
+}
+
+// Called between phases; blocking calls inside a phase watch the token
+// themselves.
+void stop_if_cancelled(const CancellationToken& token) {
+  if (token.expired()) print_error_and_exit("Recording stopped: " + token.reason());
+}
+
+}  // namespace
+
+RecordExecutionResult execute_record_request(const CommandOptions& options, const RecordObserver& observer,
+                                             std::shared_ptr<const RuntimeSettings> settings) {
+  TraceSpan span("execute_record_request", options.url);
+  if (!settings) settings = current_runtime_settings(options.json_output);
+  RuntimeSettingsScope settings_scope(settings);
+  UpstreamJobScope upstream_scope(options.backfill ? UpstreamPriority::backfill : UpstreamPriority::live);
+  const auto cancellation = observer.cancellation ? observer.cancellation : std::make_shared<CancellationToken>();
+  CancellationScope cancellation_scope(cancellation);
+  if (settings->record_timeout_seconds > 0) {
+    cancellation->set_deadline(CancellationToken::Clock::now() + std::chrono::seconds(settings->record_timeout_seconds));
   }
 
-  load_env_from_file();
-  std::string radiko_user, radiko_pass, output_dir;
-  if (!check_radiko_credentials(radiko_user, radiko_pass, output_dir) && !options.json_output) {
-    std::cerr << "No Radiko credentials found. Proceeding without login." << std::endl;
+  RecordProgress local_progress;
+  RecordProgress& progress = observer.progress ? *observer.progress : local_progress;
+
+  const std::string& output_dir = settings->output_dir;
+  const bool has_credentials = settings->has_credentials();
+
+  RecordExecutionResult result;
+  const std::string format = record_format(options);
+  if (!options.fetch_only && !options.url.empty()) {
+    if (auto stored = find_stored_url_recording(options, format)) {
+      result.resolved = resolved_from_store(options, *stored);
+      replay_stored_recording(options, observer, progress, output_dir, *stored, result);
+      return result;
+    }
+  }
+
+  set_record_phase(progress, RecordPhase::resolving);
+  result.resolved = resolve_record_command(options, 30);
+  stop_if_cancelled(*cancellation);
+  result.start_time = generate_14digit_datetime(result.resolved.datetime, 0);
+  result.end_time = generate_14digit_datetime(result.resolved.datetime, result.resolved.duration);
+  LogContextScope log_scope({std::string(), result.resolved.station_id, result.start_time});
+  RADICC_LOG_INFO << "Resolved recording: station=" << result.resolved.station_id
+                  << ", duration_minutes=" << result.resolved.duration;
+  if (!result.resolved.fetch_only) {
+    if (auto stored = find_stored_recording(result.resolved.station_id, result.start_time, result.end_time, format)) {
+      replay_stored_recording(options, observer, progress, output_dir, *stored, result);
+      return result;
+    }
+    store_counter("miss").add();
+  }
+  result.paths = resolve_output_paths(
+      output_dir, result.resolved.toml_base_dir, options.output, result.resolved.title, result.resolved.dir_name,
+      result.resolved.datetime, result.resolved.date_offset);
+  // The cover downloads while authorization and the stream plan proceed.
+  std::shared_future<ProgramCover> cover;
+  if (!result.resolved.fetch_only) cover = prefetch_program_cover(result.resolved.image_url, result.resolved.event_url);
+  progress.expected_ms.store(static_cast<std::uint64_t>(result.resolved.duration) * 60 * 1000);
+  // Without an explicit deadline a recording still ends in bounded time:
+  // ten minutes plus twice the airing, far beyond any healthy download.
+  cancellation->set_deadline(CancellationToken::Clock::now()
+                             + std::chrono::minutes(10 + 2 * std::max(result.resolved.duration, 0)));
+
+  set_record_phase(progress, RecordPhase::authorizing);
+  if (!has_credentials && !options.json_output) {
+    RADICC_LOG_INFO << "No Radiko credentials found. Proceeding without login.";
   }
 
   std::string session_id;
   bool is_areafree = false;
-  if (!radiko_user.empty() && !radiko_pass.empty()) {
-    std::cerr << "Radiko credentials found; attempting login." << std::endl;
-    auto login = login_to_radiko(radiko_user, radiko_pass);
+  if (has_credentials) {
+    RADICC_LOG_INFO << "Radiko credentials found; attempting login.";
+    auto login = login_to_radiko(settings->radiko_user, settings->radiko_pass);
     if (login) {
       session_id = login->session_id;
       is_areafree = login->is_areafree;
-      std::cerr << "Radiko login succeeded; areafree: "
-                << (is_areafree ? "enabled" : "disabled") << std::endl;
+      RADICC_LOG_INFO << "Radiko login succeeded; areafree: "
+                      << (is_areafree ? "enabled" : "disabled");
     } else if (!options.json_output) {
-      std::cerr << "Warning: Login failed, proceeding without Radiko Premium access." << std::endl;
+      RADICC_LOG_WARN << "Warning: Login failed, proceeding without Radiko Premium access.";
     }
   } else if (!options.json_output) {
-    std::cerr << "No Radiko credentials provied, proceeding without Radiko Premium access." << std::endl;
+    RADICC_LOG_INFO << "No Radiko credentials provied, proceeding without Radiko Premium access.";
   }
 
-  RecordExecutionResult result;
-  result.resolved = resolve_record_command(options, 30);
-  std::cerr << "Resolved recording: station=" << result.resolved.station_id
-            << ", duration_minutes=" << result.resolved.duration << std::endl;
-  result.paths = resolve_output_paths(
-      output_dir, result.resolved.toml_base_dir, options.output, result.resolved.title, result.resolved.dir_name,
-      result.resolved.datetime, result.resolved.date_offset);
-  result.start_time = generate_14digit_datetime(result.resolved.datetime, 0);
-  result.end_time = generate_14digit_datetime(result.resolved.datetime, result.resolved.duration);
-
+  stop_if_cancelled(*cancellation);
   if (!result.resolved.fetch_only) {
-    std::cerr << "Starting Radiko authorization." << std::endl;
+    RADICC_LOG_INFO << "Starting Radiko authorization.";
     auto auth_state = authorize_radiko(session_id);
+    stop_if_cancelled(*cancellation);
     if (!auth_state) print_error_and_exit("Authorization failed.");
-    std::cerr << "Radiko authorization succeeded: area=" << auth_state->area_id << std::endl;
+    RADICC_LOG_INFO << "Radiko authorization succeeded: area=" << auth_state->area_id;
     const auto station_available =
         is_station_available_in_area(result.resolved.station_id, auth_state->area_id);
     if (!is_areafree && station_available.has_value() && !*station_available) {
@@ -68,54 +191,137 @@ RecordExecutionResult execute_record_request(const CommandOptions& options) {
     }
     const bool use_areafree_stream =
         is_areafree && (!station_available.has_value() || !*station_available);
-    std::cerr << "Station availability: "
-              << (station_available.has_value() ? (*station_available ? "local" : "outside area") : "unknown")
-              << ", stream mode: " << (use_areafree_stream ? "areafree" : "local") << std::endl;
+    RADICC_LOG_INFO << "Station availability: "
+                    << (station_available.has_value() ? (*station_available ? "local" : "outside area") : "unknown")
+                    << ", stream mode: " << (use_areafree_stream ? "areafree" : "local");
     auto stream_plan = build_timefree_stream_plan(
         result.resolved.station_id, result.start_time, result.end_time, use_areafree_stream, *auth_state);
+    stop_if_cancelled(*cancellation);
     if (!stream_plan) print_error_and_exit("Failed to resolve timefree stream request.");
     std::size_t chunk_count = 0;
     for (const auto& source : stream_plan->sources) {
       chunk_count += source.chunks.size();
     }
-    std::cerr << "Timefree stream plan resolved: sources=" << stream_plan->sources.size()
-              << ", chunks=" << chunk_count << std::endl;
+    RADICC_LOG_INFO << "Timefree stream plan resolved: sources=" << stream_plan->sources.size()
+                    << ", chunks=" << chunk_count;
     if (!options.json_output) {
-      std::cerr << "Radiko authorization area: " << stream_plan->area_id
-                << ", areafree stream: " << (use_areafree_stream ? "enabled" : "disabled") << std::endl;
+      RADICC_LOG_INFO << "Radiko authorization area: " << stream_plan->area_id
+                      << ", areafree stream: " << (use_areafree_stream ? "enabled" : "disabled");
+    }
+    RadikoRecordOptions record_options;
+    record_options.hedge_first_chunk = settings->hedge_sources;
+    record_options.native_muxer = settings->native_muxer;
+    record_options.output.fragmented = options.fragmented;
+    record_options.output.fragment_seconds = options.fragment_seconds;
+    record_options.output.faststart = options.faststart;
+    record_options.async_writer = settings->async_writer;
+    record_options.on_output_opened = observer.on_output_opened;
+    record_options.on_output_committed = observer.on_output_committed;
+    record_options.progress = &progress;
+    RecordedOutput recorded;
+    record_options.recorded = &recorded;
+    record_options.cover = cover;
+    if (observer.on_resolved) observer.on_resolved(result);
+    set_record_phase(progress, RecordPhase::recording);
+    const auto record = [&](const RadikoStreamPlan& plan) {
+      return record_radiko(plan, result.paths.filename, result.resolved.pfm, result.resolved.title,
+                           result.paths.dir_name, result.paths.output_dir, record_options);
+    };
+    bool recorded_ok = record(*stream_plan);
+    if (!recorded_ok && stream_plan->cached_definition) {
+      stop_if_cancelled(*cancellation);
+      // The recorder drops a cached stream definition that upstream refused;
+      // a plan that no longer comes from the cache is worth one more try.
+      const auto fresh_plan = build_timefree_stream_plan(
+          result.resolved.station_id, result.start_time, result.end_time, use_areafree_stream, *auth_state);
+      if (fresh_plan && !fresh_plan->cached_definition) {
+        RADICC_LOG_WARN << "Retrying with a freshly fetched stream definition.";
+        recorded_ok = record(*fresh_plan);
+      }
     }
-    if (!record_radiko(
-            *stream_plan, result.paths.filename, result.resolved.pfm, result.resolved.title,
-            result.paths.dir_name, result.paths.output_dir, result.resolved.image_url)) {
+    if (!recorded_ok) {
+      stop_if_cancelled(*cancellation);
       print_error_and_exit("Failed to record the broadcast.");
     }
+    if (!cover.get().image_url.empty()) result.resolved.image_url = cover.get().image_url;
     logout_from_radiko(session_id);
-  } else if (!options.json_output) {
-    std::cout << "--fetch was specified, recording was skipped." << std::endl;
+    if (!recorded.digest.sha256.empty()) result.digest = recorded.digest;
+    result.duration_seconds = recorded.duration_seconds;
+    StoredRecording entry;
+    entry.station_id = result.resolved.station_id;
+    entry.ft = result.start_time;
+    entry.to = result.end_time;
+    entry.format = format;
+    entry.title = result.resolved.title;
+    entry.pfm = result.resolved.pfm;
+    entry.image_url = result.resolved.image_url;
+    if (result.digest) {
+      entry.sha256 = result.digest->sha256;
+      entry.xxh3 = result.digest->xxh3;
+      entry.size = result.digest->size;
+    }
+    entry.duration_seconds = result.duration_seconds;
+    store_recording(entry, result.paths.absolute_path);
+  } else {
+    if (const std::string image_url = resolve_program_image_url(result.resolved.event_url); !image_url.empty()) {
+      result.resolved.image_url = image_url;
+    }
+    if (!options.json_output) std::cout << "--fetch was specified, recording was skipped." << std::endl;
   }
 
+  set_record_phase(progress, RecordPhase::done);
   return result;
 }
 
+void write_record_result_json(JsonWriter& json, const CommandOptions& options, const RecordExecutionResult& result) {
+  json.begin_object()
+      .member("id", options.id.empty() ? options.target : options.id)
+      .member("station_id", result.resolved.station_id)
+      .member("duration_minutes", result.resolved.duration)
+      .member("dir", result.paths.dir_name)
+      .member("directory", result.paths.directory_path)
+      .member("pfm", result.resolved.pfm)
+      .member("image_url", result.resolved.image_url)
+      .member("date", result.start_time.substr(0, 8))
+      .member("fetch_only", result.resolved.fetch_only);
+  write_record_output_members(json, result);
+  json.end_object();
+}
+
 std::string build_record_result_json(const CommandOptions& options, const RecordExecutionResult& result) {
-  std::ostringstream json;
-  json << '{'
-       << "\"id\":\"" << json_escape(options.id.empty() ? options.target : options.id) << "\","
-       << "\"station_id\":\"" << json_escape(result.resolved.station_id) << "\","
-       << "\"start_time\":\"" << json_escape(result.start_time) << "\","
-       << "\"end_time\":\"" << json_escape(result.end_time) << "\","
-       << "\"duration_minutes\":" << result.resolved.duration << ','
-       << "\"output_file\":\"" << json_escape(result.paths.filename) << "\","
-       << "\"filepath\":\"" << json_escape(result.paths.absolute_path) << "\","
-       << "\"title\":\"" << json_escape(result.resolved.title) << "\","
-       << "\"dir\":\"" << json_escape(result.paths.dir_name) << "\","
-       << "\"directory\":\"" << json_escape(result.paths.directory_path) << "\","
-       << "\"pfm\":\"" << json_escape(result.resolved.pfm) << "\","
-       << "\"image_url\":\"" << json_escape(result.resolved.image_url) << "\","
-       << "\"date\":\"" << json_escape(result.start_time.substr(0, 8)) << "\","
-       << "\"fetch_only\":" << (result.resolved.fetch_only ? "true" : "false")
-       << '}';
-  return json.str();
+  JsonWriter json;
+  write_record_result_json(json, options, result);
+  return json.take();
+}
+
+std::string build_record_result_text(const CommandOptions& options, const RecordExecutionResult& result) {
+  std::ostringstream text;
+  text << "\n";
+  text << "ID: " << (options.id.empty() ? options.target : options.id) << "\n";
+  text << "Station: " << result.resolved.station_id << "\n";
+  text << "Time: " << result.start_time << " - " << result.end_time << "\n";
+  text << "Duration: " << result.resolved.duration << " minutes\n";
+  text << "Output File: " << result.paths.filename << "\n";
+  text << "pfm: " << result.resolved.pfm << "\n";
+  if (!result.paths.dir_name.empty()) text << "dir: " << result.paths.dir_name << "\n";
+  text << "Directory: " << result.paths.directory_path << "\n\n";
+  if (!result.resolved.image_url.empty()) text << "(image url)   " << result.resolved.image_url << "\n";
+  text << (result.resolved.fetch_only ? "Fetch completed successfully.\n" : "Recording completed successfully.\n");
+  return text.str();
+}
+
+void write_record_output_members(JsonWriter& json, const RecordExecutionResult& result) {
+  json.member("filepath", result.paths.absolute_path)
+      .member("output_file", result.paths.filename)
+      .member("title", result.resolved.title)
+      .member("start_time", result.start_time)
+      .member("end_time", result.end_time)
+      .member("from_store", result.from_store);
+  if (!result.digest) return;
+  json.member("sha256", result.digest->sha256)
+      .member("xxh3", result.digest->xxh3)
+      .member("size_bytes", result.digest->size)
+      .member("duration_seconds", result.duration_seconds, 3);
 }
 
 }  // namespace radicc
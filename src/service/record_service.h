@@ -3,7 +3,16 @@
 #include "app/command_options.h"
 #include "app/output_path.h"
 #include "app/record_resolver.h"
+#include "core/record_progress.h"
+#include "utils/cancellation.h"
+#include "utils/hash.h"
+#include "utils/json.h"
+#include "utils/runtime_settings.h"
 
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
 #include <string>
 
 namespace radicc {
@@ -13,9 +22,41 @@ struct RecordExecutionResult {
   OutputPaths paths;
   std::string start_time;
   std::string end_time;
+  // Served from the recording store instead of being recorded.
+  bool from_store = false;
+  // Digest and length of the output, computed while it was written.
+  std::optional<ContentDigest> digest;
+  double duration_seconds = 0.0;
 };
 
-RecordExecutionResult execute_record_request(const CommandOptions& options);
+// Optional hooks for callers that follow a recording while it runs.
+struct RecordObserver {
+  // Called once the output path is known, before any audio is fetched.
+  std::function<void(const RecordExecutionResult&)> on_resolved;
+  // Hidden file the output is written to until it is renamed into place.
+  std::function<void(const std::string&)> on_output_opened;
+  // Leading bytes of the output file that are final (see RadikoRecordOptions).
+  std::function<void(std::uint64_t)> on_output_committed;
+  // Phase and recorder counters; the caller owns it and marks failures.
+  RecordProgress* progress = nullptr;
+  // Cancels the request or bounds it with a deadline; optional. The request
+  // always gets a deadline derived from the airing's length.
+  std::shared_ptr<CancellationToken> cancellation;
+};
+
+// `settings` defaults to current_runtime_settings(); a caller running many
+// requests passes the snapshot it took so each request sees one view.
+RecordExecutionResult execute_record_request(const CommandOptions& options,
+                                             const RecordObserver& observer = RecordObserver(),
+                                             std::shared_ptr<const RuntimeSettings> settings = nullptr);
+// The result object of `radicc rec`/`fetch --json`, here and over /cli.
+void write_record_result_json(JsonWriter& json, const CommandOptions& options, const RecordExecutionResult& result);
 std::string build_record_result_json(const CommandOptions& options, const RecordExecutionResult& result);
+// The summary `radicc rec`/`fetch` prints without --json.
+std::string build_record_result_text(const CommandOptions& options, const RecordExecutionResult& result);
+// Members describing the output file of a finished recording, for result
+// objects: filepath, output_file, title, start_time, end_time, from_store,
+// then sha256, xxh3, size_bytes and duration_seconds when a digest exists.
+void write_record_output_members(JsonWriter& json, const RecordExecutionResult& result);
 
 }  // namespace radicc
@@ -1,14 +1,24 @@
 // Simple fetch-and-parse tester for radiko URLs.
 // Usage:
 //   radicc_fetch <url> [--title "Exact Title"]
-// Prints parsed values to stdout (JSON-ish), without recording.
+//   radicc_fetch --snapshot [path]
+// Prints parsed values to stdout (JSON-ish), without recording. --snapshot
+// instead crawls every station's weekly schedule and writes the binary
+// schedule snapshot (default: $XDG_CACHE_HOME/radicc/schedule.snapshot).
 
+#include "core/markup_scan.h"
 #include "core/radiko_http.h"
+#include "core/radiko_programs_xml.h"
+#include "core/schedule_snapshot.h"
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <optional>
-#include <regex>
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 static std::string fetch_text(const std::string& url) {
   auto result = radicc::curl_get_text(url);
@@ -19,36 +29,85 @@ struct Prog { std::string id, title, pfm, ft, to, img; };
 
 static std::vector<Prog> parse_progs_from_xml(const std::string& xml) {
   std::vector<Prog> out;
-  std::regex prog_re(R"(<prog\b[^>]*?id=\"([^\"]+)\"[^>]*?ft=\"(\d{14})\"[^>]*?to=\"(\d{14})\"[^>]*?>([\s\S]*?)</prog>)");
-  std::regex title_re(R"(<title>([\s\S]*?)</title>)");
-  std::regex pfm_re(R"(<pfm>([\s\S]*?)</pfm>)");
-  std::regex img_re(R"(<img>([\s\S]*?)</img>)");
-  std::smatch m;
-  auto begin = xml.cbegin();
-  auto end = xml.cend();
-  while (std::regex_search(begin, end, m, prog_re)) {
-    Prog p; p.id = m[1].str(); p.ft = m[2].str(); p.to = m[3].str();
-    const std::string inner = m[4].str();
-    std::smatch mt; if (std::regex_search(inner, mt, title_re)) p.title = mt[1].str();
-    std::smatch mp; if (std::regex_search(inner, mp, pfm_re))   p.pfm   = mp[1].str();
-    std::smatch mi; if (std::regex_search(inner, mi, img_re))   p.img   = mi[1].str();
+  for (auto m = radicc::find_prog_element(xml); m; m = radicc::find_prog_element(xml, m->end)) {
+    Prog p; p.id = std::string(m->id); p.ft = std::string(m->ft); p.to = std::string(m->to);
+    if (auto t = radicc::find_element_text(m->body, "title")) p.title = std::string(*t);
+    if (auto f = radicc::find_element_text(m->body, "pfm"))   p.pfm   = std::string(*f);
+    if (auto i = radicc::find_element_text(m->body, "img"))   p.img   = std::string(*i);
     out.push_back(std::move(p));
-    begin = m.suffix().first;
   }
   return out;
 }
 
 static std::optional<std::string> parse_image_from_event_html(const std::string& html) {
-  std::smatch m; std::regex img_re(R"(<img[^>]+src=\"([^\"]+)\")");
-  if (std::regex_search(html, m, img_re)) return m[1].str();
-  return std::nullopt;
+  radicc::ImageSrcScanner scanner;
+  if (scanner.feed(html)) scanner.finish();
+  if (scanner.src().empty()) return std::nullopt;
+  return scanner.src();
+}
+
+// /mobile/events/\d+
+static bool is_event_page_url(const std::string& url) {
+  const std::string marker = "/mobile/events/";
+  for (auto at = url.find(marker); at != std::string::npos; at = url.find(marker, at + 1)) {
+    const auto next = at + marker.size();
+    if (next < url.size() && url[next] >= '0' && url[next] <= '9') return true;
+  }
+  return false;
+}
+
+// Crawls the weekly schedules straight from upstream, never from an older
+// snapshot, a few stations at a time.
+static int build_snapshot(const std::string& path) {
+  constexpr std::size_t kWorkers = 8;
+  const auto ids = radicc::fetch_station_ids();
+  if (ids.empty()) {
+    std::cerr << "Station list is unavailable" << std::endl;
+    return 2;
+  }
+  std::vector<std::pair<std::string, std::vector<radicc::ProgramEventInfo>>> stations(ids.size());
+  std::atomic<std::size_t> next{0};
+  std::vector<std::thread> workers;
+  for (std::size_t i = 0; i < std::min(kWorkers, ids.size()); ++i) {
+    workers.emplace_back([&]() {
+      for (std::size_t n; (n = next.fetch_add(1)) < ids.size();) {
+        const std::string xml =
+            radicc::fetch_programs_xml("https://radiko.jp/v3/program/station/weekly/" + ids[n] + ".xml");
+        stations[n] = {ids[n], radicc::parse_programs_from_xml(xml)};
+      }
+    });
+  }
+  for (auto& worker : workers) worker.join();
+
+  std::size_t programs = 0;
+  for (const auto& [station_id, schedule] : stations) {
+    if (schedule.empty()) std::cerr << "No weekly schedule for " << station_id << "; left out" << std::endl;
+    programs += schedule.size();
+  }
+  if (programs == 0) {
+    std::cerr << "No schedules fetched" << std::endl;
+    return 2;
+  }
+  stations.erase(std::remove_if(stations.begin(), stations.end(), [](const auto& station) { return station.second.empty(); }),
+                 stations.end());
+  if (path.empty() || !radicc::write_schedule_snapshot(path, stations)) {
+    std::cerr << "Failed to write snapshot: " << path << std::endl;
+    return 4;
+  }
+  std::cout << "{\n  \"path\": \"" << path << "\",\n  \"stations\": " << stations.size()
+            << ",\n  \"programs\": " << programs << "\n}\n";
+  return 0;
 }
 
 int main(int argc, char* argv[]) {
   if (argc < 2) {
-    std::cerr << "Usage: radicc_fetch <url> [--title \"Exact Title\"]\n";
+    std::cerr << "Usage: radicc_fetch <url> [--title \"Exact Title\"]\n"
+              << "       radicc_fetch --snapshot [path]\n";
     return 1;
   }
+  if (std::string(argv[1]) == "--snapshot") {
+    return build_snapshot(argc > 2 ? argv[2] : radicc::schedule_snapshot_path());
+  }
   std::string url = argv[1];
   std::string title;
   for (int i = 2; i < argc; ++i) {
@@ -63,7 +122,8 @@ int main(int argc, char* argv[]) {
   }
 
   // Decide by URL shape
-  if (std::regex_search(url, std::regex(R"(/v3/program/station/(date|weekly)/)"))) {
+  if (url.find("/v3/program/station/date/") != std::string::npos ||
+      url.find("/v3/program/station/weekly/") != std::string::npos) {
     auto progs = parse_progs_from_xml(body);
     // Print JSON-ish
     if (!title.empty()) {
@@ -100,7 +160,7 @@ int main(int argc, char* argv[]) {
     return 0;
   }
 
-  if (std::regex_search(url, std::regex(R"(/mobile/events/\d+)"))) {
+  if (is_event_page_url(url)) {
     auto img = parse_image_from_event_html(body);
     std::cout << "{\n  \"image\": \"" << (img ? *img : std::string()) << "\"\n}\n";
     return 0;
@@ -0,0 +1,65 @@
+// The std::regex matchers that core/markup_scan.h and parse_radiko_url()
+// replaced, kept as the reference for differential tests and
+// radicc_scan_bench. Not used by radicc itself.
+
+#pragma once
+
+#include <optional>
+#include <regex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace radicc::regex_reference {
+
+struct Element {
+  std::string attributes;
+  std::string body;
+};
+
+struct Prog {
+  std::string id, ft, to, body;
+};
+
+inline std::optional<std::string> element_text(const std::string& text, const std::string& name) {
+  const std::regex re("<" + name + ">([\\s\\S]*?)</" + name + ">");
+  std::smatch m;
+  if (!std::regex_search(text, m, re)) return std::nullopt;
+  return m[1].str();
+}
+
+inline std::vector<Element> elements(const std::string& text, const std::string& name) {
+  const std::regex re("<" + name + "\\b([^>]*)>([\\s\\S]*?)</" + name + ">");
+  std::vector<Element> out;
+  for (auto it = std::sregex_iterator(text.begin(), text.end(), re); it != std::sregex_iterator(); ++it) {
+    out.push_back(Element{(*it)[1].str(), (*it)[2].str()});
+  }
+  return out;
+}
+
+inline std::vector<Prog> progs(const std::string& text) {
+  static const std::regex re(
+      R"(<prog\b[^>]*?id=\"([^\"]+)\"[^>]*?ft=\"(\d{14})\"[^>]*?to=\"(\d{14})\"[^>]*?>([\s\S]*?)</prog>)");
+  std::vector<Prog> out;
+  for (auto it = std::sregex_iterator(text.begin(), text.end(), re); it != std::sregex_iterator(); ++it) {
+    out.push_back(Prog{(*it)[1].str(), (*it)[2].str(), (*it)[3].str(), (*it)[4].str()});
+  }
+  return out;
+}
+
+inline std::optional<std::string> image_src(const std::string& html) {
+  static const std::regex re(R"(<img[^>]+src=\"([^\"]+)\")");
+  std::smatch m;
+  if (!std::regex_search(html, m, re)) return std::nullopt;
+  return m[1].str();
+}
+
+// Station id and the 14-digit start time.
+inline std::optional<std::pair<std::string, std::string>> radiko_url(const std::string& url) {
+  static const std::regex re(R"(https://radiko\.jp/#!/ts/([^/]+)/(\d{14}))");
+  std::smatch m;
+  if (!std::regex_search(url, m, re)) return std::nullopt;
+  return std::make_pair(m[1].str(), m[2].str());
+}
+
+}  // namespace radicc::regex_reference
@@ -0,0 +1,111 @@
+// Times the markup scanners against the std::regex matchers they replaced.
+// Usage:
+//   radicc_scan_bench [iterations]
+// Inputs are synthetic documents shaped like radiko's stream XML, a weekly
+// schedule and an event page.
+
+#include "core/markup_scan.h"
+#include "core/url_parser.h"
+#include "tools/regex_reference.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+namespace {
+
+std::string stream_xml() {
+  std::string xml = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<urls>\n";
+  for (int i = 0; i < 12; ++i) {
+    xml += "  <url areafree=\"" + std::to_string(i % 2) + "\" timefree=\"" + std::to_string(i / 6) +
+           "\">\n    <playlist_create_url>https://si-f-radiko.smartstream.ne.jp/tf/playlist.m3u8?n=" +
+           std::to_string(i) + "</playlist_create_url>\n  </url>\n";
+  }
+  return xml + "</urls>\n";
+}
+
+std::string weekly_schedule() {
+  std::string xml = "<radiko><stations><station id=\"TBS\"><progs>\n";
+  for (int i = 0; i < 7 * 40; ++i) {
+    const std::string hour = std::to_string(10 + i % 14);
+    xml += "<prog id=\"" + std::to_string(100000 + i) + "\" master_id=\"\" ft=\"20260322" + hour + "0000\" to=\"20260322" +
+           hour + "3000\" ftl=\"" + hour + "00\" tol=\"" + hour + "30\" dur=\"1800\">" +
+           "<title>Program " + std::to_string(i) + "</title><url>https://example.jp/</url>"
+           "<desc>" + std::string(400, 'd') + "</desc><info>" + std::string(600, 'i') + "</info>"
+           "<pfm>Performer " + std::to_string(i) + "</pfm><img>https://radiko.jp/res/program/" +
+           std::to_string(i) + ".jpg</img></prog>\n";
+  }
+  return xml + "</progs></station></stations></radiko>\n";
+}
+
+std::string event_page() {
+  std::string html = "<html><head>" + std::string(20000, ' ') + "</head><body>";
+  for (int i = 0; i < 40; ++i) html += "<div class=\"item\"><a href=\"/x\">" + std::string(200, 't') + "</a></div>";
+  return html + "<img class=\"cover\" alt=\"\" src=\"https://radiko.jp/res/program/event.jpg\"></body></html>";
+}
+
+template <typename Run>
+void measure(const char* name, int iterations, Run&& run) {
+  std::size_t sink = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) sink += run();
+  const auto elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start);
+  std::printf("%-24s %12.2f us/op  (%zu)\n", name, elapsed.count() / iterations, sink);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  const int iterations = argc > 1 ? std::max(1, std::atoi(argv[1])) : 200;
+  const std::string stream = stream_xml();
+  const std::string schedule = weekly_schedule();
+  const std::string page = event_page();
+  const std::string url = "https://radiko.jp/#!/ts/TBS/20260322010000";
+
+  measure("stream urls regex", iterations, [&] {
+    std::size_t found = 0;
+    for (const auto& element : radicc::regex_reference::elements(stream, "url")) {
+      found += radicc::regex_reference::element_text(element.body, "playlist_create_url").has_value();
+    }
+    return found;
+  });
+  measure("stream urls scan", iterations, [&] {
+    std::size_t found = 0;
+    for (auto element = radicc::find_element(stream, "url"); element;
+         element = radicc::find_element(stream, "url", element->end)) {
+      found += radicc::find_element_text(element->body, "playlist_create_url").has_value();
+    }
+    return found;
+  });
+
+  measure("weekly progs regex", iterations, [&] {
+    std::size_t found = 0;
+    for (const auto& prog : radicc::regex_reference::progs(schedule)) {
+      found += radicc::regex_reference::element_text(prog.body, "title").has_value();
+    }
+    return found;
+  });
+  measure("weekly progs scan", iterations, [&] {
+    std::size_t found = 0;
+    for (auto prog = radicc::find_prog_element(schedule); prog; prog = radicc::find_prog_element(schedule, prog->end)) {
+      found += radicc::find_element_text(prog->body, "title").has_value();
+    }
+    return found;
+  });
+
+  measure("event image regex", iterations,
+          [&] { return radicc::regex_reference::image_src(page).value_or(std::string()).size(); });
+  measure("event image scan", iterations, [&] {
+    radicc::ImageSrcScanner scanner;
+    if (scanner.feed(page)) scanner.finish();
+    return scanner.src().size();
+  });
+
+  measure("radiko url regex", iterations * 100,
+          [&] { return radicc::regex_reference::radiko_url(url).has_value() ? std::size_t{1} : 0; });
+  measure("radiko url scan", iterations * 100,
+          [&] { return radicc::parse_radiko_url(url).has_value() ? std::size_t{1} : 0; });
+  return 0;
+}
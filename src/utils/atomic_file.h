@@ -0,0 +1,21 @@
+#pragma once
+
+#include <initializer_list>
+#include <string>
+#include <string_view>
+
+namespace radicc {
+
+// Replaces `path` with `pieces`, written in order. The data goes to a
+// uniquely named file beside `path`, is fsynced and renamed over it, and
+// the directory is synced, so neither a concurrent reader nor a crash sees
+// a partial file. False, with `path` untouched, on any failure.
+bool write_file_atomically(const std::string& path, std::initializer_list<std::string_view> pieces);
+inline bool write_file_atomically(const std::string& path, std::string_view contents) {
+  return write_file_atomically(path, {contents});
+}
+
+// fsyncs the directory holding `path`, making a rename into it durable.
+bool sync_parent_directory(const std::string& path);
+
+}  // namespace radicc
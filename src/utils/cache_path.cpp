@@ -0,0 +1,34 @@
+#include "utils/cache_path.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <sys/stat.h>
+
+namespace radicc {
+namespace {
+
+bool ensure_directory(const std::string& path) {
+  struct stat st;
+  if (stat(path.c_str(), &st) == 0) return S_ISDIR(st.st_mode);
+  const std::size_t pos = path.find_last_of('/');
+  if (pos != std::string::npos && pos > 0 && !ensure_directory(path.substr(0, pos))) return false;
+  return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+}  // namespace
+
+std::string get_cache_path(const std::string& filename) {
+  std::string cache_dir;
+  const char* xdg_cache_home = std::getenv("XDG_CACHE_HOME");
+  if (xdg_cache_home && *xdg_cache_home) {
+    cache_dir = std::string(xdg_cache_home) + "/radicc";
+  } else {
+    const char* home = std::getenv("HOME");
+    if (!home || !*home) return {};
+    cache_dir = std::string(home) + "/.cache/radicc";
+  }
+  if (!ensure_directory(cache_dir)) return {};
+  return cache_dir + "/" + filename;
+}
+
+} // namespace radicc
@@ -0,0 +1,10 @@
+#pragma once
+#include <string>
+
+namespace radicc {
+
+// Returns `$XDG_CACHE_HOME/radicc/<filename>` (or `~/.cache/radicc/<filename>`),
+// creating the cache directory on first use. Empty when no home is known.
+std::string get_cache_path(const std::string& filename);
+
+} // namespace radicc
@@ -0,0 +1,75 @@
+#include "utils/cancellation.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace radicc {
+namespace {
+
+thread_local std::shared_ptr<CancellationToken> t_cancellation;
+
+std::int64_t to_ns(CancellationToken::Clock::time_point time) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+}
+
+}  // namespace
+
+void CancellationToken::cancel(const std::string& reason) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (cancelled()) return;
+    reason_ = reason;
+    cancelled_.store(true, std::memory_order_release);
+  }
+  changed_.notify_all();
+}
+
+void CancellationToken::set_deadline(Clock::time_point deadline) {
+  const std::int64_t ns = to_ns(deadline);
+  std::int64_t current = deadline_ns_.load(std::memory_order_relaxed);
+  while (ns < current && !deadline_ns_.compare_exchange_weak(current, ns, std::memory_order_relaxed)) {
+  }
+  changed_.notify_all();
+}
+
+bool CancellationToken::deadline_exceeded() const {
+  const std::int64_t deadline = deadline_ns_.load(std::memory_order_relaxed);
+  return deadline != kNoDeadline && to_ns(Clock::now()) >= deadline;
+}
+
+double CancellationToken::seconds_left() const {
+  const std::int64_t deadline = deadline_ns_.load(std::memory_order_relaxed);
+  if (deadline == kNoDeadline) return 1e9;
+  return static_cast<double>(deadline - to_ns(Clock::now())) / 1e9;
+}
+
+std::string CancellationToken::reason() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (cancelled()) return reason_;
+  return deadline_exceeded() ? "deadline exceeded" : std::string();
+}
+
+bool CancellationToken::wait_for(double seconds) {
+  const double bounded = std::min(seconds, std::max(seconds_left(), 0.0));
+  std::unique_lock<std::mutex> lock(mutex_);
+  changed_.wait_for(lock, std::chrono::duration<double>(bounded), [&]() { return cancelled(); });
+  lock.unlock();
+  return !expired();
+}
+
+CancellationScope::CancellationScope(std::shared_ptr<CancellationToken> token)
+    : previous_(std::exchange(t_cancellation, std::move(token))) {}
+
+CancellationScope::~CancellationScope() {
+  t_cancellation = std::move(previous_);
+}
+
+std::shared_ptr<CancellationToken> current_cancellation() {
+  return t_cancellation;
+}
+
+bool current_cancellation_expired() {
+  return t_cancellation && t_cancellation->expired();
+}
+
+}  // namespace radicc
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace radicc {
+
+// Cooperative cancellation for one recording. A token is cancelled
+// explicitly (DELETE /jobs/{id}) or expires at its deadline; blocking work
+// polls expired() or waits through wait_for(), and subprocesses and libav
+// I/O are interrupted when it fires.
+class CancellationToken {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  void cancel(const std::string& reason = "cancelled");
+  // Only tightens: a later deadline than the current one is ignored.
+  void set_deadline(Clock::time_point deadline);
+
+  bool cancelled() const { return cancelled_.load(std::memory_order_acquire); }
+  bool deadline_exceeded() const;
+  bool expired() const { return cancelled() || deadline_exceeded(); }
+  bool has_deadline() const { return deadline_ns_.load(std::memory_order_relaxed) != kNoDeadline; }
+  // Seconds until the deadline; a large value when there is none.
+  double seconds_left() const;
+  std::string reason() const;
+
+  // Sleeps for `seconds` or until the token expires; false if it expired.
+  bool wait_for(double seconds);
+
+ private:
+  static constexpr std::int64_t kNoDeadline = INT64_MAX;
+
+  std::atomic<bool> cancelled_{false};
+  std::atomic<std::int64_t> deadline_ns_{kNoDeadline};
+  mutable std::mutex mutex_;
+  std::condition_variable changed_;
+  std::string reason_;
+};
+
+// Makes `token` the calling thread's token for the scope's lifetime, so the
+// HTTP layer and the recorder see it without threading it through every
+// call. Worker threads adopt the token of the thread that started them.
+class CancellationScope {
+ public:
+  explicit CancellationScope(std::shared_ptr<CancellationToken> token);
+  ~CancellationScope();
+  CancellationScope(const CancellationScope&) = delete;
+  CancellationScope& operator=(const CancellationScope&) = delete;
+
+ private:
+  std::shared_ptr<CancellationToken> previous_;
+};
+
+// Null outside any scope.
+std::shared_ptr<CancellationToken> current_cancellation();
+bool current_cancellation_expired();
+
+}  // namespace radicc
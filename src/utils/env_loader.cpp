@@ -1,10 +1,10 @@
 #include "utils/env_loader.h"
+#include "utils/log.h"
 #include <algorithm>
 #include <cctype>
 #include <cstdlib>
 #include <fstream>
-#include <iostream>
-#include <sys/stat.h>
+#include <map>
 #include <utility>
 
 namespace radicc {
@@ -42,14 +42,18 @@ std::string get_config_path_for_env(const std::string& filename) {
   } else {
     const char* home = std::getenv("HOME");
     if (home) config_path = std::string(home) + "/.config/radicc";
-    else { std::cerr << "Error: Could not determine home directory.\n"; std::exit(1); }
+    else { RADICC_LOG_ERROR << "Error: Could not determine home directory."; std::exit(1); }
   }
   return config_path + "/" + filename;
 }
 
-void load_env_file(const std::string& filepath) {
+std::map<std::string, std::string> read_env_file(const std::string& filepath) {
+  std::map<std::string, std::string> values;
   std::ifstream file(filepath);
-  if (!file.is_open()) { std::cerr << "Error: Could not open " << filepath << std::endl; return; }
+  if (!file.is_open()) {
+    RADICC_LOG_ERROR << "Error: Could not open " << filepath;
+    return values;
+  }
   std::string line;
   while (std::getline(file, line)) {
     line = trim_space(std::move(line));
@@ -60,77 +64,9 @@ void load_env_file(const std::string& filepath) {
     std::string key = trim_space(line.substr(0, pos));
     std::string value = parse_env_value(line.substr(pos + 1));
     if (key.empty()) continue;
-    setenv(key.c_str(), value.c_str(), 1);
-  }
-}
-
-void load_env_from_file() {
-  std::string env_path = get_config_path_for_env("env");
-  std::string dotenv_path = get_config_path_for_env(".env");
-  struct stat st;
-  const bool suppress_logs = std::getenv("RADICC_SUPPRESS_ENV_LOG") != nullptr;
-  bool loaded = false;
-
-  if (stat(env_path.c_str(), &st) == 0) {
-    if (!suppress_logs) {
-      std::cerr << "Loading from env file: " << env_path << std::endl;
-    }
-    load_env_file(env_path);
-    loaded = true;
-  }
-
-  if (stat(dotenv_path.c_str(), &st) == 0) {
-    if (!suppress_logs) {
-      std::cerr << "Loading from .env file: " << dotenv_path << std::endl;
-    }
-    load_env_file(dotenv_path);
-    loaded = true;
-  }
-
-  if (!loaded && !suppress_logs) {
-    std::cerr << "Note: No env file found; relying on environment variables only.\n";
-  }
-}
-
-bool check_radiko_credentials(std::string& radiko_user, std::string& radiko_pass, std::string& output_dir) {
-  const char* home = std::getenv("HOME");
-  const auto expand_path = [&](const std::string& raw) -> std::string {
-    std::string expanded = raw;
-    expanded.erase(std::remove(expanded.begin(), expanded.end(), '\"'), expanded.end());
-
-    if (home) {
-      size_t pos = expanded.find("$HOME");
-      if (pos != std::string::npos) expanded.replace(pos, 5, home);
-      if (!expanded.empty() && expanded.front() == '~') {
-        expanded.replace(0, 1, home);
-      }
-    }
-
-    if (!expanded.empty() && expanded.back() != '/') {
-      expanded += '/';
-    }
-
-    return expanded;
-  };
-
-  const char* radicc_dir = std::getenv("RADICC_DIR");
-  if (radicc_dir && *radicc_dir) {
-    output_dir = expand_path(radicc_dir);
-  } else {
-    output_dir = "./";
+    values[key] = std::move(value);
   }
-
-  const char* user = std::getenv("RADIKO_USER");
-  const char* pass = std::getenv("RADIKO_PASS");
-  if (user && *user && pass && *pass) {
-    radiko_user = user;
-    radiko_pass = pass;
-    return true;
-  }
-
-  radiko_user.clear();
-  radiko_pass.clear();
-  return false;
+  return values;
 }
 
 } // namespace radicc
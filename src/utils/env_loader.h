@@ -1,11 +1,11 @@
 #pragma once
+#include <map>
 #include <string>
 
 namespace radicc {
 
 std::string get_config_path_for_env(const std::string& filename);
-void load_env_file(const std::string& filepath);
-void load_env_from_file();
-bool check_radiko_credentials(std::string& radikoUser, std::string& radikoPass, std::string& outputDir);
+// KEY=value lines of an env file; later lines win. Nothing is exported.
+std::map<std::string, std::string> read_env_file(const std::string& filepath);
 
 } // namespace radicc
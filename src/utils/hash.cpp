@@ -0,0 +1,360 @@
+#include "utils/hash.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace radicc {
+namespace {
+
+constexpr std::uint32_t kSha256Init[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+constexpr std::uint32_t kSha256Rounds[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+constexpr std::uint32_t rotr(std::uint32_t value, int bits) { return (value >> bits) | (value << (32 - bits)); }
+
+constexpr std::uint64_t kPrime32_1 = 0x9E3779B1U;
+constexpr std::uint64_t kPrime32_2 = 0x85EBCA77U;
+constexpr std::uint64_t kPrime32_3 = 0xC2B2AE3DU;
+constexpr std::uint64_t kPrime64_1 = 0x9E3779B185EBCA87ULL;
+constexpr std::uint64_t kPrime64_2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr std::uint64_t kPrime64_3 = 0x165667B19E3779F9ULL;
+constexpr std::uint64_t kPrime64_4 = 0x85EBCA77C2B2AE63ULL;
+constexpr std::uint64_t kPrime64_5 = 0x27D4EB2F165667C5ULL;
+constexpr std::uint64_t kPrimeMx1 = 0x165667919E3779F9ULL;
+constexpr std::uint64_t kPrimeMx2 = 0x9FB21C651E98DF25ULL;
+
+constexpr std::size_t kStripeLength = 64;
+constexpr std::size_t kSecretSize = 192;
+constexpr std::size_t kStripesPerBlock = (kSecretSize - kStripeLength) / 8;
+constexpr std::size_t kBlockLength = kStripeLength * kStripesPerBlock;
+constexpr std::size_t kMidSizeMax = 240;
+
+constexpr std::uint8_t kXxh3Secret[kSecretSize] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e};
+
+std::uint32_t read_le32(const std::uint8_t* p) {
+  std::uint32_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+std::uint64_t read_le64(const std::uint8_t* p) {
+  std::uint64_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+constexpr std::uint64_t rotl64(std::uint64_t value, int bits) { return (value << bits) | (value >> (64 - bits)); }
+
+std::uint64_t mul128_fold64(std::uint64_t lhs, std::uint64_t rhs) {
+  const unsigned __int128 product = static_cast<unsigned __int128>(lhs) * rhs;
+  return static_cast<std::uint64_t>(product) ^ static_cast<std::uint64_t>(product >> 64);
+}
+
+std::uint64_t xxh64_avalanche(std::uint64_t h) {
+  h ^= h >> 33;
+  h *= kPrime64_2;
+  h ^= h >> 29;
+  h *= kPrime64_3;
+  return h ^ (h >> 32);
+}
+
+std::uint64_t xxh3_avalanche(std::uint64_t h) {
+  h ^= h >> 37;
+  h *= kPrimeMx1;
+  return h ^ (h >> 32);
+}
+
+std::uint64_t rrmxmx(std::uint64_t h, std::uint64_t length) {
+  h ^= rotl64(h, 49) ^ rotl64(h, 24);
+  h *= kPrimeMx2;
+  h ^= (h >> 35) + length;
+  h *= kPrimeMx2;
+  return h ^ (h >> 28);
+}
+
+std::uint64_t mix16(const std::uint8_t* input, const std::uint8_t* secret) {
+  return mul128_fold64(read_le64(input) ^ read_le64(secret), read_le64(input + 8) ^ read_le64(secret + 8));
+}
+
+// Inputs of at most 240 bytes never reach the striped accumulator.
+std::uint64_t xxh3_short(const std::uint8_t* input, std::size_t length) {
+  const std::uint8_t* secret = kXxh3Secret;
+  if (length == 0) return xxh64_avalanche(read_le64(secret + 56) ^ read_le64(secret + 64));
+  if (length <= 3) {
+    const std::uint32_t combined = (static_cast<std::uint32_t>(input[0]) << 16)
+        | (static_cast<std::uint32_t>(input[length >> 1]) << 24) | static_cast<std::uint32_t>(input[length - 1])
+        | (static_cast<std::uint32_t>(length) << 8);
+    const std::uint64_t bitflip = read_le32(secret) ^ read_le32(secret + 4);
+    return xxh64_avalanche(combined ^ bitflip);
+  }
+  if (length <= 8) {
+    const std::uint64_t bitflip = read_le64(secret + 8) ^ read_le64(secret + 16);
+    const std::uint64_t value = read_le32(input + length - 4) + (static_cast<std::uint64_t>(read_le32(input)) << 32);
+    return rrmxmx(value ^ bitflip, length);
+  }
+  if (length <= 16) {
+    const std::uint64_t low = read_le64(input) ^ (read_le64(secret + 24) ^ read_le64(secret + 32));
+    const std::uint64_t high = read_le64(input + length - 8) ^ (read_le64(secret + 40) ^ read_le64(secret + 48));
+    return xxh3_avalanche(length + __builtin_bswap64(low) + high + mul128_fold64(low, high));
+  }
+  std::uint64_t acc = length * kPrime64_1;
+  if (length <= 128) {
+    if (length > 32) {
+      if (length > 64) {
+        if (length > 96) {
+          acc += mix16(input + 48, secret + 96);
+          acc += mix16(input + length - 64, secret + 112);
+        }
+        acc += mix16(input + 32, secret + 64);
+        acc += mix16(input + length - 48, secret + 80);
+      }
+      acc += mix16(input + 16, secret + 32);
+      acc += mix16(input + length - 32, secret + 48);
+    }
+    acc += mix16(input, secret);
+    acc += mix16(input + length - 16, secret + 16);
+    return xxh3_avalanche(acc);
+  }
+  const std::size_t rounds = length / 16;
+  for (std::size_t i = 0; i < 8; ++i) acc += mix16(input + 16 * i, secret + 16 * i);
+  acc = xxh3_avalanche(acc);
+  for (std::size_t i = 8; i < rounds; ++i) acc += mix16(input + 16 * i, secret + 16 * (i - 8) + 3);
+  acc += mix16(input + length - 16, secret + 136 - 17);
+  return xxh3_avalanche(acc);
+}
+
+void accumulate_stripe(std::uint64_t* acc, const std::uint8_t* input, const std::uint8_t* secret) {
+  for (int i = 0; i < 8; ++i) {
+    const std::uint64_t value = read_le64(input + 8 * i);
+    const std::uint64_t keyed = value ^ read_le64(secret + 8 * i);
+    acc[i ^ 1] += value;
+    acc[i] += (keyed & 0xFFFFFFFFU) * (keyed >> 32);
+  }
+}
+
+void scramble(std::uint64_t* acc) {
+  const std::uint8_t* secret = kXxh3Secret + kSecretSize - kStripeLength;
+  for (int i = 0; i < 8; ++i) {
+    std::uint64_t value = acc[i];
+    value ^= value >> 47;
+    value ^= read_le64(secret + 8 * i);
+    acc[i] = value * kPrime32_1;
+  }
+}
+
+// Feeds whole stripes, scrambling at each block boundary.
+void consume_stripes(std::uint64_t* acc, std::size_t& stripes_in_block, const std::uint8_t* input,
+                     std::size_t stripes) {
+  while (stripes > 0) {
+    const std::size_t take = std::min(stripes, kStripesPerBlock - stripes_in_block);
+    for (std::size_t i = 0; i < take; ++i) {
+      accumulate_stripe(acc, input + i * kStripeLength, kXxh3Secret + (stripes_in_block + i) * 8);
+    }
+    input += take * kStripeLength;
+    stripes -= take;
+    stripes_in_block += take;
+    if (stripes_in_block == kStripesPerBlock) {
+      scramble(acc);
+      stripes_in_block = 0;
+    }
+  }
+}
+
+}  // namespace
+
+Sha256::Sha256() { std::memcpy(state_.data(), kSha256Init, sizeof(kSha256Init)); }
+
+void Sha256::compress(const std::uint8_t* block) {
+  std::uint32_t w[64];
+  for (int i = 0; i < 16; ++i) {
+    w[i] = (static_cast<std::uint32_t>(block[i * 4]) << 24) | (static_cast<std::uint32_t>(block[i * 4 + 1]) << 16)
+        | (static_cast<std::uint32_t>(block[i * 4 + 2]) << 8) | static_cast<std::uint32_t>(block[i * 4 + 3]);
+  }
+  for (int i = 16; i < 64; ++i) {
+    const std::uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    const std::uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+  std::uint32_t a = state_[0], b = state_[1], c = state_[2], d = state_[3];
+  std::uint32_t e = state_[4], f = state_[5], g = state_[6], h = state_[7];
+  for (int i = 0; i < 64; ++i) {
+    const std::uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + kSha256Rounds[i] + w[i];
+    const std::uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+    h = g;
+    g = f;
+    f = e;
+    e = d + t1;
+    d = c;
+    c = b;
+    b = a;
+    a = t1 + t2;
+  }
+  state_[0] += a;
+  state_[1] += b;
+  state_[2] += c;
+  state_[3] += d;
+  state_[4] += e;
+  state_[5] += f;
+  state_[6] += g;
+  state_[7] += h;
+}
+
+void Sha256::update(const void* data, std::size_t size) {
+  const auto* bytes = static_cast<const std::uint8_t*>(data);
+  total_bytes_ += size;
+  if (buffered_ > 0) {
+    const std::size_t take = std::min(size, buffer_.size() - buffered_);
+    std::memcpy(buffer_.data() + buffered_, bytes, take);
+    buffered_ += take;
+    bytes += take;
+    size -= take;
+    if (buffered_ < buffer_.size()) return;
+    compress(buffer_.data());
+    buffered_ = 0;
+  }
+  for (; size >= 64; bytes += 64, size -= 64) compress(bytes);
+  std::memcpy(buffer_.data(), bytes, size);
+  buffered_ = size;
+}
+
+std::string Sha256::hex_digest() {
+  const std::uint64_t bit_length = total_bytes_ * 8;
+  const std::uint8_t pad = 0x80;
+  update(&pad, 1);
+  const std::uint8_t zero = 0;
+  while (buffered_ != 56) update(&zero, 1);
+  std::uint8_t length[8];
+  for (int i = 0; i < 8; ++i) length[i] = static_cast<std::uint8_t>(bit_length >> (56 - i * 8));
+  update(length, sizeof(length));
+
+  static constexpr char kHex[] = "0123456789abcdef";
+  std::string hex;
+  hex.reserve(64);
+  for (const std::uint32_t word : state_) {
+    for (int shift = 28; shift >= 0; shift -= 4) hex.push_back(kHex[(word >> shift) & 0x0F]);
+  }
+  return hex;
+}
+
+Xxh3::Xxh3()
+    : acc_{kPrime32_3, kPrime64_1, kPrime64_2, kPrime64_3, kPrime64_4, kPrime32_2, kPrime64_5, kPrime32_1} {}
+
+void Xxh3::update(const void* data, std::size_t size) {
+  const auto* bytes = static_cast<const std::uint8_t*>(data);
+  total_bytes_ += size;
+  if (size <= kBufferSize - buffered_) {
+    std::memcpy(buffer_.data() + buffered_, bytes, size);
+    buffered_ += size;
+    return;
+  }
+  // The final stripe is hashed differently, so at least one byte always
+  // stays buffered for digest().
+  if (buffered_ > 0) {
+    const std::size_t take = kBufferSize - buffered_;
+    std::memcpy(buffer_.data() + buffered_, bytes, take);
+    bytes += take;
+    size -= take;
+    consume_stripes(acc_.data(), stripes_in_block_, buffer_.data(), kBufferSize / kStripeLength);
+    buffered_ = 0;
+  }
+  if (size > kBufferSize) {
+    const std::size_t stripes = (size - 1) / kStripeLength;
+    consume_stripes(acc_.data(), stripes_in_block_, bytes, stripes);
+    bytes += stripes * kStripeLength;
+    size -= stripes * kStripeLength;
+    // digest() may need the tail of the last consumed stripe.
+    std::memcpy(buffer_.data() + kBufferSize - kStripeLength, bytes - kStripeLength, kStripeLength);
+  }
+  std::memcpy(buffer_.data(), bytes, size);
+  buffered_ = size;
+}
+
+std::uint64_t Xxh3::digest() const {
+  if (total_bytes_ <= kMidSizeMax) return xxh3_short(buffer_.data(), static_cast<std::size_t>(total_bytes_));
+  std::array<std::uint64_t, 8> acc = acc_;
+  const std::uint8_t* last_stripe_secret = kXxh3Secret + kSecretSize - kStripeLength - 7;
+  if (buffered_ >= kStripeLength) {
+    std::size_t stripes_in_block = stripes_in_block_;
+    consume_stripes(acc.data(), stripes_in_block, buffer_.data(), (buffered_ - 1) / kStripeLength);
+    accumulate_stripe(acc.data(), buffer_.data() + buffered_ - kStripeLength, last_stripe_secret);
+  } else {
+    std::uint8_t last_stripe[kStripeLength];
+    const std::size_t catchup = kStripeLength - buffered_;
+    std::memcpy(last_stripe, buffer_.data() + kBufferSize - catchup, catchup);
+    std::memcpy(last_stripe + catchup, buffer_.data(), buffered_);
+    accumulate_stripe(acc.data(), last_stripe, last_stripe_secret);
+  }
+  std::uint64_t result = total_bytes_ * kPrime64_1;
+  for (int i = 0; i < 4; ++i) {
+    result += mul128_fold64(acc[2 * i] ^ read_le64(kXxh3Secret + 11 + 16 * i),
+                            acc[2 * i + 1] ^ read_le64(kXxh3Secret + 11 + 16 * i + 8));
+  }
+  return xxh3_avalanche(result);
+}
+
+std::string Xxh3::hex_digest() const {
+  static constexpr char kHex[] = "0123456789abcdef";
+  const std::uint64_t value = digest();
+  std::string hex;
+  hex.reserve(16);
+  for (int shift = 60; shift >= 0; shift -= 4) hex.push_back(kHex[(value >> shift) & 0x0F]);
+  return hex;
+}
+
+ContentDigest ContentHasher::finish() {
+  ContentDigest digest;
+  digest.sha256 = sha256_.hex_digest();
+  digest.xxh3 = xxh3_.hex_digest();
+  digest.size = size_;
+  return digest;
+}
+
+std::string sha256_hex(std::string_view data) {
+  Sha256 hasher;
+  hasher.update(data);
+  return hasher.hex_digest();
+}
+
+std::string xxh3_hex(std::string_view data) {
+  Xxh3 hasher;
+  hasher.update(data);
+  return hasher.hex_digest();
+}
+
+std::optional<ContentDigest> digest_file(const std::string& path) {
+  std::FILE* file = std::fopen(path.c_str(), "rb");
+  if (!file) return std::nullopt;
+  ContentHasher hasher;
+  std::vector<char> buffer(1 << 16);
+  std::size_t read = 0;
+  while ((read = std::fread(buffer.data(), 1, buffer.size(), file)) > 0) hasher.update(buffer.data(), read);
+  const bool ok = std::ferror(file) == 0;
+  std::fclose(file);
+  if (!ok) return std::nullopt;
+  return hasher.finish();
+}
+
+}  // namespace radicc
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace radicc {
+
+// Incremental SHA-256 (FIPS 180-4).
+class Sha256 {
+ public:
+  Sha256();
+  void update(const void* data, std::size_t size);
+  void update(std::string_view data) { update(data.data(), data.size()); }
+  // Lowercase hex digest; the hasher must not be updated afterwards.
+  std::string hex_digest();
+
+ private:
+  void compress(const std::uint8_t* block);
+
+  std::array<std::uint32_t, 8> state_;
+  std::array<std::uint8_t, 64> buffer_{};
+  std::size_t buffered_ = 0;
+  std::uint64_t total_bytes_ = 0;
+};
+
+// Incremental XXH3 64-bit, seed 0 and the default secret; the digest is
+// the canonical big-endian hex form `xxhsum -H3` prints.
+class Xxh3 {
+ public:
+  Xxh3();
+  void update(const void* data, std::size_t size);
+  void update(std::string_view data) { update(data.data(), data.size()); }
+  std::uint64_t digest() const;
+  std::string hex_digest() const;
+
+ private:
+  static constexpr std::size_t kBufferSize = 256;
+
+  std::array<std::uint64_t, 8> acc_;
+  std::array<std::uint8_t, kBufferSize> buffer_{};
+  std::size_t buffered_ = 0;
+  std::size_t stripes_in_block_ = 0;
+  std::uint64_t total_bytes_ = 0;
+};
+
+struct ContentDigest {
+  std::string sha256;
+  std::string xxh3;
+  std::uint64_t size = 0;
+};
+
+// Both digests over one pass of the bytes, as they are written.
+class ContentHasher {
+ public:
+  void update(const void* data, std::size_t size) {
+    sha256_.update(data, size);
+    xxh3_.update(data, size);
+    size_ += size;
+  }
+  ContentDigest finish();
+
+ private:
+  Sha256 sha256_;
+  Xxh3 xxh3_;
+  std::uint64_t size_ = 0;
+};
+
+std::string sha256_hex(std::string_view data);
+std::string xxh3_hex(std::string_view data);
+// Reads the whole file; for outputs that were not hashed while written.
+std::optional<ContentDigest> digest_file(const std::string& path);
+
+}  // namespace radicc
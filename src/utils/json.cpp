@@ -0,0 +1,406 @@
+#include "utils/json.h"
+
+#include "utils/text_fold.h"
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <charconv>
+#include <ostream>
+
+namespace radicc {
+namespace {
+
+constexpr int kMaxDepth = 64;
+
+bool write_fd(int fd, std::string_view data) {
+  while (!data.empty()) {
+    const ssize_t n = ::write(fd, data.data(), data.size());
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    data.remove_prefix(static_cast<std::size_t>(n));
+  }
+  return true;
+}
+
+class Parser {
+ public:
+  explicit Parser(std::string_view text) : text_(text) {}
+
+  // The whole text as one object.
+  bool parse_document(std::vector<std::pair<std::string, JsonValue>>& members) {
+    skip_space();
+    if (!consume('{')) return false;
+    skip_space();
+    if (!consume('}')) {
+      do {
+        skip_space();
+        std::pair<std::string, JsonValue> member;
+        if (!parse_string(&member.first)) return false;
+        skip_space();
+        if (!consume(':') || !parse_value(&member.second, 1)) return false;
+        members.push_back(std::move(member));
+        skip_space();
+      } while (consume(','));
+      if (!consume('}')) return false;
+    }
+    skip_space();
+    return at_end();
+  }
+
+ private:
+  bool at_end() const { return position_ >= text_.size(); }
+  char peek() const { return at_end() ? '\0' : text_[position_]; }
+  bool consume(char c) {
+    if (peek() != c) return false;
+    ++position_;
+    return true;
+  }
+  bool consume(std::string_view word) {
+    if (text_.substr(position_, word.size()) != word) return false;
+    position_ += word.size();
+    return true;
+  }
+  void skip_space() {
+    while (!at_end() && (peek() == ' ' || peek() == '\t' || peek() == '\n' || peek() == '\r')) ++position_;
+  }
+  bool digits() {
+    const std::size_t start = position_;
+    while (!at_end() && peek() >= '0' && peek() <= '9') ++position_;
+    return position_ > start;
+  }
+
+  // `out` may be null when the value is only validated.
+  bool parse_value(JsonValue* out, int depth) {
+    skip_space();
+    const std::size_t start = position_;
+    JsonValue::Kind kind;
+    switch (peek()) {
+      case '"':
+        if (out) out->kind = JsonValue::Kind::string;
+        return parse_string(out ? &out->text : nullptr);
+      case '{':
+        kind = JsonValue::Kind::object;
+        if (!parse_container(depth, '}', true)) return false;
+        break;
+      case '[':
+        kind = JsonValue::Kind::array;
+        if (!parse_container(depth, ']', false)) return false;
+        break;
+      case 't':
+      case 'f':
+        if (out) {
+          out->kind = JsonValue::Kind::boolean;
+          out->boolean = peek() == 't';
+        }
+        return consume("true") || consume("false");
+      case 'n':
+        if (out) out->kind = JsonValue::Kind::null;
+        return consume("null");
+      default:
+        kind = JsonValue::Kind::number;
+        if (!parse_number()) return false;
+    }
+    if (out) {
+      out->kind = kind;
+      out->text.assign(text_.substr(start, position_ - start));
+    }
+    return true;
+  }
+
+  bool parse_container(int depth, char closing, bool is_object) {
+    if (depth >= kMaxDepth) return false;
+    ++position_;
+    skip_space();
+    if (consume(closing)) return true;
+    do {
+      skip_space();
+      if (is_object) {
+        if (!parse_string(nullptr)) return false;
+        skip_space();
+        if (!consume(':')) return false;
+      }
+      if (!parse_value(nullptr, depth + 1)) return false;
+      skip_space();
+    } while (consume(','));
+    return consume(closing);
+  }
+
+  bool parse_number() {
+    consume('-');
+    if (!consume('0') && !digits()) return false;
+    if (consume('.') && !digits()) return false;
+    if (consume('e') || consume('E')) {
+      if (!consume('+')) consume('-');
+      if (!digits()) return false;
+    }
+    return true;
+  }
+
+  bool parse_hex4(char32_t& code_unit) {
+    if (text_.size() - position_ < 4) return false;
+    unsigned value = 0;
+    const auto [end, error] = std::from_chars(text_.data() + position_, text_.data() + position_ + 4, value, 16);
+    if (error != std::errc() || end != text_.data() + position_ + 4) return false;
+    position_ += 4;
+    code_unit = value;
+    return true;
+  }
+
+  bool parse_string(std::string* out) {
+    if (!consume('"')) return false;
+    while (!at_end()) {
+      // Copy the run up to the next quote, escape or control character at once.
+      const std::size_t run_start = position_;
+      while (!at_end() && peek() != '"' && peek() != '\\' && static_cast<unsigned char>(peek()) >= 0x20) ++position_;
+      if (out) out->append(text_.substr(run_start, position_ - run_start));
+      if (at_end()) return false;
+      const char c = text_[position_++];
+      if (c == '"') return true;
+      if (c != '\\' || at_end()) return false;
+      const char escape = text_[position_++];
+      char decoded = 0;
+      switch (escape) {
+        case '"': decoded = '"'; break;
+        case '\\': decoded = '\\'; break;
+        case '/': decoded = '/'; break;
+        case 'b': decoded = '\b'; break;
+        case 'f': decoded = '\f'; break;
+        case 'n': decoded = '\n'; break;
+        case 'r': decoded = '\r'; break;
+        case 't': decoded = '\t'; break;
+        case 'u': {
+          char32_t code_point = 0;
+          if (!parse_hex4(code_point)) return false;
+          if (code_point >= 0xD800 && code_point <= 0xDBFF) {
+            char32_t low = 0;
+            if (!consume("\\u") || !parse_hex4(low) || low < 0xDC00 || low > 0xDFFF) return false;
+            code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+          } else if (code_point >= 0xDC00 && code_point <= 0xDFFF) {
+            return false;
+          }
+          if (out) append_utf8(*out, code_point);
+          continue;
+        }
+        default:
+          return false;
+      }
+      if (out) out->push_back(decoded);
+    }
+    return false;
+  }
+
+  std::string_view text_;
+  std::size_t position_ = 0;
+};
+
+}  // namespace
+
+void append_json_escaped(std::string& out, std::string_view text) {
+  static constexpr char kHex[] = "0123456789ABCDEF";
+  std::size_t run_start = 0;
+  for (std::size_t i = 0; i < text.size(); ++i) {
+    const auto c = static_cast<unsigned char>(text[i]);
+    if (c >= 0x20 && c != '"' && c != '\\') continue;
+    out.append(text.data() + run_start, i - run_start);
+    run_start = i + 1;
+    switch (c) {
+      case '\\': out += "\\\\"; break;
+      case '"': out += "\\\""; break;
+      case '\b': out += "\\b"; break;
+      case '\f': out += "\\f"; break;
+      case '\n': out += "\\n"; break;
+      case '\r': out += "\\r"; break;
+      case '\t': out += "\\t"; break;
+      default:
+        out += "\\u00";
+        out.push_back(kHex[c >> 4]);
+        out.push_back(kHex[c & 0x0F]);
+    }
+  }
+  out.append(text.data() + run_start, text.size() - run_start);
+}
+
+JsonWriter::JsonWriter(int fd, std::size_t flush_bytes)
+    : sink_([fd](std::string_view data) { return write_fd(fd, data); }), flush_bytes_(flush_bytes) {}
+
+JsonWriter::JsonWriter(std::ostream& out, std::size_t flush_bytes)
+    : sink_([&out](std::string_view data) {
+        out.write(data.data(), static_cast<std::streamsize>(data.size()));
+        return static_cast<bool>(out);
+      }),
+      flush_bytes_(flush_bytes) {}
+
+void JsonWriter::before_value() {
+  if (after_key_) {
+    after_key_ = false;
+    return;
+  }
+  if (depth_ == 0 || depth_ > kMaxDepth) return;
+  const std::uint64_t bit = std::uint64_t{1} << (depth_ - 1);
+  if (has_items_ & bit) buffer_.push_back(',');
+  has_items_ |= bit;
+}
+
+void JsonWriter::open(char bracket) {
+  before_value();
+  buffer_.push_back(bracket);
+  // Deeper containers cannot track their commas; the document is invalid,
+  // but depth keeps counting so closing brackets still pair up.
+  if (++depth_ > kMaxDepth) {
+    ok_ = false;
+    return;
+  }
+  has_items_ &= ~(std::uint64_t{1} << (depth_ - 1));
+}
+
+void JsonWriter::close(char bracket) {
+  buffer_.push_back(bracket);
+  if (depth_ > 0) --depth_;
+  maybe_flush();
+}
+
+JsonWriter& JsonWriter::begin_object() {
+  open('{');
+  return *this;
+}
+
+JsonWriter& JsonWriter::end_object() {
+  close('}');
+  return *this;
+}
+
+JsonWriter& JsonWriter::begin_array() {
+  open('[');
+  return *this;
+}
+
+JsonWriter& JsonWriter::end_array() {
+  close(']');
+  return *this;
+}
+
+JsonWriter& JsonWriter::key(std::string_view name) {
+  before_value();
+  buffer_.push_back('"');
+  append_json_escaped(buffer_, name);
+  buffer_ += "\":";
+  after_key_ = true;
+  return *this;
+}
+
+JsonWriter& JsonWriter::value(std::string_view text) {
+  before_value();
+  buffer_.push_back('"');
+  append_json_escaped(buffer_, text);
+  buffer_.push_back('"');
+  return *this;
+}
+
+JsonWriter& JsonWriter::value(bool flag) {
+  before_value();
+  buffer_ += flag ? "true" : "false";
+  return *this;
+}
+
+JsonWriter& JsonWriter::integer(long long number) {
+  before_value();
+  char digits[24];
+  const auto result = std::to_chars(digits, digits + sizeof(digits), number);
+  buffer_.append(digits, result.ptr);
+  return *this;
+}
+
+JsonWriter& JsonWriter::unsigned_integer(unsigned long long number) {
+  before_value();
+  char digits[24];
+  const auto result = std::to_chars(digits, digits + sizeof(digits), number);
+  buffer_.append(digits, result.ptr);
+  return *this;
+}
+
+JsonWriter& JsonWriter::value(double number, int precision) {
+  before_value();
+  char digits[64];
+  const auto result = std::to_chars(digits, digits + sizeof(digits), number, std::chars_format::fixed, precision);
+  if (result.ec != std::errc()) {
+    buffer_ += "null";
+  } else {
+    buffer_.append(digits, result.ptr);
+  }
+  return *this;
+}
+
+JsonWriter& JsonWriter::null() {
+  before_value();
+  buffer_ += "null";
+  return *this;
+}
+
+JsonWriter& JsonWriter::raw(std::string_view json) {
+  before_value();
+  buffer_.append(json);
+  return *this;
+}
+
+std::string JsonWriter::take() {
+  std::string taken = std::move(buffer_);
+  reset();
+  return taken;
+}
+
+void JsonWriter::reset() {
+  buffer_.clear();
+  has_items_ = 0;
+  depth_ = 0;
+  after_key_ = false;
+}
+
+bool JsonWriter::flush() {
+  if (sink_ && !buffer_.empty()) {
+    if (ok_) ok_ = sink_(buffer_);
+    buffer_.clear();
+  }
+  return ok_;
+}
+
+void JsonWriter::maybe_flush() {
+  if (sink_ && buffer_.size() >= flush_bytes_) flush();
+}
+
+const JsonValue* JsonObject::find(std::string_view name) const {
+  for (const auto& [member_name, member_value] : members_) {
+    if (member_name == name) return &member_value;
+  }
+  return nullptr;
+}
+
+std::optional<std::string> JsonObject::get_string(std::string_view name) const {
+  const JsonValue* found = find(name);
+  if (!found || found->kind != JsonValue::Kind::string) return std::nullopt;
+  return found->text;
+}
+
+std::optional<std::int64_t> JsonObject::get_integer(std::string_view name) const {
+  const JsonValue* found = find(name);
+  if (!found || found->kind != JsonValue::Kind::number) return std::nullopt;
+  std::int64_t number = 0;
+  const char* end = found->text.data() + found->text.size();
+  const auto result = std::from_chars(found->text.data(), end, number);
+  if (result.ec != std::errc() || result.ptr != end) return std::nullopt;
+  return number;
+}
+
+std::optional<bool> JsonObject::get_bool(std::string_view name) const {
+  const JsonValue* found = find(name);
+  if (!found || found->kind != JsonValue::Kind::boolean) return std::nullopt;
+  return found->boolean;
+}
+
+std::optional<JsonObject> parse_json_object(std::string_view text) {
+  JsonObject object;
+  if (!Parser(text).parse_document(object.members_)) return std::nullopt;
+  return object;
+}
+
+}  // namespace radicc
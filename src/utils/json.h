@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace radicc {
+
+// Appends `text` to `out` as the contents of a JSON string (no quotes).
+void append_json_escaped(std::string& out, std::string_view text);
+
+// Streaming JSON writer. Values are escaped straight into one buffer that
+// is reused across documents; with a sink the buffer is handed on whenever
+// it passes `flush_bytes`, so a long array never exists as a whole string.
+// Commas are placed automatically; nesting is limited to 64 levels, and
+// deeper output marks the writer not ok().
+//
+//   JsonWriter json;
+//   json.begin_object().member("title", title).member("size", size).end_object();
+//   send(json.str());
+class JsonWriter {
+ public:
+  static constexpr std::size_t kDefaultFlushBytes = 64 * 1024;
+
+  JsonWriter() = default;
+  // Writes to the file descriptor `fd`, e.g. a client socket.
+  explicit JsonWriter(int fd, std::size_t flush_bytes = kDefaultFlushBytes);
+  explicit JsonWriter(std::ostream& out, std::size_t flush_bytes = kDefaultFlushBytes);
+
+  JsonWriter& begin_object();
+  JsonWriter& end_object();
+  JsonWriter& begin_array();
+  JsonWriter& end_array();
+  JsonWriter& key(std::string_view name);
+
+  JsonWriter& value(std::string_view text);
+  JsonWriter& value(const std::string& text) { return value(std::string_view(text)); }
+  JsonWriter& value(const char* text) { return value(std::string_view(text)); }
+  JsonWriter& value(bool flag);
+  template <typename T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>, int> = 0>
+  JsonWriter& value(T number) {
+    if constexpr (std::is_signed_v<T>) {
+      return integer(static_cast<long long>(number));
+    } else {
+      return unsigned_integer(static_cast<unsigned long long>(number));
+    }
+  }
+  // Fixed notation with `precision` digits after the point.
+  JsonWriter& value(double number, int precision);
+  JsonWriter& value(double number) = delete;  // would otherwise convert to bool
+  JsonWriter& null();
+  // An already serialized JSON value.
+  JsonWriter& raw(std::string_view json);
+
+  template <typename T>
+  JsonWriter& member(std::string_view name, const T& member_value) {
+    return key(name).value(member_value);
+  }
+  JsonWriter& member(std::string_view name, double number, int precision) {
+    return key(name).value(number, precision);
+  }
+
+  // Output not handed to the sink yet; everything without a sink.
+  const std::string& str() const { return buffer_; }
+  std::string take();
+  // Clears the output and nesting, keeping the buffer's capacity.
+  void reset();
+  // Hands buffered output to the sink. False once any write failed or the
+  // nesting limit was passed.
+  bool flush();
+  bool ok() const { return ok_; }
+
+ private:
+  void before_value();
+  void open(char bracket);
+  void close(char bracket);
+  JsonWriter& integer(long long number);
+  JsonWriter& unsigned_integer(unsigned long long number);
+  void maybe_flush();
+
+  std::string buffer_;
+  std::function<bool(std::string_view)> sink_;
+  std::size_t flush_bytes_ = kDefaultFlushBytes;
+  std::uint64_t has_items_ = 0;  // bit n: the container at depth n has a value
+  int depth_ = 0;
+  bool after_key_ = false;
+  bool ok_ = true;
+};
+
+struct JsonValue {
+  enum class Kind { null, boolean, number, string, object, array };
+  Kind kind = Kind::null;
+  // Decoded contents of a string; the source text of a number, object or array.
+  std::string text;
+  bool boolean = false;
+};
+
+// Top-level members of a JSON object. Nested objects and arrays are
+// validated but kept as source text.
+class JsonObject {
+ public:
+  // The first member named `name`, or null.
+  const JsonValue* find(std::string_view name) const;
+  // nullopt when the member is missing or of another type.
+  std::optional<std::string> get_string(std::string_view name) const;
+  std::optional<std::int64_t> get_integer(std::string_view name) const;
+  std::optional<bool> get_bool(std::string_view name) const;
+
+ private:
+  friend std::optional<JsonObject> parse_json_object(std::string_view text);
+  std::vector<std::pair<std::string, JsonValue>> members_;
+};
+
+// Reads a JSON object in one pass, without backtracking. nullopt when
+// `text` is not exactly one well-formed object.
+std::optional<JsonObject> parse_json_object(std::string_view text);
+
+}  // namespace radicc
@@ -0,0 +1,83 @@
+#include "utils/local_socket.h"
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+namespace radicc {
+namespace {
+
+bool fill_address(const std::string& path, sockaddr_un& address) {
+  if (path.empty() || path.size() >= sizeof(address.sun_path)) return false;
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+  return true;
+}
+
+}  // namespace
+
+std::string local_socket_path() {
+  if (const char* path = std::getenv("RADICC_SOCKET"); path && *path != '\0') return path;
+  const char* runtime_dir = std::getenv("XDG_RUNTIME_DIR");
+  if (!runtime_dir || *runtime_dir == '\0') return {};
+  return std::string(runtime_dir) + "/radicc/radicc.sock";
+}
+
+int connect_local_socket(const std::string& path) {
+  sockaddr_un address;
+  if (!fill_address(path, address)) return -1;
+  const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) return -1;
+  if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+    ::close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+int listen_local_socket(const std::string& path) {
+  sockaddr_un address;
+  if (!fill_address(path, address)) return -1;
+  const std::size_t slash = path.rfind('/');
+  if (slash != std::string::npos && slash > 0) {
+    const std::string directory = path.substr(0, slash);
+    if (::mkdir(directory.c_str(), 0700) != 0 && errno != EEXIST) return -1;
+  }
+
+  // A socket file nobody answers on is left over from a server that died.
+  const int existing = connect_local_socket(path);
+  if (existing >= 0) {
+    ::close(existing);
+    errno = EADDRINUSE;
+    return -1;
+  }
+  // Anything else at the path is not ours to remove.
+  struct stat st;
+  if (::lstat(path.c_str(), &st) == 0) {
+    if (!S_ISSOCK(st.st_mode)) {
+      errno = EEXIST;
+      return -1;
+    }
+    ::unlink(path.c_str());
+  }
+
+  const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) return -1;
+  // The directory is private already; keep the socket owner-only as well.
+  if (::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::chmod(path.c_str(), 0600) != 0 ||
+      ::listen(fd, 16) != 0) {
+    const int saved = errno;
+    ::close(fd);
+    errno = saved;
+    return -1;
+  }
+  return fd;
+}
+
+}  // namespace radicc
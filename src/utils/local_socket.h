@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+
+namespace radicc {
+
+// `$XDG_RUNTIME_DIR/radicc/radicc.sock` (or RADICC_SOCKET), where
+// radicc-server listens for local CLI clients. Empty when neither is set.
+std::string local_socket_path();
+
+// A stream socket connected to `path`, or -1 when nothing listens there.
+int connect_local_socket(const std::string& path);
+
+// A listening socket at `path`, readable only by the current user. Creates
+// the directory and replaces a socket file left behind by a dead server;
+// returns -1 when another server is already listening there, something
+// other than a socket holds the path, or binding fails.
+int listen_local_socket(const std::string& path);
+
+}  // namespace radicc
@@ -0,0 +1,249 @@
+#include "utils/log.h"
+
+#include "utils/json.h"
+
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <thread>
+#include <utility>
+
+namespace radicc {
+namespace {
+
+constexpr std::size_t kRingSlots = 4096;
+
+thread_local LogContext t_log_context;
+
+LogLevel parse_log_level(const char* value) {
+  if (!value) return LogLevel::info;
+  if (std::strcmp(value, "debug") == 0) return LogLevel::debug;
+  if (std::strcmp(value, "warn") == 0 || std::strcmp(value, "warning") == 0) return LogLevel::warn;
+  if (std::strcmp(value, "error") == 0) return LogLevel::error;
+  return LogLevel::info;
+}
+
+LogFormat log_format_from_env() {
+  const char* value = std::getenv("RADICC_LOG_FORMAT");
+  return value && std::strcmp(value, "json") == 0 ? LogFormat::json : LogFormat::text;
+}
+
+std::string utc_timestamp() {
+  const auto now = std::chrono::system_clock::now();
+  const std::time_t seconds = std::chrono::system_clock::to_time_t(now);
+  const auto millis =
+      std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count() % 1000;
+  std::tm tm{};
+  gmtime_r(&seconds, &tm);
+  char buffer[48];
+  std::snprintf(buffer, sizeof(buffer), "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ", tm.tm_year + 1900, tm.tm_mon + 1,
+                tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, static_cast<int>(millis));
+  return buffer;
+}
+
+// Bounded multi-producer, single-consumer ring (Vyukov). A slot's sequence
+// tells producers and the flusher whose turn it is, so neither side locks.
+class LogRing {
+ public:
+  LogRing() {
+    for (std::size_t i = 0; i < kRingSlots; ++i) slots_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  bool push(std::string& line) {
+    std::size_t position = tail_.load(std::memory_order_relaxed);
+    Slot* slot = nullptr;
+    while (true) {
+      slot = &slots_[position % kRingSlots];
+      const std::size_t sequence = slot->sequence.load(std::memory_order_acquire);
+      const auto lag = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position);
+      if (lag == 0) {
+        if (tail_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) break;
+      } else if (lag < 0) {
+        return false;  // full
+      } else {
+        position = tail_.load(std::memory_order_relaxed);
+      }
+    }
+    slot->line = std::move(line);
+    slot->sequence.store(position + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Flusher thread only.
+  bool pop(std::string& line) {
+    Slot& slot = slots_[head_ % kRingSlots];
+    if (slot.sequence.load(std::memory_order_acquire) != head_ + 1) return false;
+    line = std::move(slot.line);
+    slot.sequence.store(head_ + kRingSlots, std::memory_order_release);
+    ++head_;
+    return true;
+  }
+
+ private:
+  struct alignas(64) Slot {
+    std::atomic<std::size_t> sequence{0};
+    std::string line;
+  };
+
+  std::array<Slot, kRingSlots> slots_;
+  alignas(64) std::atomic<std::size_t> tail_{0};
+  std::size_t head_ = 0;
+};
+
+class Logger {
+ public:
+  Logger() : format_(log_format_from_env()), flusher_([this]() { run(); }) {
+    flusher_.detach();
+    std::atexit([]() { flush_log(); });
+  }
+
+  LogFormat format() const { return format_; }
+
+  void submit(std::string line) {
+    // A full ring means the flusher is behind; wait for room rather than
+    // drop lines, which are often the last words before a failure.
+    while (!ring_.push(line)) {
+      pushed_.notify_one();
+      std::this_thread::yield();
+    }
+    pushed_.fetch_add(1, std::memory_order_release);
+    pushed_.notify_one();
+  }
+
+  void flush() {
+    const std::uint64_t target = pushed_.load(std::memory_order_acquire);
+    std::uint64_t current = written_.load(std::memory_order_acquire);
+    while (current < target) {
+      written_.wait(current, std::memory_order_acquire);
+      current = written_.load(std::memory_order_acquire);
+    }
+  }
+
+ private:
+  void run() {
+    std::string batch;
+    std::string line;
+    while (true) {
+      const std::uint64_t seen = pushed_.load(std::memory_order_acquire);
+      std::uint64_t lines = 0;
+      while (ring_.pop(line)) {
+        batch += line;
+        ++lines;
+      }
+      if (lines > 0) {
+        write_all(batch);
+        batch.clear();
+        written_.fetch_add(lines, std::memory_order_release);
+        written_.notify_all();
+        continue;
+      }
+      pushed_.wait(seen, std::memory_order_acquire);
+    }
+  }
+
+  static void write_all(const std::string& data) {
+    std::size_t offset = 0;
+    while (offset < data.size()) {
+      const ssize_t n = ::write(STDERR_FILENO, data.data() + offset, data.size() - offset);
+      if (n < 0) {
+        if (errno == EINTR) continue;
+        return;
+      }
+      offset += static_cast<std::size_t>(n);
+    }
+  }
+
+  const LogFormat format_;
+  LogRing ring_;
+  alignas(64) std::atomic<std::uint64_t> pushed_{0};
+  alignas(64) std::atomic<std::uint64_t> written_{0};
+  std::thread flusher_;
+};
+
+// Never destroyed: threads may still log while static destructors run.
+Logger& logger() {
+  static Logger* instance = new Logger();
+  return *instance;
+}
+
+}  // namespace
+
+namespace detail {
+
+int init_log_level() {
+  const int level = static_cast<int>(parse_log_level(std::getenv("RADICC_LOG_LEVEL")));
+  g_log_level.store(level, std::memory_order_relaxed);
+  return level;
+}
+
+}  // namespace detail
+
+const char* log_level_name(LogLevel level) {
+  switch (level) {
+    case LogLevel::debug: return "debug";
+    case LogLevel::info: return "info";
+    case LogLevel::warn: return "warn";
+    case LogLevel::error: return "error";
+  }
+  return "info";
+}
+
+LogContextScope::LogContextScope(const LogContext& context) : previous_(t_log_context) {
+  if (!context.job_id.empty()) t_log_context.job_id = context.job_id;
+  if (!context.station.empty()) t_log_context.station = context.station;
+  if (!context.ft.empty()) t_log_context.ft = context.ft;
+}
+
+LogContextScope::~LogContextScope() {
+  t_log_context = std::move(previous_);
+}
+
+const LogContext& current_log_context() {
+  return t_log_context;
+}
+
+std::string format_log_line(LogFormat format, LogLevel level, const LogContext& context, const std::string& message) {
+  // Call sites used to end lines themselves; one trailing newline is ours.
+  std::string text = message;
+  while (!text.empty() && text.back() == '\n') text.pop_back();
+  std::string line;
+  if (format == LogFormat::json) {
+    JsonWriter json;
+    json.begin_object().member("time", utc_timestamp()).member("level", log_level_name(level));
+    if (!context.job_id.empty()) json.member("job", context.job_id);
+    if (!context.station.empty()) json.member("station", context.station);
+    if (!context.ft.empty()) json.member("ft", context.ft);
+    json.member("msg", text).end_object();
+    line = json.take();
+    line += '\n';
+    return line;
+  }
+  if (!context.job_id.empty() || !context.station.empty() || !context.ft.empty()) {
+    std::string prefix;
+    if (!context.job_id.empty()) prefix += "job=" + context.job_id;
+    if (!context.station.empty()) prefix += std::string(prefix.empty() ? "" : " ") + "station=" + context.station;
+    if (!context.ft.empty()) prefix += std::string(prefix.empty() ? "" : " ") + "ft=" + context.ft;
+    line = "[" + prefix + "] ";
+  }
+  line += text;
+  line += '\n';
+  return line;
+}
+
+void write_log(LogLevel level, const std::string& message) {
+  Logger& instance = logger();
+  instance.submit(format_log_line(instance.format(), level, t_log_context, message));
+}
+
+void flush_log() {
+  logger().flush();
+}
+
+}  // namespace radicc
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <ostream>
+#include <sstream>
+#include <string>
+
+namespace radicc {
+
+// Process-wide logging to stderr. A line carries a level and the calling
+// thread's job context, and is written as text or, with
+// RADICC_LOG_FORMAT=json, as one JSON object per line. Callers format the
+// line and push it onto a lock-free ring; a background thread writes it
+// out, so concurrent jobs never wait on stderr. RADICC_LOG_LEVEL (debug,
+// info, warn, error; default info) drops quieter lines before they are
+// formatted, and builds with RADICC_NO_DEBUG_LOG compile debug lines away.
+
+enum class LogLevel { debug = 0, info = 1, warn = 2, error = 3 };
+enum class LogFormat { text, json };
+
+const char* log_level_name(LogLevel level);
+
+namespace detail {
+// -1 until the environment has been read.
+inline std::atomic<int> g_log_level{-1};
+int init_log_level();
+}  // namespace detail
+
+inline bool log_enabled(LogLevel level) {
+  int minimum = detail::g_log_level.load(std::memory_order_relaxed);
+  if (minimum < 0) minimum = detail::init_log_level();
+  return static_cast<int>(level) >= minimum;
+}
+
+// Who a line is about. Empty fields are left out.
+struct LogContext {
+  std::string job_id;
+  std::string station;
+  std::string ft;
+};
+
+// Fills in the calling thread's context for the scope's lifetime; fields
+// left empty keep the outer value. Worker threads adopt their parent's
+// context by passing current_log_context(). Scopes nest.
+class LogContextScope {
+ public:
+  explicit LogContextScope(const LogContext& context);
+  ~LogContextScope();
+  LogContextScope(const LogContextScope&) = delete;
+  LogContextScope& operator=(const LogContextScope&) = delete;
+
+ private:
+  LogContext previous_;
+};
+
+const LogContext& current_log_context();
+
+std::string format_log_line(LogFormat format, LogLevel level, const LogContext& context, const std::string& message);
+
+void write_log(LogLevel level, const std::string& message);
+// Blocks until every line logged so far has reached stderr.
+void flush_log();
+
+// One line, written when the statement ends. Use through the RADICC_LOG_*
+// macros, which skip formatting entirely for a disabled level.
+class LogLine {
+ public:
+  explicit LogLine(LogLevel level) : level_(level) {}
+  ~LogLine() { write_log(level_, stream_.str()); }
+  LogLine(const LogLine&) = delete;
+  LogLine& operator=(const LogLine&) = delete;
+
+  template <typename T>
+  LogLine& operator<<(const T& value) {
+    stream_ << value;
+    return *this;
+  }
+  LogLine& operator<<(std::ostream& (*manipulator)(std::ostream&)) {
+    stream_ << manipulator;
+    return *this;
+  }
+
+ private:
+  LogLevel level_;
+  std::ostringstream stream_;
+};
+
+// Lets the macros below discard a streamed LogLine inside ?:.
+struct LogVoidify {
+  void operator&(const LogLine&) {}
+};
+
+}  // namespace radicc
+
+// An expression, so it is safe as the body of an unbraced if.
+#define RADICC_LOG(level) \
+  !::radicc::log_enabled(level) ? (void)0 : ::radicc::LogVoidify() & ::radicc::LogLine(level)
+#define RADICC_LOG_INFO RADICC_LOG(::radicc::LogLevel::info)
+#define RADICC_LOG_WARN RADICC_LOG(::radicc::LogLevel::warn)
+#define RADICC_LOG_ERROR RADICC_LOG(::radicc::LogLevel::error)
+#if defined(RADICC_NO_DEBUG_LOG)
+#define RADICC_LOG_DEBUG true ? (void)0 : ::radicc::LogVoidify() & ::radicc::LogLine(::radicc::LogLevel::debug)
+#else
+#define RADICC_LOG_DEBUG RADICC_LOG(::radicc::LogLevel::debug)
+#endif
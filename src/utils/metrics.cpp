@@ -0,0 +1,141 @@
+#include "utils/metrics.h"
+
+#include <sstream>
+
+namespace radicc {
+namespace {
+
+std::size_t shard_index() {
+  static std::atomic<std::size_t> next{0};
+  thread_local const std::size_t index = next.fetch_add(1, std::memory_order_relaxed) % kMetricShards;
+  return index;
+}
+
+std::string with_labels(const std::string& labels, const std::string& extra = {}) {
+  if (labels.empty() && extra.empty()) return {};
+  if (labels.empty()) return "{" + extra + "}";
+  if (extra.empty()) return "{" + labels + "}";
+  return "{" + labels + "," + extra + "}";
+}
+
+std::string format_number(double value) {
+  std::ostringstream out;
+  out << value;
+  return out.str();
+}
+
+}  // namespace
+
+void Counter::add(std::uint64_t value) {
+  shards_[shard_index()].value.fetch_add(value, std::memory_order_relaxed);
+}
+
+std::uint64_t Counter::value() const {
+  std::uint64_t total = 0;
+  for (const auto& shard : shards_) total += shard.value.load(std::memory_order_relaxed);
+  return total;
+}
+
+Histogram::Histogram(std::vector<double> bounds) : bounds_(std::move(bounds)) {
+  for (auto& shard : shards_) {
+    shard.buckets = std::make_unique<std::atomic<std::uint64_t>[]>(bounds_.size() + 1);
+    for (std::size_t i = 0; i <= bounds_.size(); ++i) shard.buckets[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+void Histogram::observe(double value) {
+  std::size_t bucket = 0;
+  while (bucket < bounds_.size() && value > bounds_[bucket]) ++bucket;
+  auto& shard = shards_[shard_index()];
+  shard.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+  shard.sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+Histogram::Totals Histogram::totals() const {
+  Totals totals;
+  totals.cumulative.assign(bounds_.size() + 1, 0);
+  for (const auto& shard : shards_) {
+    for (std::size_t i = 0; i <= bounds_.size(); ++i) {
+      totals.cumulative[i] += shard.buckets[i].load(std::memory_order_relaxed);
+    }
+    totals.sum += shard.sum.load(std::memory_order_relaxed);
+  }
+  for (std::size_t i = 1; i < totals.cumulative.size(); ++i) totals.cumulative[i] += totals.cumulative[i - 1];
+  return totals;
+}
+
+MetricsRegistry::Family& MetricsRegistry::family(const std::string& name, const std::string& help, const char* type) {
+  auto& entry = families_[name];
+  if (entry.type.empty()) {
+    entry.help = help;
+    entry.type = type;
+  }
+  return entry;
+}
+
+Counter& MetricsRegistry::counter(const std::string& name, const std::string& help, const std::string& labels) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto& slot = family(name, help, "counter").counters[labels];
+  if (!slot) slot = std::make_unique<Counter>();
+  return *slot;
+}
+
+Gauge& MetricsRegistry::gauge(const std::string& name, const std::string& help, const std::string& labels) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto& slot = family(name, help, "gauge").gauges[labels];
+  if (!slot) slot = std::make_unique<Gauge>();
+  return *slot;
+}
+
+Histogram& MetricsRegistry::histogram(const std::string& name, const std::string& help,
+                                      const std::vector<double>& bounds, const std::string& labels) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto& slot = family(name, help, "histogram").histograms[labels];
+  if (!slot) slot = std::make_unique<Histogram>(bounds);
+  return *slot;
+}
+
+std::string MetricsRegistry::render_prometheus() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::ostringstream out;
+  for (const auto& [name, family] : families_) {
+    out << "# HELP " << name << ' ' << family.help << '\n'
+        << "# TYPE " << name << ' ' << family.type << '\n';
+    for (const auto& [labels, counter] : family.counters) {
+      out << name << with_labels(labels) << ' ' << counter->value() << '\n';
+    }
+    for (const auto& [labels, gauge] : family.gauges) {
+      out << name << with_labels(labels) << ' ' << gauge->value() << '\n';
+    }
+    for (const auto& [labels, histogram] : family.histograms) {
+      const auto totals = histogram->totals();
+      const auto& bounds = histogram->bounds();
+      for (std::size_t i = 0; i < bounds.size(); ++i) {
+        out << name << "_bucket" << with_labels(labels, "le=\"" + format_number(bounds[i]) + "\"") << ' '
+            << totals.cumulative[i] << '\n';
+      }
+      out << name << "_bucket" << with_labels(labels, "le=\"+Inf\"") << ' ' << totals.cumulative.back() << '\n'
+          << name << "_sum" << with_labels(labels) << ' ' << format_number(totals.sum) << '\n'
+          << name << "_count" << with_labels(labels) << ' ' << totals.cumulative.back() << '\n';
+    }
+  }
+  return out.str();
+}
+
+MetricsRegistry& metrics() {
+  static MetricsRegistry registry;
+  return registry;
+}
+
+const std::vector<double>& latency_buckets_seconds() {
+  static const std::vector<double> buckets = {0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60};
+  return buckets;
+}
+
+const std::vector<double>& throughput_buckets_bytes_per_second() {
+  static const std::vector<double> buckets = {
+      16e3, 32e3, 64e3, 128e3, 256e3, 512e3, 1e6, 4e6, 16e6, 64e6};
+  return buckets;
+}
+
+}  // namespace radicc
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace radicc {
+
+// Process-wide metrics in Prometheus text format. Registration takes a lock;
+// updates are lock-free and spread over per-thread shards so concurrent jobs
+// do not contend on one cache line. Call sites keep the returned reference.
+
+constexpr std::size_t kMetricShards = 16;
+
+class Counter {
+ public:
+  void add(std::uint64_t value = 1);
+  std::uint64_t value() const;
+
+ private:
+  struct alignas(64) Shard {
+    std::atomic<std::uint64_t> value{0};
+  };
+  std::array<Shard, kMetricShards> shards_;
+};
+
+class Gauge {
+ public:
+  void add(std::int64_t delta) { value_.fetch_add(delta, std::memory_order_relaxed); }
+  void set(std::int64_t value) { value_.store(value, std::memory_order_relaxed); }
+  std::int64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<std::int64_t> value_{0};
+};
+
+class Histogram {
+ public:
+  // `bounds` are the upper bucket limits in ascending order; +Inf is implicit.
+  explicit Histogram(std::vector<double> bounds);
+  void observe(double value);
+
+  struct Totals {
+    std::vector<std::uint64_t> cumulative;  // one per bound, then +Inf
+    double sum = 0.0;
+  };
+  Totals totals() const;
+  const std::vector<double>& bounds() const { return bounds_; }
+
+ private:
+  struct alignas(64) Shard {
+    std::unique_ptr<std::atomic<std::uint64_t>[]> buckets;
+    std::atomic<double> sum{0.0};
+  };
+  std::vector<double> bounds_;
+  std::array<Shard, kMetricShards> shards_;
+};
+
+class MetricsRegistry {
+ public:
+  // `labels` is the rendered label set without braces, e.g. `endpoint="auth1"`.
+  Counter& counter(const std::string& name, const std::string& help, const std::string& labels = {});
+  Gauge& gauge(const std::string& name, const std::string& help, const std::string& labels = {});
+  Histogram& histogram(const std::string& name, const std::string& help,
+                       const std::vector<double>& bounds, const std::string& labels = {});
+
+  std::string render_prometheus() const;
+
+ private:
+  struct Family {
+    std::string help;
+    std::string type;
+    std::map<std::string, std::unique_ptr<Counter>> counters;
+    std::map<std::string, std::unique_ptr<Gauge>> gauges;
+    std::map<std::string, std::unique_ptr<Histogram>> histograms;
+  };
+  Family& family(const std::string& name, const std::string& help, const char* type);
+
+  mutable std::mutex mutex_;
+  std::map<std::string, Family> families_;
+};
+
+MetricsRegistry& metrics();
+
+// Shared bucket layouts.
+const std::vector<double>& latency_buckets_seconds();
+const std::vector<double>& throughput_buckets_bytes_per_second();
+
+}  // namespace radicc
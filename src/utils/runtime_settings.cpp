@@ -0,0 +1,132 @@
+#include "utils/runtime_settings.h"
+
+#include "utils/env_loader.h"
+#include "utils/hash.h"
+#include "utils/log.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <mutex>
+#include <string_view>
+#include <utility>
+
+namespace radicc {
+namespace {
+
+std::mutex g_settings_mutex;
+std::shared_ptr<const RuntimeSettings> g_settings;
+thread_local std::shared_ptr<const RuntimeSettings> t_settings;
+
+std::string expand_output_dir(std::string raw) {
+  const char* home = std::getenv("HOME");
+  raw.erase(std::remove(raw.begin(), raw.end(), '"'), raw.end());
+  if (home) {
+    const std::size_t pos = raw.find("$HOME");
+    if (pos != std::string::npos) raw.replace(pos, 5, home);
+    if (!raw.empty() && raw.front() == '~') raw.replace(0, 1, home);
+  }
+  if (!raw.empty() && raw.back() != '/') raw += '/';
+  return raw;
+}
+
+void store_settings(std::shared_ptr<const RuntimeSettings> settings) {
+  std::lock_guard<std::mutex> lock(g_settings_mutex);
+  g_settings = std::move(settings);
+}
+
+}  // namespace
+
+std::string RuntimeSettings::value(const std::string& name) const {
+  const auto it = file_values.find(name);
+  if (it != file_values.end()) return it->second;
+  const char* value = std::getenv(name.c_str());
+  return value ? std::string(value) : std::string();
+}
+
+std::string RuntimeSettings::fingerprint() const {
+  const auto affects_commands = [](std::string_view name) {
+    if (name.rfind("RADICC_", 0) != 0 && name.rfind("RADIKO_", 0) != 0) return false;
+    return name != "RADICC_SOCKET" && name != "RADICC_STANDALONE" && name.rfind("RADICC_LOG", 0) != 0
+        && name != "RADICC_DEBUG_LOG" && name != "RADICC_NO_DEBUG_LOG";
+  };
+  std::map<std::string, std::string> values;
+  for (char** entry = environ; *entry; ++entry) {
+    const std::string_view text(*entry);
+    const std::size_t equals = text.find('=');
+    if (equals == std::string_view::npos || !affects_commands(text.substr(0, equals))) continue;
+    values[std::string(text.substr(0, equals))] = std::string(text.substr(equals + 1));
+  }
+  for (const auto& [name, value] : file_values) {
+    if (affects_commands(name)) values[name] = value;
+  }
+  std::string joined;
+  for (const auto& [name, value] : values) {
+    if (!value.empty()) joined += name + '=' + value + '\n';
+  }
+  return xxh3_hex(joined);
+}
+
+std::shared_ptr<const RuntimeSettings> load_runtime_settings(bool quiet) {
+  auto settings = std::make_shared<RuntimeSettings>();
+  struct stat st;
+  // .env is read last, so it overrides env.
+  for (const char* name : {"env", ".env"}) {
+    const std::string path = get_config_path_for_env(name);
+    if (::stat(path.c_str(), &st) != 0) continue;
+    if (!quiet) RADICC_LOG_INFO << "Loading from " << name << " file: " << path;
+    for (auto& [key, value] : read_env_file(path)) settings->file_values[key] = std::move(value);
+    settings->loaded_files.push_back(path);
+  }
+  if (settings->loaded_files.empty() && !quiet) {
+    RADICC_LOG_INFO << "Note: No env file found; relying on environment variables only.";
+  }
+
+  const std::string radicc_dir = settings->value("RADICC_DIR");
+  settings->output_dir = radicc_dir.empty() ? std::string("./") : expand_output_dir(radicc_dir);
+  const std::string user = settings->value("RADIKO_USER");
+  const std::string pass = settings->value("RADIKO_PASS");
+  if (!user.empty() && !pass.empty()) {
+    settings->radiko_user = user;
+    settings->radiko_pass = pass;
+  }
+  settings->hedge_sources = settings->value("RADICC_HEDGE_SOURCES") == "1";
+  settings->native_muxer = settings->value("RADICC_NATIVE_MUXER") != "0";
+  settings->async_writer = settings->value("RADICC_ASYNC_WRITER") == "1";
+  const long timeout = std::strtol(settings->value("RADICC_RECORD_TIMEOUT").c_str(), nullptr, 10);
+  settings->record_timeout_seconds = timeout > 0 ? timeout : 0;
+  return settings;
+}
+
+std::shared_ptr<const RuntimeSettings> current_runtime_settings(bool quiet) {
+  std::lock_guard<std::mutex> lock(g_settings_mutex);
+  if (!g_settings) g_settings = load_runtime_settings(quiet);
+  return g_settings;
+}
+
+std::shared_ptr<const RuntimeSettings> reload_runtime_settings() {
+  auto settings = load_runtime_settings();
+  store_settings(settings);
+  return settings;
+}
+
+RuntimeSettingsScope::RuntimeSettingsScope(std::shared_ptr<const RuntimeSettings> settings)
+    : previous_(std::exchange(t_settings, std::move(settings))) {}
+
+RuntimeSettingsScope::~RuntimeSettingsScope() {
+  t_settings = std::move(previous_);
+}
+
+std::shared_ptr<const RuntimeSettings> scoped_runtime_settings() {
+  return t_settings;
+}
+
+std::string runtime_env(const std::string& name) {
+  // Inside a scope the snapshot is the thread's own; no lock is needed.
+  if (t_settings) return t_settings->value(name);
+  return current_runtime_settings()->value(name);
+}
+
+}  // namespace radicc
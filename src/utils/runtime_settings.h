@@ -0,0 +1,69 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace radicc {
+
+// Environment-derived settings, read once into an immutable snapshot.
+//
+// The env files ($XDG_CONFIG_HOME/radicc/env and .env) are parsed into the
+// snapshot instead of being applied with setenv, so concurrent requests
+// never race on the process environment; values from the files still win
+// over the environment, as before. A request takes one snapshot and keeps
+// it through a RuntimeSettingsScope; reload_runtime_settings() swaps in a
+// new one for later requests.
+struct RuntimeSettings {
+  std::string output_dir;  // RADICC_DIR, expanded, with a trailing slash; "./" when unset
+  std::string radiko_user;
+  std::string radiko_pass;
+  bool hedge_sources = false;       // RADICC_HEDGE_SOURCES=1
+  bool native_muxer = true;         // RADICC_NATIVE_MUXER=0 disables
+  bool async_writer = false;        // RADICC_ASYNC_WRITER=1
+  long record_timeout_seconds = 0;  // RADICC_RECORD_TIMEOUT; 0 = only the default deadline
+  std::vector<std::string> loaded_files;
+  // Every variable the env files define.
+  std::map<std::string, std::string> file_values;
+
+  bool has_credentials() const { return !radiko_user.empty() && !radiko_pass.empty(); }
+  // The env files' value for `name`, else the process environment's; empty
+  // when unset.
+  std::string value(const std::string& name) const;
+  // Digest of every non-empty RADICC_*/RADIKO_* value these settings
+  // resolve, leaving out logging and the local socket. Two processes with
+  // equal fingerprints run a command the same way.
+  std::string fingerprint() const;
+};
+
+// Reads the env files and the environment. `quiet` skips the log lines
+// naming the files.
+std::shared_ptr<const RuntimeSettings> load_runtime_settings(bool quiet = false);
+
+// The process's snapshot, loaded on first use.
+std::shared_ptr<const RuntimeSettings> current_runtime_settings(bool quiet = false);
+std::shared_ptr<const RuntimeSettings> reload_runtime_settings();
+
+// Makes `settings` the calling thread's snapshot for the scope's lifetime,
+// so a running request keeps the tunables it started with across reloads.
+// Worker threads adopt the snapshot of the thread that started them.
+class RuntimeSettingsScope {
+ public:
+  explicit RuntimeSettingsScope(std::shared_ptr<const RuntimeSettings> settings);
+  ~RuntimeSettingsScope();
+  RuntimeSettingsScope(const RuntimeSettingsScope&) = delete;
+  RuntimeSettingsScope& operator=(const RuntimeSettingsScope&) = delete;
+
+ private:
+  std::shared_ptr<const RuntimeSettings> previous_;
+};
+
+// The calling thread's scoped snapshot; null outside any scope.
+std::shared_ptr<const RuntimeSettings> scoped_runtime_settings();
+
+// `name` from the calling thread's scoped snapshot, else the process's, for
+// tunables read deep in the HTTP and recording layers.
+std::string runtime_env(const std::string& name);
+
+}  // namespace radicc
@@ -0,0 +1,185 @@
+#include "utils/text_fold.h"
+
+#include <algorithm>
+#include <array>
+#include <iterator>
+#include <utility>
+
+namespace radicc {
+namespace {
+
+constexpr char32_t kReplacement = 0xFFFD;
+constexpr char32_t kDrop = 0;  // folds to nothing
+constexpr char32_t kVoicedMark = 0x3099;
+constexpr char32_t kSemiVoicedMark = 0x309A;
+
+// U+FF61..U+FF9F, half-width katakana and CJK punctuation, in NFKC.
+constexpr char32_t kHalfwidthKana[] = {
+    0x3002, 0x300C, 0x300D, 0x3001, 0x30FB, 0x30F2, 0x30A1, 0x30A3, 0x30A5, 0x30A7, 0x30A9, 0x30E3, 0x30E5,
+    0x30E7, 0x30C3, 0x30FC, 0x30A2, 0x30A4, 0x30A6, 0x30A8, 0x30AA, 0x30AB, 0x30AD, 0x30AF, 0x30B1, 0x30B3,
+    0x30B5, 0x30B7, 0x30B9, 0x30BB, 0x30BD, 0x30BF, 0x30C1, 0x30C4, 0x30C6, 0x30C8, 0x30CA, 0x30CB, 0x30CC,
+    0x30CD, 0x30CE, 0x30CF, 0x30D2, 0x30D5, 0x30D8, 0x30DB, 0x30DE, 0x30DF, 0x30E0, 0x30E1, 0x30E2, 0x30E4,
+    0x30E6, 0x30E8, 0x30E9, 0x30EA, 0x30EB, 0x30EC, 0x30ED, 0x30EF, 0x30F3, kVoicedMark, kSemiVoicedMark,
+};
+static_assert(std::size(kHalfwidthKana) == 0xFF9F - 0xFF61 + 1);
+
+// The Halfwidth and Fullwidth Forms block, U+FF00..U+FFFF.
+constexpr std::array<char32_t, 0x100> kWidthForms = [] {
+  std::array<char32_t, 0x100> table{};
+  for (char32_t i = 0; i < 0x100; ++i) table[i] = 0xFF00 + i;
+  for (char32_t c = 0xFF01; c <= 0xFF5E; ++c) table[c - 0xFF00] = c - 0xFEE0;  // full-width ASCII
+  table[0x5F] = 0x2985;
+  table[0x60] = 0x2986;
+  for (std::size_t i = 0; i < std::size(kHalfwidthKana); ++i) table[0x61 + i] = kHalfwidthKana[i];
+  constexpr char32_t kFullwidthSigns[] = {0x00A2, 0x00A3, 0x00AC, 0x00AF, 0x00A6, 0x00A5, 0x20A9};
+  for (std::size_t i = 0; i < std::size(kFullwidthSigns); ++i) table[0xE0 + i] = kFullwidthSigns[i];
+  return table;
+}();
+
+constexpr std::array<char, 0x80> kAsciiFold = [] {
+  std::array<char, 0x80> table{};
+  for (int c = 0; c < 0x80; ++c) table[c] = static_cast<char>(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c);
+  for (const int space : {'\t', '\n', '\r', '\f', '\v'}) table[space] = ' ';
+  return table;
+}();
+
+// Spaces, dashes, tildes and quotes that radiko and hand-typed config spell
+// differently. Sorted by code point.
+constexpr std::pair<char32_t, char32_t> kPunctuation[] = {
+    {0x00A0, U' '}, {0x2002, U' '}, {0x2003, U' '}, {0x2004, U' '}, {0x2005, U' '},  {0x2006, U' '},
+    {0x2007, U' '}, {0x2008, U' '}, {0x2009, U' '}, {0x200A, U' '}, {0x200B, kDrop}, {0x2010, U'-'},
+    {0x2011, U'-'}, {0x2012, U'-'}, {0x2013, U'-'}, {0x2014, U'-'}, {0x2015, U'-'},  {0x2018, U'\''},
+    {0x2019, U'\''}, {0x201C, U'"'}, {0x201D, U'"'}, {0x2024, U'.'}, {0x202F, U' '}, {0x205F, U' '},
+    {0x2212, U'-'}, {0x3000, U' '}, {0x301C, U'~'}, {0xFEFF, kDrop},
+};
+static_assert(std::is_sorted(std::begin(kPunctuation), std::end(kPunctuation)));
+
+// Voiced and semi-voiced forms of U+3040..U+30FF, for composing a
+// following U+3099 / U+309A.
+struct KanaMarks {
+  char32_t voiced = 0;
+  char32_t semi_voiced = 0;
+};
+constexpr std::array<KanaMarks, 0xC0> kKanaMarks = [] {
+  std::array<KanaMarks, 0xC0> table{};
+  const auto set = [&](char32_t base, char32_t voiced, char32_t semi_voiced) {
+    table[base - 0x3040] = KanaMarks{voiced, semi_voiced};
+    // The hiragana counterpart sits 0x60 lower.
+    table[base - 0x60 - 0x3040] = KanaMarks{voiced - 0x60, semi_voiced ? semi_voiced - 0x60 : 0};
+  };
+  // Ka, sa and ta rows: the voiced form is the next code point.
+  for (const char32_t base : {0x30AB, 0x30AD, 0x30AF, 0x30B1, 0x30B3, 0x30B5, 0x30B7, 0x30B9, 0x30BB, 0x30BD, 0x30BF,
+                              0x30C1, 0x30C4, 0x30C6, 0x30C8}) {
+    set(base, base + 1, 0);
+  }
+  // Ha row: voiced, then semi-voiced.
+  for (const char32_t base : {0x30CF, 0x30D2, 0x30D5, 0x30D8, 0x30DB}) set(base, base + 1, base + 2);
+  set(0x30A6, 0x30F4, 0);  // u -> vu
+  for (char32_t base = 0x30EF; base <= 0x30F2; ++base) table[base - 0x3040].voiced = base + 8;  // wa, wi, we, wo
+  table[0x309D - 0x3040].voiced = 0x309E;  // iteration marks
+  table[0x30FD - 0x3040].voiced = 0x30FE;
+  return table;
+}();
+
+char32_t fold_code_point(char32_t code_point) {
+  if (code_point < 0x80) return static_cast<unsigned char>(kAsciiFold[code_point]);
+  if (code_point >= 0xFF00 && code_point <= 0xFFFF) {
+    code_point = kWidthForms[code_point - 0xFF00];
+    return code_point < 0x80 ? static_cast<unsigned char>(kAsciiFold[code_point]) : code_point;
+  }
+  const auto it = std::lower_bound(std::begin(kPunctuation), std::end(kPunctuation), code_point,
+                                   [](const std::pair<char32_t, char32_t>& entry, char32_t value) {
+                                     return entry.first < value;
+                                   });
+  return it != std::end(kPunctuation) && it->first == code_point ? it->second : code_point;
+}
+
+}  // namespace
+
+char32_t decode_utf8(std::string_view text, std::size_t& position) {
+  const auto lead = static_cast<unsigned char>(text[position]);
+  if (lead < 0x80) {
+    ++position;
+    return lead;
+  }
+  std::size_t length = 0;
+  char32_t code_point = 0;
+  char32_t minimum = 0;
+  if ((lead & 0xE0) == 0xC0) {
+    length = 2, code_point = lead & 0x1F, minimum = 0x80;
+  } else if ((lead & 0xF0) == 0xE0) {
+    length = 3, code_point = lead & 0x0F, minimum = 0x800;
+  } else if ((lead & 0xF8) == 0xF0) {
+    length = 4, code_point = lead & 0x07, minimum = 0x10000;
+  }
+  if (length == 0 || text.size() - position < length) {
+    ++position;
+    return kReplacement;
+  }
+  for (std::size_t i = 1; i < length; ++i) {
+    const auto byte = static_cast<unsigned char>(text[position + i]);
+    if ((byte & 0xC0) != 0x80) {
+      ++position;
+      return kReplacement;
+    }
+    code_point = (code_point << 6) | (byte & 0x3F);
+  }
+  if (code_point < minimum || code_point > 0x10FFFF || (code_point >= 0xD800 && code_point <= 0xDFFF)) {
+    ++position;
+    return kReplacement;
+  }
+  position += length;
+  return code_point;
+}
+
+void append_utf8(std::string& out, char32_t code_point) {
+  if (code_point < 0x80) {
+    out.push_back(static_cast<char>(code_point));
+  } else if (code_point < 0x800) {
+    out.push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+    out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+  } else if (code_point < 0x10000) {
+    out.push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+    out.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+  } else {
+    out.push_back(static_cast<char>(0xF0 | (code_point >> 18)));
+    out.push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+  }
+}
+
+std::u32string fold_for_match(std::string_view text) {
+  std::u32string folded;
+  folded.reserve(text.size());
+  for (std::size_t position = 0; position < text.size();) {
+    const char32_t code_point = fold_code_point(decode_utf8(text, position));
+    if (code_point == kDrop) continue;
+    if (code_point == U' ') {
+      if (!folded.empty() && folded.back() != U' ') folded.push_back(U' ');
+      continue;
+    }
+    if ((code_point == kVoicedMark || code_point == kSemiVoicedMark) && !folded.empty() && folded.back() >= 0x3040 &&
+        folded.back() <= 0x30FF) {
+      const KanaMarks& marks = kKanaMarks[folded.back() - 0x3040];
+      const char32_t composed = code_point == kVoicedMark ? marks.voiced : marks.semi_voiced;
+      if (composed != 0) {
+        folded.back() = composed;
+        continue;
+      }
+    }
+    folded.push_back(code_point);
+  }
+  if (!folded.empty() && folded.back() == U' ') folded.pop_back();
+  return folded;
+}
+
+std::string match_key(std::string_view text) {
+  std::string key;
+  key.reserve(text.size());
+  for (const char32_t code_point : fold_for_match(text)) append_utf8(key, code_point);
+  return key;
+}
+
+}  // namespace radicc
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace radicc {
+
+// Decodes the UTF-8 code point at `position` and advances past it. A
+// malformed, overlong or truncated sequence yields U+FFFD and advances one
+// byte.
+char32_t decode_utf8(std::string_view text, std::size_t& position);
+void append_utf8(std::string& out, char32_t code_point);
+
+// Folds text for matching, roughly NFKC plus case folding: full-width ASCII
+// and half-width katakana become their ordinary forms, voiced-sound marks
+// are composed onto the preceding kana, ASCII is lower-cased, dash, tilde
+// and quote variants are unified, and runs of whitespace become one space
+// with none at either end. The tables behind it are built at compile time.
+std::u32string fold_for_match(std::string_view text);
+
+// fold_for_match() as UTF-8. Titles that differ only in those ways get the
+// same key, so it can be hashed and compared directly.
+std::string match_key(std::string_view text);
+
+}  // namespace radicc
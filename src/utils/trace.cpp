@@ -0,0 +1,95 @@
+#include "utils/trace.h"
+
+#include "utils/atomic_file.h"
+#include "utils/json.h"
+
+#include <unistd.h>
+
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+namespace radicc {
+namespace {
+
+struct TraceEvent {
+  const char* name;
+  std::string detail;
+  std::int64_t start_us;
+  std::int64_t duration_us;
+  std::uint32_t tid;
+};
+
+// Bounds memory for a long-running server with tracing left on.
+constexpr std::size_t kMaxTraceEvents = 1 << 20;
+
+std::mutex g_trace_mutex;
+std::vector<TraceEvent> g_trace_events;
+std::chrono::steady_clock::time_point g_trace_origin = std::chrono::steady_clock::now();
+
+std::int64_t trace_now_us() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - g_trace_origin)
+      .count();
+}
+
+// Small stable ids read better in trace viewers than native thread ids.
+std::uint32_t trace_thread_id() {
+  static std::atomic<std::uint32_t> next{1};
+  thread_local const std::uint32_t id = next.fetch_add(1, std::memory_order_relaxed);
+  return id;
+}
+
+}  // namespace
+
+void start_trace() {
+  std::lock_guard<std::mutex> lock(g_trace_mutex);
+  g_trace_events.clear();
+  g_trace_origin = std::chrono::steady_clock::now();
+  detail::g_trace_enabled.store(true, std::memory_order_relaxed);
+}
+
+bool write_trace(const std::string& path) {
+  std::vector<TraceEvent> events;
+  {
+    std::lock_guard<std::mutex> lock(g_trace_mutex);
+    events = g_trace_events;
+  }
+  JsonWriter json;
+  json.begin_object().member("displayTimeUnit", "ms").key("traceEvents").begin_array();
+  const long pid = static_cast<long>(::getpid());
+  for (const auto& event : events) {
+    json.begin_object()
+        .member("name", event.name)
+        .member("cat", "radicc")
+        .member("ph", "X")
+        .member("ts", event.start_us)
+        .member("dur", event.duration_us)
+        .member("pid", pid)
+        .member("tid", event.tid);
+    if (!event.detail.empty()) json.key("args").begin_object().member("detail", event.detail).end_object();
+    json.end_object();
+  }
+  json.end_array().end_object();
+  std::string document = json.take();
+  document += '\n';
+  // Jobs finishing together each write a whole file under their own temp
+  // name; the last rename wins.
+  return write_file_atomically(path, document);
+}
+
+void TraceSpan::begin(const char* name, const std::string* detail) {
+  name_ = name;
+  if (detail) detail_ = *detail;
+  start_us_ = trace_now_us();
+  active_ = true;
+}
+
+void TraceSpan::end() {
+  const std::int64_t end_us = trace_now_us();
+  const std::uint32_t tid = trace_thread_id();
+  std::lock_guard<std::mutex> lock(g_trace_mutex);
+  if (g_trace_events.size() >= kMaxTraceEvents) return;
+  g_trace_events.push_back(TraceEvent{name_, std::move(detail_), start_us_, end_us - start_us_, tid});
+}
+
+}  // namespace radicc
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace radicc {
+
+// Chrome / Perfetto trace recording ("Trace Event Format" JSON). Tracing is
+// off unless start_trace() is called; a disabled TraceSpan costs one relaxed
+// atomic load.
+
+namespace detail {
+inline std::atomic<bool> g_trace_enabled{false};
+}  // namespace detail
+
+inline bool trace_enabled() { return detail::g_trace_enabled.load(std::memory_order_relaxed); }
+
+// Clears any recorded events and starts recording.
+void start_trace();
+// Writes every event recorded so far; recording continues.
+bool write_trace(const std::string& path);
+
+// Records one complete event from construction to destruction on the
+// calling thread. `name` must outlive the span (string literals).
+class TraceSpan {
+ public:
+  explicit TraceSpan(const char* name) {
+    if (trace_enabled()) begin(name, nullptr);
+  }
+  TraceSpan(const char* name, const std::string& detail) {
+    if (trace_enabled()) begin(name, &detail);
+  }
+  ~TraceSpan() {
+    if (active_) end();
+  }
+  TraceSpan(const TraceSpan&) = delete;
+  TraceSpan& operator=(const TraceSpan&) = delete;
+
+ private:
+  void begin(const char* name, const std::string* detail);
+  void end();
+
+  const char* name_ = nullptr;
+  std::string detail_;
+  std::int64_t start_us_ = 0;
+  bool active_ = false;
+};
+
+}  // namespace radicc
@@ -1,9 +1,48 @@
 #include "app/common.h"
 #include "app/output_path.h"
+#include "core/adts_mp4_muxer.h"
+#include "core/config_snapshot.h"
+#include "core/hls_playlist.h"
+#include "core/markup_scan.h"
+#include "core/output_sink.h"
+#include "core/program_image.h"
+#include "core/program_search.h"
+#include "core/radiko_http.h"
+#include "core/radiko_programs_xml.h"
+#include "core/radiko_stream.h"
+#include "core/record_progress.h"
+#include "core/retry_policy.h"
+#include "core/schedule_snapshot.h"
+#include "core/recording_store.h"
+#include "core/stream_source_stats.h"
+#include "core/upstream_governor.h"
+#include "core/url_parser.h"
+#include "tools/regex_reference.h"
+#include "utils/cancellation.h"
+#include "utils/hash.h"
+#include "utils/json.h"
+#include "utils/local_socket.h"
+#include "utils/log.h"
+#include "utils/metrics.h"
+#include "utils/runtime_settings.h"
+#include "utils/text_fold.h"
+#include "utils/trace.h"
 
 #include <array>
 #include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <sstream>
 #include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
 
 namespace {
 
@@ -57,6 +96,856 @@ void test_output_path_date_offset() {
   assert(paths.filename == "宮本佳林の雑談ラジオ-20260710.m4a");
 }
 
+void test_stream_sources_ranked_by_history() {
+  char cache_dir[] = "/tmp/radicc-tests-XXXXXX";
+  assert(mkdtemp(cache_dir) != nullptr);
+  setenv("XDG_CACHE_HOME", cache_dir, 1);
+
+  radicc::record_stream_source_success("https://slow.example", 2.0, 20000.0);
+  radicc::record_stream_source_success("https://fast.example", 0.2, 400000.0);
+  radicc::record_stream_source_failure("https://broken.example");
+
+  std::vector<radicc::RadikoStreamSource> sources(4);
+  sources[0].origin = "https://broken.example";
+  sources[1].origin = "https://slow.example";
+  sources[2].origin = "https://unknown.example";
+  sources[3].origin = "https://fast.example";
+  radicc::rank_stream_sources(sources);
+
+  assert(sources[0].origin == "https://fast.example");
+  assert(sources[1].origin == "https://slow.example");
+  assert(sources[2].origin == "https://unknown.example");
+  assert(sources[3].origin == "https://broken.example");
+
+  // Three results stay in memory until the recording saves them.
+  const std::string stats_path = std::string(cache_dir) + "/radicc/stream_sources.tsv";
+  struct stat st {};
+  assert(stat(stats_path.c_str(), &st) != 0);
+  radicc::save_stream_source_stats();
+  assert(stat(stats_path.c_str(), &st) == 0 && st.st_size > 0);
+
+  // Old failures fade as an origin keeps delivering.
+  for (int i = 0; i < 5; ++i) radicc::record_stream_source_failure("https://flaky.example");
+  radicc::record_stream_source_success("https://flaky.example", 0.2, 400000.0);
+  assert(radicc::stream_source_stats("https://flaky.example").failure_rate > 0.5);
+  for (int i = 0; i < 10; ++i) radicc::record_stream_source_success("https://flaky.example", 0.2, 400000.0);
+  const auto flaky = radicc::stream_source_stats("https://flaky.example");
+  assert(flaky.failures == 5 && flaky.failure_rate < 0.05);
+}
+
+void test_stream_definition_cache_serves_and_invalidates() {
+  char cache_dir[] = "/tmp/radicc-tests-XXXXXX";
+  assert(mkdtemp(cache_dir) != nullptr);
+  setenv("XDG_CACHE_HOME", cache_dir, 1);
+  const std::string streams_dir = std::string(cache_dir) + "/radicc/streams";
+  assert(mkdir((std::string(cache_dir) + "/radicc").c_str(), 0755) == 0);
+  assert(mkdir(streams_dir.c_str(), 0755) == 0);
+  const std::string path = streams_dir + "/TBS.tsv";
+  {
+    std::ofstream file(path);
+    file << "areafree\thttps://b.example/tf/playlist.m3u8\n";
+    file << "local\thttps://a.example/tf/playlist.m3u8\n";
+  }
+
+  radicc::RadikoAuthState auth;
+  auth.area_id = "JP13";
+  auth.authtoken = "token";
+  const auto plan = radicc::build_timefree_stream_plan("TBS", "20260322010000", "20260322013000", false, auth);
+  assert(plan.has_value());
+  assert(plan->cached_definition);
+  assert(plan->station_id == "TBS");
+  assert(plan->sources.size() == 1);
+  assert(plan->sources[0].origin == "https://a.example");
+  assert(plan->sources[0].chunks.front().url.rfind("https://a.example/tf/playlist.m3u8?station_id=TBS", 0) == 0);
+
+  radicc::invalidate_stream_definition("TBS");
+  struct stat st {};
+  assert(stat(path.c_str(), &st) != 0);
+}
+
+void test_recording_store_replays_airing() {
+  char cache_dir[] = "/tmp/radicc-tests-store-XXXXXX";
+  assert(mkdtemp(cache_dir) != nullptr);
+  setenv("XDG_CACHE_HOME", cache_dir, 1);
+  unsetenv("RADICC_STORE_MAX_MB");
+
+  assert(radicc::sha256_hex("abc") == "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+
+  const std::string recorded = std::string(cache_dir) + "/recorded.m4a";
+  std::ofstream(recorded, std::ios::binary) << "stored audio";
+  radicc::StoredRecording entry;
+  entry.station_id = "TBS";
+  entry.ft = "20260710010000";
+  entry.to = "20260710020000";
+  entry.format = "m4a";
+  entry.title = "Program";
+  assert(radicc::store_recording(entry, recorded));
+
+  assert(!radicc::find_stored_recording("TBS", "20260710010000", "", "m4a+faststart"));
+  assert(!radicc::find_stored_recording("TBS", "20260710010000", "20260710013000", "m4a"));
+  const auto stored = radicc::find_stored_recording("TBS", "20260710010000", "", "m4a");
+  assert(stored && stored->title == "Program" && stored->size == 12);
+  assert(stored->sha256 == radicc::sha256_hex("stored audio"));
+
+  const std::string replayed = std::string(cache_dir) + "/replayed.m4a";
+  assert(radicc::materialize_stored_recording(*stored, replayed));
+  std::ifstream in(replayed, std::ios::binary);
+  const std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  assert(content == "stored audio");
+
+  // Editing a delivered file in place leaves the stored object alone; a
+  // same-size edit of the object itself is caught by the digest.
+  std::ofstream(recorded, std::ios::binary) << "edited audio";
+  std::ofstream(replayed, std::ios::binary) << "edited audio";
+  assert(radicc::find_stored_recording("TBS", "20260710010000", "", "m4a"));
+  const std::string object = std::string(cache_dir) + "/radicc/recordings/" + stored->sha256 + ".m4a";
+  std::ofstream(object, std::ios::binary) << "stored audiO";
+  assert(!radicc::find_stored_recording("TBS", "20260710010000", "", "m4a"));
+  std::ofstream(object, std::ios::binary) << "stored audio";
+
+  // A zero size limit evicts everything, including the object file.
+  setenv("RADICC_STORE_MAX_MB", "0", 1);
+  entry.ft = "20260711010000";
+  entry.to = "20260711020000";
+  radicc::store_recording(entry, recorded);
+  assert(!radicc::find_stored_recording("TBS", "20260710010000", "", "m4a"));
+  struct stat st;
+  assert(::stat((std::string(cache_dir) + "/radicc/recordings/" + stored->sha256 + ".m4a").c_str(), &st) != 0);
+  unsetenv("RADICC_STORE_MAX_MB");
+}
+
+std::string make_adts_frame(std::size_t payload_size, char fill) {
+  // AAC-LC, 48 kHz (index 3), stereo, no CRC.
+  const std::size_t frame_length = payload_size + 7;
+  std::string frame = {
+      '\xFF', '\xF1',
+      static_cast<char>((1 << 6) | (3 << 2)),
+      static_cast<char>((2 << 6) | ((frame_length >> 11) & 0x03)),
+      static_cast<char>((frame_length >> 3) & 0xFF),
+      static_cast<char>(((frame_length & 0x07) << 5) | 0x1F),
+      '\xFC'};
+  frame.append(payload_size, fill);
+  return frame;
+}
+
+std::uint32_t read_u32(const std::string& data, std::size_t offset) {
+  return (static_cast<std::uint32_t>(static_cast<unsigned char>(data[offset])) << 24)
+      | (static_cast<std::uint32_t>(static_cast<unsigned char>(data[offset + 1])) << 16)
+      | (static_cast<std::uint32_t>(static_cast<unsigned char>(data[offset + 2])) << 8)
+      | static_cast<std::uint32_t>(static_cast<unsigned char>(data[offset + 3]));
+}
+
+void test_adts_header_and_config() {
+  const std::string frame = make_adts_frame(100, 'a');
+  const auto header = radicc::parse_adts_header(reinterpret_cast<const std::uint8_t*>(frame.data()), frame.size());
+  assert(header);
+  assert(header->audio_object_type == 2);
+  assert(radicc::adts_sample_rate(header->sampling_index) == 48000);
+  assert(header->channel_config == 2);
+  assert(header->frame_length == 107);
+  assert(radicc::build_audio_specific_config(*header) == std::string("\x11\x90", 2));
+}
+
+void test_adts_muxer_writes_m4a_layout() {
+  const std::string path = "/tmp/radicc-tests-muxer.m4a";
+  const std::string id3 = std::string("ID3\x04\x00\x00\x00\x00\x00\x02", 10) + "xy";
+  const std::string stream = id3 + make_adts_frame(100, 'a') + make_adts_frame(80, 'b') + make_adts_frame(60, 'c');
+
+  radicc::AdtsMp4Muxer muxer(radicc::Mp4Metadata{"Artist", "Album", {}});
+  assert(muxer.open(path));
+  const auto* bytes = reinterpret_cast<const std::uint8_t*>(stream.data());
+  assert(muxer.write(bytes, 50));
+  assert(muxer.write(bytes + 50, stream.size() - 50));
+  assert(muxer.finish());
+  assert(muxer.sample_count() == 3);
+
+  std::ifstream file(path, std::ios::binary);
+  std::ostringstream buffer;
+  buffer << file.rdbuf();
+  const std::string data = buffer.str();
+  assert(data.compare(4, 8, "ftypM4A ") == 0);
+  const std::uint32_t ftyp_size = read_u32(data, 0);
+  assert(data.compare(ftyp_size + 4, 4, "mdat") == 0);
+  assert(read_u32(data, ftyp_size) == 8 + 240);
+  assert(data.compare(ftyp_size + 8, 100, std::string(100, 'a')) == 0);
+  const std::size_t moov = ftyp_size + 8 + 240;
+  assert(data.compare(moov + 4, 4, "moov") == 0);
+  assert(read_u32(data, moov) == data.size() - moov);
+  const std::size_t stsz = data.find("stsz");
+  assert(stsz != std::string::npos && read_u32(data, stsz + 12) == 3);
+  assert(data.find("\xA9" "ART") != std::string::npos);
+  const auto& digest = muxer.digest();
+  assert(digest && digest->size == data.size());
+  assert(digest->sha256 == radicc::sha256_hex(data) && digest->xxh3 == radicc::xxh3_hex(data));
+}
+
+void test_adts_muxer_writes_fragments(bool faststart) {
+  const std::string path = "/tmp/radicc-tests-muxer-fragmented.m4a";
+  std::string stream;
+  for (int i = 0; i < 60; ++i) stream += make_adts_frame(20, 'f');
+
+  radicc::Mp4OutputOptions options;
+  options.fragmented = true;
+  options.fragment_seconds = 1;
+  // Fragmented output already leads with moov, so faststart changes nothing.
+  options.faststart = faststart;
+  radicc::AdtsMp4Muxer muxer(radicc::Mp4Metadata{"Artist", "Album", {}}, options);
+  assert(muxer.open(path));
+  assert(muxer.write(reinterpret_cast<const std::uint8_t*>(stream.data()), stream.size()));
+  assert(muxer.finish());
+
+  std::ifstream file(path, std::ios::binary);
+  std::ostringstream buffer;
+  buffer << file.rdbuf();
+  const std::string data = buffer.str();
+  assert(data.compare(4, 8, "ftypiso6") == 0);
+  const std::uint32_t moov = read_u32(data, 0);
+  assert(data.compare(moov + 4, 4, "moov") == 0);
+  assert(data.find("trex") < moov + read_u32(data, moov));
+  // 48 kHz: a one-second fragment closes after 47 frames, the rest follow in a second one.
+  const std::size_t first_moof = moov + read_u32(data, moov);
+  assert(data.compare(first_moof + 4, 4, "moof") == 0);
+  const std::size_t first_trun = data.find("trun", first_moof);
+  assert(read_u32(data, first_trun + 8) == 47);
+  const std::size_t second_moof = data.find("moof", first_trun) - 4;
+  const std::size_t second_trun = data.find("trun", second_moof);
+  assert(read_u32(data, second_trun + 8) == 13);
+  const std::size_t second_tfdt = data.find("tfdt", second_moof);
+  assert(read_u32(data, second_tfdt + 12) == 47 * 1024);
+  assert(muxer.digest() && muxer.digest()->xxh3 == radicc::xxh3_hex(data));
+}
+
+void test_output_sink_commits_atomically() {
+  char dir[] = "/tmp/radicc-tests-sink-XXXXXX";
+  assert(mkdtemp(dir) != nullptr);
+  const std::string path = std::string(dir) + "/out.m4a";
+  std::string payload;
+  for (int i = 0; i < 20000; ++i) payload += static_cast<char>('a' + i % 26);
+
+  radicc::OutputSinkOptions options;
+  options.async = true;
+  options.buffer_size = 4096;
+  options.expected_bytes = 1 << 20;
+  {
+    radicc::OutputSink sink(options);
+    assert(sink.open(path));
+    const std::string partial = sink.partial_path();
+    assert(partial.find("/.out.m4a.partial-") != std::string::npos);
+    assert(sink.write(payload.data(), payload.size()));
+    assert(sink.flush());
+    struct stat st;
+    assert(::stat(path.c_str(), &st) != 0);
+    assert(::stat(partial.c_str(), &st) == 0 && static_cast<std::size_t>(st.st_size) == payload.size());
+    assert(sink.commit());
+    assert(::stat(partial.c_str(), &st) != 0);
+  }
+  std::ifstream file(path, std::ios::binary);
+  const std::string written((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  assert(written == payload);
+
+  std::string partial;
+  {
+    radicc::OutputSink sink;
+    assert(sink.open(path));
+    partial = sink.partial_path();
+    assert(sink.write("x", 1));
+  }
+  struct stat st;
+  assert(::stat(partial.c_str(), &st) != 0);
+  assert(::stat(path.c_str(), &st) == 0 && static_cast<std::size_t>(st.st_size) == payload.size());
+
+  // A sink that keeps its flushes leaves them beside the final path.
+  assert(radicc::kept_partial_output_path("/a.b/out.m4a") == "/a.b/out.partial.m4a");
+  assert(radicc::kept_partial_output_path("/a.b/out") == "/a.b/out.partial");
+  const std::string kept = std::string(dir) + "/next.partial.m4a";
+  options.keep_flushed_on_abort = true;
+  {
+    radicc::OutputSink sink(options);
+    assert(sink.open(std::string(dir) + "/next.m4a"));
+    partial = sink.partial_path();
+    assert(sink.write(payload.data(), 5000) && sink.flush());
+    assert(sink.write(payload.data(), 5000));
+  }
+  assert(::stat(partial.c_str(), &st) != 0);
+  assert(::stat(kept.c_str(), &st) == 0 && st.st_size == 5000);
+  std::remove(kept.c_str());
+  std::remove(path.c_str());
+  rmdir(dir);
+}
+
+void test_upstream_governor_limits_and_shares() {
+  setenv("RADICC_UPSTREAM_RPS", "20", 1);
+  setenv("RADICC_UPSTREAM_BURST", "2", 1);
+  assert(radicc::upstream_host("https://tf-f-rpaa-radiko.smartstream.ne.jp:443/tf/playlist.m3u8") ==
+         "tf-f-rpaa-radiko.smartstream.ne.jp");
+  const auto started = std::chrono::steady_clock::now();
+  for (int i = 0; i < 4; ++i) radicc::acquire_upstream_requests("https://governor.test/a.aac");
+  // Two requests fit the burst; the other two wait 50 ms each.
+  assert(std::chrono::steady_clock::now() - started >= std::chrono::milliseconds(90));
+  unsetenv("RADICC_UPSTREAM_RPS");
+  unsetenv("RADICC_UPSTREAM_BURST");
+
+  assert(radicc::upstream_bandwidth_share() == 0);
+  setenv("RADICC_UPSTREAM_BANDWIDTH_KB", "100", 1);
+  {
+    radicc::UpstreamJobScope backfill(radicc::UpstreamPriority::backfill);
+    {
+      radicc::UpstreamJobScope live(radicc::UpstreamPriority::live);
+      assert(radicc::upstream_bandwidth_share() == 80000);
+    }
+    assert(radicc::upstream_bandwidth_share() == 100000);
+    setenv("RADICC_UPSTREAM_JOB_BANDWIDTH_KB", "30", 1);
+    assert(radicc::upstream_bandwidth_share() == 30000);
+  }
+  unsetenv("RADICC_UPSTREAM_BANDWIDTH_KB");
+  unsetenv("RADICC_UPSTREAM_JOB_BANDWIDTH_KB");
+}
+
+void test_retry_policy_opens_circuit() {
+  using radicc::UpstreamFailure;
+  assert(radicc::classify_http_failure(22, 503) == UpstreamFailure::retryable);
+  assert(radicc::classify_http_failure(22, 429) == UpstreamFailure::retryable);
+  assert(radicc::classify_http_failure(22, 404) == UpstreamFailure::fatal);
+  assert(radicc::classify_http_failure(28, 0) == UpstreamFailure::retryable);
+  assert(radicc::classify_http_failure(3, 0) == UpstreamFailure::fatal);
+  assert(radicc::retry_policy_for("segment").max_attempts == 4);
+
+  setenv("RADICC_RETRY_MAX_ATTEMPTS", "1", 1);
+  setenv("RADICC_CIRCUIT_FAILURES", "2", 1);
+  setenv("RADICC_CIRCUIT_COOLDOWN", "1", 1);
+  const std::string url = "https://breaker.test/v3/station/list/JP13.xml";
+  for (int i = 0; i < 2; ++i) {
+    radicc::UpstreamCall call(url);
+    assert(call.begin());
+    assert(!call.retry(UpstreamFailure::retryable));
+  }
+  assert(!radicc::UpstreamCall(url).begin());
+  std::this_thread::sleep_for(std::chrono::milliseconds(1050));
+  {
+    radicc::UpstreamCall probe(url);
+    assert(probe.begin());
+    assert(!radicc::UpstreamCall(url).begin());
+    probe.succeeded();
+  }
+  assert(radicc::UpstreamCall(url).begin());
+  unsetenv("RADICC_RETRY_MAX_ATTEMPTS");
+  unsetenv("RADICC_CIRCUIT_FAILURES");
+  unsetenv("RADICC_CIRCUIT_COOLDOWN");
+}
+
+void test_cancellation_token_deadline_and_cancel() {
+  auto token = std::make_shared<radicc::CancellationToken>();
+  assert(!token->expired() && !token->has_deadline());
+  token->set_deadline(std::chrono::steady_clock::now() + std::chrono::seconds(60));
+  // A later deadline never loosens an earlier one.
+  token->set_deadline(std::chrono::steady_clock::now() + std::chrono::seconds(600));
+  assert(token->seconds_left() <= 60.0);
+  assert(token->wait_for(0.01));
+  {
+    radicc::CancellationScope scope(token);
+    assert(radicc::current_cancellation() == token);
+    std::thread canceller([token]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      token->cancel("stop");
+    });
+    const auto started = std::chrono::steady_clock::now();
+    assert(!token->wait_for(5.0));
+    assert(std::chrono::steady_clock::now() - started < std::chrono::seconds(2));
+    canceller.join();
+    assert(radicc::current_cancellation_expired());
+    assert(token->cancelled() && token->reason() == "stop");
+  }
+  assert(!radicc::current_cancellation());
+
+  radicc::CancellationToken late;
+  late.set_deadline(std::chrono::steady_clock::now() - std::chrono::seconds(1));
+  assert(late.deadline_exceeded() && !late.cancelled());
+  assert(late.reason() == "deadline exceeded");
+}
+
+void test_log_keeps_lines_whole() {
+  const radicc::LogContext context{"job1", "TBS", "20260322003000"};
+  const std::string text = radicc::format_log_line(radicc::LogFormat::text, radicc::LogLevel::info, context, "hello\n");
+  assert(text == "[job=job1 station=TBS ft=20260322003000] hello\n");
+  const std::string json = radicc::format_log_line(radicc::LogFormat::json, radicc::LogLevel::warn, context, "a \"b\"");
+  assert(json.find("\"level\":\"warn\",\"job\":\"job1\",\"station\":\"TBS\"") != std::string::npos);
+  assert(json.find("\"msg\":\"a \\\"b\\\"\"}\n") != std::string::npos);
+
+  // Lines from concurrent writers reach stderr whole and none are lost.
+  char path[] = "/tmp/radicc-tests-log-XXXXXX";
+  const int fd = mkstemp(path);
+  assert(fd >= 0);
+  radicc::flush_log();
+  const int saved = dup(STDERR_FILENO);
+  dup2(fd, STDERR_FILENO);
+  std::vector<std::thread> writers;
+  for (int t = 0; t < 4; ++t) {
+    writers.emplace_back([t]() {
+      radicc::LogContextScope scope({"job" + std::to_string(t), std::string(), std::string()});
+      for (int i = 0; i < 3000; ++i) RADICC_LOG_INFO << "line " << i;
+    });
+  }
+  for (auto& writer : writers) writer.join();
+  radicc::flush_log();
+  dup2(saved, STDERR_FILENO);
+  close(saved);
+  close(fd);
+
+  std::ifstream file(path);
+  std::string line;
+  int lines = 0;
+  while (std::getline(file, line)) {
+    assert(line.rfind("[job", 0) == 0 && line.find("] line ") != std::string::npos);
+    ++lines;
+  }
+  assert(lines == 4 * 3000);
+  std::remove(path);
+}
+
+void test_config_snapshot_indexes_programs() {
+  char dir[] = "/tmp/radicc-tests-config-XXXXXX";
+  assert(mkdtemp(dir) != nullptr);
+  const std::string path = std::string(dir) + "/radicc.toml";
+  std::ofstream(path) << "base_dir = \"/srv/radiko\"\n"
+                         "[\"Show A\"]\nid = \"a\"\nstation = \"JORF\"\ndate_offset = 1\n"
+                         "[\"Show B\"]\nid = \"a\"\nstation = \"TBS\"\ndate_offset = \"x\"\ntags = [1]\n";
+  const auto config = radicc::ConfigSnapshot::load(path);
+  assert(config->found() && config->base_dir() == "/srv/radiko");
+  const radicc::ProgramConfig* a = config->find_id("a");
+  assert(a && a->section == "Show A" && a->title == "Show A" && a->station == "JORF");
+  assert(a->date_offset && *a->date_offset == 1);
+  const radicc::ProgramConfig* b = config->find_section("Show B");
+  assert(b && !b->date_offset && b->fields.at("station") == "TBS");
+  assert(!config->find_section("Show C") && !config->find_id("c"));
+  // Duplicate id, bad date_offset and the array value.
+  assert(config->errors().size() == 3);
+  assert(!radicc::ConfigSnapshot::load(std::string(dir) + "/missing.toml")->found());
+  std::remove(path.c_str());
+
+  // A reload that cannot parse the file keeps the programs it had.
+  const char* saved = std::getenv("XDG_CONFIG_HOME");
+  const std::string saved_value = saved ? saved : "";
+  setenv("XDG_CONFIG_HOME", dir, 1);
+  const std::string config_dir = std::string(dir) + "/radicc";
+  assert(mkdir(config_dir.c_str(), 0755) == 0);
+  const std::string live_path = config_dir + "/radicc.toml";
+  std::ofstream(live_path) << "[\"Show A\"]\nid = \"a\"\nstation = \"JORF\"\n";
+  const auto loaded = radicc::reload_config();
+  assert(loaded->find_id("a"));
+  std::ofstream(live_path) << "[\"Show A\"\nid = ";
+  assert(radicc::reload_config() == loaded && radicc::current_config() == loaded);
+  if (saved) {
+    setenv("XDG_CONFIG_HOME", saved_value.c_str(), 1);
+  } else {
+    unsetenv("XDG_CONFIG_HOME");
+  }
+  std::remove(live_path.c_str());
+  rmdir(config_dir.c_str());
+  rmdir(dir);
+  radicc::reload_config();
+}
+
+void test_runtime_settings_read_env_files() {
+  char dir[] = "/tmp/radicc-tests-env-XXXXXX";
+  assert(mkdtemp(dir) != nullptr);
+  const std::string config_dir = std::string(dir) + "/radicc";
+  assert(mkdir(config_dir.c_str(), 0755) == 0);
+  std::ofstream(config_dir + "/env") << "RADICC_DIR=/srv/env\nRADIKO_USER=env-user\n";
+  std::ofstream(config_dir + "/.env") << "RADICC_DIR=\"/srv/dotenv\"\nRADIKO_PASS='secret'\nRADICC_ASYNC_WRITER=1\n";
+  const char* saved = std::getenv("XDG_CONFIG_HOME");
+  const std::string saved_value = saved ? saved : "";
+  setenv("XDG_CONFIG_HOME", dir, 1);
+  unsetenv("RADIKO_USER");
+  unsetenv("RADIKO_PASS");
+
+  const auto settings = radicc::load_runtime_settings(true);
+  assert(settings->loaded_files.size() == 2);
+  assert(settings->output_dir == "/srv/dotenv/");
+  assert(settings->has_credentials() && settings->radiko_user == "env-user" && settings->radiko_pass == "secret");
+  assert(settings->async_writer && settings->native_muxer && !settings->hedge_sources);
+  // The files never reach the process environment.
+  assert(std::getenv("RADIKO_USER") == nullptr);
+
+  // Only settings that change how a command runs count towards the fingerprint.
+  const std::string fingerprint = settings->fingerprint();
+  setenv("RADICC_SOCKET", "/tmp/radicc-tests.sock", 1);
+  assert(settings->fingerprint() == fingerprint);
+  setenv("RADICC_NATIVE_MUXER", "0", 1);
+  assert(settings->fingerprint() != fingerprint);
+  unsetenv("RADICC_NATIVE_MUXER");
+  unsetenv("RADICC_SOCKET");
+  assert(settings->fingerprint() == fingerprint);
+
+  // A scoped request keeps its snapshot across a reload; others see the new one.
+  {
+    radicc::RuntimeSettingsScope scope(settings);
+    std::ofstream(config_dir + "/.env") << "RADICC_ASYNC_WRITER=0\n";
+    radicc::reload_runtime_settings();
+    assert(radicc::runtime_env("RADICC_ASYNC_WRITER") == "1");
+    std::thread([] { assert(radicc::runtime_env("RADICC_ASYNC_WRITER") == "0"); }).join();
+  }
+  assert(radicc::runtime_env("RADICC_ASYNC_WRITER") == "0");
+
+  if (saved) {
+    setenv("XDG_CONFIG_HOME", saved_value.c_str(), 1);
+  } else {
+    unsetenv("XDG_CONFIG_HOME");
+  }
+  radicc::reload_runtime_settings();
+  std::remove((config_dir + "/env").c_str());
+  std::remove((config_dir + "/.env").c_str());
+  rmdir(config_dir.c_str());
+  rmdir(dir);
+}
+
+void test_local_socket_replaces_stale_file() {
+  char dir[] = "/tmp/radicc-tests-sock-XXXXXX";
+  assert(mkdtemp(dir) != nullptr);
+  const std::string path = std::string(dir) + "/radicc/radicc.sock";
+  assert(radicc::connect_local_socket(path) < 0);
+
+  const int first = radicc::listen_local_socket(path);
+  assert(first >= 0);
+  struct stat st;
+  assert(stat(path.c_str(), &st) == 0 && (st.st_mode & 0777) == 0600);
+  // A live server keeps its socket.
+  assert(radicc::listen_local_socket(path) < 0);
+  const int client = radicc::connect_local_socket(path);
+  assert(client >= 0);
+  close(client);
+
+  // Once it is gone, the file left behind is taken over.
+  close(first);
+  assert(stat(path.c_str(), &st) == 0);
+  const int second = radicc::listen_local_socket(path);
+  assert(second >= 0);
+  close(second);
+
+  // Other files at the path are left alone.
+  std::remove(path.c_str());
+  std::ofstream(path) << "data";
+  assert(radicc::listen_local_socket(path) < 0 && errno == EEXIST);
+  assert(stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode));
+
+  std::remove(path.c_str());
+  rmdir((std::string(dir) + "/radicc").c_str());
+  rmdir(dir);
+}
+
+radicc::ProgramEventInfo search_program(const std::string& title, const std::string& pfm, const std::string& ft) {
+  radicc::ProgramEventInfo program;
+  program.title = title;
+  program.pfm = pfm;
+  program.ft = ft;
+  program.to = ft.substr(0, 8) + "235959";
+  return program;
+}
+
+void test_program_search_index_ranks_and_updates() {
+  radicc::ProgramSearchIndex index;
+  index.update_station("LFR", {search_program("オールナイトニッポン", "星野源", "20260322010000"),
+                               search_program("ＮＥＷＳ ＷＡＶＥ", "", "20260322070000")});
+  index.update_station("TBS", {search_program("JUNK 爆笑問題カーボーイ", "爆笑問題", "20260324010000"),
+                               search_program("深夜の音楽", "オールナイト小僧", "20260321230000")});
+  assert(index.size() == 4);
+
+  // Title matches outrank performer matches.
+  auto hits = index.search("オールナイト", 10);
+  assert(hits.size() == 2);
+  assert(hits[0].station_id == "LFR" && hits[1].station_id == "TBS");
+  assert(hits[0].score > hits[1].score);
+  // Full-width and case are folded; a station filter narrows the search.
+  assert(index.search("news wave", 10).size() == 1);
+  assert(index.search("爆笑", 10, "LFR").empty());
+  assert(index.search("爆笑", 10, "TBS").size() == 1);
+  assert(index.search("音", 10).size() == 1);
+
+  // A refreshed schedule replaces the station's old entries.
+  index.update_station("LFR", {search_program("オードリーのオールナイトニッポン", "オードリー", "20260329010000")});
+  assert(index.size() == 3);
+  hits = index.search("オールナイトニッポン", 10);
+  assert(hits.size() == 1 && hits[0].program.ft == "20260329010000");
+  assert(index.search("news", 10).empty());
+}
+
+void test_match_key_folds_title_variants() {
+  // Full-width ASCII, case, ideographic spaces and a wave dash variant.
+  assert(radicc::match_key("Ａぇ！　ｇｒｏｕｐのＭＢＳヤングタウン") == radicc::match_key("Aぇ! groupのMBSヤングタウン"));
+  assert(radicc::match_key("  JUNK\t 爆笑問題〜カーボーイ ") == "junk 爆笑問題~カーボーイ");
+  // Half-width katakana, with its voiced mark composed.
+  assert(radicc::match_key("ｶﾞｯﾂﾘ") == "ガッツリ");
+  assert(radicc::match_key("か\xE3\x82\x99") == "が");
+
+  std::size_t position = 0;
+  assert(radicc::decode_utf8("\xC0\xAF", position) == 0xFFFD && position == 1);
+
+  const auto schedule = radicc::parse_program_schedule(
+      "<prog id=\"1\" ft=\"20260322010000\" to=\"20260322030000\"><title>ＪＵＮＫ　爆笑問題カーボーイ</title></prog>"
+      "<prog id=\"2\" ft=\"20260329010000\" to=\"20260329030000\"><title>JUNK 爆笑問題カーボーイ</title></prog>");
+  assert(schedule->find_title("junk 爆笑問題カーボーイ").size() == 2);
+  assert(schedule->find_title("JUNK").empty());
+}
+
+void test_image_src_scanner_stops_at_first_image() {
+  // The page arrives in pieces that split the tag and the attribute.
+  const std::string page =
+      "<html><body><img class=\"logo\" src=\"\"><p>x</p><img alt=\"cover\" src=\"https://img.example/a.jpg\">"
+      "<img src=\"https://img.example/b.jpg\"></body></html>";
+  radicc::ImageSrcScanner scanner;
+  std::size_t fed = 0;
+  bool more = true;
+  for (; more && fed < page.size(); fed += 7) more = scanner.feed(std::string_view(page).substr(fed, 7));
+  assert(!more && scanner.src() == "https://img.example/a.jpg");
+  assert(fed < page.size());
+
+  radicc::ImageSrcScanner none;
+  assert(none.feed("<html><img alt=\"x\"></html>"));
+  assert(none.src().empty());
+}
+
+void test_markup_scanners_match_regex() {
+  // Random documents built from pieces of every pattern, so partial and
+  // overlapping tags come up often, must match exactly as the regexes did.
+  static const std::vector<std::string> kPieces = {
+      "<url", "<urls", "<url ", ">", "</url>", " timefree=\"1\"", " areafree=\"0\"", "<playlist_create_url>",
+      "</playlist_create_url>", "<prog", "<progs", " id=\"", "p1", "\"", " ft=\"", " to=\"", "20260322010000",
+      " id=\"p2\"", " ft=\"20260322010000\"", " to=\"20260322030000\"",
+      "<prog id=\"p3\" ft=\"20260322010000\" to=\"20260322030000\">", "https://radiko.jp/#!/ts/TBS/20260322010000",
+      "2026", "</prog>", "<title>", "</title>", "<img", " src=\"", "https://img.example/a.jpg", "x", " ", "/",
+      "https://radiko.jp/#!/ts/", "TBS", "\n"};
+  std::mt19937 random(20260322);
+  std::uniform_int_distribution<std::size_t> piece(0, kPieces.size() - 1);
+  std::uniform_int_distribution<int> length(0, 40);
+  for (int round = 0; round < 3000; ++round) {
+    std::string text;
+    for (int i = length(random); i > 0; --i) text += kPieces[piece(random)];
+
+    const auto title = radicc::find_element_text(text, "title");
+    const auto expected_title = radicc::regex_reference::element_text(text, "title");
+    assert(title.has_value() == expected_title.has_value() && (!title || *title == *expected_title));
+
+    const auto expected_urls = radicc::regex_reference::elements(text, "url");
+    std::size_t urls = 0;
+    for (auto url = radicc::find_element(text, "url"); url; url = radicc::find_element(text, "url", url->end)) {
+      assert(urls < expected_urls.size());
+      assert(url->attributes == expected_urls[urls].attributes && url->body == expected_urls[urls].body);
+      ++urls;
+    }
+    assert(urls == expected_urls.size());
+
+    const auto expected_progs = radicc::regex_reference::progs(text);
+    std::size_t progs = 0;
+    for (auto prog = radicc::find_prog_element(text); prog; prog = radicc::find_prog_element(text, prog->end)) {
+      assert(progs < expected_progs.size());
+      const auto& expected = expected_progs[progs++];
+      assert(prog->id == expected.id && prog->ft == expected.ft && prog->to == expected.to &&
+             prog->body == expected.body);
+    }
+    assert(progs == expected_progs.size());
+
+    radicc::ImageSrcScanner scanner;
+    bool more = true;
+    for (std::size_t fed = 0; more && fed < text.size(); fed += 5) more = scanner.feed(std::string_view(text).substr(fed, 5));
+    if (more) scanner.finish();
+    assert(scanner.src() == radicc::regex_reference::image_src(text).value_or(std::string()));
+
+    const auto parsed = radicc::parse_radiko_url(text);
+    const auto expected_url = radicc::regex_reference::radiko_url(text);
+    assert(parsed.has_value() == expected_url.has_value());
+    if (parsed) {
+      const auto& [station, dt] = *parsed;
+      assert(station == expected_url->first && dt[0] + dt[1] + dt[2] == expected_url->second);
+    }
+  }
+}
+
+void test_schedule_snapshot_round_trip() {
+  char dir[] = "/tmp/radicc-tests-snapshot-XXXXXX";
+  assert(mkdtemp(dir) != nullptr);
+  const std::string path = std::string(dir) + "/schedule.snapshot";
+  const auto program = [](const char* ft, const char* to, const char* title) {
+    radicc::ProgramEventInfo info;
+    info.event_url = std::string("https://radiko.jp/mobile/events/") + ft;
+    info.ft = ft;
+    info.to = to;
+    info.title = title;
+    info.pfm = "Host";
+    info.img = info.image_url = "https://img.example/cover.jpg";
+    return info;
+  };
+  // Out of order on purpose; records are sorted by station and start.
+  assert(radicc::write_schedule_snapshot(
+      path, {{"TBS",
+              {program("20260323050000", "20260323060000", "Morning"),
+               program("20260322050000", "20260322060000", "Morning"),
+               program("20260323040000", "20260323050000", "Late night")}},
+             {"LFR", {program("20260322250000", "20260323010000", "ANN")}}}));
+
+  const auto snapshot = radicc::ScheduleSnapshot::open(path);
+  assert(snapshot && snapshot->program_count() == 4);
+  assert((snapshot->station_ids() == std::vector<std::string>{"LFR", "TBS"}));
+  const auto week = snapshot->programs("TBS");
+  assert(week.size() == 3 && week[0].ft == "20260322050000" && week[2].ft == "20260323050000");
+  assert(week[1].title == "Late night" && week[1].image_url == week[1].img && week[1].pfm == "Host");
+  const auto day = snapshot->programs("TBS", "20260322050000", "20260323050000");
+  assert(day.size() == 2 && day[1].to == "20260323050000");
+  assert(snapshot->covers("TBS", "20260322050000", "20260323050000"));
+  assert(!snapshot->covers("TBS", "20260323050000", "20260324050000"));
+  assert(snapshot->programs("QRR").empty() && !snapshot->covers("QRR", "20260322050000", "20260323050000"));
+
+  // A rebuilt snapshot replaces the file; the old mapping stays readable.
+  assert(radicc::write_schedule_snapshot(path, {{"QRR", {program("20260322050000", "20260322060000", "News")}}}));
+  assert(snapshot->programs("LFR").size() == 1);
+  assert((radicc::ScheduleSnapshot::open(path)->station_ids() == std::vector<std::string>{"QRR"}));
+
+  assert(::truncate(path.c_str(), 100) == 0);
+  assert(!radicc::ScheduleSnapshot::open(path));
+}
+
+void test_json_writer_and_reader() {
+  radicc::JsonWriter json;
+  json.begin_object()
+      .member("title", "A \"quoted\"\ttitle\x01")
+      .member("size", std::uint64_t{42})
+      .member("offset", -3)
+      .member("score", 0.5, 3)
+      .member("done", true)
+      .key("items")
+      .begin_array()
+      .value("a")
+      .begin_object()
+      .end_object()
+      .null()
+      .end_array()
+      .end_object();
+  assert(json.str() ==
+         "{\"title\":\"A \\\"quoted\\\"\\ttitle\\u0001\",\"size\":42,\"offset\":-3,\"score\":0.500,"
+         "\"done\":true,\"items\":[\"a\",{},null]}");
+
+  // A sink receives the output as the buffer fills.
+  std::ostringstream out;
+  radicc::JsonWriter streamed(out, 16);
+  streamed.begin_array();
+  for (int i = 0; i < 10; ++i) streamed.value("item");
+  streamed.end_array();
+  assert(!out.str().empty() && streamed.str().size() < 16);
+  streamed.flush();
+  assert(out.str().size() == 2 + 10 * 6 + 9);
+
+  // Nesting past the tracked depth marks the document invalid.
+  radicc::JsonWriter deep;
+  for (int i = 0; i < 65; ++i) deep.begin_array();
+  assert(!deep.ok());
+  for (int i = 0; i < 65; ++i) deep.end_array();
+  assert(deep.str() == std::string(65, '[') + std::string(65, ']'));
+
+  const auto request = radicc::parse_json_object(
+      " {\"url\": \"https://radiko.jp/#!/ts/JORF/20260322003000\", \"date_offset\": 1, \"async\": true,"
+      " \"note\": \"\\u30e9\\u30b8\\ud83d\\udcfb\\n\", \"nested\": {\"a\": [1, 2.5e3]}, \"ratio\": 1.5} ");
+  assert(request);
+  assert(request->get_string("url") == "https://radiko.jp/#!/ts/JORF/20260322003000");
+  assert(request->get_integer("date_offset") == 1);
+  assert(request->get_bool("async") == true);
+  assert(request->get_string("note") == "ラジ\xF0\x9F\x93\xBB\n");
+  assert(request->find("nested")->text == "{\"a\": [1, 2.5e3]}");
+  assert(!request->get_integer("ratio") && !request->get_string("date_offset") && !request->find("missing"));
+  assert(!radicc::parse_json_object("{\"url\": \"x\"} trailing"));
+  assert(!radicc::parse_json_object("{\"url\": \"unterminated}"));
+  assert(!radicc::parse_json_object("{\"a\": 01}"));
+  assert(!radicc::parse_json_object("[1]"));
+}
+
+void test_record_progress_snapshot() {
+  radicc::RecordProgress progress;
+  progress.expected_ms = 30 * 60 * 1000;
+  radicc::set_record_phase(progress, radicc::RecordPhase::recording);
+  radicc::begin_record_source(progress, 1, 6);
+  progress.chunks_done = 2;
+  progress.position_ms = 12 * 60 * 1000;
+
+  const auto snapshot = radicc::snapshot_record_progress(progress);
+  assert(snapshot.phase == radicc::RecordPhase::recording);
+  assert(snapshot.source_index == 1 && snapshot.chunks_total == 6);
+  assert(snapshot.eta_seconds.has_value());
+  const std::string json = radicc::record_progress_json(snapshot);
+  assert(json.find("\"phase\":\"recording\"") != std::string::npos);
+  assert(json.find("\"chunks_done\":2,\"chunks_total\":6") != std::string::npos);
+  assert(radicc::format_record_progress(snapshot).rfind("recording 12:00/30:00 (40%) chunks 2/6", 0) == 0);
+
+  radicc::set_record_phase(progress, radicc::RecordPhase::done);
+  const auto finished = radicc::snapshot_record_progress(progress);
+  assert(!finished.eta_seconds.has_value());
+  assert(radicc::record_progress_json(finished).find("\"eta_seconds\":null") != std::string::npos);
+}
+
+void test_metrics_registry_renders_prometheus() {
+  radicc::MetricsRegistry registry;
+  auto& counter = registry.counter("test_events_total", "Events.", "kind=\"a\"");
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&counter]() {
+      for (int i = 0; i < 1000; ++i) counter.add();
+    });
+  }
+  for (auto& thread : threads) thread.join();
+  assert(counter.value() == 4000);
+
+  auto& histogram = registry.histogram("test_latency_seconds", "Latency.", {0.1, 1});
+  histogram.observe(0.05);
+  histogram.observe(0.5);
+  histogram.observe(5);
+  const std::string text = registry.render_prometheus();
+  assert(text.find("# TYPE test_events_total counter\ntest_events_total{kind=\"a\"} 4000\n") != std::string::npos);
+  assert(text.find("test_latency_seconds_bucket{le=\"0.1\"} 1\n") != std::string::npos);
+  assert(text.find("test_latency_seconds_bucket{le=\"1\"} 2\n") != std::string::npos);
+  assert(text.find("test_latency_seconds_bucket{le=\"+Inf\"} 3\n") != std::string::npos);
+  assert(text.find("test_latency_seconds_count 3\n") != std::string::npos);
+
+  assert(radicc::classify_upstream_endpoint("https://radiko.jp/v2/api/auth1") == "auth1");
+  assert(radicc::classify_upstream_endpoint("https://radiko.jp/v3/program/station/date/20260322/JORF.xml") == "program_xml");
+  assert(radicc::classify_upstream_endpoint("https://radiko.jp/mobile/events/123") == "event_page");
+}
+
+void test_trace_writes_chrome_json() {
+  { radicc::TraceSpan ignored("before_start"); }
+  radicc::start_trace();
+  {
+    radicc::TraceSpan outer("outer", std::string("detail \"quoted\""));
+    std::thread([]() { radicc::TraceSpan inner("worker"); }).join();
+  }
+  const std::string path = "/tmp/radicc-tests-trace.json";
+  assert(radicc::write_trace(path));
+  std::ifstream file(path);
+  std::ostringstream buffer;
+  buffer << file.rdbuf();
+  const std::string json = buffer.str();
+  assert(json.rfind("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", 0) == 0);
+  assert(json.find("before_start") == std::string::npos);
+  assert(json.find("\"name\":\"outer\"") != std::string::npos);
+  assert(json.find("\"detail\":\"detail \\\"quoted\\\"\"") != std::string::npos);
+  const std::size_t worker = json.find("\"name\":\"worker\"");
+  const std::size_t outer = json.find("\"name\":\"outer\"");
+  assert(worker != std::string::npos);
+  const std::string worker_tid = json.substr(json.find("\"tid\":", worker), 9);
+  const std::string outer_tid = json.substr(json.find("\"tid\":", outer), 9);
+  assert(worker_tid != outer_tid);
+}
+
+void test_hls_playlist_resolution() {
+  const auto master = radicc::parse_hls_playlist(
+      "#EXTM3U\n#EXT-X-STREAM-INF:BANDWIDTH=52973\r\nchunklist.m3u8?x=1\n",
+      "https://example.jp/tf/playlist.m3u8?station_id=JORF");
+  assert(master.variant_urls.size() == 1 && master.segment_urls.empty());
+  assert(master.variant_urls[0] == "https://example.jp/tf/chunklist.m3u8?x=1");
+
+  const auto media = radicc::parse_hls_playlist(
+      "#EXTM3U\n#EXTINF:5,\n/seg/1.aac\n#EXTINF:5,\nhttps://cdn.example.jp/2.aac\n",
+      "https://example.jp/tf/chunklist.m3u8");
+  assert(media.segment_urls.size() == 2);
+  assert(media.segment_urls[0] == "https://example.jp/seg/1.aac");
+  assert(media.segment_urls[1] == "https://cdn.example.jp/2.aac");
+}
+
 }  // namespace
 
 int main() {
@@ -64,5 +953,30 @@ int main() {
   test_output_path_sanitizes_generated_names();
   test_output_path_keeps_apostrophe();
   test_output_path_date_offset();
+  test_stream_sources_ranked_by_history();
+  test_stream_definition_cache_serves_and_invalidates();
+  test_recording_store_replays_airing();
+  test_adts_header_and_config();
+  test_adts_muxer_writes_m4a_layout();
+  test_adts_muxer_writes_fragments(false);
+  test_adts_muxer_writes_fragments(true);
+  test_output_sink_commits_atomically();
+  test_upstream_governor_limits_and_shares();
+  test_retry_policy_opens_circuit();
+  test_cancellation_token_deadline_and_cancel();
+  test_log_keeps_lines_whole();
+  test_config_snapshot_indexes_programs();
+  test_runtime_settings_read_env_files();
+  test_local_socket_replaces_stale_file();
+  test_program_search_index_ranks_and_updates();
+  test_match_key_folds_title_variants();
+  test_image_src_scanner_stops_at_first_image();
+  test_markup_scanners_match_regex();
+  test_schedule_snapshot_round_trip();
+  test_json_writer_and_reader();
+  test_hls_playlist_resolution();
+  test_record_progress_snapshot();
+  test_metrics_registry_renders_prometheus();
+  test_trace_writes_chrome_json();
   return 0;
 }